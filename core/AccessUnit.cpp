@@ -0,0 +1,156 @@
+#include "AccessUnit.h"
+#include <string.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+static const uint8_t START_CODE[] = {0x00, 0x00, 0x00, 0x01};
+
+void release_access_unit(AccessUnit *au) {
+  av_buffer_unref(&au->buf);
+  *au = AccessUnit();
+}
+
+bool read_first_mb_in_slice(const uint8_t *nal, uint32_t size,
+                            uint32_t *firstMb) {
+  // ue(v) right after the 1-byte NAL header. Skip emulation prevention
+  // bytes (00 00 03) while collecting bits; 32 bits cover any real value.
+  uint64_t bits = 0;
+  int nbits = 0;
+  int zeros = 0;
+  for (uint32_t i = 1; i < size && nbits < 64 - 8; i++) {
+    if (zeros >= 2 && nal[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    zeros = nal[i] == 0 ? zeros + 1 : 0;
+    bits = (bits << 8) | nal[i];
+    nbits += 8;
+  }
+  if (nbits == 0)
+    return false;
+  bits <<= 64 - nbits; // MSB-align
+
+  int leadingZeros = 0;
+  while (leadingZeros < nbits && !(bits & (1ULL << 63))) {
+    bits <<= 1;
+    leadingZeros++;
+  }
+  if (leadingZeros > 31 || 2 * leadingZeros + 1 > nbits)
+    return false;
+
+  bits <<= 1; // Marker bit
+  uint64_t suffix = leadingZeros ? bits >> (64 - leadingZeros) : 0;
+  *firstMb = (uint32_t)((1ULL << leadingZeros) - 1 + suffix);
+  return true;
+}
+
+AccessUnitAssembler::AccessUnitAssembler(PacketPool *pool) : m_pool(pool) {}
+
+AccessUnitAssembler::~AccessUnitAssembler() {
+  release_access_unit(&m_pending);
+}
+
+bool AccessUnitAssembler::starts_new_unit(const uint8_t *nal, uint32_t size,
+                                          uint64_t timestampUs) const {
+  if (empty() || size == 0)
+    return false;
+  if (timestampUs != m_pending.timestamp_us)
+    return true;
+
+  int nalType = nal[0] & 0x1F;
+  if (nalType == NAL_AUD)
+    return true;
+
+  if (!m_pending.has_slices())
+    return false; // Still collecting headers for the next picture
+
+  switch (nalType) {
+  case NAL_SPS:
+  case NAL_PPS:
+  case NAL_SEI:
+    return true;
+  case NAL_SLICE:
+  case NAL_IDR: {
+    uint32_t firstMb = 0;
+    return read_first_mb_in_slice(nal, size, &firstMb) && firstMb == 0;
+  }
+  default:
+    return false;
+  }
+}
+
+bool AccessUnitAssembler::append(const uint8_t *nal, uint32_t size,
+                                 uint64_t timestampUs) {
+  if (size == 0)
+    return true;
+
+  size_t needed = (size_t)m_pending.size + 4 + size;
+  if (!m_pending.buf || PacketPool::usable_size(m_pending.buf) < needed) {
+    // First NAL of the unit, or an oversized picture: take a (bigger)
+    // pooled buffer and carry over what we have so far.
+    AVBufferRef *buf = m_pool->get(needed);
+    if (!buf) {
+      release_access_unit(&m_pending);
+      return false;
+    }
+    if (m_pending.size) {
+      memcpy(buf->data, m_pending.buf->data, m_pending.size);
+      m_pool->count_copy(m_pending.size);
+    }
+    av_buffer_unref(&m_pending.buf);
+    m_pending.buf = buf;
+  }
+
+  int nalType = nal[0] & 0x1F;
+  if (empty())
+    m_pending.timestamp_us = timestampUs;
+
+  uint8_t *dst = m_pending.buf->data + m_pending.size;
+  memcpy(dst, START_CODE, 4);
+  memcpy(dst + 4, nal, size);
+  m_pool->count_copy(size);
+
+  uint32_t offset = m_pending.size + 4;
+  m_pending.size += 4 + size;
+
+  if (nalType == NAL_SPS) {
+    m_pending.sps_offset = offset;
+    m_pending.sps_size = size;
+  } else if (nalType == NAL_PPS) {
+    m_pending.pps_offset = offset;
+    m_pending.pps_size = size;
+  }
+  bool slice = nalType == NAL_SLICE || nalType == NAL_IDR;
+  if (slice && !m_pending.slice_size) {
+    m_pending.slice_offset = offset;
+    m_pending.slice_size = size;
+  }
+  if (slice) {
+    uint32_t n = m_pending.slice_count++;
+    if (n < AccessUnit::MAX_SLICES) {
+      uint32_t firstMb = 0;
+      read_first_mb_in_slice(nal, size, &firstMb);
+      m_pending.slice_first_mb[n] = firstMb;
+    }
+  }
+  if (slice && (nal[0] & 0x60))
+    m_pending.reference = true;
+  m_pending.nal_mask |= 1u << nalType;
+  m_pending.nal_count++;
+  return true;
+}
+
+void AccessUnitAssembler::take(AccessUnit *out) {
+  release_access_unit(out);
+  if (m_pending.buf) {
+    // FFmpeg requires zeroed padding after the bitstream
+    memset(m_pending.buf->data + m_pending.size, 0,
+           AV_INPUT_BUFFER_PADDING_SIZE);
+  }
+  *out = m_pending;
+  m_pending = AccessUnit();
+}
+
+void AccessUnitAssembler::discard() { release_access_unit(&m_pending); }
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef ACCESS_UNIT_H
+#define ACCESS_UNIT_H
+
+#include "PacketPool.h"
+#include <stdint.h>
+
+// H.264 NAL unit types used by the receiver
+#define NAL_SLICE 1
+#define NAL_IDR 5
+#define NAL_SEI 6
+#define NAL_SPS 7
+#define NAL_PPS 8
+#define NAL_AUD 9
+
+// One coded picture as a single Annex B byte stream (start code + NAL, ...),
+// ready to go to the decoder in one avcodec_send_packet call.
+struct AccessUnit {
+  AVBufferRef *buf = nullptr; // Pooled; zeroed padding follows `size` bytes
+  uint32_t size = 0;
+  uint64_t timestamp_us = 0; // Capture time of the picture (sender clock)
+  uint32_t nal_mask = 0;     // Bit n set if a NAL of type n is present
+  uint32_t nal_count = 0;
+  bool reference = false; // Some slice has nal_ref_idc != 0
+
+  // Last SPS/PPS payload inside the buffer (size 0 if absent)
+  uint32_t sps_offset = 0, sps_size = 0;
+  uint32_t pps_offset = 0, pps_size = 0;
+  // First slice NAL (size 0 if none); its header names the PPS in use
+  uint32_t slice_offset = 0, slice_size = 0;
+  // first_mb_in_slice of the slices, in arrival order; slice_count goes on
+  // counting past MAX_SLICES
+  enum { MAX_SLICES = 32 };
+  uint32_t slice_count = 0;
+  uint32_t slice_first_mb[MAX_SLICES];
+
+  const uint8_t *data() const { return buf ? buf->data : nullptr; }
+  bool has(int nalType) const { return (nal_mask & (1u << nalType)) != 0; }
+  bool is_keyframe() const { return has(NAL_IDR); }
+  bool has_slices() const { return has(NAL_SLICE) || has(NAL_IDR); }
+};
+
+// Groups the per-NAL messages sent by VideoEncoder.sendNALUs back into
+// access units. A new unit starts on a capture timestamp change, an AUD,
+// parameter sets/SEI after a slice, or a slice with first_mb_in_slice == 0.
+//
+// The pending unit is written straight into a PacketPool buffer; take()
+// hands that buffer on by reference, so each NAL is copied once (ring ->
+// pool) and the steady state does no heap allocation.
+class AccessUnitAssembler {
+public:
+  explicit AccessUnitAssembler(PacketPool *pool);
+  ~AccessUnitAssembler();
+
+  // True if `nal` cannot belong to the unit currently pending.
+  bool starts_new_unit(const uint8_t *nal, uint32_t size,
+                       uint64_t timestampUs) const;
+
+  // Appends `nal` (without start code) to the pending unit. Returns false if
+  // no buffer could be allocated; the pending unit is dropped in that case.
+  bool append(const uint8_t *nal, uint32_t size, uint64_t timestampUs);
+
+  bool empty() const { return m_pending.nal_count == 0; }
+  const AccessUnit &pending() const { return m_pending; }
+
+  // Moves the pending unit into *out, releasing whatever out still held.
+  void take(AccessUnit *out);
+
+  // Drops the pending unit.
+  void discard();
+
+private:
+  PacketPool *m_pool;
+  AccessUnit m_pending;
+};
+
+// Drops the unit's buffer reference and clears it
+void release_access_unit(AccessUnit *au);
+
+// Parses first_mb_in_slice from a slice NAL. Returns false if truncated.
+bool read_first_mb_in_slice(const uint8_t *nal, uint32_t size,
+                            uint32_t *firstMb);
+
+#endif // ACCESS_UNIT_H
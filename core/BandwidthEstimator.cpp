@@ -0,0 +1,333 @@
+#include "BandwidthEstimator.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// Trendline: exponential smoothing of the accumulated delay, and the gain
+// applied to the slope before it is compared against the threshold
+static const double SMOOTHING = 0.9;
+static const double TREND_GAIN = 4.0;
+static const int MAX_TREND_SAMPLES = 60;
+
+// Adaptive threshold (ms): starting point, bounds, and how fast it follows
+// the trend up and down. Spikes far above it are not learned from.
+static const double INITIAL_THRESHOLD_MS = 12.5;
+static const double MIN_THRESHOLD_MS = 6.0;
+static const double MAX_THRESHOLD_MS = 600.0;
+static const double K_UP = 0.0087;
+static const double K_DOWN = 0.039;
+static const double MAX_ADAPT_OFFSET_MS = 15.0;
+static const double MAX_ADAPT_STEP_MS = 100.0;
+
+// Overuse has to last this long (and for two groups) to count
+static const double OVERUSE_TIME_MS = 10.0;
+
+// A gap this long (a paused or reconnecting sender) restarts the trend
+static const int64_t MAX_GROUP_GAP_US = 2000000;
+
+// Incoming rate window: RATE_BUCKETS buckets of this size
+static const int64_t BUCKET_US = 10000;
+
+// AIMD: decrease to this share of the incoming rate, at most this often;
+// otherwise grow multiplicatively, or additively near the link rate
+static const double BETA = 0.85;
+static const int64_t MIN_DECREASE_INTERVAL_US = 200000;
+static const double INCREASE_PER_S = 1.08;
+static const double ADDITIVE_SHARE_PER_S = 0.04;
+static const double ADDITIVE_MIN_BPS = 48000;
+static const int64_t MAX_RATE_STEP_US = 200000;
+
+// Never ask for much more than actually arrives: the sender may not be
+// filling the target, and probing has to start from what it does send
+static const double MAX_OVER_INCOMING = 1.5;
+static const double INCOMING_MARGIN_BPS = 10000;
+
+// Loss above this share of a window's packets cuts the target by half the
+// loss rate
+static const double LOSS_THRESHOLD = 0.10;
+static const int64_t LOSS_WINDOW_US = 1000000;
+static const uint32_t MIN_LOSS_SAMPLES = 20;
+
+// Frame rate ladder: full, half, quarter of max_fps. A rung needs this many
+// bits per picture, and 20% more to climb back up to it.
+static const double MIN_BITS_PER_FRAME = 25000;
+static const double FPS_UP_HYSTERESIS = 1.2;
+
+// poll(): resend on a change this large (at most every interval), and
+// refresh regardless this often
+static const double REPORT_CHANGE = 0.05;
+static const int64_t MIN_REPORT_INTERVAL_US = 100000;
+static const int64_t REFRESH_INTERVAL_US = 1000000;
+
+BandwidthEstimator::BandwidthEstimator(const BweConfig &config)
+    : m_config(config) {
+  reset();
+}
+
+void BandwidthEstimator::reset() {
+  m_haveGroup = m_havePrev = false;
+  m_groupSendUs = m_groupArrivalUs = 0;
+  m_prevSendUs = m_prevArrivalUs = 0;
+
+  m_firstArrivalUs = 0;
+  m_accumulated = m_smoothed = 0;
+  m_samples = 0;
+  m_trend = 0;
+
+  m_threshold = INITIAL_THRESHOLD_MS;
+  m_prevTrend = 0;
+  m_lastDetectUs = -1;
+  m_overuseMs = -1;
+  m_overuseCount = 0;
+  m_signal = SIGNAL_NORMAL;
+  m_overuses = 0;
+
+  memset(m_buckets, 0, sizeof(m_buckets));
+  m_bucketEpoch = -1;
+  m_firstPacketUs = -1;
+  m_incomingBps = 0;
+
+  m_targetBps = m_config.start_bps;
+  m_linkBps = 0;
+  m_lastRateUs = -1;
+  m_lastDecreaseUs = -1;
+  m_holding = false;
+  m_received = m_lost = 0;
+  m_lossWindowUs = -1;
+  m_fps = m_config.max_fps;
+  update_fps();
+
+  m_sentBps = 0;
+  m_sentFps = 0;
+  m_sentUs = -1;
+}
+
+void BandwidthEstimator::on_packet(int64_t sendUs, int64_t arrivalUs,
+                                   size_t bytes) {
+  if (m_firstPacketUs < 0) {
+    m_firstPacketUs = arrivalUs;
+    m_lossWindowUs = arrivalUs;
+  }
+  update_incoming(arrivalUs, bytes);
+  m_received++;
+
+  if (!m_haveGroup) {
+    m_haveGroup = true;
+    m_groupSendUs = sendUs;
+    m_groupArrivalUs = arrivalUs;
+    return;
+  }
+  if (sendUs == m_groupSendUs) {
+    m_groupArrivalUs = std::max(m_groupArrivalUs, arrivalUs);
+    return;
+  }
+  if (sendUs < m_groupSendUs)
+    return; // Reordered into an earlier picture: only counts as rate
+
+  add_group(m_groupSendUs, m_groupArrivalUs);
+  m_groupSendUs = sendUs;
+  m_groupArrivalUs = arrivalUs;
+}
+
+void BandwidthEstimator::on_lost(uint32_t count) { m_lost += count; }
+
+// A group is complete once the next one starts
+void BandwidthEstimator::add_group(int64_t sendUs, int64_t arrivalUs) {
+  if (m_havePrev) {
+    int64_t sendDelta = sendUs - m_prevSendUs;
+    int64_t arrivalDelta = arrivalUs - m_prevArrivalUs;
+    if (sendDelta > MAX_GROUP_GAP_US || arrivalDelta > MAX_GROUP_GAP_US) {
+      m_samples = 0;
+      m_accumulated = m_smoothed = 0;
+      m_firstArrivalUs = arrivalUs;
+    } else {
+      update_trend((arrivalDelta - sendDelta) / 1000.0, arrivalUs);
+      detect(arrivalUs);
+    }
+  } else {
+    m_firstArrivalUs = arrivalUs;
+  }
+  m_prevSendUs = sendUs;
+  m_prevArrivalUs = arrivalUs;
+  m_havePrev = true;
+  update_rate(arrivalUs);
+}
+
+// Least-squares slope of the smoothed accumulated delay against arrival
+// time, over the last TREND_WINDOW groups
+void BandwidthEstimator::update_trend(double deltaMs, int64_t arrivalUs) {
+  m_accumulated += deltaMs;
+  m_smoothed = SMOOTHING * m_smoothed + (1 - SMOOTHING) * m_accumulated;
+  int slot = m_samples % TREND_WINDOW;
+  m_times[slot] = (arrivalUs - m_firstArrivalUs) / 1000.0;
+  m_delays[slot] = m_smoothed;
+  m_samples++;
+  if (m_samples < TREND_WINDOW)
+    return;
+
+  double meanX = 0, meanY = 0;
+  for (int i = 0; i < TREND_WINDOW; i++) {
+    meanX += m_times[i];
+    meanY += m_delays[i];
+  }
+  meanX /= TREND_WINDOW;
+  meanY /= TREND_WINDOW;
+  double num = 0, den = 0;
+  for (int i = 0; i < TREND_WINDOW; i++) {
+    num += (m_times[i] - meanX) * (m_delays[i] - meanY);
+    den += (m_times[i] - meanX) * (m_times[i] - meanX);
+  }
+  if (den > 0) {
+    m_trend = std::min(m_samples, MAX_TREND_SAMPLES) * (num / den) *
+              TREND_GAIN;
+  }
+}
+
+void BandwidthEstimator::detect(int64_t arrivalUs) {
+  if (m_samples < TREND_WINDOW)
+    return;
+  double dtMs =
+      m_lastDetectUs < 0 ? 0 : (arrivalUs - m_lastDetectUs) / 1000.0;
+  m_lastDetectUs = arrivalUs;
+
+  if (m_trend > m_threshold) {
+    m_overuseMs = m_overuseMs < 0 ? dtMs / 2 : m_overuseMs + dtMs;
+    m_overuseCount++;
+    if (m_overuseMs > OVERUSE_TIME_MS && m_overuseCount > 1 &&
+        m_trend >= m_prevTrend) {
+      m_overuseMs = 0;
+      m_overuseCount = 0;
+      m_signal = SIGNAL_OVERUSE;
+    }
+  } else if (m_trend < -m_threshold) {
+    m_overuseMs = -1;
+    m_overuseCount = 0;
+    m_signal = SIGNAL_UNDERUSE;
+  } else {
+    m_overuseMs = -1;
+    m_overuseCount = 0;
+    m_signal = SIGNAL_NORMAL;
+  }
+  m_prevTrend = m_trend;
+
+  // Follow the trend slowly up and quickly down, so a loaded path (or a
+  // competing TCP flow) does not keep us in overuse for good
+  double absTrend = fabs(m_trend);
+  if (absTrend > m_threshold + MAX_ADAPT_OFFSET_MS)
+    return;
+  double k = absTrend < m_threshold ? K_DOWN : K_UP;
+  m_threshold += k * (absTrend - m_threshold) *
+                 std::min(dtMs, MAX_ADAPT_STEP_MS);
+  m_threshold =
+      std::max(MIN_THRESHOLD_MS, std::min(MAX_THRESHOLD_MS, m_threshold));
+}
+
+void BandwidthEstimator::update_incoming(int64_t nowUs, size_t bytes) {
+  int64_t epoch = nowUs / BUCKET_US;
+  if (m_bucketEpoch < 0) {
+    m_bucketEpoch = epoch;
+  } else if (epoch > m_bucketEpoch) {
+    int64_t clear = std::min<int64_t>(epoch - m_bucketEpoch, RATE_BUCKETS);
+    for (int64_t i = 1; i <= clear; i++)
+      m_buckets[(m_bucketEpoch + i) % RATE_BUCKETS] = 0;
+    m_bucketEpoch = epoch;
+  } else if (epoch <= m_bucketEpoch - RATE_BUCKETS) {
+    return; // Older than the window
+  }
+  m_buckets[epoch % RATE_BUCKETS] += (uint32_t)bytes;
+
+  uint64_t total = 0;
+  for (int i = 0; i < RATE_BUCKETS; i++)
+    total += m_buckets[i];
+  m_incomingBps = total * 8.0 * 1e6 / (RATE_BUCKETS * BUCKET_US);
+}
+
+void BandwidthEstimator::update_rate(int64_t nowUs) {
+  double dtS = m_lastRateUs < 0
+                   ? 0
+                   : std::min(nowUs - m_lastRateUs, MAX_RATE_STEP_US) / 1e6;
+  m_lastRateUs = nowUs;
+  // The incoming rate means little until the window has filled once
+  bool haveIncoming = nowUs - m_firstPacketUs >= RATE_BUCKETS * BUCKET_US;
+
+  if (m_signal == SIGNAL_OVERUSE) {
+    bool canDecrease = m_lastDecreaseUs < 0 ||
+                       nowUs - m_lastDecreaseUs >= MIN_DECREASE_INTERVAL_US;
+    if (haveIncoming && canDecrease) {
+      m_targetBps = std::min(m_targetBps, BETA * m_incomingBps);
+      if (m_linkBps <= 0 || m_incomingBps < m_linkBps * 0.6 ||
+          m_incomingBps > m_linkBps * 1.5)
+        m_linkBps = m_incomingBps;
+      else
+        m_linkBps = 0.8 * m_linkBps + 0.2 * m_incomingBps;
+      m_lastDecreaseUs = nowUs;
+      m_overuses++;
+    }
+    m_holding = true;
+  } else if (m_signal == SIGNAL_UNDERUSE) {
+    m_holding = true; // Let the queue drain at the current rate
+  } else {
+    m_holding = false;
+  }
+
+  if (!m_holding) {
+    // Well past the last overuse: the link got faster, probe freely
+    if (m_linkBps > 0 && m_targetBps > m_linkBps * 1.5)
+      m_linkBps = 0;
+    if (m_linkBps > 0 && m_targetBps > m_linkBps * 0.9)
+      m_targetBps += std::max(ADDITIVE_MIN_BPS,
+                              m_targetBps * ADDITIVE_SHARE_PER_S) *
+                     dtS;
+    else
+      m_targetBps *= pow(INCREASE_PER_S, dtS);
+  }
+  if (haveIncoming) {
+    m_targetBps = std::min(m_targetBps, m_incomingBps * MAX_OVER_INCOMING +
+                                            INCOMING_MARGIN_BPS);
+  }
+
+  if (nowUs - m_lossWindowUs >= LOSS_WINDOW_US) {
+    uint32_t total = m_received + m_lost;
+    double loss = total ? (double)m_lost / total : 0;
+    if (total >= MIN_LOSS_SAMPLES && loss > LOSS_THRESHOLD)
+      m_targetBps *= 1 - 0.5 * loss;
+    m_received = m_lost = 0;
+    m_lossWindowUs = nowUs;
+  }
+
+  m_targetBps = std::max((double)m_config.min_bps,
+                         std::min((double)m_config.max_bps, m_targetBps));
+  update_fps();
+}
+
+void BandwidthEstimator::update_fps() {
+  int fps = std::max(1, m_config.max_fps);
+  for (int rung = 0; rung < 2 && fps / 2 >= 1; rung++) {
+    double need =
+        MIN_BITS_PER_FRAME * fps * (fps > m_fps ? FPS_UP_HYSTERESIS : 1.0);
+    if (m_targetBps >= need)
+      break;
+    fps /= 2;
+  }
+  m_fps = fps;
+}
+
+bool BandwidthEstimator::poll(int64_t nowUs, uint32_t *bps, int *fps) {
+  if (m_firstPacketUs < 0)
+    return false;
+  uint32_t target = (uint32_t)m_targetBps;
+  bool send = m_sentUs < 0 || m_fps != m_sentFps ||
+              nowUs - m_sentUs >= REFRESH_INTERVAL_US;
+  if (!send && nowUs - m_sentUs >= MIN_REPORT_INTERVAL_US) {
+    double change = fabs((double)target - m_sentBps);
+    send = change > m_sentBps * REPORT_CHANGE;
+  }
+  if (!send)
+    return false;
+  m_sentBps = target;
+  m_sentFps = m_fps;
+  m_sentUs = nowUs;
+  *bps = target;
+  *fps = m_fps;
+  return true;
+}
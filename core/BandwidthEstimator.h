@@ -0,0 +1,123 @@
+#pragma once
+#ifndef BANDWIDTH_ESTIMATOR_H
+#define BANDWIDTH_ESTIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BweConfig {
+  uint32_t min_bps = 300000;
+  uint32_t start_bps = 1500000; // What the phone's encoder starts at
+  uint32_t max_bps = 8000000;
+  int max_fps = 60;
+};
+
+// Receiver-side bandwidth estimate for one stream, after the delay-based
+// controller of Google Congestion Control (draft-ietf-rmcat-gcc-02).
+//
+// Packets are grouped by send time: all of a picture's packets carry its
+// capture time. Between two complete groups, the arrival interval minus
+// the send interval is how much the one-way delay changed. It grows while
+// a queue builds up somewhere on the path and shrinks while one drains,
+// and the sender's and receiver's clocks never have to agree. The slope of
+// that accumulated delay over the last groups is compared against a
+// threshold that adapts to the noise, giving overuse, underuse or normal.
+//
+// An AIMD controller turns the signal into a target. Overuse cuts it to
+// 85% of what actually arrived over the last half second; otherwise it
+// grows 8% a second, slowing to a linear climb near the rate the last
+// overuse happened at. Underuse holds it while the queue drains. Heavy
+// loss (RTP only) cuts it too. The frame rate follows the bitrate down a
+// 60/30/15 ladder so each picture keeps enough bits to be worth sending.
+//
+// Times are microseconds; send and arrival times may come from different
+// clocks. Not thread-safe: feed and poll it from one thread.
+class BandwidthEstimator {
+public:
+  enum Signal { SIGNAL_NORMAL, SIGNAL_OVERUSE, SIGNAL_UNDERUSE };
+
+  explicit BandwidthEstimator(const BweConfig &config = BweConfig());
+
+  void reset();
+
+  // A packet (or, over TCP, a NAL unit) of `bytes` sent at `sendUs` by the
+  // sender's clock and received at `arrivalUs` by ours
+  void on_packet(int64_t sendUs, int64_t arrivalUs, size_t bytes);
+
+  // Packets the jitter buffer gave up on
+  void on_lost(uint32_t count);
+
+  // True when the target should go to the sender: it moved by more than
+  // 5%, the frame rate changed, or the last one is a second old
+  bool poll(int64_t nowUs, uint32_t *bps, int *fps);
+
+  uint32_t target_bps() const { return (uint32_t)m_targetBps; }
+  int target_fps() const { return m_fps; }
+  uint32_t incoming_bps() const { return (uint32_t)m_incomingBps; }
+  double trend_ms() const { return m_trend; }
+  double threshold_ms() const { return m_threshold; }
+  Signal signal() const { return m_signal; }
+  uint64_t overuses() const { return m_overuses; }
+
+private:
+  enum { TREND_WINDOW = 20, RATE_BUCKETS = 50 };
+
+  void add_group(int64_t sendUs, int64_t arrivalUs);
+  void update_trend(double deltaMs, int64_t arrivalUs);
+  void detect(int64_t arrivalUs);
+  void update_rate(int64_t nowUs);
+  void update_incoming(int64_t nowUs, size_t bytes);
+  void update_fps();
+
+  BweConfig m_config;
+
+  // Current send-time group
+  bool m_haveGroup;
+  int64_t m_groupSendUs;
+  int64_t m_groupArrivalUs;
+  bool m_havePrev;
+  int64_t m_prevSendUs;
+  int64_t m_prevArrivalUs;
+
+  // Trendline over (arrival ms, smoothed accumulated delay ms)
+  int64_t m_firstArrivalUs;
+  double m_accumulated;
+  double m_smoothed;
+  double m_times[TREND_WINDOW];
+  double m_delays[TREND_WINDOW];
+  int m_samples; // Total, not capped at the window
+  double m_trend;
+
+  // Overuse detector
+  double m_threshold;
+  double m_prevTrend;
+  int64_t m_lastDetectUs;
+  double m_overuseMs;
+  int m_overuseCount;
+  Signal m_signal;
+  uint64_t m_overuses;
+
+  // Incoming rate: bytes per 10 ms bucket over the last half second
+  uint32_t m_buckets[RATE_BUCKETS];
+  int64_t m_bucketEpoch; // Index of the newest bucket; -1 before any
+  int64_t m_firstPacketUs;
+  double m_incomingBps;
+
+  // Rate controller
+  double m_targetBps;
+  double m_linkBps; // Incoming rate at the last overuse; 0 = unknown
+  int64_t m_lastRateUs;
+  int64_t m_lastDecreaseUs;
+  bool m_holding;
+  uint32_t m_received;
+  uint32_t m_lost;
+  int64_t m_lossWindowUs;
+  int m_fps;
+
+  // Last target handed out by poll()
+  uint32_t m_sentBps;
+  int m_sentFps;
+  int64_t m_sentUs;
+};
+
+#endif // BANDWIDTH_ESTIMATOR_H
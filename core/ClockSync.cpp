@@ -0,0 +1,176 @@
+#include "ClockSync.h"
+#include <chrono>
+#include <math.h>
+
+// Replies slower than this say nothing useful about the offset
+static const int64_t MAX_RTT_US = 1000000;
+// Below this much history the skew is noise; hold it at zero
+static const int64_t MIN_SKEW_SPAN_US = 20000000;
+// Crystals are good to tens of ppm; anything past this is a bad fit
+static const double MAX_SKEW = 500e-6;
+// Slack on top of the round-trip bounds before a sample counts as a step
+static const double STEP_MARGIN_US = 20000;
+
+int64_t clock_now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static double model_offset_at(const ClockModel &m, int64_t localUs) {
+  return m.offset_us + m.skew * (double)(localUs - m.ref_us);
+}
+
+ClockSync::ClockSync()
+    : m_count(0), m_samples(0), m_steps(0), m_seq(0), m_refUs(0),
+      m_offsetUs(0.0), m_skew(0.0), m_minRttUs(0), m_synced(false) {}
+
+int64_t ClockSync::on_reply(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+  int64_t rtt = (t4 - t1) - (t3 - t2);
+  if (t4 < t1 || rtt < 0 || rtt > MAX_RTT_US)
+    return -1; // Our clock moved under the exchange, or a stale reply
+
+  Sample s;
+  s.local_us = t1 + (t4 - t1) / 2;
+  // Offset = ((T2 - T1) + (T3 - T4)) / 2
+  s.offset_us = ((double)(t2 - t1) + (double)(t3 - t4)) / 2.0;
+  s.rtt_us = rtt;
+
+  // Both this sample and the model are within half a round trip of the
+  // truth; further apart than that, a clock was stepped
+  if (m_count > 0) {
+    double error = fabs(s.offset_us - model_offset_at(m_model, s.local_us));
+    if (error > (rtt + m_model.min_rtt_us) / 2.0 + STEP_MARGIN_US) {
+      m_count = 0;
+      m_steps++;
+    }
+  }
+
+  m_window[m_samples % WINDOW] = s;
+  m_samples++;
+  if (m_count < WINDOW)
+    m_count++;
+  fit();
+  return rtt;
+}
+
+// Minimum-RTT sample of each span, then a least-squares line through them
+void ClockSync::fit() {
+  const Sample *kept[SPANS] = {};
+  for (int i = 0; i < m_count; i++) {
+    const Sample &s = m_window[(m_samples - m_count + i) % WINDOW];
+    int span = i * SPANS / m_count;
+    if (!kept[span] || s.rtt_us < kept[span]->rtt_us)
+      kept[span] = &s;
+  }
+
+  const Sample *first = kept[0]; // Span 0 always has the oldest sample
+  const Sample *last = first, *best = first;
+  int n = 0;
+  double meanX = 0, meanY = 0;
+  for (const Sample *s : kept) {
+    if (!s)
+      continue;
+    last = s;
+    if (s->rtt_us < best->rtt_us)
+      best = s;
+    meanX += (double)(s->local_us - first->local_us);
+    meanY += s->offset_us;
+    n++;
+  }
+  meanX /= n;
+  meanY /= n;
+
+  ClockModel m;
+  m.synced = true;
+  m.min_rtt_us = best->rtt_us;
+  bool fitted = false;
+  if (n >= 3 && last->local_us - first->local_us >= MIN_SKEW_SPAN_US) {
+    double sxx = 0, sxy = 0;
+    for (const Sample *s : kept) {
+      if (!s)
+        continue;
+      double dx = (double)(s->local_us - first->local_us) - meanX;
+      sxx += dx * dx;
+      sxy += dx * (s->offset_us - meanY);
+    }
+    m.skew = sxy / sxx;
+    m.ref_us = first->local_us + (int64_t)meanX;
+    m.offset_us = meanY;
+    fitted = fabs(m.skew) <= MAX_SKEW;
+  }
+  if (!fitted) {
+    // Too little history (or a fit gone wrong): trust the quickest sample
+    m.skew = 0;
+    m.ref_us = best->local_us;
+    m.offset_us = best->offset_us;
+  }
+  publish(m);
+}
+
+void ClockSync::publish(const ClockModel &m) {
+  m_model = m;
+  uint32_t seq = m_seq.load(std::memory_order_relaxed);
+  m_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_refUs.store(m.ref_us, std::memory_order_relaxed);
+  m_offsetUs.store(m.offset_us, std::memory_order_relaxed);
+  m_skew.store(m.skew, std::memory_order_relaxed);
+  m_minRttUs.store(m.min_rtt_us, std::memory_order_relaxed);
+  m_synced.store(m.synced, std::memory_order_relaxed);
+  m_seq.store(seq + 2, std::memory_order_release);
+}
+
+ClockModel ClockSync::model() const {
+  ClockModel m;
+  uint32_t before, after;
+  do {
+    before = m_seq.load(std::memory_order_acquire);
+    m.ref_us = m_refUs.load(std::memory_order_relaxed);
+    m.offset_us = m_offsetUs.load(std::memory_order_relaxed);
+    m.skew = m_skew.load(std::memory_order_relaxed);
+    m.min_rtt_us = m_minRttUs.load(std::memory_order_relaxed);
+    m.synced = m_synced.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = m_seq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return m;
+}
+
+void ClockSync::reset() {
+  // Keep mapping with the last model until the next connection syncs
+  m_count = 0;
+  m_samples = 0;
+  m_steps = 0;
+  ClockModel m = m_model;
+  m.synced = false;
+  publish(m);
+}
+
+void ClockSync::set_offset_ms(double offsetMs) {
+  m_count = 0;
+  ClockModel m;
+  m.offset_us = offsetMs * 1000.0;
+  m.synced = true;
+  publish(m);
+}
+
+double ClockSync::offset_ms() const {
+  return model_offset_at(model(), clock_now_us()) / 1000.0;
+}
+
+int64_t ClockSync::capture_to_local_us(uint64_t captureTimestampUs) const {
+  // iOS sends microseconds since 2001-01-01.
+  // Need to adjust to Unix Epoch (1970) for system_clock comparison
+  // Offset: 978307200 seconds * 1,000,000
+  const int64_t APPLE_TO_UNIX_OFFSET_US = 978307200000000LL;
+  int64_t remoteUnixUs = captureTimestampUs + APPLE_TO_UNIX_OFFSET_US;
+
+  // Adjust for Clock Offset
+  // Offset = iPhone - Windows
+  // We want Windows Time, so Windows = iPhone - Offset, with the offset
+  // taken at (near enough) the local time the frame was captured
+  ClockModel m = model();
+  int64_t approxLocalUs = remoteUnixUs - (int64_t)m.offset_us;
+  return remoteUnixUs - (int64_t)model_offset_at(m, approxLocalUs);
+}
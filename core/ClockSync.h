@@ -0,0 +1,94 @@
+#pragma once
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Sender clock in terms of ours: offset(t) = offset_us + skew * (t - ref_us),
+// offset = sender - receiver, t our clock (microseconds since the Unix epoch)
+struct ClockModel {
+  int64_t ref_us = 0;
+  double offset_us = 0;
+  double skew = 0;        // Sender seconds gained per one of ours
+  int64_t min_rtt_us = 0; // Best round trip in the window; 0 = fixed offset
+  bool synced = false;
+};
+
+// Offset and skew between the sender's clock and ours, from the AGCM
+// SYNC_REQUEST / SYNC_REPLY exchange (NTP-style T1..T4), resampled for as
+// long as the stream is up.
+//
+// A sample's offset is off by at most half its round trip, and on Wi-Fi the
+// round trip varies by tens of milliseconds, so only the quickest samples
+// are trusted: the window is split into equal spans and the minimum-RTT
+// sample of each is kept. A least-squares line through those gives the
+// offset now and the skew, which keeps the mapping right over hours of
+// crystal drift. A sample that disagrees with the model by more than its
+// own uncertainty means one of the clocks was stepped; the window restarts.
+//
+// Written from one thread at a time (the Reactor, or the caller before a
+// replay starts), read per frame by the decoders: the model is published
+// through a seqlock, so readers never block or contend with the writer.
+class ClockSync {
+public:
+  ClockSync();
+
+  // T1/T4: our send/receive times, T2/T3: sender receive/send times, all
+  // microseconds since the Unix epoch. Returns the round-trip time (us), or
+  // -1 for a reply that cannot be used.
+  int64_t on_reply(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+  // Connection lost: forget the samples and sync again on the next one
+  void reset();
+
+  // Fixed offset with no SYNC exchange (capture replay)
+  void set_offset_ms(double offsetMs);
+
+  ClockModel model() const;
+  bool synced() const { return model().synced; }
+
+  // Offset = sender - receiver, now
+  double offset_ms() const;
+
+  // Samples taken and clock steps seen since the last reset
+  uint64_t samples() const { return m_samples; }
+  uint64_t steps() const { return m_steps; }
+
+  // Maps a wire capture timestamp (sender clock, microseconds since
+  // 2001-01-01) onto our clock, microseconds since the Unix epoch.
+  int64_t capture_to_local_us(uint64_t captureTimestampUs) const;
+
+private:
+  // About two minutes at one sample a second, in spans of a quarter minute
+  enum { WINDOW = 128, SPANS = 8 };
+
+  struct Sample {
+    int64_t local_us; // Midpoint of T1 and T4
+    double offset_us;
+    int64_t rtt_us;
+  };
+
+  void fit();
+  void publish(const ClockModel &m);
+
+  // Writer side only
+  Sample m_window[WINDOW];
+  int m_count; // Valid samples, newest at (m_samples - 1) % WINDOW
+  uint64_t m_samples;
+  uint64_t m_steps;
+  ClockModel m_model; // Last published
+
+  // Seqlock: odd while a write is in progress
+  std::atomic<uint32_t> m_seq;
+  std::atomic<int64_t> m_refUs;
+  std::atomic<double> m_offsetUs;
+  std::atomic<double> m_skew;
+  std::atomic<int64_t> m_minRttUs;
+  std::atomic<bool> m_synced;
+};
+
+// system_clock now, microseconds since the Unix epoch
+int64_t clock_now_us();
+
+#endif // CLOCK_SYNC_H
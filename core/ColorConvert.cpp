@@ -0,0 +1,254 @@
+#include "ColorConvert.h"
+#include "ColorConvertKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) ||            \
+    defined(__i386__)
+#define CC_X86 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Defined in ColorConvertAVX2.cpp; false if that file was built without AVX2
+extern const bool kColorConvertHasAvx2Kernel;
+
+// Q6 coefficients, see ColorConvertKernels.h. [matrix][range]
+static const YuvCoeffs COEFFS[2][2] = {
+    // BT.601: limited, full
+    {{16, 75, 102, 25, 52, 129}, {0, 64, 90, 22, 46, 113}},
+    // BT.709: limited, full
+    {{16, 75, 115, 14, 34, 135}, {0, 64, 101, 12, 30, 119}},
+};
+
+static inline int sat16(int v) {
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+static inline uint8_t clamp8(int v) {
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+void yuv_row_c(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+               int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c) {
+  for (int x = 0; x < width; x++) {
+    int cu = u[(x >> 1) * chromaStep] - 128;
+    int cv = v[(x >> 1) * chromaStep] - 128;
+    int yy = (y[x] - c.yOffset) * c.yCoef + 32;
+
+    dst[4 * x + 0] = clamp8(sat16(yy + c.bu * cu) >> 6);
+    dst[4 * x + 1] = clamp8(sat16(yy - (c.gu * cu + c.gv * cv)) >> 6);
+    dst[4 * x + 2] = clamp8(sat16(yy + c.rv * cv) >> 6);
+    dst[4 * x + 3] = 255;
+  }
+}
+
+#ifdef CC_SSE2
+// 16 pixels per iteration
+template <bool NV12>
+static void row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     uint8_t *dst, int width, const YuvCoeffs &c) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k128 = _mm_set1_epi16(128);
+  const __m128i lowByte = _mm_set1_epi16(0x00FF);
+  const __m128i yOff = _mm_set1_epi16(c.yOffset);
+  const __m128i yCoef = _mm_set1_epi16(c.yCoef);
+  const __m128i round = _mm_set1_epi16(32);
+  const __m128i rv = _mm_set1_epi16(c.rv);
+  const __m128i gu = _mm_set1_epi16(c.gu);
+  const __m128i gv = _mm_set1_epi16(c.gv);
+  const __m128i bu = _mm_set1_epi16(c.bu);
+  const __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    // 8 chroma samples, widened to 16 bit and centred
+    __m128i cu, cv;
+    if (NV12) {
+      __m128i uv = _mm_loadu_si128((const __m128i *)(u + x));
+      cu = _mm_and_si128(uv, lowByte);
+      cv = _mm_srli_epi16(uv, 8);
+    } else {
+      cu = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + x / 2)),
+                             zero);
+      cv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v + x / 2)),
+                             zero);
+    }
+    cu = _mm_sub_epi16(cu, k128);
+    cv = _mm_sub_epi16(cv, k128);
+
+    __m128i rC = _mm_mullo_epi16(cv, rv);
+    __m128i gC = _mm_add_epi16(_mm_mullo_epi16(cu, gu), _mm_mullo_epi16(cv, gv));
+    __m128i bC = _mm_mullo_epi16(cu, bu);
+
+    // Each chroma term covers two horizontal pixels
+    __m128i rLo = _mm_unpacklo_epi16(rC, rC), rHi = _mm_unpackhi_epi16(rC, rC);
+    __m128i gLo = _mm_unpacklo_epi16(gC, gC), gHi = _mm_unpackhi_epi16(gC, gC);
+    __m128i bLo = _mm_unpacklo_epi16(bC, bC), bHi = _mm_unpackhi_epi16(bC, bC);
+
+    __m128i yv = _mm_loadu_si128((const __m128i *)(y + x));
+    __m128i yLo = _mm_unpacklo_epi8(yv, zero);
+    __m128i yHi = _mm_unpackhi_epi8(yv, zero);
+    yLo = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(yLo, yOff), yCoef), round);
+    yHi = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(yHi, yOff), yCoef), round);
+
+    __m128i B = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(yLo, bLo), 6),
+                                 _mm_srai_epi16(_mm_adds_epi16(yHi, bHi), 6));
+    __m128i G = _mm_packus_epi16(_mm_srai_epi16(_mm_subs_epi16(yLo, gLo), 6),
+                                 _mm_srai_epi16(_mm_subs_epi16(yHi, gHi), 6));
+    __m128i R = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(yLo, rLo), 6),
+                                 _mm_srai_epi16(_mm_adds_epi16(yHi, rHi), 6));
+
+    // Interleave to B G R A
+    __m128i bg0 = _mm_unpacklo_epi8(B, G), bg1 = _mm_unpackhi_epi8(B, G);
+    __m128i ra0 = _mm_unpacklo_epi8(R, alpha), ra1 = _mm_unpackhi_epi8(R, alpha);
+    __m128i *out = (__m128i *)(dst + 4 * x);
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bg0, ra0));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg0, ra0));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg1, ra1));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg1, ra1));
+  }
+
+  int step = NV12 ? 2 : 1;
+  yuv_row_c(y + x, u + (x / 2) * step, v + (x / 2) * step, step, dst + 4 * x,
+            width - x, c);
+}
+
+void yuv_row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c) {
+  if (chromaStep == 2)
+    row_sse2<true>(y, u, v, dst, width, c);
+  else
+    row_sse2<false>(y, u, v, dst, width, c);
+}
+#endif // CC_SSE2
+
+// Runtime CPU dispatch, resolved once
+struct RowBackend {
+  YuvRowFunc func;
+  const char *name;
+};
+
+static RowBackend select_backend() {
+#ifdef CC_X86
+  if (kColorConvertHasAvx2Kernel && cpu_has_avx2())
+    return {yuv_row_avx2, "AVX2"};
+#endif
+#ifdef CC_SSE2
+  return {yuv_row_sse2, "SSE2"};
+#else
+  return {yuv_row_c, "C"};
+#endif
+}
+
+static const RowBackend &backend() {
+  static const RowBackend selected = select_backend();
+  return selected;
+}
+
+const char *yuv_to_bgra_backend() { return backend().name; }
+
+void yuv_to_bgra(const YuvImage &src, YuvMatrix matrix, YuvRange range,
+                 uint8_t *dst, int dstStride, int y0, int y1) {
+  const YuvCoeffs &c = COEFFS[matrix][range];
+  YuvRowFunc row = backend().func;
+  bool nv12 = src.layout == YUV_LAYOUT_NV12;
+
+  for (int yy = y0; yy < y1; yy++) {
+    const uint8_t *yRow = src.plane[0] + (ptrdiff_t)yy * src.stride[0];
+    const uint8_t *uRow = src.plane[1] + (ptrdiff_t)(yy >> 1) * src.stride[1];
+    const uint8_t *vRow =
+        nv12 ? uRow + 1 : src.plane[2] + (ptrdiff_t)(yy >> 1) * src.stride[2];
+    row(yRow, uRow, vRow, nv12 ? 2 : 1, dst + (ptrdiff_t)yy * dstStride,
+        src.width, c);
+  }
+}
+
+// Chroma rows [c0, c1) cover luma rows [y0, y1) of a 4:2:0 frame
+static void chroma_rows(const YuvImage &src, int y0, int y1, int *c0,
+                        int *c1) {
+  *c0 = y0 >> 1;
+  *c1 = std::min((y1 + 1) >> 1, (src.height + 1) >> 1);
+}
+
+static void copy_luma(const YuvImage &src, uint8_t *dst, int dstStride,
+                      int y0, int y1) {
+  for (int yy = y0; yy < y1; yy++)
+    memcpy(dst + (ptrdiff_t)yy * dstStride,
+           src.plane[0] + (ptrdiff_t)yy * src.stride[0], src.width);
+}
+
+void yuv_to_nv12(const YuvImage &src, uint8_t *dstY, uint8_t *dstUV,
+                 int dstStride, int y0, int y1) {
+  copy_luma(src, dstY, dstStride, y0, y1);
+  int cw = (src.width + 1) >> 1, c0, c1;
+  chroma_rows(src, y0, y1, &c0, &c1);
+  for (int cy = c0; cy < c1; cy++) {
+    uint8_t *out = dstUV + (ptrdiff_t)cy * dstStride;
+    const uint8_t *u = src.plane[1] + (ptrdiff_t)cy * src.stride[1];
+    if (src.layout == YUV_LAYOUT_NV12) {
+      memcpy(out, u, 2 * cw);
+      continue;
+    }
+    const uint8_t *v = src.plane[2] + (ptrdiff_t)cy * src.stride[2];
+    for (int x = 0; x < cw; x++) {
+      out[2 * x] = u[x];
+      out[2 * x + 1] = v[x];
+    }
+  }
+}
+
+void yuv_to_i420(const YuvImage &src, uint8_t *dstY, uint8_t *dstU,
+                 uint8_t *dstV, int dstStride, int y0, int y1) {
+  copy_luma(src, dstY, dstStride, y0, y1);
+  int cw = (src.width + 1) >> 1, c0, c1;
+  chroma_rows(src, y0, y1, &c0, &c1);
+  int cStride = dstStride / 2;
+  for (int cy = c0; cy < c1; cy++) {
+    uint8_t *outU = dstU + (ptrdiff_t)cy * cStride;
+    uint8_t *outV = dstV + (ptrdiff_t)cy * cStride;
+    const uint8_t *u = src.plane[1] + (ptrdiff_t)cy * src.stride[1];
+    if (src.layout == YUV_LAYOUT_I420) {
+      memcpy(outU, u, cw);
+      memcpy(outV, src.plane[2] + (ptrdiff_t)cy * src.stride[2], cw);
+      continue;
+    }
+    for (int x = 0; x < cw; x++) {
+      outU[x] = u[2 * x];
+      outV[x] = u[2 * x + 1];
+    }
+  }
+}
+
+void yuv_to_yuy2(const YuvImage &src, uint8_t *dst, int dstStride, int y0,
+                 int y1) {
+  bool nv12 = src.layout == YUV_LAYOUT_NV12;
+  int pairs = src.width >> 1;
+  for (int yy = y0; yy < y1; yy++) {
+    const uint8_t *y = src.plane[0] + (ptrdiff_t)yy * src.stride[0];
+    const uint8_t *u = src.plane[1] + (ptrdiff_t)(yy >> 1) * src.stride[1];
+    const uint8_t *v =
+        nv12 ? u + 1 : src.plane[2] + (ptrdiff_t)(yy >> 1) * src.stride[2];
+    int step = nv12 ? 2 : 1;
+    uint8_t *out = dst + (ptrdiff_t)yy * dstStride;
+    int x = 0;
+    for (; x < pairs; x++) {
+      out[4 * x] = y[2 * x];
+      out[4 * x + 1] = u[x * step];
+      out[4 * x + 2] = y[2 * x + 1];
+      out[4 * x + 3] = v[x * step];
+    }
+    if (src.width & 1) {
+      out[4 * x] = y[2 * x];
+      out[4 * x + 1] = u[x * step];
+      out[4 * x + 2] = y[2 * x];
+      out[4 * x + 3] = v[x * step];
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <stdint.h>
+
+// YUV -> BGRA colour conversion for frame bus readers that want RGB.
+//
+// Source and destination sizes are always identical, so this is a straight
+// per-pixel matrix. Kernels exist for AVX2, SSE2 and plain C and are picked
+// once at runtime from CPUID. All backends use the same Q6 fixed-point
+// maths and produce bit-identical output.
+
+enum YuvMatrix { YUV_MATRIX_BT601, YUV_MATRIX_BT709 };
+enum YuvRange { YUV_RANGE_LIMITED, YUV_RANGE_FULL };
+enum YuvLayout {
+  YUV_LAYOUT_I420, // Y, U, V planes (AV_PIX_FMT_YUV420P)
+  YUV_LAYOUT_NV12  // Y plane + interleaved UV plane (AV_PIX_FMT_NV12)
+};
+
+struct YuvImage {
+  YuvLayout layout;
+  int width;
+  int height;
+  const uint8_t *plane[3]; // NV12 uses plane[0] and plane[1]
+  int stride[3];
+};
+
+// Converts rows [y0, y1) of `src` to BGRA (alpha 255). `dst` points at row
+// 0 of the destination; pass 0, src.height for a whole frame.
+void yuv_to_bgra(const YuvImage &src, YuvMatrix matrix, YuvRange range,
+                 uint8_t *dst, int dstStride, int y0, int y1);
+
+// Name of the kernel picked for this CPU ("AVX2", "SSE2" or "C")
+const char *yuv_to_bgra_backend();
+
+// 4:2:0 repacking without colour maths, for the NV12 frame bus and for
+// consumers that take YUV. Same row convention as yuv_to_bgra(); y0
+// should be even, or the chroma row it shares with y0 - 1 is written
+// again. Plain C: these only move bytes.
+void yuv_to_nv12(const YuvImage &src, uint8_t *dstY, uint8_t *dstUV,
+                 int dstStride, int y0, int y1);
+// Chroma rows are dstStride / 2 bytes, as DirectShow lays out I420
+void yuv_to_i420(const YuvImage &src, uint8_t *dstY, uint8_t *dstU,
+                 uint8_t *dstV, int dstStride, int y0, int y1);
+// Packed Y0 U Y1 V; an odd last pixel repeats its luma
+void yuv_to_yuy2(const YuvImage &src, uint8_t *dst, int dstStride, int y0,
+                 int y1);
+
+#endif // COLOR_CONVERT_H
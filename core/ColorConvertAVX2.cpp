@@ -0,0 +1,116 @@
+// Built with /arch:AVX2 (MSVC) or -mavx2 (GCC/Clang), see CMakeLists.txt.
+// Only called after ColorConvert.cpp has checked CPUID.
+#include "ColorConvertKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+extern const bool kColorConvertHasAvx2Kernel = true;
+
+// 32 pixels per iteration
+template <bool NV12>
+static void row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     uint8_t *dst, int width, const YuvCoeffs &c) {
+  const __m256i k128 = _mm256_set1_epi16(128);
+  const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+  const __m256i yOff = _mm256_set1_epi16(c.yOffset);
+  const __m256i yCoef = _mm256_set1_epi16(c.yCoef);
+  const __m256i round = _mm256_set1_epi16(32);
+  const __m256i rv = _mm256_set1_epi16(c.rv);
+  const __m256i gu = _mm256_set1_epi16(c.gu);
+  const __m256i gv = _mm256_set1_epi16(c.gv);
+  const __m256i bu = _mm256_set1_epi16(c.bu);
+  const __m256i alpha = _mm256_set1_epi8((char)0xFF);
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    // 16 chroma samples in order, widened to 16 bit and centred
+    __m256i cu, cv;
+    if (NV12) {
+      __m256i uv = _mm256_loadu_si256((const __m256i *)(u + x));
+      cu = _mm256_and_si256(uv, lowByte);
+      cv = _mm256_srli_epi16(uv, 8);
+    } else {
+      cu = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(u + x / 2)));
+      cv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(v + x / 2)));
+    }
+    cu = _mm256_sub_epi16(cu, k128);
+    cv = _mm256_sub_epi16(cv, k128);
+
+    // Qword order 0,2,1,3 so the in-lane unpacks below duplicate chroma
+    // 0..7 for pixels 0..15 and 8..15 for pixels 16..31
+    __m256i rC = _mm256_permute4x64_epi64(_mm256_mullo_epi16(cv, rv), 0xD8);
+    __m256i gC = _mm256_permute4x64_epi64(
+        _mm256_add_epi16(_mm256_mullo_epi16(cu, gu), _mm256_mullo_epi16(cv, gv)),
+        0xD8);
+    __m256i bC = _mm256_permute4x64_epi64(_mm256_mullo_epi16(cu, bu), 0xD8);
+
+    __m256i rLo = _mm256_unpacklo_epi16(rC, rC);
+    __m256i rHi = _mm256_unpackhi_epi16(rC, rC);
+    __m256i gLo = _mm256_unpacklo_epi16(gC, gC);
+    __m256i gHi = _mm256_unpackhi_epi16(gC, gC);
+    __m256i bLo = _mm256_unpacklo_epi16(bC, bC);
+    __m256i bHi = _mm256_unpackhi_epi16(bC, bC);
+
+    // Pixels 0..15 and 16..31
+    __m256i yLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x)));
+    __m256i yHi =
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + x + 16)));
+    yLo = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_sub_epi16(yLo, yOff), yCoef), round);
+    yHi = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_sub_epi16(yHi, yOff), yCoef), round);
+
+    // packus works per 128-bit lane: lane 0 = px 0-7 | 16-23,
+    // lane 1 = px 8-15 | 24-31
+    __m256i B = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_adds_epi16(yLo, bLo), 6),
+        _mm256_srai_epi16(_mm256_adds_epi16(yHi, bHi), 6));
+    __m256i G = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_subs_epi16(yLo, gLo), 6),
+        _mm256_srai_epi16(_mm256_subs_epi16(yHi, gHi), 6));
+    __m256i R = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_adds_epi16(yLo, rLo), 6),
+        _mm256_srai_epi16(_mm256_adds_epi16(yHi, rHi), 6));
+
+    // bg0/ra0: px 0-7 | 8-15, bg1/ra1: px 16-23 | 24-31
+    __m256i bg0 = _mm256_unpacklo_epi8(B, G), bg1 = _mm256_unpackhi_epi8(B, G);
+    __m256i ra0 = _mm256_unpacklo_epi8(R, alpha);
+    __m256i ra1 = _mm256_unpackhi_epi8(R, alpha);
+
+    // px 0-3 | 8-11, px 4-7 | 12-15, px 16-19 | 24-27, px 20-23 | 28-31
+    __m256i p0 = _mm256_unpacklo_epi16(bg0, ra0);
+    __m256i p1 = _mm256_unpackhi_epi16(bg0, ra0);
+    __m256i p2 = _mm256_unpacklo_epi16(bg1, ra1);
+    __m256i p3 = _mm256_unpackhi_epi16(bg1, ra1);
+
+    __m256i *out = (__m256i *)(dst + 4 * x);
+    _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+  }
+
+  int step = NV12 ? 2 : 1;
+  yuv_row_c(y + x, u + (x / 2) * step, v + (x / 2) * step, step, dst + 4 * x,
+            width - x, c);
+}
+
+void yuv_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c) {
+  if (chromaStep == 2)
+    row_avx2<true>(y, u, v, dst, width, c);
+  else
+    row_avx2<false>(y, u, v, dst, width, c);
+}
+
+#else // !__AVX2__
+
+extern const bool kColorConvertHasAvx2Kernel = false;
+
+void yuv_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c) {
+  yuv_row_c(y, u, v, chromaStep, dst, width, c);
+}
+
+#endif // __AVX2__
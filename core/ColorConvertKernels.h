@@ -0,0 +1,38 @@
+#pragma once
+#ifndef COLOR_CONVERT_KERNELS_H
+#define COLOR_CONVERT_KERNELS_H
+
+#include <stdint.h>
+
+// Internal to ColorConvert*.cpp: per-row kernels and their coefficients.
+//
+// Fixed point, Q6, 16-bit intermediates:
+//   Y' = (Y - yOffset) * yCoef + 32
+//   B  = sat16(Y' + bu * U') >> 6
+//   G  = sat16(Y' - (gu * U' + gv * V')) >> 6
+//   R  = sat16(Y' + rv * V') >> 6
+// with U' = U - 128, V' = V - 128. No product can overflow int16; sums
+// saturate, which only ever happens for values that clamp anyway.
+struct YuvCoeffs {
+  int16_t yOffset;
+  int16_t yCoef;
+  int16_t rv;
+  int16_t gu;
+  int16_t gv;
+  int16_t bu;
+};
+
+// One output row. `u`/`v` step by `chromaStep` bytes per chroma sample
+// (1 for I420 planes, 2 for interleaved NV12 with v == u + 1).
+typedef void (*YuvRowFunc)(const uint8_t *y, const uint8_t *u,
+                           const uint8_t *v, int chromaStep, uint8_t *dst,
+                           int width, const YuvCoeffs &c);
+
+void yuv_row_c(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+               int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c);
+void yuv_row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c);
+void yuv_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  int chromaStep, uint8_t *dst, int width, const YuvCoeffs &c);
+
+#endif // COLOR_CONVERT_KERNELS_H
@@ -0,0 +1,119 @@
+#include "ConvertPool.h"
+#include "Platform.h"
+#include <algorithm>
+
+// 1080p: 32 rows are 90 KB of I420 in and 90 KB of NV12 (240 KB of BGRA)
+// out, well within a core's L2
+static const int DEFAULT_BAND_ROWS = 32;
+
+ConvertPool::ConvertPool()
+    : m_bandRows(DEFAULT_BAND_ROWS), m_running(false), m_generation(0),
+      m_job(), m_next(0), m_done(0) {}
+
+ConvertPool::~ConvertPool() { stop(); }
+
+void ConvertPool::start(int threads, int bandRows) {
+  int cores = std::max(1, (int)std::thread::hardware_concurrency());
+  if (threads <= 0)
+    threads = cores;
+  if (bandRows > 0)
+    m_bandRows = (bandRows + 1) & ~1;
+
+  m_running = true;
+  for (int i = 1; i < threads; i++)
+    m_threads.emplace_back(&ConvertPool::thread_func, this, i % cores);
+}
+
+void ConvertPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running)
+      return;
+    m_running = false;
+  }
+  m_cond.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+  m_threads.clear();
+}
+
+void ConvertPool::convert(const YuvImage &src, YuvMatrix matrix,
+                          YuvRange range, uint8_t *dst, int dstStride, int y0,
+                          int y1) {
+  Job job = {src, matrix, range, dst, nullptr, dstStride, y0, y1, 0, 0};
+  run(job);
+}
+
+void ConvertPool::to_nv12(const YuvImage &src, uint8_t *dstY, uint8_t *dstUV,
+                          int dstStride, int y0, int y1) {
+  // No colour maths: the matrix and range are not used
+  Job job = {src, YUV_MATRIX_BT601, YUV_RANGE_LIMITED, dstY, dstUV,
+             dstStride, y0, y1, 0, 0};
+  run(job);
+}
+
+void ConvertPool::run(Job job) {
+  job.band_rows = m_bandRows;
+  job.bands = (job.y1 - job.y0 + m_bandRows - 1) / m_bandRows;
+  if (m_threads.empty() || job.bands < 2 || !m_busy.try_lock()) {
+    convert_band(job, job.y0, job.y1);
+    return;
+  }
+
+  uint32_t generation;
+  m_done.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    generation = ++m_generation;
+    m_job = job;
+    m_next.store((uint64_t)generation << 32, std::memory_order_release);
+  }
+  m_cond.notify_all();
+  run_bands(job, generation);
+
+  // Barrier: the bands other threads claimed may still be in progress,
+  // each a fraction of a millisecond
+  while (m_done.load(std::memory_order_acquire) < job.bands)
+    std::this_thread::yield();
+  m_busy.unlock();
+}
+
+void ConvertPool::convert_band(const Job &job, int y0, int y1) {
+  if (job.dst_uv)
+    yuv_to_nv12(job.src, job.dst, job.dst_uv, job.dst_stride, y0, y1);
+  else
+    yuv_to_bgra(job.src, job.matrix, job.range, job.dst, job.dst_stride, y0,
+                y1);
+}
+
+void ConvertPool::run_bands(const Job &job, uint32_t generation) {
+  uint64_t next = m_next.load(std::memory_order_acquire);
+  while ((uint32_t)(next >> 32) == generation &&
+         (int)(uint32_t)next < job.bands) {
+    if (!m_next.compare_exchange_weak(next, next + 1,
+                                      std::memory_order_acq_rel))
+      continue; // `next` reloaded
+    int y = job.y0 + (int)(uint32_t)next * job.band_rows;
+    convert_band(job, y, std::min(y + job.band_rows, job.y1));
+    m_done.fetch_add(1, std::memory_order_release);
+    next = m_next.load(std::memory_order_acquire);
+  }
+}
+
+void ConvertPool::thread_func(int cpu) {
+  pin_current_thread(cpu);
+  uint32_t seen = 0;
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock,
+                  [&]() { return !m_running || m_generation != seen; });
+      if (!m_running)
+        return;
+      seen = m_generation;
+      job = m_job;
+    }
+    run_bands(job, seen);
+  }
+}
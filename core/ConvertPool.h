@@ -0,0 +1,80 @@
+#pragma once
+#ifndef CONVERT_POOL_H
+#define CONVERT_POOL_H
+
+#include "ColorConvert.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Persistent threads that split a frame's conversion (YUV -> BGRA, or the
+// repack into the NV12 frame bus) into horizontal bands, sized so a band's
+// source and destination rows stay in cache.
+// The caller converts bands too and returns once every band is written (a
+// barrier per frame), so a frame costs one wake-up, never a thread start.
+// Bands are claimed from a shared counter: a worker that is slow to wake
+// just takes fewer.
+//
+// One frame at a time. A caller that finds the pool busy with another
+// session's frame converts on its own thread rather than wait.
+class ConvertPool {
+public:
+  ConvertPool();
+  ~ConvertPool();
+
+  // `threads` counts the caller: 0 = one per core, 1 = no workers. Worker
+  // n is pinned to core n, leaving core 0 to the rest of the receiver.
+  // `bandRows` (0 = default) is rounded up to even for 4:2:0 chroma.
+  void start(int threads, int bandRows);
+  void stop();
+
+  // Threads converting a frame, caller included
+  int threads() const { return (int)m_threads.size() + 1; }
+  int band_rows() const { return m_bandRows; }
+
+  // yuv_to_bgra() over rows [y0, y1), spread across the pool
+  void convert(const YuvImage &src, YuvMatrix matrix, YuvRange range,
+               uint8_t *dst, int dstStride, int y0, int y1);
+  // yuv_to_nv12() likewise
+  void to_nv12(const YuvImage &src, uint8_t *dstY, uint8_t *dstUV,
+               int dstStride, int y0, int y1);
+
+private:
+  struct Job {
+    YuvImage src;
+    YuvMatrix matrix;
+    YuvRange range;
+    uint8_t *dst;
+    uint8_t *dst_uv; // NV12 target; null for BGRA
+    int dst_stride;
+    int y0, y1;
+    int band_rows;
+    int bands;
+  };
+
+  void run(Job job);
+  static void convert_band(const Job &job, int y0, int y1);
+  void thread_func(int cpu);
+  void run_bands(const Job &job, uint32_t generation);
+
+  int m_bandRows;
+  std::mutex m_busy; // Held by the caller for the whole frame
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_running;
+  uint32_t m_generation; // Bumped per frame
+  Job m_job;
+
+  // Generation in the high half, next unclaimed band in the low half, so
+  // a worker still holding the last frame's job cannot claim a band of
+  // this one
+  std::atomic<uint64_t> m_next;
+  std::atomic<int> m_done; // Bands written this frame
+  std::vector<std::thread> m_threads;
+};
+
+#endif // CONVERT_POOL_H
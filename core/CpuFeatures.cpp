@@ -0,0 +1,55 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) ||            \
+    defined(__i386__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuidex(r, leaf, subleaf);
+  for (int i = 0; i < 4; i++)
+    regs[i] = (unsigned)r[i];
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static bool os_saves_ymm() {
+#if defined(_MSC_VER)
+  return (_xgetbv(0) & 0x6) == 0x6;
+#else
+  unsigned lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (lo & 0x6) == 0x6;
+#endif
+}
+
+static bool detect_avx2() {
+  unsigned regs[4];
+  cpuid(0, 0, regs);
+  if (regs[0] < 7)
+    return false;
+  cpuid(1, 0, regs);
+  bool osxsave = (regs[2] & (1u << 27)) != 0;
+  bool avx = (regs[2] & (1u << 28)) != 0;
+  if (!osxsave || !avx || !os_saves_ymm())
+    return false;
+  cpuid(7, 0, regs);
+  return (regs[1] & (1u << 5)) != 0;
+}
+
+bool cpu_has_avx2() {
+  static const bool has = detect_avx2();
+  return has;
+}
+
+#else
+
+bool cpu_has_avx2() { return false; }
+
+#endif
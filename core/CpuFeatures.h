@@ -0,0 +1,12 @@
+#pragma once
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime CPU checks for the SIMD kernels that are built with a wider
+// instruction set than the rest of the core (ColorConvertAVX2.cpp,
+// FecAVX2.cpp). Always false on non-x86 targets.
+
+// AVX2 instructions are present and the OS saves the YMM registers
+bool cpu_has_avx2();
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,681 @@
+#include "Decoder.h"
+#include "ClockSync.h"
+#include "ColorConvert.h"
+#include "ConvertPool.h"
+#include "FrameBus.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+// NAL start code for Annex B format (required by FFmpeg H.264 decoder)
+static const uint8_t NAL_START_CODE[] = {0x00, 0x00, 0x00, 0x01};
+
+static const char *DECODE_PROFILE_NAMES[DECODE_PROFILE_COUNT] = {
+    "ultra-low-latency", "balanced", "throughput"};
+
+const char *decode_profile_name(DecodeProfile profile) {
+  return profile >= 0 && profile < DECODE_PROFILE_COUNT
+             ? DECODE_PROFILE_NAMES[profile]
+             : "unknown";
+}
+
+bool parse_decode_profile(const std::string &name, DecodeProfile *profile) {
+  for (int i = 0; i < DECODE_PROFILE_COUNT; i++) {
+    if (name == DECODE_PROFILE_NAMES[i]) {
+      *profile = (DecodeProfile)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// FFmpeg Log Callback
+static void ffmpeg_log_callback(void *ptr, int level, const char *fmt,
+                                va_list vl) {
+  if (level > AV_LOG_WARNING)
+    return; // Only log warnings and above
+
+  // Format the message
+  char line[1024];
+  vsnprintf(line, sizeof(line), fmt, vl);
+
+  // Write to our log file
+  log_msg(std::string("[FFMPEG] ") + line);
+}
+
+// Describes a decoded frame for the in-tree converter. Returns false for
+// formats it does not handle; those still go through libswscale.
+static bool frame_to_yuv_image(const AVFrame *frame, YuvImage *img) {
+  switch (frame->format) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+    img->layout = YUV_LAYOUT_I420;
+    break;
+  case AV_PIX_FMT_NV12:
+    img->layout = YUV_LAYOUT_NV12;
+    break;
+  default:
+    return false;
+  }
+  img->width = frame->width;
+  img->height = frame->height;
+  for (int i = 0; i < 3; i++) {
+    img->plane[i] = frame->data[i];
+    img->stride[i] = frame->linesize[i];
+  }
+  return true;
+}
+
+static bool in_tree_format(int format) {
+  return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P ||
+         format == AV_PIX_FMT_NV12;
+}
+
+// What the software decoder will output for a stream, so the converter can
+// be ready before the first frame. NONE where that is not certain.
+static int predicted_format(const H264Sps &sps) {
+  if (sps.bit_depth == 8) {
+    switch (sps.chroma_format_idc) {
+    case 0:
+      return AV_PIX_FMT_GRAY8;
+    case 1:
+      return sps.full_range ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+    case 2:
+      return sps.full_range ? AV_PIX_FMT_YUVJ422P : AV_PIX_FMT_YUV422P;
+    case 3:
+      return sps.full_range ? AV_PIX_FMT_YUVJ444P : AV_PIX_FMT_YUV444P;
+    }
+  } else if (sps.bit_depth == 10) {
+    switch (sps.chroma_format_idc) {
+    case 1:
+      return AV_PIX_FMT_YUV420P10;
+    case 2:
+      return AV_PIX_FMT_YUV422P10;
+    case 3:
+      return AV_PIX_FMT_YUV444P10;
+    }
+  }
+  return AV_PIX_FMT_NONE;
+}
+
+// Unspecified streams keep the BT.601 default libswscale used
+static YuvMatrix frame_matrix(const AVFrame *frame) {
+  return frame->colorspace == AVCOL_SPC_BT709 ? YUV_MATRIX_BT709
+                                              : YUV_MATRIX_BT601;
+}
+
+static YuvRange frame_range(const AVFrame *frame) {
+  return (frame->color_range == AVCOL_RANGE_JPEG ||
+          frame->format == AV_PIX_FMT_YUVJ420P)
+             ? YUV_RANGE_FULL
+             : YUV_RANGE_LIMITED;
+}
+
+// FrameSlot::color: readers do the RGB conversion, so they need both
+static uint32_t frame_color(const AVFrame *frame) {
+  return (frame_matrix(frame) == YUV_MATRIX_BT709 ? FRAME_COLOR_BT709 : 0) |
+         (frame_range(frame) == YUV_RANGE_FULL ? FRAME_COLOR_FULL_RANGE : 0);
+}
+
+Decoder::Decoder(PacketPool *pool, FrameBus *bus, const ClockSync *clock)
+    : m_pool(pool), m_bus(bus), m_clock(clock), m_codec(nullptr),
+      m_codecCtx(nullptr), m_frame(nullptr), m_packet(nullptr),
+      m_swsCtx(nullptr), m_convert(nullptr), m_swsFormat(-1),
+      m_swsWidth(-1), m_swsHeight(-1),
+      m_threadCount(0), m_openThreads(0),
+      m_profile(DECODE_ULTRA_LOW_LATENCY),
+      m_openProfile(DECODE_ULTRA_LOW_LATENCY), m_inFlight(),
+      m_inFlightNext(0), m_bandConvert(false), m_decoding(nullptr),
+      m_bandUs(0), m_openSlot(nullptr), m_hasSeenKeyframe(false),
+      m_fedSps(-1), m_fedPps(-1), m_fedSpsGen(0), m_fedPpsGen(0),
+      m_haveFormat(false), m_sendErrors(0), m_recvErrors(0) {}
+
+Decoder::~Decoder() {
+  if (m_swsCtx)
+    sws_freeContext(m_swsCtx);
+  if (m_frame)
+    av_frame_free(&m_frame);
+  if (m_packet)
+    av_packet_free(&m_packet);
+  if (m_codecCtx)
+    avcodec_free_context(&m_codecCtx);
+}
+
+bool Decoder::open() {
+  // Setup Logging
+  av_log_set_callback(ffmpeg_log_callback);
+  av_log_set_level(AV_LOG_WARNING);
+
+  m_codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+  if (!m_codec) {
+    log_err("Codec not found\n");
+    return false;
+  }
+
+  log_msg("Using H.264 software decoder\n");
+
+  m_frame = av_frame_alloc();
+  m_packet = av_packet_alloc();
+  if (!m_frame || !m_packet)
+    return false;
+
+  // NV12 output goes straight into shared memory; no staging frame
+  return setup_decoder();
+}
+
+// Core initialization of decoder context (Software Only). No extradata:
+// the parameter sets go in-band, in front of the IDR that needs them, and
+// the decoder follows SPS changes on its own without a new context.
+bool Decoder::setup_decoder() {
+  if (m_codecCtx) {
+    avcodec_free_context(&m_codecCtx);
+  }
+
+  m_codecCtx = avcodec_alloc_context3(m_codec);
+  if (!m_codecCtx) {
+    log_err("Could not allocate video codec context\n");
+    return false;
+  }
+
+  // Software decoding configuration. Slice threads only help streams
+  // coded with several slices per picture; they never add delay.
+  int threads = m_threadCount; // 0: auto-detect
+  switch (m_profile) {
+  case DECODE_ULTRA_LOW_LATENCY:
+  default:
+    m_codecCtx->thread_type = FF_THREAD_SLICE;
+    m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY; // No reorder buffering
+    break;
+  case DECODE_BALANCED:
+    m_codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (threads == 0 || threads > 2)
+      threads = 2;
+    break;
+  case DECODE_THROUGHPUT:
+    m_codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    break;
+  }
+  m_codecCtx->thread_count = threads;
+  m_openThreads = m_threadCount;
+  m_openProfile = m_profile;
+
+  // Frame threads would hand over rows of several pictures at once
+  bool bands = m_bandConvert && m_profile == DECODE_ULTRA_LOW_LATENCY;
+  if (bands) {
+    m_codecCtx->opaque = this;
+    m_codecCtx->draw_horiz_band = draw_band;
+  }
+  m_band.active = false;
+  log_msg(std::string("Decoder Configured for SOFTWARE decoding (") +
+          decode_profile_name(m_profile) +
+          (bands ? ", band convert, " : ", ") +
+          (threads ? std::to_string(threads) : std::string("auto")) +
+          " threads)\n");
+
+  if (avcodec_open2(m_codecCtx, m_codec, NULL) < 0) {
+    log_err("Could not open codec\n");
+    avcodec_free_context(&m_codecCtx);
+    return false;
+  }
+  return true;
+}
+
+void Decoder::reset_stream() {
+  m_hasSeenKeyframe = false;
+  // Possibly another phone: forget its parameter sets (the output format
+  // stays until an SPS says otherwise)
+  m_params = H264ParamSets();
+  m_fedSps = m_fedPps = -1;
+  m_band.active = false;
+  if (m_codecCtx &&
+      (m_threadCount != m_openThreads || m_profile != m_openProfile)) {
+    setup_decoder(); // New threading: before any frame, so cheap
+  } else if (m_codecCtx) {
+    // Flush decoder to remove any old reference frames
+    avcodec_flush_buffers(m_codecCtx);
+  }
+  log_msg("DEBUG: Waiting for Keyframe/SPS/PPS...\n");
+}
+
+void Decoder::restart() {
+  setup_decoder();
+  m_fedSps = m_fedPps = -1; // The new context has seen no headers
+}
+
+// Tracks the unit's parameter sets and works out which headers the decoder
+// needs in front of it. An IDR gets the SPS/PPS it uses prepended if the
+// decoder has not been given their current version since the last flush
+// (*prependSize > 0). In-band copies the decoder already has are skipped
+// instead: returns how many leading bytes of the unit to leave out.
+uint32_t Decoder::prepare_headers(const AccessUnit &au, size_t *prependSize) {
+  *prependSize = 0;
+  int spsId = -1, ppsId = -1;
+  H264ParamSets::Update spsUpdate = H264ParamSets::PS_INVALID;
+  H264ParamSets::Update ppsUpdate = H264ParamSets::PS_INVALID;
+  // An SPS this parser rejects is left to the decoder, untracked
+  if (au.sps_size)
+    spsUpdate = m_params.add_sps(au.data() + au.sps_offset, au.sps_size,
+                                 &spsId);
+  if (au.pps_size)
+    ppsUpdate = m_params.add_pps(au.data() + au.pps_offset, au.pps_size,
+                                 &ppsId);
+  if (!au.is_keyframe() || !au.slice_size)
+    return 0;
+
+  int slicePps;
+  if (!read_slice_pps_id(au.data() + au.slice_offset, au.slice_size,
+                         &slicePps))
+    return 0;
+  const H264Sps *sps = m_params.sps_for_pps(slicePps);
+  if (!sps)
+    return 0; // Headers never seen (or unparseable): send as is
+
+  // Geometry and format are settled before the first frame decodes
+  if (!m_haveFormat || sps->width != m_format.width ||
+      sps->height != m_format.height ||
+      sps->chroma_format_idc != m_format.chroma_format_idc ||
+      sps->bit_depth != m_format.bit_depth ||
+      sps->full_range != m_format.full_range ||
+      sps->matrix != m_format.matrix)
+    configure_output(*sps);
+
+  uint32_t spsGen = m_params.sps_entry(sps->id).generation;
+  uint32_t ppsGen = m_params.pps_entry(slicePps).generation;
+  bool decoderHas = m_fedSps == sps->id && m_fedSpsGen == spsGen &&
+                    m_fedPps == slicePps && m_fedPpsGen == ppsGen;
+  m_fedSps = sps->id;
+  m_fedSpsGen = spsGen;
+  m_fedPps = slicePps;
+  m_fedPpsGen = ppsGen;
+
+  bool inBand = spsId == sps->id && ppsId == slicePps;
+  if (!decoderHas && !inBand) {
+    *prependSize = 8 + m_params.sps_entry(sps->id).nal.size() +
+                   m_params.pps_entry(slicePps).nal.size();
+    return 0;
+  }
+  // Everything ahead of the first slice can go if it is only the repeated
+  // headers (and an AUD): [AUD][SPS][PPS][IDR...], as VideoToolbox sends
+  // it. Anything else there (SEI) keeps the unit whole.
+  const uint32_t SKIPPABLE = (1u << NAL_AUD) | (1u << NAL_SPS) |
+                             (1u << NAL_PPS) | (1u << NAL_IDR) |
+                             (1u << NAL_SLICE);
+  if (decoderHas && inBand && spsUpdate == H264ParamSets::PS_SAME &&
+      ppsUpdate == H264ParamSets::PS_SAME && !(au.nal_mask & ~SKIPPABLE) &&
+      au.sps_offset < au.slice_offset && au.pps_offset < au.slice_offset)
+    return au.slice_offset - 4;
+  return 0;
+}
+
+// A new stream format, known from its SPS ahead of the first frame: log
+// it, set up the converter and tell frame bus readers the new size
+void Decoder::configure_output(const H264Sps &sps) {
+  static const char *CHROMA[] = {"4:0:0", "4:2:0", "4:2:2", "4:4:4"};
+  std::stringstream ss;
+  ss << "Stream format: " << sps.width << "x" << sps.height;
+  if (sps.width != sps.coded_width || sps.height != sps.coded_height)
+    ss << " (coded " << sps.coded_width << "x" << sps.coded_height << ")";
+  ss << ", profile " << sps.profile_idc << " level " << sps.level_idc / 10
+     << "." << sps.level_idc % 10 << ", " << CHROMA[sps.chroma_format_idc]
+     << " " << sps.bit_depth << "-bit, "
+     << (sps.full_range ? "full" : "limited") << " range";
+  if (sps.fps() > 0)
+    ss << ", " << sps.fps() << " fps";
+  ss << ", " << sps.max_num_ref_frames << " ref";
+  if (sps.num_reorder_frames >= 0)
+    ss << ", " << sps.num_reorder_frames << " reorder";
+  ss << "\n";
+  log_msg(ss.str());
+
+  if (frame_nv12_bytes(sps.width, sps.height) > FRAME_BUFFER_SIZE)
+    log_err("Frames of this size do not fit the frame bus; not published\n");
+  prepare_converter(predicted_format(sps), sps.width, sps.height);
+  m_bus->announce_geometry((uint32_t)sps.width, (uint32_t)sps.height);
+  m_format = sps;
+  m_haveFormat = true;
+}
+
+// Re-initialize scaler if format/size changes. Only formats the NV12 repack
+// does not take need libswscale; NONE (not predictable from the SPS) waits for
+// the first frame.
+void Decoder::prepare_converter(int format, int width, int height) {
+  if (format == AV_PIX_FMT_NONE ||
+      (m_swsFormat == format && m_swsWidth == width &&
+       m_swsHeight == height))
+    return;
+  if (m_swsCtx) {
+    sws_freeContext(m_swsCtx);
+    m_swsCtx = NULL;
+  }
+  // Destination resolution should match source resolution (no scaling)
+  if (!in_tree_format(format)) {
+    m_swsCtx = sws_getContext(width, height, (AVPixelFormat)format, width,
+                              height, AV_PIX_FMT_NV12, SWS_BILINEAR, NULL,
+                              NULL, NULL);
+  }
+  m_swsFormat = format;
+  m_swsWidth = width;
+  m_swsHeight = height;
+}
+
+void Decoder::decode(AccessUnit &au) {
+  if (!au.buf || au.size == 0 || !m_codecCtx)
+    return;
+
+  uint64_t captureTimestampUs = au.timestamp_us;
+
+  // SPS (7), PPS (8), IDR (5) are critical for starting playback
+  if (au.has(NAL_SPS) || au.has(NAL_PPS) || au.is_keyframe()) {
+    if (!m_hasSeenKeyframe) {
+      log_msg(" [Keyframe/Header Found! Syncing Stream...] \n");
+      m_hasSeenKeyframe = true;
+    }
+  }
+
+  // If we haven't seen a keyframe yet, drop this packet to avoid artifacts
+  if (!m_hasSeenKeyframe) {
+    return;
+  }
+
+  size_t headerSize = 0;
+  uint32_t skip = prepare_headers(au, &headerSize);
+  if (!au.has_slices()) {
+    return; // Headers only: bundled with the next IDR
+  }
+
+  if (headerSize) {
+    // Rare path: rebuild the unit with the headers in front
+    AVBufferRef *buf = m_pool->get(headerSize + au.size);
+    if (!buf) {
+      log_err("OOM: Could not allocate packet buffer\n");
+      return;
+    }
+    const std::vector<uint8_t> &sps = m_params.sps_entry(m_fedSps).nal;
+    const std::vector<uint8_t> &pps = m_params.pps_entry(m_fedPps).nal;
+    uint8_t *dst = buf->data;
+    memcpy(dst, NAL_START_CODE, 4);
+    memcpy(dst + 4, sps.data(), sps.size());
+    dst += 4 + sps.size();
+    memcpy(dst, NAL_START_CODE, 4);
+    memcpy(dst + 4, pps.data(), pps.size());
+    dst += 4 + pps.size();
+    memcpy(dst, au.data(), au.size + AV_INPUT_BUFFER_PADDING_SIZE);
+    m_pool->count_copy(headerSize + au.size);
+
+    av_buffer_unref(&au.buf);
+    au.buf = buf;
+    au.size += (uint32_t)headerSize;
+  }
+
+  // Direct Send to Decoder: the packet takes over our buffer reference
+  AVPacket *pkt = m_packet;
+  pkt->buf = au.buf;
+  pkt->data = au.buf->data + skip; // Past headers the decoder already has
+  pkt->size = (int)(au.size - skip);
+  pkt->pts = (int64_t)captureTimestampUs; // Comes back on the decoded frame
+  au.buf = nullptr;
+
+  // Set Flags
+  if (au.is_keyframe()) {
+    pkt->flags |= AV_PKT_FLAG_KEY;
+  }
+
+  m_stats.units++;
+  m_stats.nals += au.nal_count;
+
+  auto t0 = std::chrono::steady_clock::now();
+  m_inFlight[m_inFlightNext++ % IN_FLIGHT] = {pkt->pts, t0};
+  m_decoding = &au; // Slice layout for draw_band
+
+  int sendRes = avcodec_send_packet(m_codecCtx, pkt);
+  if (sendRes < 0) {
+    m_sendErrors++;
+    if (m_sendErrors % 100 == 1) {
+      char errbuf[AV_ERROR_MAX_STRING_SIZE] = {0};
+      av_strerror(sendRes, errbuf, AV_ERROR_MAX_STRING_SIZE);
+      log_err("Error sending packet: " + std::string(errbuf) + "\n");
+    }
+  } else {
+    while (true) {
+      int recvRes = avcodec_receive_frame(m_codecCtx, m_frame);
+      if (recvRes == AVERROR(EAGAIN) || recvRes == AVERROR_EOF) {
+        break;
+      }
+      if (recvRes < 0) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(recvRes, errbuf, AV_ERROR_MAX_STRING_SIZE);
+        m_recvErrors++;
+        if (m_recvErrors % 100 == 1) {
+          log_err("Error receiving frame: " + std::string(errbuf) + "\n");
+        }
+        break;
+      }
+
+      auto t1 = std::chrono::steady_clock::now(); // Decode Done
+      count_in_out(m_frame->pts, t1);
+
+      // Capture time of this picture (the decoder may hand back an earlier
+      // unit than the one just sent)
+      publish_frame(m_frame->pts != AV_NOPTS_VALUE ? (uint64_t)m_frame->pts
+                                                   : captureTimestampUs);
+
+      auto t2 = std::chrono::steady_clock::now(); // Render Done
+
+      m_stats.decode_us +=
+          std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0)
+              .count();
+      m_stats.render_us +=
+          std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
+              .count();
+      m_stats.frames++;
+
+      if (m_onFrame)
+        m_onFrame();
+    }
+  }
+  m_decoding = nullptr;
+  // Drops our reference; the buffer returns to the pool once the decoder
+  // is done with it too
+  av_packet_unref(pkt);
+}
+
+// Matches a picture back to the packet it came from: with frame threads
+// that was a few decode() calls ago
+void Decoder::count_in_out(int64_t pts,
+                           std::chrono::steady_clock::time_point out) {
+  for (const InFlight &f : m_inFlight) {
+    if (f.pts == pts && f.pts != AV_NOPTS_VALUE) {
+      m_stats.in_out_us +=
+          std::chrono::duration_cast<std::chrono::microseconds>(out - f.sent)
+              .count();
+      m_stats.in_out_frames++;
+      return;
+    }
+  }
+}
+
+void Decoder::publish_frame(uint64_t captureTimestampUs) {
+  AVFrame *frame = m_frame;
+  int64_t frameLocalUs = m_clock->capture_to_local_us(captureTimestampUs);
+
+  YuvImage yuv;
+  bool inTreeConvert = frame_to_yuv_image(frame, &yuv);
+
+  // Normally done ahead from the SPS; this catches anything it missed
+  prepare_converter(frame->format, frame->width, frame->height);
+
+  // Repack straight into the next shared-memory slot as NV12, the
+  // decoder's own 4:2:0 at 12 bits per pixel; readers convert to what they
+  // need. Up to 1920x1080, portrait included, fits. Claiming a slot never
+  // waits on readers (seqlock).
+  bool fits =
+      frame_nv12_bytes(frame->width, frame->height) <= FRAME_BUFFER_SIZE;
+  if (m_bus->layout() && fits && (inTreeConvert || m_swsCtx)) {
+    // Band conversion may already have claimed a slot and filled most of it
+    FrameSlot *slot = m_openSlot ? m_openSlot : m_bus->begin_write();
+    m_openSlot = nullptr;
+    int stride = (int)frame_nv12_stride(frame->width);
+    uint8_t *dst[4] = {slot->data, slot->data + (size_t)stride * frame->height,
+                       NULL, NULL};
+    int dstStride[4] = {stride, stride, 0, 0};
+
+    if (finish_band(frame, dst[0], dst[1], stride)) {
+      // Converted while it was being decoded
+    } else if (inTreeConvert) {
+      convert_rows(yuv, dst[0], dst[1], stride, 0, frame->height);
+    } else {
+      sws_scale(m_swsCtx, (uint8_t const *const *)frame->data,
+                frame->linesize, 0, frame->height, dst, dstStride);
+    }
+
+    slot->width = frame->width;
+    slot->height = frame->height;
+    slot->stride = (uint32_t)stride;
+    slot->format = FRAME_FORMAT_NV12;
+    slot->color = frame_color(frame);
+    slot->timestamp_us = (uint64_t)frameLocalUs;
+    m_bus->end_write(slot);
+  }
+
+  // Calculate E2E Latency
+  m_stats.e2e_ms += (clock_now_us() - frameLocalUs) / 1000.0;
+}
+
+void Decoder::convert_rows(const YuvImage &yuv, uint8_t *dstY,
+                           uint8_t *dstUV, int dstStride, int y0, int y1) {
+  if (m_convert)
+    m_convert->to_nv12(yuv, dstY, dstUV, dstStride, y0, y1);
+  else
+    yuv_to_nv12(yuv, dstY, dstUV, dstStride, y0, y1);
+}
+
+// draw_horiz_band: rows [y, y + height) of `src` are decoded (and
+// deblocked) and will not change, except next to slice boundaries when
+// slice threads defer filtering across them. Runs inside
+// avcodec_send_packet, on the decoder thread or a slice thread.
+void Decoder::draw_band(AVCodecContext *ctx, const AVFrame *src, int[],
+                        int y, int, int height) {
+  static_cast<Decoder *>(ctx->opaque)->convert_band(src, y, height);
+}
+
+void Decoder::convert_band(const AVFrame *src, int y, int height) {
+  auto t0 = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_bandLock);
+    if (src->data[0] != m_band.luma || src->pts != m_band.pts) {
+      if (!start_band(src))
+        return;
+    }
+    if (!m_band.active)
+      return;
+  }
+
+  int y1 = std::min(y + height, m_band.yuv.height);
+  if (y < 0 || y >= y1)
+    return;
+  int stride = (int)frame_nv12_stride(m_band.yuv.width);
+  yuv_to_nv12(m_band.yuv, m_openSlot->data,
+              m_openSlot->data + (size_t)stride * m_band.yuv.height, stride,
+              y, y1);
+  memset(&m_bandRows[y], 1, y1 - y);
+  m_bandUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - t0)
+                  .count();
+}
+
+// First band of a picture: claims the slot it will be published in. A
+// picture that never comes out (or comes out later than the next one
+// starts) just leaves the slot to the next.
+bool Decoder::start_band(const AVFrame *src) {
+  m_band.active = false;
+  m_band.luma = src->data[0];
+  m_band.pts = src->pts;
+
+  // Rows line up with the output only without top/left cropping, and
+  // field pictures come in as alternate lines
+  YuvImage yuv;
+  if (!m_bus->layout() || !m_haveFormat || !m_format.frame_mbs_only ||
+      m_format.crop_left || m_format.crop_top ||
+      !frame_to_yuv_image(src, &yuv) ||
+      frame_nv12_bytes(src->width, src->height) > FRAME_BUFFER_SIZE)
+    return false;
+
+  if (!m_openSlot)
+    m_openSlot = m_bus->begin_write();
+  m_band.active = true;
+  m_band.format = src->format;
+  m_band.yuv = yuv;
+  if (m_decoding) {
+    m_band.slice_count = m_decoding->slice_count;
+    memcpy(m_band.slice_first_mb, m_decoding->slice_first_mb,
+           sizeof(m_band.slice_first_mb));
+  } else {
+    m_band.slice_count = AccessUnit::MAX_SLICES + 1; // Unknown
+  }
+  m_bandRows.assign((size_t)src->height, 0);
+  m_bandUs = 0;
+  return true;
+}
+
+// The picture is out: if it is the one converted in bands, converts what
+// the bands did not cover and returns true
+bool Decoder::finish_band(const AVFrame *frame, uint8_t *dstY,
+                          uint8_t *dstUV, int dstStride) {
+  if (!m_band.active)
+    return false;
+  m_band.active = false;
+  // Concealed errors rewrite pixels after their rows were handed over
+  if (frame->data[0] != m_band.luma || frame->pts != m_band.pts ||
+      frame->format != m_band.format || frame->width != m_band.yuv.width ||
+      frame->height != m_band.yuv.height || frame->decode_error_flags ||
+      m_band.slice_count > AccessUnit::MAX_SLICES)
+    return false;
+
+  auto t0 = std::chrono::steady_clock::now();
+  // Slice threads deblock each slice's first macroblock row once its
+  // neighbour above is done, after both have been handed over; redo the
+  // rows that filtering (and the bands straddling it) can touch
+  static const int SLICE_EDGE_ROWS = 32;
+  int mbWidth = m_format.coded_width / 16;
+  for (uint32_t i = 0; i < m_band.slice_count; i++) {
+    int edge = (int)(m_band.slice_first_mb[i] / mbWidth) * 16;
+    if (edge == 0)
+      continue;
+    int from = std::max(0, edge - SLICE_EDGE_ROWS);
+    int to = std::min(frame->height, edge + SLICE_EDGE_ROWS);
+    if (from < to)
+      memset(&m_bandRows[from], 0, to - from);
+  }
+  for (int y = 0; y < frame->height;) {
+    if (m_bandRows[y]) {
+      y++;
+      continue;
+    }
+    int end = y;
+    while (end < frame->height && !m_bandRows[end])
+      end++;
+    convert_rows(m_band.yuv, dstY, dstUV, dstStride, y, end);
+    y = end;
+  }
+
+  double bandUs = (double)m_bandUs.load();
+  double tailUs = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+  m_stats.band_frames++;
+  if (bandUs + tailUs > 0)
+    m_stats.overlap_sum += bandUs / (bandUs + tailUs);
+  return true;
+}
@@ -0,0 +1,187 @@
+#pragma once
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "AccessUnit.h"
+#include "ColorConvert.h"
+#include "H264Params.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct AVCodec;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+class ClockSync;
+class ConvertPool;
+class FrameBus;
+struct FrameSlot;
+
+// How the decoder trades latency for throughput. Frame threading decodes
+// N pictures at once, but each one then comes out N-1 pictures late.
+enum DecodeProfile {
+  DECODE_ULTRA_LOW_LATENCY, // Slice threads only, AV_CODEC_FLAG_LOW_DELAY:
+                            // every picture out on the call that sent it
+  DECODE_BALANCED,          // Frame threads capped at 2: one picture late
+  DECODE_THROUGHPUT,        // Frame + slice threads on every core we get
+  DECODE_PROFILE_COUNT
+};
+
+// "ultra-low-latency", "balanced", "throughput"
+const char *decode_profile_name(DecodeProfile profile);
+bool parse_decode_profile(const std::string &name, DecodeProfile *profile);
+
+// Per-interval decode figures for the metrics line
+struct DecodeStats {
+  uint32_t units = 0;  // Access units sent to the decoder
+  uint32_t nals = 0;   // NALs in those units
+  uint32_t frames = 0; // Pictures published
+  long long decode_us = 0;
+  long long render_us = 0;
+  double e2e_ms = 0; // Sum of capture -> published latencies
+  // Packet in (avcodec_send_packet) to its picture out, summed over the
+  // pictures matched back to their packet; includes frame-thread delay
+  long long in_out_us = 0;
+  uint32_t in_out_frames = 0;
+  // Band conversion: pictures converted while being decoded, and the share
+  // of each one's conversion time that overlapped decoding, summed
+  uint32_t band_frames = 0;
+  double overlap_sum = 0;
+};
+
+// H.264 software decode, repacked as NV12 into the frame bus. Runs on one
+// thread (the decode stage); nothing here is thread-safe.
+class Decoder {
+public:
+  Decoder(PacketPool *pool, FrameBus *bus, const ClockSync *clock);
+  ~Decoder();
+
+  // Finds the decoder and opens a context. Returns false on failure.
+  bool open();
+
+  // New connection: waits for SPS/IDR again and drops reference frames.
+  // The context is only re-created if the thread count changed.
+  void reset_stream();
+
+  // Decodes one access unit (Annex B, start codes already in place). The
+  // pooled buffer is handed to the decoder by reference, never copied.
+  void decode(AccessUnit &au);
+
+  // FFmpeg decode threads from the next reset_stream() on; 0 = one per
+  // core. Concurrent sessions split the cores between them.
+  void set_thread_count(int threads) { m_threadCount = threads; }
+
+  // Takes effect at the next reset_stream() or restart()
+  void set_profile(DecodeProfile profile) { m_profile = profile; }
+  // Profile of the open context
+  DecodeProfile profile() const { return m_openProfile; }
+
+  // Converts rows into the frame bus as the decoder finishes them
+  // (draw_horiz_band) rather than once the picture is out. Needs a context
+  // without frame threads, i.e. DECODE_ULTRA_LOW_LATENCY; ignored
+  // otherwise. Takes effect when the context is next created.
+  void set_band_convert(bool enabled) { m_bandConvert = enabled; }
+
+  // Whole-picture conversions go through `pool` (shared between
+  // sessions); null converts on the calling thread
+  void set_convert_pool(ConvertPool *pool) { m_convert = pool; }
+
+  // Re-creates the context with the current profile and thread count,
+  // keeping the stream's parameter sets. Call right before a keyframe.
+  void restart();
+
+  // Called after every published frame (e.g. to repaint a preview)
+  void set_frame_callback(std::function<void()> callback) {
+    m_onFrame = callback;
+  }
+
+  const DecodeStats &stats() const { return m_stats; }
+  void reset_stats() { m_stats = DecodeStats(); }
+
+private:
+  bool setup_decoder();
+  uint32_t prepare_headers(const AccessUnit &au, size_t *prependSize);
+  void configure_output(const H264Sps &sps);
+  void prepare_converter(int format, int width, int height);
+  void count_in_out(int64_t pts, std::chrono::steady_clock::time_point out);
+  void publish_frame(uint64_t captureTimestampUs);
+  void convert_rows(const YuvImage &yuv, uint8_t *dstY, uint8_t *dstUV,
+                    int dstStride, int y0, int y1);
+
+  static void draw_band(AVCodecContext *ctx, const AVFrame *src,
+                        int offset[], int y, int type, int height);
+  void convert_band(const AVFrame *src, int y, int height);
+  bool start_band(const AVFrame *src);
+  bool finish_band(const AVFrame *frame, uint8_t *dstY, uint8_t *dstUV,
+                   int dstStride);
+
+  PacketPool *m_pool;
+  FrameBus *m_bus;
+  const ClockSync *m_clock;
+  std::function<void()> m_onFrame;
+
+  const AVCodec *m_codec;
+  AVCodecContext *m_codecCtx;
+  AVFrame *m_frame;
+  AVPacket *m_packet; // Reused; wraps pooled buffers
+  SwsContext *m_swsCtx;
+  ConvertPool *m_convert;
+  int m_swsFormat, m_swsWidth, m_swsHeight;
+  int m_threadCount;
+  int m_openThreads; // thread_count of the open context
+  DecodeProfile m_profile;
+  DecodeProfile m_openProfile;
+
+  // Send time of recent packets by pts, for DecodeStats::in_out_us
+  enum { IN_FLIGHT = 64 };
+  struct InFlight {
+    int64_t pts;
+    std::chrono::steady_clock::time_point sent;
+  };
+  InFlight m_inFlight[IN_FLIGHT];
+  uint32_t m_inFlightNext;
+
+  // Band conversion of the picture being decoded. draw_horiz_band runs on
+  // the slice threads, several at once, each on rows of its own; the lock
+  // only covers moving on to a new picture.
+  struct BandPicture {
+    bool active = false;
+    const uint8_t *luma = nullptr; // Which picture: its buffer and pts
+    int64_t pts = 0;
+    int format = -1;
+    YuvImage yuv;
+    uint32_t slice_count = 0;
+    uint32_t slice_first_mb[AccessUnit::MAX_SLICES];
+  };
+  bool m_bandConvert;
+  std::mutex m_bandLock;
+  BandPicture m_band;
+  const AccessUnit *m_decoding;    // Unit inside decode(), for its slices
+  std::vector<uint8_t> m_bandRows;  // Non-zero once the row is converted
+  std::atomic<int64_t> m_bandUs;    // Conversion time inside the decoder
+  FrameSlot *m_openSlot;            // Claimed from the bus, not published
+
+  // Connection / Stream State
+  bool m_hasSeenKeyframe;
+
+  // Parameter sets by ID, and the versions the decoder has been given
+  // since the last flush (-1: none)
+  H264ParamSets m_params;
+  int m_fedSps, m_fedPps;
+  uint32_t m_fedSpsGen, m_fedPpsGen;
+  H264Sps m_format; // Active SPS the output is configured for
+  bool m_haveFormat;
+
+  int m_sendErrors;
+  int m_recvErrors;
+  DecodeStats m_stats;
+};
+
+#endif // DECODER_H
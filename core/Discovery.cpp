@@ -0,0 +1,215 @@
+#include "Discovery.h"
+#include "ClockSync.h"
+#include "Log.h"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+#include <string>
+
+static const uint32_t PING_PERIOD_MS = 1000;
+// Log the clock model once a minute
+static const uint64_t SYNC_REPORT_SAMPLES = 60;
+
+Discovery::Discovery(ClockSync *clock)
+    : m_clock(clock), m_reactor(nullptr), m_timer(0), m_port(0),
+      m_socket(INVALID_SOCKET_VALUE), m_deviceAvailable(false),
+      m_lastConsoleState(STATE_WAITING) {
+  memset(&m_broadcastAddr, 0, sizeof(m_broadcastAddr));
+  memset(&m_lastDeviceAddr, 0, sizeof(m_lastDeviceAddr));
+  memset(m_lastDiscoveryName, 0, sizeof(m_lastDiscoveryName));
+  memset(m_lastDiscoveryIP, 0, sizeof(m_lastDiscoveryIP));
+}
+
+Discovery::~Discovery() { stop(); }
+
+bool Discovery::start(Reactor *reactor, uint16_t port,
+                      std::function<bool()> isConnected) {
+  m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (m_socket == INVALID_SOCKET_VALUE) {
+    log_msg("[Discovery] Error: Socket creation failed\n");
+    return false;
+  }
+
+  // 1. Enable Broadcast
+  int broadcast = 1;
+  if (setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST, (const char *)&broadcast,
+                 sizeof(broadcast)) < 0) {
+    log_msg("[Discovery] Error: Could not enable broadcast.\n");
+    socket_close(m_socket);
+    m_socket = INVALID_SOCKET_VALUE;
+    return false;
+  }
+
+  // 2. Bind to the discovery port
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = INADDR_ANY;
+  local.sin_port = htons(port);
+  if (bind(m_socket, (sockaddr *)&local, sizeof(local)) < 0) {
+    log_msg("[Discovery] Error: Bind failed.\n");
+    socket_close(m_socket);
+    m_socket = INVALID_SOCKET_VALUE;
+    return false;
+  }
+
+  // 3. Replies arrive through the reactor
+  socket_set_nonblocking(m_socket);
+
+  // 4. Setup Broadcast Destination
+  m_broadcastAddr.sin_family = AF_INET;
+  m_broadcastAddr.sin_port = htons(port);
+  m_broadcastAddr.sin_addr.s_addr = INADDR_BROADCAST;
+
+  m_port = port;
+  m_isConnected = isConnected;
+  m_reactor = reactor;
+  m_reactor->add(m_socket, REACTOR_READ, [this](uint32_t) { on_readable(); });
+  m_timer = m_reactor->add_timer(0, PING_PERIOD_MS, [this]() { on_tick(); });
+
+  log_msg("[Discovery] Starting Active Discovery (Broadcasting PING on " +
+          std::to_string(m_port) + ")...\n");
+  log_msg("Device Not Found\n");
+  return true;
+}
+
+void Discovery::stop() {
+  if (!m_reactor)
+    return;
+  m_reactor->cancel_timer(m_timer);
+  m_reactor->remove(m_socket);
+  m_reactor = nullptr;
+  socket_close(m_socket);
+  m_socket = INVALID_SOCKET_VALUE;
+}
+
+// Once a second: broadcast PING, take a clock sample, expire the device
+void Discovery::on_tick() {
+  static const char PING_PACKET[] = {0x41, 0x47, 0x43, 0x4D, 0x01, 1};
+
+  bool isConnected = m_isConnected && m_isConnected();
+  sendto(m_socket, PING_PACKET, sizeof(PING_PACKET), 0,
+         (sockaddr *)&m_broadcastAddr, sizeof(m_broadcastAddr));
+
+  // SYNC REQUEST every tick while connected: ClockSync keeps a window of
+  // samples to filter the Wi-Fi jitter out and follow the drift
+  if (isConnected && m_deviceAvailable) {
+    char syncPkt[13]; // Magic(4) + Type(1) + T1(8)
+    memcpy(syncPkt, "AGCM", 4);
+    syncPkt[4] = 0x03; // SYNC_REQUEST
+
+    int64_t t1 = clock_now_us();
+    // Little Endian assuming x64
+    memcpy(syncPkt + 5, &t1, 8);
+
+    // Send to specific device IP, not broadcast
+    sendto(m_socket, syncPkt, sizeof(syncPkt), 0,
+           (sockaddr *)&m_lastDeviceAddr, sizeof(m_lastDeviceAddr));
+  }
+
+  if (m_deviceAvailable) {
+    long long elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::steady_clock::now() -
+                            m_lastBeaconTime)
+                            .count();
+    if (elapsed > 3) {
+      m_deviceAvailable = false;
+
+      if (m_lastConsoleState != STATE_WAITING) {
+        if (!isConnected) {
+          log_msg("Device Not Found\n");
+          log_msg("[Discovery] Device Lost (Timeout)\n");
+        }
+        m_lastConsoleState = STATE_WAITING;
+      }
+    }
+  } else if (!isConnected && m_lastConsoleState != STATE_WAITING) {
+    log_msg("Device Not Found\n");
+    m_lastConsoleState = STATE_WAITING;
+  }
+}
+
+// PONGs and SYNC_REPLYs; drains everything queued
+void Discovery::on_readable() {
+  for (;;) {
+    char buf[1024];
+    sockaddr_in sender;
+    socklen_t senderLen = sizeof(sender);
+
+    int len = (int)recvfrom(m_socket, buf, sizeof(buf), 0, (sockaddr *)&sender,
+                            &senderLen);
+    if (len < 0 && socket_would_block())
+      return;
+    if (len <= 0)
+      continue; // ICMP errors etc. surface here; nothing to do
+
+    // PONG Format: Magic(4) + Type(1)=2 + Ver(1) + State(1) + Name(32)
+    if (len >= 39 && strncmp(buf, "AGCM", 4) == 0 && buf[4] == 0x02) {
+      char *namePtr = buf + 7;
+      char nameBuffer[33];
+      strncpy(nameBuffer, namePtr, 32);
+      nameBuffer[32] = 0; // Ensure null termination
+
+      // Extract Sender IP
+      char ipStr[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &(sender.sin_addr), ipStr, INET_ADDRSTRLEN);
+
+      std::string deviceName(nameBuffer);
+
+      // Only print if new or changed
+      if (std::string(m_lastDiscoveryName) != deviceName ||
+          strcmp(m_lastDiscoveryIP, ipStr) != 0) {
+        log_msg("[Discovery] Device Found: " + deviceName + " (" + ipStr +
+                ")\n");
+
+        // Update last discovered info
+        strncpy(m_lastDiscoveryName, nameBuffer, 32);
+        m_lastDiscoveryName[32] = 0;
+        strncpy(m_lastDiscoveryIP, ipStr, INET_ADDRSTRLEN - 1);
+        m_lastDiscoveryIP[INET_ADDRSTRLEN - 1] = 0;
+      }
+
+      m_lastDeviceAddr = sender;
+
+      m_lastBeaconTime = std::chrono::steady_clock::now();
+      m_deviceAvailable = true;
+
+      // UI Update Logic (Console Only, No Window Title)
+      bool isConnected = m_isConnected && m_isConnected();
+      m_lastConsoleState = isConnected ? STATE_CONNECTED : STATE_AVAILABLE;
+    } else if (len >= 29 && buf[4] == 0x04) {
+      // SYNC_REPLY: Magic(4)+Type(1)+T1(8)+T2(8)+T3(8)
+      int64_t t1, t2, t3;
+      memcpy(&t1, buf + 5, 8);
+      memcpy(&t2, buf + 13, 8);
+      memcpy(&t3, buf + 21, 8);
+
+      bool wasSynced = m_clock->synced();
+      uint64_t steps = m_clock->steps();
+      int64_t rtt = m_clock->on_reply(t1, t2, t3, clock_now_us());
+      if (rtt < 0)
+        continue;
+
+      std::stringstream ss;
+      if (!wasSynced) {
+        ss << "[ClockSync] Synced! Offset: " << m_clock->offset_ms()
+           << "ms | RTT: " << (rtt / 1000.0) << "ms\n";
+      } else if (m_clock->steps() != steps) {
+        ss << "[ClockSync] Clock stepped, resampling. Offset: "
+           << m_clock->offset_ms() << "ms\n";
+      } else if (m_clock->samples() % SYNC_REPORT_SAMPLES == 0) {
+        ClockModel model = m_clock->model();
+        ss << std::fixed << std::setprecision(2)
+           << "[ClockSync] Offset: " << m_clock->offset_ms()
+           << "ms | Skew: " << model.skew * 1e6
+           << "ppm | Min RTT: " << model.min_rtt_us / 1000.0
+           << "ms | RTT: " << rtt / 1000.0 << "ms | Samples: "
+           << m_clock->samples() << "\n";
+      } else {
+        continue;
+      }
+      log_msg(ss.str());
+    }
+  }
+}
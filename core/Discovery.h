@@ -0,0 +1,51 @@
+#pragma once
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include "Platform.h"
+#include "Reactor.h"
+#include <chrono>
+#include <functional>
+
+class ClockSync;
+
+// Active discovery on the AGCM UDP port: broadcasts PING once a second,
+// tracks the sender from its PONGs and, while a stream is connected, sends
+// a SYNC_REQUEST every second and feeds the replies to ClockSync. Runs
+// entirely on the Reactor thread: a read handler for replies and a 1 s
+// timer for the PING/SYNC cadence.
+class Discovery {
+public:
+  explicit Discovery(ClockSync *clock);
+  ~Discovery();
+
+  // `isConnected` reports whether a video stream is currently up
+  bool start(Reactor *reactor, uint16_t port,
+             std::function<bool()> isConnected);
+  // The reactor must no longer be running
+  void stop();
+
+private:
+  enum DiscoveryState { STATE_WAITING, STATE_AVAILABLE, STATE_CONNECTED };
+
+  void on_readable();
+  void on_tick();
+
+  ClockSync *m_clock;
+  std::function<bool()> m_isConnected;
+  Reactor *m_reactor;
+  TimerId m_timer;
+  uint16_t m_port;
+  socket_t m_socket;
+  sockaddr_in m_broadcastAddr;
+
+  // Track last discovery to avoid log spam
+  char m_lastDiscoveryName[33];
+  char m_lastDiscoveryIP[INET_ADDRSTRLEN];
+  sockaddr_in m_lastDeviceAddr;
+  std::chrono::steady_clock::time_point m_lastBeaconTime;
+  bool m_deviceAvailable;
+  DiscoveryState m_lastConsoleState;
+};
+
+#endif // DISCOVERY_H
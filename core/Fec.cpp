@@ -0,0 +1,226 @@
+#include "Fec.h"
+#include "CpuFeatures.h"
+#include "FecKernels.h"
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Defined in FecAVX2.cpp; false if that file was built without AVX2
+extern const bool kFecHasAvx2Kernel;
+
+// x^8 + x^4 + x^3 + x^2 + 1, with 2 as the generator
+static const int GF_POLY = 0x11D;
+
+struct GfTables {
+  uint8_t exp[510]; // Doubled so log a + log b needs no modulo
+  uint8_t log[256];
+
+  GfTables() {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+      exp[i] = exp[i + 255] = (uint8_t)x;
+      log[x] = (uint8_t)i;
+      x <<= 1;
+      if (x & 0x100)
+        x ^= GF_POLY;
+    }
+    log[0] = 0; // Never used: zero is special-cased
+  }
+};
+
+static const GfTables &gf() {
+  static const GfTables tables;
+  return tables;
+}
+
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0)
+    return 0;
+  const GfTables &t = gf();
+  return t.exp[t.log[a] + t.log[b]];
+}
+
+static uint8_t gf_inv(uint8_t a) {
+  const GfTables &t = gf();
+  return t.exp[255 - t.log[a]];
+}
+
+void gf_nibble_tables(uint8_t c, uint8_t lo[16], uint8_t hi[16]) {
+  for (int i = 0; i < 16; i++) {
+    lo[i] = gf_mul(c, (uint8_t)i);
+    hi[i] = gf_mul(c, (uint8_t)(i << 4));
+  }
+}
+
+void gf_mul_add_c(uint8_t *dst, const uint8_t *src, uint8_t c,
+                  size_t size) {
+  if (c == 1) {
+    for (size_t i = 0; i < size; i++)
+      dst[i] ^= src[i];
+    return;
+  }
+  uint8_t lo[16], hi[16];
+  gf_nibble_tables(c, lo, hi);
+  for (size_t i = 0; i < size; i++)
+    dst[i] ^= lo[src[i] & 15] ^ hi[src[i] >> 4];
+}
+
+#ifdef FEC_SSE2
+void gf_mul_add_sse2(uint8_t *dst, const uint8_t *src, uint8_t c,
+                     size_t size) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i poly = _mm_set1_epi8((char)(GF_POLY & 0xFF));
+
+  size_t x = 0;
+  for (; x + 16 <= size; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + x));
+    __m128i acc = zero;
+    for (unsigned bits = c;;) {
+      if (bits & 1)
+        acc = _mm_xor_si128(acc, v);
+      bits >>= 1;
+      if (!bits)
+        break;
+      // v * 2: shift left, reduce the bytes whose top bit fell out
+      __m128i carry = _mm_and_si128(_mm_cmplt_epi8(v, zero), poly);
+      v = _mm_xor_si128(_mm_add_epi8(v, v), carry);
+    }
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+    _mm_storeu_si128((__m128i *)(dst + x), _mm_xor_si128(d, acc));
+  }
+  gf_mul_add_c(dst + x, src + x, c, size - x);
+}
+#endif // FEC_SSE2
+
+// Runtime CPU dispatch, resolved once
+struct MulAddBackend {
+  GfMulAddFunc func;
+  const char *name;
+};
+
+static MulAddBackend select_backend() {
+  if (kFecHasAvx2Kernel && cpu_has_avx2())
+    return {gf_mul_add_avx2, "AVX2"};
+#ifdef FEC_SSE2
+  return {gf_mul_add_sse2, "SSE2"};
+#else
+  return {gf_mul_add_c, "C"};
+#endif
+}
+
+static const MulAddBackend &backend() {
+  static const MulAddBackend selected = select_backend();
+  return selected;
+}
+
+const char *fec_backend() { return backend().name; }
+
+void fec_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t size) {
+  if (c != 0)
+    backend().func(dst, src, c, size);
+}
+
+// Cauchy matrix 1 / (x_row + y_col) with x_row = 255 - row, y_col = col
+// (disjoint while col < 256 - FEC_MAX_REPAIR), each column scaled by
+// x_0 + y_col so that row 0 comes out as all ones
+uint8_t fec_coefficient(int row, int col) {
+  uint8_t y = (uint8_t)col;
+  return gf_mul((uint8_t)(255 ^ y), gf_inv((uint8_t)((255 - row) ^ y)));
+}
+
+void fec_encode(const uint8_t *const *sources, int k, int row,
+                uint8_t *repair, size_t size) {
+  if (row == 0 && k > 0) {
+    memcpy(repair, sources[0], size);
+    for (int j = 1; j < k; j++)
+      fec_mul_add(repair, sources[j], 1, size);
+    return;
+  }
+  memset(repair, 0, size);
+  for (int j = 0; j < k; j++)
+    fec_mul_add(repair, sources[j], fec_coefficient(row, j), size);
+}
+
+// Gauss-Jordan on the e x e system; Cauchy submatrices are never singular
+static void invert(uint8_t m[FEC_MAX_REPAIR][FEC_MAX_REPAIR], int e,
+                   uint8_t inv[FEC_MAX_REPAIR][FEC_MAX_REPAIR]) {
+  for (int i = 0; i < e; i++) {
+    for (int j = 0; j < e; j++)
+      inv[i][j] = i == j ? 1 : 0;
+  }
+  for (int col = 0; col < e; col++) {
+    int pivot = col;
+    while (m[pivot][col] == 0)
+      pivot++;
+    if (pivot != col) {
+      for (int j = 0; j < e; j++) {
+        uint8_t t = m[col][j];
+        m[col][j] = m[pivot][j];
+        m[pivot][j] = t;
+        t = inv[col][j];
+        inv[col][j] = inv[pivot][j];
+        inv[pivot][j] = t;
+      }
+    }
+    uint8_t scale = gf_inv(m[col][col]);
+    for (int j = 0; j < e; j++) {
+      m[col][j] = gf_mul(m[col][j], scale);
+      inv[col][j] = gf_mul(inv[col][j], scale);
+    }
+    for (int i = 0; i < e; i++) {
+      uint8_t f = m[i][col];
+      if (i == col || f == 0)
+        continue;
+      for (int j = 0; j < e; j++) {
+        m[i][j] ^= gf_mul(f, m[col][j]);
+        inv[i][j] ^= gf_mul(f, inv[col][j]);
+      }
+    }
+  }
+}
+
+bool fec_decode(uint8_t *const *sources, const bool *present, int k,
+                const uint8_t *const *repairs, const int *rows,
+                int repairCount, size_t size) {
+  int missing[FEC_MAX_REPAIR];
+  int e = 0;
+  for (int j = 0; j < k; j++) {
+    if (present[j])
+      continue;
+    if (e == FEC_MAX_REPAIR || e == repairCount)
+      return false;
+    missing[e++] = j;
+  }
+  if (e == 0)
+    return true;
+
+  // Take the present sources out of the first e repair symbols, leaving
+  // e equations in the missing ones
+  std::vector<uint8_t> rhs((size_t)e * size);
+  uint8_t m[FEC_MAX_REPAIR][FEC_MAX_REPAIR];
+  for (int i = 0; i < e; i++) {
+    uint8_t *r = &rhs[(size_t)i * size];
+    memcpy(r, repairs[i], size);
+    for (int j = 0; j < k; j++) {
+      if (present[j])
+        fec_mul_add(r, sources[j], fec_coefficient(rows[i], j), size);
+    }
+    for (int t = 0; t < e; t++)
+      m[i][t] = fec_coefficient(rows[i], missing[t]);
+  }
+
+  uint8_t inv[FEC_MAX_REPAIR][FEC_MAX_REPAIR];
+  invert(m, e, inv);
+  for (int t = 0; t < e; t++) {
+    uint8_t *out = sources[missing[t]];
+    memset(out, 0, size);
+    for (int i = 0; i < e; i++)
+      fec_mul_add(out, &rhs[(size_t)i * size], inv[t][i], size);
+  }
+  return true;
+}
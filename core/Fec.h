@@ -0,0 +1,47 @@
+#pragma once
+#ifndef FEC_H
+#define FEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Erasure code for forward error correction: a systematic Reed-Solomon
+// code over GF(2^8) (polynomial x^8 + x^4 + x^3 + x^2 + 1).
+//
+// k source symbols (equal-sized byte blocks) are protected by up to
+// FEC_MAX_REPAIR repair symbols; any k of the k + m symbols rebuild the
+// sources. Repair row r is
+//   repair[r] = sum over j of fec_coefficient(r, j) * source[j]
+// with a Cauchy matrix scaled so that row 0 is all ones: a single repair
+// symbol is the plain XOR parity of the group. Coefficients do not depend
+// on k or m, so a group can be cut short and its repair count chosen per
+// group without the two sides agreeing on anything else.
+//
+// The region kernel (dst ^= c * src) exists for AVX2, SSE2 and plain C and
+// is picked once at runtime from CPUID.
+#define FEC_MAX_SOURCE 128
+#define FEC_MAX_REPAIR 16
+
+// Generator coefficient of source `col` in repair row `row`
+uint8_t fec_coefficient(int row, int col);
+
+// Computes repair symbol `row` of the `k` sources. All buffers are `size`
+// bytes.
+void fec_encode(const uint8_t *const *sources, int k, int row,
+                uint8_t *repair, size_t size);
+
+// Rebuilds the sources whose `present` flag is false, in place in
+// `sources`, from the `repairCount` repair symbols `repairs` with row
+// numbers `rows`. Returns false (and writes nothing) if fewer repair
+// symbols than missing sources were given.
+bool fec_decode(uint8_t *const *sources, const bool *present, int k,
+                const uint8_t *const *repairs, const int *rows,
+                int repairCount, size_t size);
+
+// dst ^= c * src over `size` bytes; the kernel the codec runs on
+void fec_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t size);
+
+// Name of the kernel picked for this CPU ("AVX2", "SSE2" or "C")
+const char *fec_backend();
+
+#endif // FEC_H
@@ -0,0 +1,52 @@
+// Built with /arch:AVX2 (MSVC) or -mavx2 (GCC/Clang), see CMakeLists.txt.
+// Only called after Fec.cpp has checked CPUID.
+#include "FecKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+extern const bool kFecHasAvx2Kernel = true;
+
+// 32 bytes per iteration
+void gf_mul_add_avx2(uint8_t *dst, const uint8_t *src, uint8_t c,
+                     size_t size) {
+  size_t x = 0;
+  if (c == 1) {
+    for (; x + 32 <= size; x += 32) {
+      __m256i s = _mm256_loadu_si256((const __m256i *)(src + x));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+      _mm256_storeu_si256((__m256i *)(dst + x), _mm256_xor_si256(d, s));
+    }
+  } else {
+    uint8_t lo[16], hi[16];
+    gf_nibble_tables(c, lo, hi);
+    // Same table in both lanes: VPSHUFB only looks within its own lane
+    const __m256i tableLo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)lo));
+    const __m256i tableHi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)hi));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    for (; x + 32 <= size; x += 32) {
+      __m256i s = _mm256_loadu_si256((const __m256i *)(src + x));
+      __m256i l = _mm256_and_si256(s, nibble);
+      __m256i h = _mm256_and_si256(_mm256_srli_epi16(s, 4), nibble);
+      __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, l),
+                                   _mm256_shuffle_epi8(tableHi, h));
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+      _mm256_storeu_si256((__m256i *)(dst + x), _mm256_xor_si256(d, p));
+    }
+  }
+  gf_mul_add_c(dst + x, src + x, c, size - x);
+}
+
+#else // !__AVX2__
+
+extern const bool kFecHasAvx2Kernel = false;
+
+void gf_mul_add_avx2(uint8_t *dst, const uint8_t *src, uint8_t c,
+                     size_t size) {
+  gf_mul_add_c(dst, src, c, size);
+}
+
+#endif // __AVX2__
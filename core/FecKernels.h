@@ -0,0 +1,30 @@
+#pragma once
+#ifndef FEC_KERNELS_H
+#define FEC_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Internal to Fec*.cpp: region kernels for dst ^= c * src in GF(2^8).
+//
+// The C and AVX2 kernels split each source byte into nibbles:
+//   c * x = lo[x & 15] ^ hi[x >> 4]
+// with two 16-entry product tables per coefficient, which PSHUFB looks up
+// 32 bytes at a time. SSE2 has no byte shuffle, so its kernel multiplies
+// bit-serially instead (doubling with the reduction mask, XOR-ing in the
+// multiples c selects). c == 1 is a plain XOR everywhere.
+typedef void (*GfMulAddFunc)(uint8_t *dst, const uint8_t *src, uint8_t c,
+                             size_t size);
+
+uint8_t gf_mul(uint8_t a, uint8_t b);
+
+// lo[i] = c * i, hi[i] = c * (i << 4)
+void gf_nibble_tables(uint8_t c, uint8_t lo[16], uint8_t hi[16]);
+
+void gf_mul_add_c(uint8_t *dst, const uint8_t *src, uint8_t c, size_t size);
+void gf_mul_add_sse2(uint8_t *dst, const uint8_t *src, uint8_t c,
+                     size_t size);
+void gf_mul_add_avx2(uint8_t *dst, const uint8_t *src, uint8_t c,
+                     size_t size);
+
+#endif // FEC_KERNELS_H
@@ -0,0 +1,123 @@
+#include "Feedback.h"
+#include <string.h>
+
+static const size_t HEADER_SIZE = 9; // Magic + Type + SSRC
+
+static void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  put_le16(p, (uint16_t)v);
+  put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+  return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static std::vector<uint8_t> make_header(uint8_t type, uint32_t ssrc) {
+  std::vector<uint8_t> msg(HEADER_SIZE);
+  memcpy(msg.data(), "AGCM", 4);
+  msg[4] = type;
+  put_le32(&msg[5], ssrc);
+  return msg;
+}
+
+static bool check_header(const uint8_t *msg, size_t size, uint8_t type,
+                         uint32_t *ssrc) {
+  if (size < HEADER_SIZE || memcmp(msg, "AGCM", 4) != 0 || msg[4] != type)
+    return false;
+  *ssrc = get_le32(msg + 5);
+  return true;
+}
+
+std::vector<std::vector<uint8_t>> agcm_build_nacks(uint32_t ssrc,
+                                                   const uint16_t *seqs,
+                                                   size_t count) {
+  std::vector<std::vector<uint8_t>> out;
+  std::vector<uint8_t> msg;
+  size_t i = 0;
+  while (i < count) {
+    if (msg.empty()) {
+      msg = make_header(AGCM_NACK, ssrc);
+      msg.push_back(0); // Count
+    }
+
+    uint16_t pid = seqs[i++];
+    uint16_t blp = 0;
+    while (i < count) {
+      uint16_t d = (uint16_t)(seqs[i] - pid);
+      if (d < 1 || d > 16)
+        break;
+      blp |= (uint16_t)(1 << (d - 1));
+      i++;
+    }
+    size_t pos = msg.size();
+    msg.resize(pos + 4);
+    put_le16(&msg[pos], pid);
+    put_le16(&msg[pos + 2], blp);
+
+    if (++msg[HEADER_SIZE] == AGCM_NACK_MAX_ENTRIES) {
+      out.push_back(msg);
+      msg.clear();
+    }
+  }
+  if (!msg.empty())
+    out.push_back(msg);
+  return out;
+}
+
+std::vector<uint8_t> agcm_build_pli(uint32_t ssrc) {
+  return make_header(AGCM_PLI, ssrc);
+}
+
+std::vector<uint8_t> agcm_build_bitrate_target(uint32_t ssrc,
+                                               uint32_t bitrate, int fps) {
+  std::vector<uint8_t> msg = make_header(AGCM_BITRATE_TARGET, ssrc);
+  msg.resize(HEADER_SIZE + 5);
+  put_le32(&msg[HEADER_SIZE], bitrate);
+  msg[HEADER_SIZE + 4] = (uint8_t)(fps < 0 ? 0 : (fps > 255 ? 255 : fps));
+  return msg;
+}
+
+bool agcm_parse_nack(const uint8_t *msg, size_t size, uint32_t *ssrc,
+                     std::vector<uint16_t> *seqs) {
+  seqs->clear();
+  if (!check_header(msg, size, AGCM_NACK, ssrc) || size < HEADER_SIZE + 1)
+    return false;
+  size_t count = msg[HEADER_SIZE];
+  if (size < HEADER_SIZE + 1 + count * 4)
+    return false;
+
+  const uint8_t *entry = msg + HEADER_SIZE + 1;
+  for (size_t e = 0; e < count; e++, entry += 4) {
+    uint16_t pid = get_le16(entry);
+    uint16_t blp = get_le16(entry + 2);
+    seqs->push_back(pid);
+    for (int bit = 0; bit < 16; bit++) {
+      if (blp & (1 << bit))
+        seqs->push_back((uint16_t)(pid + bit + 1));
+    }
+  }
+  return true;
+}
+
+bool agcm_parse_pli(const uint8_t *msg, size_t size, uint32_t *ssrc) {
+  return check_header(msg, size, AGCM_PLI, ssrc);
+}
+
+bool agcm_parse_bitrate_target(const uint8_t *msg, size_t size,
+                               uint32_t *ssrc, uint32_t *bitrate, int *fps) {
+  if (!check_header(msg, size, AGCM_BITRATE_TARGET, ssrc) ||
+      size < HEADER_SIZE + 5)
+    return false;
+  *bitrate = get_le32(msg + HEADER_SIZE);
+  *fps = msg[HEADER_SIZE + 4];
+  return true;
+}
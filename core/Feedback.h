@@ -0,0 +1,47 @@
+#pragma once
+#ifndef FEEDBACK_H
+#define FEEDBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Feedback from the receiver to the phone, carried as AGCM messages to the
+// phone's discovery port (the socket that answers PING/SYNC). Little
+// endian, like SYNC_REQUEST/SYNC_REPLY.
+//
+//   NACK: Magic(4) + Type(1)=0x05 + SSRC(4) + Count(1) + Count * {PID(2),
+//         BLP(2)}. As RFC 4585 generic NACK: PID is a lost sequence number,
+//         bit i of BLP marks PID + i + 1 as lost too.
+//   PLI:  Magic(4) + Type(1)=0x06 + SSRC(4). Picture loss: send a keyframe
+//         (RFC 4585 PLI / RFC 5104 FIR have the same effect here). Also
+//         sent over TCP, with SSRC 0, by the latency governor.
+//   BITRATE_TARGET: Magic(4) + Type(1)=0x07 + SSRC(4) + Bitrate(4, bit/s)
+//         + FPS(1). What the encoder should aim for, from the receiver's
+//         bandwidth estimate (BandwidthEstimator.h). Sent on either
+//         transport; SSRC is 0 over TCP.
+#define AGCM_NACK 0x05
+#define AGCM_PLI 0x06
+#define AGCM_BITRATE_TARGET 0x07
+
+// Most NACK entries in one message (each covers up to 17 packets)
+#define AGCM_NACK_MAX_ENTRIES 64
+
+// `seqs` ascending, in 16-bit sequence order. Returns one message per
+// AGCM_NACK_MAX_ENTRIES entries.
+std::vector<std::vector<uint8_t>> agcm_build_nacks(uint32_t ssrc,
+                                                   const uint16_t *seqs,
+                                                   size_t count);
+std::vector<uint8_t> agcm_build_pli(uint32_t ssrc);
+std::vector<uint8_t> agcm_build_bitrate_target(uint32_t ssrc,
+                                               uint32_t bitrate, int fps);
+
+// Both return false for anything that is not a well-formed message of
+// their type. `seqs` is cleared first.
+bool agcm_parse_nack(const uint8_t *msg, size_t size, uint32_t *ssrc,
+                     std::vector<uint16_t> *seqs);
+bool agcm_parse_pli(const uint8_t *msg, size_t size, uint32_t *ssrc);
+bool agcm_parse_bitrate_target(const uint8_t *msg, size_t size,
+                               uint32_t *ssrc, uint32_t *bitrate, int *fps);
+
+#endif // FEEDBACK_H
@@ -0,0 +1,131 @@
+#include "FrameBus.h"
+#include "Log.h"
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+FrameBus::FrameBus() : m_shm(nullptr), m_notify(0) {
+  m_name[0] = 0;
+#ifdef _WIN32
+  m_hMapFile = NULL;
+#else
+  m_fd = -1;
+#endif
+}
+
+FrameBus::~FrameBus() { close(); }
+
+bool FrameBus::create(int session) {
+#ifdef _WIN32
+  frame_bus_name(m_name, sizeof(m_name), SHARED_MEMORY_NAME, session);
+  m_hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                  sizeof(SharedMemoryLayout), m_name);
+  if (m_hMapFile == NULL) {
+    log_err("Could not create file mapping object (" +
+            std::to_string(GetLastError()) + ").\n");
+    return false;
+  }
+  // The camera keeps the section alive across receiver restarts
+  bool isNew = GetLastError() != ERROR_ALREADY_EXISTS;
+
+  m_shm = (SharedMemoryLayout *)MapViewOfFile(
+      m_hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedMemoryLayout));
+  if (m_shm == NULL) {
+    log_err("Could not map view of file (" + std::to_string(GetLastError()) +
+            ").\n");
+    close();
+    return false;
+  }
+#else
+  frame_bus_name(m_name, sizeof(m_name), SHARED_MEMORY_POSIX_NAME, session);
+  m_fd = shm_open(m_name, O_CREAT | O_RDWR, 0644);
+  if (m_fd < 0) {
+    log_err("Could not create shared memory object (" +
+            std::to_string(errno) + ").\n");
+    return false;
+  }
+  // A reader that still has it mapped keeps the object alive across
+  // receiver restarts; only a fresh one is empty
+  struct stat st;
+  bool isNew = fstat(m_fd, &st) != 0 || st.st_size == 0;
+  if (ftruncate(m_fd, sizeof(SharedMemoryLayout)) != 0) {
+    log_err("Could not size shared memory object (" + std::to_string(errno) +
+            ").\n");
+    close();
+    return false;
+  }
+
+  void *view = mmap(NULL, sizeof(SharedMemoryLayout), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, m_fd, 0);
+  if (view == MAP_FAILED) {
+    log_err("Could not map shared memory (" + std::to_string(errno) + ").\n");
+    close();
+    return false;
+  }
+  m_shm = (SharedMemoryLayout *)view;
+#endif
+
+  if (isNew || m_shm->magic != SHARED_MEMORY_MAGIC ||
+      m_shm->version != SHARED_MEMORY_VERSION) {
+    // Init Header
+    m_shm->magic = SHARED_MEMORY_MAGIC;
+    m_shm->version = SHARED_MEMORY_VERSION; // Version 4: seqlock ring of NV12
+    m_shm->slot_count = FRAME_SLOT_COUNT;
+    m_shm->width = VIDEO_WIDTH;
+    m_shm->height = VIDEO_HEIGHT;
+    m_shm->write_sequence = 0;
+    m_shm->latest_slot = 0;
+    m_shm->waiter_count = 0;
+  } else {
+    // Re-opened under readers: their waiter_count registrations and the
+    // sequence they compare against stay. A slot left mid-write by a
+    // receiver that died is marked stable so the next write makes it odd.
+    for (int i = 0; i < FRAME_SLOT_COUNT; i++) {
+      if (m_shm->slots[i].sequence & 1)
+        shm_store_release(&m_shm->slots[i].sequence,
+                          m_shm->slots[i].sequence + 1);
+    }
+  }
+
+  // Readers fall back to polling if this fails, so it is not fatal
+  m_notify = frame_notify_create(session);
+  if (!m_notify)
+    log_err("Could not create frame event.\n");
+  return true;
+}
+
+void FrameBus::close() {
+#ifdef _WIN32
+  if (m_shm)
+    UnmapViewOfFile(m_shm);
+  if (m_hMapFile)
+    CloseHandle(m_hMapFile);
+  m_hMapFile = NULL;
+#else
+  if (m_shm)
+    munmap(m_shm, sizeof(SharedMemoryLayout));
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    // Readers that still have it mapped keep their view
+    shm_unlink(m_name);
+  }
+  m_fd = -1;
+#endif
+  m_shm = nullptr;
+  frame_notify_close(m_notify);
+  m_notify = 0;
+}
+
+void FrameBus::end_write(FrameSlot *slot) {
+  frame_slot_end_write(m_shm, slot);
+  frame_notify_publish(m_shm, m_notify);
+}
+
+void FrameBus::announce_geometry(uint32_t width, uint32_t height) {
+  if (m_shm)
+    frame_bus_announce_geometry(m_shm, width, height);
+}
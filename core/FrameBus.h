@@ -0,0 +1,52 @@
+#pragma once
+#ifndef FRAME_BUS_H
+#define FRAME_BUS_H
+
+#include "Platform.h" // Before FrameNotify.h (winsock2 ordering)
+
+#include "FrameNotify.h"
+#include "SharedMemory.h"
+
+// Writer end of the shared-memory frame ring (SharedMemoryLayout v4).
+//
+// Windows: named file mapping SHARED_MEMORY_NAME, read by the DirectShow
+// filter. POSIX: shm_open(SHARED_MEMORY_POSIX_NAME), so local tools can
+// attach to it the same way. Either way each published frame wakes
+// readers through FrameNotify. Sessions other than 0 get their own bus
+// under a suffixed name (frame_bus_name).
+class FrameBus {
+public:
+  FrameBus();
+  ~FrameBus();
+
+  // Creates (or attaches to) the section of `session`. The header is only
+  // initialised in a new section; one a reader kept alive keeps its
+  // sequence and waiter counts. Returns false and logs on failure.
+  bool create(int session = 0);
+  void close();
+
+  SharedMemoryLayout *layout() const { return m_shm; }
+
+  // Slot to write the next frame into. Never blocks.
+  FrameSlot *begin_write() { return frame_slot_begin_write(m_shm); }
+
+  // Publishes `slot` (geometry/format/timestamp already filled in) and
+  // wakes waiting readers.
+  void end_write(FrameSlot *slot);
+
+  // Geometry of the frames about to come, from the stream's SPS, so readers
+  // can pick a media type before the first of them is published
+  void announce_geometry(uint32_t width, uint32_t height);
+
+private:
+  SharedMemoryLayout *m_shm;
+  FrameNotifyHandle m_notify;
+  char m_name[FRAME_BUS_NAME_SIZE];
+#ifdef _WIN32
+  HANDLE m_hMapFile;
+#else
+  int m_fd;
+#endif
+};
+
+#endif // FRAME_BUS_H
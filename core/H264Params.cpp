@@ -0,0 +1,321 @@
+#include "H264Params.h"
+#include <string.h>
+
+namespace {
+
+// MSB-first reader over the RBSP of a NAL unit: emulation prevention bytes
+// (00 00 03) are dropped on the fly. Reading past the end sets a sticky
+// error and returns zeros, so parsers check once at the end.
+class BitReader {
+public:
+  BitReader(const uint8_t *data, uint32_t size)
+      : m_data(data), m_size(size), m_pos(0), m_bit(0), m_zeros(0),
+        m_error(false) {
+    skip_emulation();
+  }
+
+  bool error() const { return m_error; }
+
+  uint32_t bit() {
+    if (m_pos >= m_size) {
+      m_error = true;
+      return 0;
+    }
+    uint32_t v = (m_data[m_pos] >> (7 - m_bit)) & 1;
+    if (++m_bit == 8) {
+      m_bit = 0;
+      m_zeros = m_data[m_pos] == 0 ? m_zeros + 1 : 0;
+      m_pos++;
+      skip_emulation();
+    }
+    return v;
+  }
+
+  uint32_t bits(int n) {
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++)
+      v = (v << 1) | bit();
+    return v;
+  }
+
+  // ue(v): Exp-Golomb; anything past 32 bits is treated as corrupt
+  uint32_t ue() {
+    int leadingZeros = 0;
+    while (!bit()) {
+      if (m_error || ++leadingZeros > 31) {
+        m_error = true;
+        return 0;
+      }
+    }
+    return (uint32_t)((1ULL << leadingZeros) - 1 + bits(leadingZeros));
+  }
+
+  // se(v): 1, 2, 3, 4 ... map to 1, -1, 2, -2 ...
+  int32_t se() {
+    uint32_t k = ue();
+    return (k & 1) ? (int32_t)((k + 1) / 2) : -(int32_t)(k / 2);
+  }
+
+private:
+  void skip_emulation() {
+    if (m_zeros >= 2 && m_pos < m_size && m_data[m_pos] == 0x03) {
+      m_pos++;
+      m_zeros = 0;
+    }
+  }
+
+  const uint8_t *m_data;
+  uint32_t m_size;
+  uint32_t m_pos;
+  int m_bit;
+  int m_zeros; // Zero bytes just consumed
+  bool m_error;
+};
+
+} // namespace
+
+// Profiles whose SPS carries chroma_format_idc, bit depths and scaling lists
+static bool has_chroma_format(int profileIdc) {
+  static const int PROFILES[] = {100, 110, 122, 244, 44,  83, 86,
+                                 118, 128, 138, 139, 134, 135};
+  for (int p : PROFILES) {
+    if (p == profileIdc)
+      return true;
+  }
+  return false;
+}
+
+// scaling_list() (7.3.2.1.1.1): only skipped, the decoder applies it
+static void skip_scaling_list(BitReader *br, int size) {
+  int last = 8, next = 8;
+  for (int j = 0; j < size; j++) {
+    if (next != 0)
+      next = (last + br->se() + 256) % 256;
+    last = next == 0 ? last : next;
+  }
+}
+
+// hrd_parameters() (E.1.2), skipped to reach what follows it
+static void skip_hrd(BitReader *br) {
+  uint32_t cpbCount = br->ue() + 1;
+  if (cpbCount > 32)
+    cpbCount = 32; // Corrupt; the error flag will follow soon enough
+  br->bits(8); // bit_rate_scale, cpb_size_scale
+  for (uint32_t i = 0; i < cpbCount; i++) {
+    br->ue();  // bit_rate_value_minus1
+    br->ue();  // cpb_size_value_minus1
+    br->bit(); // cbr_flag
+  }
+  br->bits(20); // Four 5-bit delay/length fields
+}
+
+static void parse_vui(BitReader *br, H264Sps *sps) {
+  if (br->bit()) { // aspect_ratio_info_present_flag
+    if (br->bits(8) == 255) // Extended_SAR
+      br->bits(32);
+  }
+  if (br->bit()) // overscan_info_present_flag
+    br->bit();
+  if (br->bit()) { // video_signal_type_present_flag
+    br->bits(3);   // video_format
+    sps->full_range = br->bit() != 0;
+    if (br->bit()) { // colour_description_present_flag
+      sps->colour_primaries = (int)br->bits(8);
+      sps->transfer = (int)br->bits(8);
+      sps->matrix = (int)br->bits(8);
+    }
+  }
+  if (br->bit()) { // chroma_loc_info_present_flag
+    br->ue();
+    br->ue();
+  }
+  if (br->bit()) { // timing_info_present_flag
+    sps->num_units_in_tick = br->bits(32);
+    sps->time_scale = br->bits(32);
+    br->bit(); // fixed_frame_rate_flag
+  }
+  bool nalHrd = br->bit() != 0;
+  if (nalHrd)
+    skip_hrd(br);
+  bool vclHrd = br->bit() != 0;
+  if (vclHrd)
+    skip_hrd(br);
+  if (nalHrd || vclHrd)
+    br->bit(); // low_delay_hrd_flag
+  br->bit();   // pic_struct_present_flag
+  if (br->bit()) { // bitstream_restriction_flag
+    br->bit();     // motion_vectors_over_pic_boundaries_flag
+    br->ue();      // max_bytes_per_pic_denom
+    br->ue();      // max_bits_per_mb_denom
+    br->ue();      // log2_max_mv_length_horizontal
+    br->ue();      // log2_max_mv_length_vertical
+    sps->num_reorder_frames = (int)br->ue();
+    br->ue(); // max_dec_frame_buffering
+  }
+}
+
+bool parse_h264_sps(const uint8_t *nal, uint32_t size, H264Sps *out) {
+  if (size < 4 || (nal[0] & 0x1F) != 7)
+    return false;
+  H264Sps sps;
+  BitReader br(nal + 1, size - 1);
+  sps.profile_idc = (int)br.bits(8);
+  br.bits(8); // constraint_set flags
+  sps.level_idc = (int)br.bits(8);
+  uint32_t id = br.ue();
+  if (id >= H264ParamSets::MAX_SPS)
+    return false;
+  sps.id = (int)id;
+
+  bool separateColourPlane = false;
+  if (has_chroma_format(sps.profile_idc)) {
+    sps.chroma_format_idc = (int)br.ue();
+    if (sps.chroma_format_idc > 3)
+      return false;
+    if (sps.chroma_format_idc == 3)
+      separateColourPlane = br.bit() != 0;
+    sps.bit_depth = (int)br.ue() + 8;
+    if ((int)br.ue() + 8 != sps.bit_depth || sps.bit_depth > 14)
+      return false; // Mixed luma/chroma depths: nothing here handles them
+    br.bit(); // qpprime_y_zero_transform_bypass_flag
+    if (br.bit()) { // seq_scaling_matrix_present_flag
+      int lists = sps.chroma_format_idc != 3 ? 8 : 12;
+      for (int i = 0; i < lists; i++) {
+        if (br.bit())
+          skip_scaling_list(&br, i < 6 ? 16 : 64);
+      }
+    }
+  }
+
+  br.ue(); // log2_max_frame_num_minus4
+  uint32_t pocType = br.ue();
+  if (pocType == 0) {
+    br.ue(); // log2_max_pic_order_cnt_lsb_minus4
+  } else if (pocType == 1) {
+    br.bit(); // delta_pic_order_always_zero_flag
+    br.se();  // offset_for_non_ref_pic
+    br.se();  // offset_for_top_to_bottom_field
+    uint32_t cycle = br.ue();
+    if (cycle > 255)
+      return false;
+    for (uint32_t i = 0; i < cycle; i++)
+      br.se();
+  } else if (pocType != 2) {
+    return false;
+  }
+  sps.max_num_ref_frames = (int)br.ue();
+  br.bit(); // gaps_in_frame_num_value_allowed_flag
+  uint32_t widthMbs = br.ue() + 1;
+  uint32_t heightMapUnits = br.ue() + 1;
+  sps.frame_mbs_only = br.bit() != 0;
+  if (!sps.frame_mbs_only)
+    br.bit(); // mb_adaptive_frame_field_flag
+  br.bit();   // direct_8x8_inference_flag
+  if (widthMbs > 1024 || heightMapUnits > 1024)
+    return false; // Past level 6.2; garbage
+  sps.coded_width = (int)widthMbs * 16;
+  sps.coded_height = (sps.frame_mbs_only ? 1 : 2) * (int)heightMapUnits * 16;
+
+  if (br.bit()) { // frame_cropping_flag
+    // Offsets are in chroma samples (frame rows for interlaced)
+    int chromaArrayType = separateColourPlane ? 0 : sps.chroma_format_idc;
+    int unitX = 1, unitY = sps.frame_mbs_only ? 1 : 2;
+    if (chromaArrayType != 0) {
+      unitX *= chromaArrayType == 3 ? 1 : 2;
+      unitY *= chromaArrayType == 1 ? 2 : 1;
+    }
+    sps.crop_left = (int)br.ue() * unitX;
+    sps.crop_right = (int)br.ue() * unitX;
+    sps.crop_top = (int)br.ue() * unitY;
+    sps.crop_bottom = (int)br.ue() * unitY;
+  }
+  sps.width = sps.coded_width - sps.crop_left - sps.crop_right;
+  sps.height = sps.coded_height - sps.crop_top - sps.crop_bottom;
+  if (sps.width <= 0 || sps.height <= 0)
+    return false;
+
+  if (br.error())
+    return false;
+
+  // A VUI that runs off the end only costs its own fields
+  if (br.bit()) { // vui_parameters_present_flag
+    H264Sps withVui = sps;
+    parse_vui(&br, &withVui);
+    if (!br.error())
+      sps = withVui;
+  }
+  *out = sps;
+  return true;
+}
+
+bool parse_h264_pps(const uint8_t *nal, uint32_t size, H264Pps *out) {
+  if (size < 2 || (nal[0] & 0x1F) != 8)
+    return false;
+  BitReader br(nal + 1, size - 1);
+  uint32_t id = br.ue();
+  uint32_t spsId = br.ue();
+  bool cabac = br.bit() != 0;
+  if (br.error() || id >= H264ParamSets::MAX_PPS ||
+      spsId >= H264ParamSets::MAX_SPS)
+    return false;
+  out->id = (int)id;
+  out->sps_id = (int)spsId;
+  out->cabac = cabac;
+  return true;
+}
+
+bool read_slice_pps_id(const uint8_t *nal, uint32_t size, int *ppsId) {
+  if (size < 2)
+    return false;
+  BitReader br(nal + 1, size - 1);
+  br.ue(); // first_mb_in_slice
+  br.ue(); // slice_type
+  uint32_t id = br.ue();
+  if (br.error() || id >= H264ParamSets::MAX_PPS)
+    return false;
+  *ppsId = (int)id;
+  return true;
+}
+
+H264ParamSets::Update H264ParamSets::store(Entry *entry, const uint8_t *nal,
+                                           uint32_t size) {
+  if (entry->nal.size() == size && memcmp(entry->nal.data(), nal, size) == 0)
+    return PS_SAME;
+  Update update = entry->generation ? PS_CHANGED : PS_NEW;
+  entry->nal.assign(nal, nal + size);
+  entry->generation++;
+  return update;
+}
+
+H264ParamSets::Update H264ParamSets::add_sps(const uint8_t *nal,
+                                             uint32_t size, int *id) {
+  H264Sps sps;
+  if (!parse_h264_sps(nal, size, &sps))
+    return PS_INVALID;
+  if (id)
+    *id = sps.id;
+  Update update = store(&m_sps[sps.id], nal, size);
+  if (update != PS_SAME)
+    m_spsInfo[sps.id] = sps;
+  return update;
+}
+
+H264ParamSets::Update H264ParamSets::add_pps(const uint8_t *nal,
+                                             uint32_t size, int *id) {
+  H264Pps pps;
+  if (!parse_h264_pps(nal, size, &pps))
+    return PS_INVALID;
+  if (id)
+    *id = pps.id;
+  Update update = store(&m_pps[pps.id], nal, size);
+  if (update != PS_SAME)
+    m_ppsInfo[pps.id] = pps;
+  return update;
+}
+
+const H264Sps *H264ParamSets::sps_for_pps(int ppsId) const {
+  if (ppsId < 0 || ppsId >= MAX_PPS || !m_pps[ppsId].generation)
+    return nullptr;
+  int spsId = m_ppsInfo[ppsId].sps_id;
+  return m_sps[spsId].generation ? &m_spsInfo[spsId] : nullptr;
+}
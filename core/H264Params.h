@@ -0,0 +1,86 @@
+#pragma once
+#ifndef H264_PARAMS_H
+#define H264_PARAMS_H
+
+#include <stdint.h>
+#include <vector>
+
+// What the receiver needs from a sequence parameter set (H.264 7.3.2.1)
+struct H264Sps {
+  int id = 0;
+  int profile_idc = 0;
+  int level_idc = 0;
+  int chroma_format_idc = 1; // 0 mono, 1 4:2:0, 2 4:2:2, 3 4:4:4
+  int bit_depth = 8;         // Luma; chroma is not allowed to differ here
+  int max_num_ref_frames = 0;
+  bool frame_mbs_only = true;
+
+  int coded_width = 0, coded_height = 0; // Whole macroblocks
+  int width = 0, height = 0;             // Displayed, after cropping
+  int crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+
+  // VUI (Annex E); the defaults are what an absent VUI means
+  bool full_range = false;
+  int colour_primaries = 2, transfer = 2, matrix = 2; // 2 = unspecified
+  uint32_t num_units_in_tick = 0, time_scale = 0;
+  int num_reorder_frames = -1; // -1: not signalled
+
+  // Nominal frame rate from the VUI timing info, 0 if absent
+  double fps() const {
+    return num_units_in_tick ? time_scale / (2.0 * num_units_in_tick) : 0;
+  }
+};
+
+// ... and from a picture parameter set (7.3.2.2)
+struct H264Pps {
+  int id = 0;
+  int sps_id = 0;
+  bool cabac = false;
+};
+
+// Parse a NAL unit (1-byte header included, no start code, emulation
+// prevention bytes still in). Return false on a truncated or unsupported
+// set; *out is then unspecified.
+bool parse_h264_sps(const uint8_t *nal, uint32_t size, H264Sps *out);
+bool parse_h264_pps(const uint8_t *nal, uint32_t size, H264Pps *out);
+
+// pic_parameter_set_id from a slice header. Returns false if truncated.
+bool read_slice_pps_id(const uint8_t *nal, uint32_t size, int *ppsId);
+
+// Parameter sets seen on one stream, by ID, kept as received so they can
+// be put in front of an IDR that arrives without them. A set re-sent with
+// identical bytes (every IDR from VideoToolbox) changes nothing; new bytes
+// under a known ID bump its generation, which is how callers tell whether
+// the decoder has seen the current version.
+class H264ParamSets {
+public:
+  enum Update { PS_SAME, PS_NEW, PS_CHANGED, PS_INVALID };
+
+  // *id (optional) receives the set's ID unless PS_INVALID is returned
+  Update add_sps(const uint8_t *nal, uint32_t size, int *id = nullptr);
+  Update add_pps(const uint8_t *nal, uint32_t size, int *id = nullptr);
+
+  // The SPS a slice using PPS `ppsId` decodes with, or null if either set
+  // has not arrived
+  const H264Sps *sps_for_pps(int ppsId) const;
+
+  struct Entry {
+    std::vector<uint8_t> nal;
+    uint32_t generation = 0; // 0: never received
+  };
+  const Entry &sps_entry(int id) const { return m_sps[id]; }
+  const Entry &pps_entry(int id) const { return m_pps[id]; }
+  const H264Pps &pps(int id) const { return m_ppsInfo[id]; }
+
+  enum { MAX_SPS = 32, MAX_PPS = 256 };
+
+private:
+  static Update store(Entry *entry, const uint8_t *nal, uint32_t size);
+
+  Entry m_sps[MAX_SPS];
+  Entry m_pps[MAX_PPS];
+  H264Sps m_spsInfo[MAX_SPS];
+  H264Pps m_ppsInfo[MAX_PPS];
+};
+
+#endif // H264_PARAMS_H
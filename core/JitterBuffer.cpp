@@ -0,0 +1,284 @@
+#include "JitterBuffer.h"
+#include <algorithm>
+#include <string.h>
+
+// Bounds of the gap give-up delay (microseconds)
+static const int64_t MIN_DELAY_US = 5000;
+static const int64_t MAX_DELAY_US = 200000;
+
+// Gap delay in units of interarrival jitter
+static const double JITTER_MULTIPLIER = 3.0;
+
+// Headroom over the slowest recent reordered packet
+static const double REORDER_HEADROOM = 1.25;
+
+// Retransmission: first guess at the round trip until one is measured,
+// and how often one packet is asked for at most
+static const double INITIAL_RTT_US = 20000;
+static const int MAX_NACKS_PER_PACKET = 3;
+static const int64_t MIN_NACK_RETRY_US = 5000;
+
+// Extended sequence numbers start here so a reordered packet just before
+// the first one received does not wrap below zero
+static const uint64_t SEQ_BASE = 1 << 16;
+
+JitterBuffer::JitterBuffer(size_t capacity)
+    : m_nackEnabled(false), m_nackHoldUs(0) {
+  size_t n = 1;
+  while (n < capacity)
+    n <<= 1;
+  m_slots.resize(n);
+  m_mask = n - 1;
+  reset();
+}
+
+void JitterBuffer::reset() {
+  for (Slot &s : m_slots) {
+    s.used = s.delivered = false;
+    s.nacks = 0;
+  }
+  m_started = false;
+  m_next = m_highest = 0;
+  m_pendingLost = 0;
+  m_haveTransit = false;
+  m_lastTransitUs = 0;
+  m_jitterUs = 0;
+  m_reorderPeakUs = 0;
+  m_delayUs = MIN_DELAY_US;
+  m_rttUs = INITIAL_RTT_US;
+  m_lostTotal = m_late = m_reordered = m_nacked = m_recovered = 0;
+  m_rebuilt = 0;
+}
+
+void JitterBuffer::set_nack_enabled(bool enabled) {
+  m_nackEnabled = enabled;
+  update_delay();
+}
+
+void JitterBuffer::set_nack_hold_us(int64_t holdUs) {
+  m_nackHoldUs = holdUs;
+  update_delay();
+}
+
+// Nearest extended number to the next expected one
+uint64_t JitterBuffer::extend(uint16_t seq) const {
+  int16_t delta = (int16_t)(uint16_t)(seq - (uint16_t)m_next);
+  return (uint64_t)((int64_t)m_next + delta);
+}
+
+const JitterBuffer::Slot *JitterBuffer::first_after_gap() const {
+  for (uint64_t seq = m_next + 1; seq <= m_highest; seq++) {
+    const Slot &s = m_slots[seq & m_mask];
+    if (s.used && s.ext_seq == seq)
+      return &s;
+  }
+  return nullptr;
+}
+
+// RFC 3550 A.8, on packets that advance the sequence
+void JitterBuffer::update_jitter(const RtpHeader &header, int64_t arrivalUs) {
+  int64_t transitUs =
+      arrivalUs - (int64_t)header.timestamp * 1000000 / RTP_CLOCK_RATE;
+  if (m_haveTransit) {
+    int64_t d = transitUs - m_lastTransitUs;
+    // The RTP timestamp wrapped: skip this sample
+    if (d > -1000000000LL && d < 1000000000LL)
+      m_jitterUs += ((double)(d < 0 ? -d : d) - m_jitterUs) / 16.0;
+  }
+  m_lastTransitUs = transitUs;
+  m_haveTransit = true;
+}
+
+void JitterBuffer::update_delay() {
+  m_reorderPeakUs -= m_reorderPeakUs / 1024.0; // ~2 s at 500 packets/s
+  double target = std::max(m_jitterUs * JITTER_MULTIPLIER,
+                           m_reorderPeakUs * REORDER_HEADROOM);
+  // Room for the hold, a request, its retransmission and one retry
+  if (m_nackEnabled)
+    target = std::max(target, m_nackHoldUs + 2 * m_rttUs +
+                                  m_jitterUs * JITTER_MULTIPLIER);
+  m_delayUs = std::min(MAX_DELAY_US, std::max(MIN_DELAY_US, (int64_t)target));
+}
+
+bool JitterBuffer::insert(const uint8_t *packet, size_t size,
+                          const RtpHeader &header, int64_t arrivalUs,
+                          bool rebuilt) {
+  if (!m_started) {
+    m_started = true;
+    m_next = m_highest = SEQ_BASE + header.seq;
+  }
+
+  uint64_t ext = extend(header.seq);
+  Slot &slot = m_slots[ext & m_mask];
+  bool known = slot.ext_seq == ext;
+  if (known && slot.delivered)
+    return false; // Duplicate, e.g. a retransmission that was not needed
+
+  // Answer to one of our requests: time the round trip. Retransmissions
+  // stay out of the reorder statistics; the delay covers them already.
+  bool retransmitted = header.payload_type == RTP_PAYLOAD_TYPE_RTX;
+  if (retransmitted && known && !slot.used && slot.nacks > 0) {
+    m_rttUs += ((double)(arrivalUs - slot.nacked_us) - m_rttUs) / 8.0;
+    slot.nacks = 0;
+  }
+
+  if (ext < m_next) {
+    m_late++;
+    if (!retransmitted && !rebuilt) {
+      // Its gap was already given up: wait longer next time
+      m_reorderPeakUs = std::max(m_reorderPeakUs,
+                                 (double)m_delayUs * 2 / REORDER_HEADROOM);
+    }
+    update_delay();
+    return false;
+  }
+  if (ext - m_next > m_mask) {
+    // Too far ahead to buffer (sender restart or a long outage): give up on
+    // everything before it
+    m_pendingLost += (uint32_t)std::min<uint64_t>(ext - m_next, UINT32_MAX);
+    for (Slot &s : m_slots)
+      s.used = false;
+    m_next = ext;
+    m_highest = ext;
+  }
+
+  if (slot.used && slot.ext_seq == ext)
+    return false; // Duplicate
+
+  slot.data.assign(packet, packet + size);
+  slot.header = header;
+  slot.arrival_us = arrivalUs;
+  slot.ext_seq = ext;
+  slot.used = true;
+  slot.delivered = false;
+  slot.nacks = 0;
+
+  if (ext > m_highest || (ext == m_highest && ext == m_next)) {
+    if (!rebuilt)
+      update_jitter(header, arrivalUs);
+    // Everything skipped over is missing as of now
+    for (uint64_t seq = m_highest + 1; seq < ext; seq++) {
+      Slot &gap = m_slots[seq & m_mask];
+      gap.used = false;
+      gap.delivered = false;
+      gap.ext_seq = seq;
+      gap.missing_us = arrivalUs;
+      gap.nacked_us = 0;
+      gap.nacks = 0;
+    }
+    m_highest = ext;
+    if (rebuilt)
+      m_rebuilt++;
+  } else if (rebuilt) {
+    m_rebuilt++;
+  } else if (retransmitted) {
+    m_recovered++;
+  } else {
+    // Filled a gap: it arrived this long after the packet behind it
+    m_reordered++;
+    for (uint64_t seq = ext + 1; seq <= m_highest; seq++) {
+      const Slot &s = m_slots[seq & m_mask];
+      if (s.used && s.ext_seq == seq) {
+        m_reorderPeakUs =
+            std::max(m_reorderPeakUs, (double)(arrivalUs - s.arrival_us));
+        break;
+      }
+    }
+  }
+  update_delay();
+  return true;
+}
+
+JitterBuffer::PopResult JitterBuffer::pop(int64_t nowUs,
+                                          const uint8_t **packet,
+                                          RtpHeader *header, uint32_t *lost) {
+  if (m_pendingLost) {
+    *lost = m_pendingLost;
+    m_lostTotal += m_pendingLost;
+    m_pendingLost = 0;
+    return POP_LOST;
+  }
+  if (!m_started || m_next > m_highest)
+    return POP_EMPTY;
+
+  Slot &slot = m_slots[m_next & m_mask];
+  if (slot.used && slot.ext_seq == m_next) {
+    slot.used = false;
+    slot.delivered = true;
+    *packet = slot.data.data();
+    *header = slot.header;
+    m_next++;
+    return POP_PACKET;
+  }
+
+  // Head missing: wait for it until the packet behind it is `delay` old
+  const Slot *after = first_after_gap();
+  if (!after || nowUs - after->arrival_us < m_delayUs)
+    return POP_EMPTY;
+  *lost = (uint32_t)(after->ext_seq - m_next);
+  m_lostTotal += *lost;
+  m_next = after->ext_seq;
+  return POP_LOST;
+}
+
+int64_t JitterBuffer::wait_us(int64_t nowUs) const {
+  if (m_pendingLost)
+    return 0;
+  if (!m_started || m_next > m_highest)
+    return -1;
+  const Slot &slot = m_slots[m_next & m_mask];
+  if (slot.used && slot.ext_seq == m_next)
+    return 0;
+  const Slot *after = first_after_gap();
+  if (!after)
+    return -1;
+  return std::max<int64_t>(0, after->arrival_us + m_delayUs - nowUs);
+}
+
+int64_t JitterBuffer::nack_retry_us() const {
+  return std::max(MIN_NACK_RETRY_US, (int64_t)(m_rttUs * 1.5));
+}
+
+// A missing packet is asked for at once, then again every retry interval,
+// for as long as a retransmission sent now could still arrive before its
+// gap expires
+void JitterBuffer::collect_nacks(int64_t nowUs, std::vector<uint16_t> *seqs) {
+  if (!m_nackEnabled || !m_started)
+    return;
+  int64_t retryUs = nack_retry_us();
+  for (uint64_t seq = m_next; seq <= m_highest; seq++) {
+    Slot &s = m_slots[seq & m_mask];
+    if (s.used || s.ext_seq != seq)
+      continue;
+    if (s.nacks >= MAX_NACKS_PER_PACKET ||
+        nowUs + (int64_t)m_rttUs > s.missing_us + m_delayUs)
+      continue;
+    if (s.nacks == 0 ? nowUs < s.missing_us + m_nackHoldUs
+                     : nowUs - s.nacked_us < retryUs)
+      continue;
+    seqs->push_back((uint16_t)(seq - SEQ_BASE));
+    s.nacked_us = nowUs;
+    s.nacks++;
+    m_nacked++;
+  }
+}
+
+int64_t JitterBuffer::nack_wait_us(int64_t nowUs) const {
+  if (!m_nackEnabled || !m_started)
+    return -1;
+  int64_t retryUs = nack_retry_us();
+  int64_t best = -1;
+  for (uint64_t seq = m_next; seq <= m_highest; seq++) {
+    const Slot &s = m_slots[seq & m_mask];
+    if (s.used || s.ext_seq != seq || s.nacks >= MAX_NACKS_PER_PACKET)
+      continue;
+    int64_t due =
+        s.nacks == 0 ? s.missing_us + m_nackHoldUs : s.nacked_us + retryUs;
+    if (std::max(due, nowUs) + (int64_t)m_rttUs > s.missing_us + m_delayUs)
+      continue; // Could not make it any more
+    int64_t waitUs = std::max<int64_t>(0, due - nowUs);
+    if (best < 0 || waitUs < best)
+      best = waitUs;
+  }
+  return best;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include "Rtp.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Puts one RTP stream back into sequence order.
+//
+// Packets that arrive in order are released at once: a picture is never
+// held back to smooth playout, because the decoder renders as soon as it
+// has one. Only a gap in the sequence makes the buffer wait, and for no
+// longer than the adaptive delay: a multiple of the RFC 3550 interarrival
+// jitter, raised whenever a reordered packet took longer than that to
+// arrive and decaying back afterwards. Past the delay the gap is given up
+// as lost.
+//
+// With NACK enabled the missing packets are also asked for again
+// (collect_nacks), and the delay grows to cover a retransmission round
+// trip. A packet is only requested while a retransmission can still beat
+// its gap's deadline. Retransmissions come back with RTP_PAYLOAD_TYPE_RTX,
+// which tells them apart from reordered originals when timing the round
+// trip.
+//
+// Packets rebuilt by FEC (RtpFec.h) are inserted like late originals but
+// kept out of the jitter and reorder statistics: they arrive whenever the
+// repair packets do. While FEC is in use, set_nack_hold_us() gives the
+// repair packets a head start before a gap is asked for.
+//
+// Slots are allocated once and reused; the steady state never allocates.
+class JitterBuffer {
+public:
+  enum PopResult {
+    POP_PACKET, // *packet / *header filled in
+    POP_LOST,   // A gap was given up; *lost packets are missing
+    POP_EMPTY   // Nothing releasable now; see wait_us()
+  };
+
+  // `capacity` is the most packets held at once (rounded up to 2^n)
+  explicit JitterBuffer(size_t capacity = 1024);
+
+  void reset();
+
+  // Off by default; see collect_nacks()
+  void set_nack_enabled(bool enabled);
+
+  // How long a gap waits before its first request (0 by default)
+  void set_nack_hold_us(int64_t holdUs);
+
+  // Copies the packet in. Returns false if it is a duplicate or arrived
+  // after its gap was already given up. `rebuilt` marks a packet recovered
+  // by FEC rather than received.
+  bool insert(const uint8_t *packet, size_t size, const RtpHeader &header,
+              int64_t arrivalUs, bool rebuilt = false);
+
+  // Next packet in sequence order. The packet stays valid until the next
+  // insert().
+  PopResult pop(int64_t nowUs, const uint8_t **packet, RtpHeader *header,
+                uint32_t *lost);
+
+  // Time until the gap at the head expires, or -1 if there is none
+  int64_t wait_us(int64_t nowUs) const;
+
+  // Appends the missing sequence numbers (ascending) that are due for a
+  // first or repeated retransmission request, and marks them requested
+  void collect_nacks(int64_t nowUs, std::vector<uint16_t> *seqs);
+
+  // Time until collect_nacks() has something to send, or -1
+  int64_t nack_wait_us(int64_t nowUs) const;
+
+  // --- Metrics (producer thread) ---
+  double jitter_ms() const { return m_jitterUs / 1000.0; }
+  double delay_ms() const { return m_delayUs / 1000.0; }
+  uint64_t lost() const { return m_lostTotal; }
+  uint64_t late() const { return m_late; }
+  uint64_t reordered() const { return m_reordered; }
+  uint64_t nacked() const { return m_nacked; }       // Requests sent
+  uint64_t recovered() const { return m_recovered; } // Retransmitted in time
+  double rtt_ms() const { return m_rttUs / 1000.0; } // Request to arrival
+  uint64_t rebuilt() const { return m_rebuilt; }     // By FEC, in time
+
+private:
+  struct Slot {
+    std::vector<uint8_t> data;
+    RtpHeader header;
+    int64_t arrival_us = 0;
+    uint64_t ext_seq = 0;
+    bool used = false;      // Holds a packet not yet popped
+    bool delivered = false; // Popped; a copy arriving now is a duplicate
+
+    // While missing (!used, ext_seq set when the gap opened)
+    int64_t missing_us = 0; // When the gap was noticed
+    int64_t nacked_us = 0;  // Last request
+    uint8_t nacks = 0;      // Requests so far
+  };
+
+  uint64_t extend(uint16_t seq) const;
+  const Slot *first_after_gap() const;
+  void update_jitter(const RtpHeader &header, int64_t arrivalUs);
+  void update_delay();
+  int64_t nack_retry_us() const;
+
+  std::vector<Slot> m_slots;
+  size_t m_mask;
+
+  bool m_started;
+  uint64_t m_next;    // Extended sequence number to release next
+  uint64_t m_highest; // Highest extended sequence number seen
+  uint32_t m_pendingLost;
+
+  // RFC 3550 interarrival jitter (microseconds)
+  bool m_haveTransit;
+  int64_t m_lastTransitUs;
+  double m_jitterUs;
+
+  double m_reorderPeakUs; // Decaying maximum wait a reordered packet needed
+  int64_t m_delayUs;      // Current give-up delay for a gap
+
+  bool m_nackEnabled;
+  double m_rttUs; // Smoothed request-to-retransmission time
+  int64_t m_nackHoldUs;
+
+  uint64_t m_lostTotal;
+  uint64_t m_late;
+  uint64_t m_reordered;
+  uint64_t m_nacked;
+  uint64_t m_recovered;
+  uint64_t m_rebuilt;
+};
+
+#endif // JITTER_BUFFER_H
@@ -0,0 +1,58 @@
+#include "Log.h"
+#include "Platform.h"
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+static std::ofstream debugFile;
+static std::mutex logMutex;
+
+std::string log_timestamped_path(const std::string &dir,
+                                 const std::string &prefix,
+                                 const std::string &ext) {
+  // Generate unique filename
+  auto t = std::time(nullptr);
+  auto tm = *std::localtime(&t);
+  std::ostringstream oss;
+  oss << prefix << std::put_time(&tm, "%Y%m%d_%H%M%S") << ext;
+  return path_join(dir, oss.str());
+}
+
+void log_init(const std::string &logDir) {
+  make_directory(logDir);
+
+  std::string path = log_timestamped_path(logDir, "log_");
+  std::lock_guard<std::mutex> lock(logMutex);
+  debugFile.open(path, std::ios::out | std::ios::trunc);
+  if (debugFile.is_open()) {
+    debugFile << "Frame,Time,R,G,B\n";
+    std::cout << "Debug Log: " << path << "\n";
+  }
+}
+
+void log_close() {
+  std::lock_guard<std::mutex> lock(logMutex);
+  if (debugFile.is_open())
+    debugFile.close();
+}
+
+void log_msg(const std::string &msg) {
+  std::lock_guard<std::mutex> lock(logMutex);
+  std::cout << msg;
+  if (debugFile.is_open()) {
+    debugFile << "# " << msg;
+    debugFile.flush();
+  }
+}
+
+void log_err(const std::string &msg) {
+  std::lock_guard<std::mutex> lock(logMutex);
+  std::cerr << msg;
+  if (debugFile.is_open()) {
+    debugFile << "ERROR: " << msg;
+    debugFile.flush();
+  }
+}
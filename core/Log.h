@@ -0,0 +1,23 @@
+#pragma once
+#ifndef LOG_H
+#define LOG_H
+
+#include <string>
+
+// Console + debug file logging shared by every receiver front end.
+// Messages carry their own trailing newline, as before.
+
+// Opens <logDir>/log_<timestamp>.txt (creating logDir). Without a call to
+// this, messages only go to the console.
+void log_init(const std::string &logDir);
+void log_close();
+
+void log_msg(const std::string &msg);
+void log_err(const std::string &msg);
+
+// "<dir>/<prefix><YYYYmmdd_HHMMSS><ext>"
+std::string log_timestamped_path(const std::string &dir,
+                                 const std::string &prefix,
+                                 const std::string &ext = ".txt");
+
+#endif // LOG_H
@@ -0,0 +1,91 @@
+#include "LogReceiver.h"
+#include "Log.h"
+
+LogReceiver::LogReceiver()
+    : m_reactor(nullptr), m_listenSocket(INVALID_SOCKET_VALUE) {}
+
+LogReceiver::~LogReceiver() { stop(); }
+
+bool LogReceiver::start(Reactor *reactor, uint16_t port,
+                        const std::string &dir) {
+  m_listenSocket = tcp_listen(port, 1);
+  if (m_listenSocket == INVALID_SOCKET_VALUE) {
+    log_msg("[LogReceiver] Bind failed on " + std::to_string(port) + ".\n");
+    return false;
+  }
+  socket_set_nonblocking(m_listenSocket);
+
+  // Create logs directory if it doesn't exist
+  m_dir = dir;
+  make_directory(m_dir);
+
+  m_reactor = reactor;
+  m_reactor->add(m_listenSocket, REACTOR_READ,
+                 [this](uint32_t) { on_accept(); });
+  log_msg("[LogReceiver] Listening for logs on port " + std::to_string(port) +
+          "...\n");
+  return true;
+}
+
+void LogReceiver::stop() {
+  if (!m_reactor)
+    return;
+  // Whatever arrived of an unfinished upload is kept
+  while (!m_uploads.empty())
+    finish(m_uploads.begin()->first);
+  m_reactor->remove(m_listenSocket);
+  m_reactor = nullptr;
+  socket_close(m_listenSocket);
+  m_listenSocket = INVALID_SOCKET_VALUE;
+}
+
+void LogReceiver::on_accept() {
+  for (;;) {
+    sockaddr_in clientAddr;
+    socklen_t clientAddrLen = sizeof(clientAddr);
+    socket_t ClientSocket =
+        accept(m_listenSocket, (sockaddr *)&clientAddr, &clientAddrLen);
+    if (ClientSocket == INVALID_SOCKET_VALUE)
+      return;
+
+    log_msg("[LogReceiver] Receiving Log File...\n");
+    socket_set_nonblocking(ClientSocket);
+
+    // Generate filename with timestamp
+    std::unique_ptr<Upload> upload(new Upload);
+    upload->path = log_timestamped_path(m_dir, "iphone_log_");
+    upload->out.open(upload->path, std::ios::binary);
+    m_uploads[ClientSocket] = std::move(upload);
+    m_reactor->add(ClientSocket, REACTOR_READ, [this, ClientSocket](uint32_t) {
+      on_readable(ClientSocket);
+    });
+  }
+}
+
+// Read and Write until the phone closes the connection
+void LogReceiver::on_readable(socket_t s) {
+  Upload &upload = *m_uploads[s];
+  char buffer[4096];
+  for (;;) {
+    int bytesReceived = (int)recv(s, buffer, sizeof(buffer), 0);
+    if (bytesReceived < 0 && socket_would_block())
+      return;
+    if (bytesReceived <= 0)
+      break;
+    upload.out.write(buffer, bytesReceived);
+    upload.bytes += bytesReceived;
+  }
+  finish(s);
+}
+
+void LogReceiver::finish(socket_t s) {
+  auto it = m_uploads.find(s);
+  Upload &upload = *it->second;
+  upload.out.close();
+  log_msg("[LogReceiver] Saved " + std::to_string(upload.bytes) +
+          " bytes to " + upload.path + "\n");
+
+  m_reactor->remove(s);
+  socket_close(s);
+  m_uploads.erase(it);
+}
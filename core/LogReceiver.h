@@ -0,0 +1,41 @@
+#pragma once
+#ifndef LOG_RECEIVER_H
+#define LOG_RECEIVER_H
+
+#include "Platform.h"
+#include "Reactor.h"
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+// Accepts text logs uploaded by the iOS app (one file per connection) and
+// saves them as <dir>/iphone_log_<timestamp>.txt. Uploads are read on the
+// Reactor thread.
+class LogReceiver {
+public:
+  LogReceiver();
+  ~LogReceiver();
+
+  bool start(Reactor *reactor, uint16_t port, const std::string &dir);
+  // The reactor must no longer be running
+  void stop();
+
+private:
+  struct Upload {
+    std::ofstream out;
+    std::string path;
+    uint64_t bytes = 0;
+  };
+
+  void on_accept();
+  void on_readable(socket_t s);
+  void finish(socket_t s);
+
+  std::string m_dir;
+  Reactor *m_reactor;
+  socket_t m_listenSocket;
+  std::map<socket_t, std::unique_ptr<Upload>> m_uploads;
+};
+
+#endif // LOG_RECEIVER_H
@@ -0,0 +1,46 @@
+#include "PacketPool.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+PacketPool::PacketPool(size_t bufferSize)
+    : m_pool(nullptr), m_bufferSize(bufferSize), m_allocations(0),
+      m_bytesCopied(0) {
+  m_pool = av_buffer_pool_init2(m_bufferSize + AV_INPUT_BUFFER_PADDING_SIZE,
+                                this, alloc_buffer, NULL);
+}
+
+PacketPool::~PacketPool() {
+  // Buffers still held by the decoder stay valid; the pool itself is freed
+  // when the last one comes back.
+  av_buffer_pool_uninit(&m_pool);
+}
+
+AVBufferRef *PacketPool::alloc_buffer(void *opaque, size_t size) {
+  PacketPool *self = (PacketPool *)opaque;
+  self->m_allocations++;
+  return av_buffer_alloc(size);
+}
+
+size_t PacketPool::usable_size(const AVBufferRef *buf) {
+  return buf->size - AV_INPUT_BUFFER_PADDING_SIZE;
+}
+
+AVBufferRef *PacketPool::get(size_t minSize) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (minSize > m_bufferSize) {
+    // Rare (large IDR): move to bigger buffers. The old pool drains as its
+    // outstanding buffers are released.
+    while (m_bufferSize < minSize)
+      m_bufferSize *= 2;
+    av_buffer_pool_uninit(&m_pool);
+    m_pool = av_buffer_pool_init2(m_bufferSize + AV_INPUT_BUFFER_PADDING_SIZE,
+                                  this, alloc_buffer, NULL);
+  }
+
+  if (!m_pool)
+    return nullptr;
+  return av_buffer_pool_get(m_pool);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+#include <libavutil/buffer.h>
+}
+
+// Refcounted bitstream buffers for the decoder.
+//
+// The network stage writes access units (start codes included) straight
+// into buffers from this pool and the decoder takes them by reference via
+// AVPacket::buf, so a picture is copied exactly once: socket ring -> pool.
+// Buffers return to the pool when FFmpeg drops its last reference.
+class PacketPool {
+public:
+  explicit PacketPool(size_t bufferSize = 256 * 1024);
+  ~PacketPool();
+
+  // Buffer of at least `minSize` usable bytes plus
+  // AV_INPUT_BUFFER_PADDING_SIZE. The pool switches to larger buffers if a
+  // request does not fit. Thread-safe.
+  AVBufferRef *get(size_t minSize);
+
+  // Usable bytes in buffers returned by get() (excludes padding)
+  static size_t usable_size(const AVBufferRef *buf);
+
+  // Instrumentation for the metrics line
+  void count_copy(size_t bytes) { m_bytesCopied += bytes; }
+  uint64_t allocations() const { return m_allocations.load(); }
+  uint64_t bytes_copied() const { return m_bytesCopied.load(); }
+
+private:
+  static AVBufferRef *alloc_buffer(void *opaque, size_t size);
+
+  std::mutex m_mutex; // Guards pool replacement
+  AVBufferPool *m_pool;
+  size_t m_bufferSize;
+
+  std::atomic<uint64_t> m_allocations;
+  std::atomic<uint64_t> m_bytesCopied;
+};
+
+#endif // PACKET_POOL_H
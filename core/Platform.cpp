@@ -0,0 +1,175 @@
+#include "Platform.h"
+#include <string.h>
+
+#ifdef _WIN32
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+bool net_init() {
+#ifdef _WIN32
+  WSADATA wsaData;
+  return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+  return true;
+#endif
+}
+
+void net_cleanup() {
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+void socket_close(socket_t s) {
+  if (s == INVALID_SOCKET_VALUE)
+    return;
+#ifdef _WIN32
+  closesocket(s);
+#else
+  close(s);
+#endif
+}
+
+void socket_shutdown(socket_t s) {
+  if (s == INVALID_SOCKET_VALUE)
+    return;
+#ifdef _WIN32
+  shutdown(s, SD_BOTH);
+#else
+  shutdown(s, SHUT_RDWR);
+#endif
+}
+
+void socket_set_recv_timeout(socket_t s, int timeoutMs) {
+#ifdef _WIN32
+  DWORD timeout = (DWORD)timeoutMs;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
+             sizeof(timeout));
+#else
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+bool socket_set_nonblocking(socket_t s) {
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  return ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+  int flags = fcntl(s, F_GETFL, 0);
+  return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool socket_would_block() {
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+uint32_t socket_pending_bytes(socket_t s) {
+  if (s == INVALID_SOCKET_VALUE)
+    return 0;
+#ifdef _WIN32
+  u_long pending = 0;
+  ioctlsocket(s, FIONREAD, &pending);
+#else
+  int pending = 0;
+  ioctl(s, FIONREAD, &pending);
+#endif
+  return (uint32_t)pending;
+}
+
+socket_t tcp_listen(uint16_t port, int backlog) {
+  socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (s == INVALID_SOCKET_VALUE)
+    return INVALID_SOCKET_VALUE;
+
+#ifndef _WIN32
+  // Allow a quick restart while old connections sit in TIME_WAIT
+  int reuse = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+  sockaddr_in service;
+  memset(&service, 0, sizeof(service));
+  service.sin_family = AF_INET;
+  service.sin_addr.s_addr = INADDR_ANY;
+  service.sin_port = htons(port);
+
+  if (bind(s, (sockaddr *)&service, sizeof(service)) != 0 ||
+      listen(s, backlog) != 0) {
+    socket_close(s);
+    return INVALID_SOCKET_VALUE;
+  }
+  return s;
+}
+
+socket_t udp_bind(uint16_t port) {
+  socket_t s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (s == INVALID_SOCKET_VALUE)
+    return INVALID_SOCKET_VALUE;
+
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = INADDR_ANY;
+  local.sin_port = htons(port);
+  if (bind(s, (sockaddr *)&local, sizeof(local)) != 0) {
+    socket_close(s);
+    return INVALID_SOCKET_VALUE;
+  }
+  return s;
+}
+
+bool make_directory(const std::string &path) {
+#ifdef _WIN32
+  return CreateDirectoryA(path.c_str(), NULL) ||
+         GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+std::string path_join(const std::string &dir, const std::string &name) {
+  if (dir.empty())
+    return name;
+#ifdef _WIN32
+  const char sep = '\\';
+#else
+  const char sep = '/';
+#endif
+  char last = dir[dir.size() - 1];
+  if (last == '/' || last == '\\')
+    return dir + name;
+  return dir + sep + name;
+}
+
+bool pin_current_thread(int cpu) {
+#if defined(_WIN32)
+  if (cpu < 0 || cpu >= 64)
+    return false;
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
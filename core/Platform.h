@@ -0,0 +1,75 @@
+#pragma once
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Thin socket/filesystem layer so the receiver core builds on Winsock and
+// on POSIX. Only what the core actually uses is wrapped; everything else
+// is plain BSD sockets, which both sides share.
+
+#include <stdint.h>
+#include <string>
+
+#ifdef _WIN32
+// CRITICAL: winsock2.h must be included BEFORE windows.h
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+typedef SOCKET socket_t;
+typedef int socklen_t;
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+typedef int socket_t;
+#define INVALID_SOCKET_VALUE (-1)
+#endif
+
+// WSAStartup/WSACleanup on Windows; no-ops elsewhere
+bool net_init();
+void net_cleanup();
+
+void socket_close(socket_t s);
+
+// Unblocks a thread sitting in accept()/recv() on `s` (used on shutdown)
+void socket_shutdown(socket_t s);
+
+void socket_set_recv_timeout(socket_t s, int timeoutMs);
+
+// For sockets driven by the Reactor
+bool socket_set_nonblocking(socket_t s);
+
+// The last socket call failed only because it would have blocked
+bool socket_would_block();
+
+// Bytes queued in the kernel receive buffer (0 if unknown)
+uint32_t socket_pending_bytes(socket_t s);
+
+// Listening TCP socket bound to INADDR_ANY:port. INVALID_SOCKET_VALUE on
+// failure.
+socket_t tcp_listen(uint16_t port, int backlog);
+
+// UDP socket bound to INADDR_ANY:port. INVALID_SOCKET_VALUE on failure.
+socket_t udp_bind(uint16_t port);
+
+// Creates `path` if missing (one level). Returns false on failure.
+bool make_directory(const std::string &path);
+
+// Joins a directory and a file name with the native separator
+std::string path_join(const std::string &dir, const std::string &name);
+
+// Pins the calling thread to one logical CPU. Best effort: false where the
+// OS has no such call (macOS) or refuses.
+bool pin_current_thread(int cpu);
+
+#endif // PLATFORM_H
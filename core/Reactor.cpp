@@ -0,0 +1,325 @@
+#include "Reactor.h"
+#include "Log.h"
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#ifdef _WIN32
+#define reactor_poll WSAPoll
+#else
+#define reactor_poll poll
+#endif
+
+// Wake-ups per wait; more ready sockets are picked up on the next pass
+static const int MAX_EVENTS = 64;
+
+#ifdef __linux__
+// The event carries the registration's generation next to the fd
+static int epoll_update(int epoll, int op, socket_t s, uint32_t interest,
+                        uint32_t generation) {
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  if (interest & REACTOR_READ)
+    ev.events |= EPOLLIN;
+  if (interest & REACTOR_WRITE)
+    ev.events |= EPOLLOUT;
+  ev.data.u64 = ((uint64_t)generation << 32) | (uint32_t)s;
+  return epoll_ctl(epoll, op, s, &ev);
+}
+#endif
+
+Reactor::Reactor()
+    : m_nextGeneration(1), m_nextTimerId(1), m_stopRequested(false) {
+#ifdef __linux__
+  m_epoll = -1;
+  m_wakeFd = -1;
+#else
+  m_wakeSocket = INVALID_SOCKET_VALUE;
+  memset(&m_wakeAddr, 0, sizeof(m_wakeAddr));
+  m_pollDirty = true;
+#endif
+}
+
+Reactor::~Reactor() { close(); }
+
+bool Reactor::open() {
+  m_stopRequested = false;
+#ifdef __linux__
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_epoll < 0 || m_wakeFd < 0) {
+    log_err("Reactor: epoll setup failed (" + std::to_string(errno) + ")\n");
+    close();
+    return false;
+  }
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u64 = (uint32_t)m_wakeFd; // Generation 0
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &ev);
+#else
+  m_wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  m_wakeAddr.sin_family = AF_INET;
+  m_wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  m_wakeAddr.sin_port = 0; // Any free port
+  socklen_t len = sizeof(m_wakeAddr);
+  if (m_wakeSocket == INVALID_SOCKET_VALUE ||
+      bind(m_wakeSocket, (sockaddr *)&m_wakeAddr, sizeof(m_wakeAddr)) != 0 ||
+      getsockname(m_wakeSocket, (sockaddr *)&m_wakeAddr, &len) != 0) {
+    log_err("Reactor: wake-up socket setup failed\n");
+    close();
+    return false;
+  }
+  socket_set_nonblocking(m_wakeSocket);
+  m_pollDirty = true;
+#endif
+  return true;
+}
+
+void Reactor::close() {
+#ifdef __linux__
+  if (m_epoll >= 0)
+    ::close(m_epoll);
+  if (m_wakeFd >= 0)
+    ::close(m_wakeFd);
+  m_epoll = -1;
+  m_wakeFd = -1;
+#else
+  socket_close(m_wakeSocket);
+  m_wakeSocket = INVALID_SOCKET_VALUE;
+  m_pollDirty = true;
+#endif
+  m_sockets.clear();
+  m_timers.clear();
+  std::lock_guard<std::mutex> lock(m_postMutex);
+  m_posted.clear();
+}
+
+bool Reactor::add(socket_t s, uint32_t interest, IoHandler handler) {
+  Registration reg;
+  reg.interest = interest;
+  reg.generation = m_nextGeneration++;
+  if (reg.generation == 0)
+    reg.generation = m_nextGeneration++; // 0 is the wake-up fd's
+  reg.handler = std::make_shared<IoHandler>(handler);
+#ifdef __linux__
+  if (epoll_update(m_epoll, EPOLL_CTL_ADD, s, interest, reg.generation) != 0)
+    return false;
+#else
+  m_pollDirty = true;
+#endif
+  m_sockets[s] = reg;
+  return true;
+}
+
+void Reactor::modify(socket_t s, uint32_t interest) {
+  auto it = m_sockets.find(s);
+  if (it == m_sockets.end() || it->second.interest == interest)
+    return;
+  it->second.interest = interest;
+#ifdef __linux__
+  epoll_update(m_epoll, EPOLL_CTL_MOD, s, interest, it->second.generation);
+#else
+  m_pollDirty = true;
+#endif
+}
+
+void Reactor::remove(socket_t s) {
+  if (m_sockets.erase(s) == 0)
+    return;
+#ifdef __linux__
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, s, NULL);
+#else
+  m_pollDirty = true;
+#endif
+}
+
+TimerId Reactor::add_timer(uint32_t delayMs, uint32_t periodMs,
+                           std::function<void()> fn) {
+  Timer timer;
+  timer.due = Clock::now() + std::chrono::milliseconds(delayMs);
+  timer.period = std::chrono::milliseconds(periodMs);
+  timer.fn = std::make_shared<std::function<void()>>(fn);
+  TimerId id = m_nextTimerId++;
+  m_timers[id] = timer;
+  return id;
+}
+
+void Reactor::cancel_timer(TimerId id) { m_timers.erase(id); }
+
+void Reactor::post(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(m_postMutex);
+    m_posted.push_back(fn);
+  }
+  wake();
+}
+
+void Reactor::stop() {
+  m_stopRequested = true;
+  wake();
+}
+
+void Reactor::wake() {
+#ifdef __linux__
+  uint64_t one = 1;
+  if (write(m_wakeFd, &one, sizeof(one)) < 0) {
+    // Counter saturated: a wake-up is pending anyway
+  }
+#else
+  char byte = 0;
+  sendto(m_wakeSocket, &byte, 1, 0, (sockaddr *)&m_wakeAddr,
+         sizeof(m_wakeAddr));
+#endif
+}
+
+// -1 (block indefinitely) when no timer is armed
+int Reactor::next_timeout_ms() const {
+  if (m_timers.empty())
+    return -1;
+  Clock::time_point next = Clock::time_point::max();
+  for (const auto &t : m_timers) {
+    if (t.second.due < next)
+      next = t.second.due;
+  }
+  auto now = Clock::now();
+  if (next <= now)
+    return 0;
+  // Round up: waking a fraction early would only spin once more
+  auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(next - now).count();
+  return (int)((us + 999) / 1000);
+}
+
+void Reactor::run_timers() {
+  auto now = Clock::now();
+  std::vector<TimerId> due;
+  for (const auto &t : m_timers) {
+    if (t.second.due <= now)
+      due.push_back(t.first);
+  }
+  for (TimerId id : due) {
+    auto it = m_timers.find(id);
+    if (it == m_timers.end())
+      continue; // Cancelled by an earlier callback
+    std::shared_ptr<std::function<void()>> fn = it->second.fn;
+    if (it->second.period.count() > 0)
+      it->second.due = now + it->second.period;
+    else
+      m_timers.erase(it);
+    (*fn)();
+  }
+}
+
+void Reactor::run_posted() {
+  std::vector<std::function<void()>> posted;
+  {
+    std::lock_guard<std::mutex> lock(m_postMutex);
+    posted.swap(m_posted);
+  }
+  for (auto &fn : posted)
+    fn();
+}
+
+void Reactor::dispatch(socket_t s, uint32_t generation, uint32_t events) {
+  auto it = m_sockets.find(s);
+  if (it == m_sockets.end() || it->second.generation != generation)
+    return; // Removed (or its number reused) earlier in this pass
+  // The handler may remove (and so destroy) its own registration
+  std::shared_ptr<IoHandler> handler = it->second.handler;
+  (*handler)(events);
+}
+
+#ifndef __linux__
+void Reactor::build_poll_set() {
+  m_pollFds.clear();
+  m_pollGenerations.clear();
+  pollfd wakeFd;
+  wakeFd.fd = m_wakeSocket;
+  wakeFd.events = POLLIN;
+  wakeFd.revents = 0;
+  m_pollFds.push_back(wakeFd);
+  m_pollGenerations.push_back(0);
+  for (const auto &reg : m_sockets) {
+    if (reg.second.interest == 0)
+      continue; // Paused
+    pollfd p;
+    p.fd = reg.first;
+    p.events = (short)(((reg.second.interest & REACTOR_READ) ? POLLIN : 0) |
+                       ((reg.second.interest & REACTOR_WRITE) ? POLLOUT : 0));
+    p.revents = 0;
+    m_pollFds.push_back(p);
+    m_pollGenerations.push_back(reg.second.generation);
+  }
+  m_pollDirty = false;
+}
+#endif
+
+void Reactor::wait(int timeoutMs) {
+#ifdef __linux__
+  epoll_event events[MAX_EVENTS];
+  int n = epoll_wait(m_epoll, events, MAX_EVENTS, timeoutMs);
+  for (int i = 0; i < n && !m_stopRequested; i++) {
+    int fd = (int)(uint32_t)events[i].data.u64;
+    uint32_t generation = (uint32_t)(events[i].data.u64 >> 32);
+    if (generation == 0) {
+      uint64_t count;
+      if (read(m_wakeFd, &count, sizeof(count)) < 0) {
+        // Already drained
+      }
+      continue;
+    }
+    uint32_t ready = 0;
+    if (events[i].events & EPOLLIN)
+      ready |= REACTOR_READ;
+    if (events[i].events & EPOLLOUT)
+      ready |= REACTOR_WRITE;
+    if (events[i].events & (EPOLLERR | EPOLLHUP))
+      ready |= REACTOR_HANGUP;
+    dispatch(fd, generation, ready);
+  }
+#else
+  if (m_pollDirty)
+    build_poll_set();
+  // Handlers below may add or remove sockets; that only marks the set for
+  // the next wait, so iterate over this one unchanged. dispatch() skips
+  // entries whose registration changed meanwhile.
+  std::vector<pollfd> &fds = m_pollFds;
+  for (pollfd &p : fds)
+    p.revents = 0;
+
+  int n = reactor_poll(fds.data(), (unsigned long)fds.size(), timeoutMs);
+  if (n <= 0)
+    return;
+  if (fds[0].revents) {
+    char drain[64];
+    while (recv(m_wakeSocket, drain, sizeof(drain), 0) > 0) {
+    }
+  }
+  for (size_t i = 1; i < fds.size() && !m_stopRequested; i++) {
+    if (!fds[i].revents)
+      continue;
+    uint32_t ready = 0;
+    if (fds[i].revents & POLLIN)
+      ready |= REACTOR_READ;
+    if (fds[i].revents & POLLOUT)
+      ready |= REACTOR_WRITE;
+    if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+      ready |= REACTOR_HANGUP;
+    dispatch(fds[i].fd, m_pollGenerations[i], ready);
+  }
+#endif
+}
+
+void Reactor::run() {
+  while (!m_stopRequested) {
+    wait(next_timeout_ms());
+    if (m_stopRequested)
+      break;
+    run_posted();
+    run_timers();
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "Platform.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#if !defined(__linux__) && !defined(_WIN32)
+#include <poll.h>
+#endif
+
+// Interest / readiness bits
+#define REACTOR_READ 1
+#define REACTOR_WRITE 2
+#define REACTOR_HANGUP 4 // Error or peer reset; a read returns the detail
+
+typedef uint64_t TimerId;
+
+// Single-threaded readiness loop for every receiver socket (video, AGCM,
+// log upload) plus the timers that drive discovery.
+//
+// Linux: epoll with an eventfd for wake-ups. Elsewhere: poll()/WSAPoll()
+// with a loopback UDP socket as the wake-up channel. Sockets are
+// level-triggered and must be non-blocking. With no timer armed the loop
+// sleeps until a socket is ready or post()/stop() is called, so an idle
+// receiver never wakes up.
+//
+// add/modify/remove and the timer calls belong to the loop thread (or to
+// setup code before run() starts); post() and stop() are safe anywhere.
+class Reactor {
+public:
+  typedef std::function<void(uint32_t events)> IoHandler;
+
+  Reactor();
+  ~Reactor();
+
+  bool open();
+  void close(); // After run() has returned
+
+  bool add(socket_t s, uint32_t interest, IoHandler handler);
+  void modify(socket_t s, uint32_t interest);
+  // Safe from inside the socket's own handler
+  void remove(socket_t s);
+
+  // Runs `fn` after `delayMs`, then every `periodMs` if non-zero
+  TimerId add_timer(uint32_t delayMs, uint32_t periodMs,
+                    std::function<void()> fn);
+  void cancel_timer(TimerId id);
+
+  // Runs `fn` on the loop thread
+  void post(std::function<void()> fn);
+
+  // Dispatches until stop(). Returns within one wake-up of stop().
+  void run();
+  void stop();
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  // `generation` is new for every add(): a socket closed by one handler and
+  // its number handed out again by accept() in the same pass must not get
+  // the old socket's readiness.
+  struct Registration {
+    uint32_t interest;
+    uint32_t generation;
+    std::shared_ptr<IoHandler> handler;
+  };
+
+  struct Timer {
+    Clock::time_point due;
+    std::chrono::milliseconds period;
+    std::shared_ptr<std::function<void()>> fn;
+  };
+
+  int next_timeout_ms() const;
+  void run_timers();
+  void run_posted();
+  void dispatch(socket_t s, uint32_t generation, uint32_t events);
+  void wait(int timeoutMs);
+  void wake();
+
+  std::map<socket_t, Registration> m_sockets;
+  uint32_t m_nextGeneration;
+  std::map<TimerId, Timer> m_timers;
+  TimerId m_nextTimerId;
+
+  std::mutex m_postMutex;
+  std::vector<std::function<void()>> m_posted;
+  std::atomic<bool> m_stopRequested;
+
+#ifdef __linux__
+  int m_epoll;
+  int m_wakeFd; // eventfd
+#else
+  socket_t m_wakeSocket; // UDP bound to loopback; wake() sends to itself
+  sockaddr_in m_wakeAddr;
+  // Wake-up socket first, then every socket with interest. Rebuilt only
+  // after add/modify/remove.
+  void build_poll_set();
+  std::vector<pollfd> m_pollFds;
+  std::vector<uint32_t> m_pollGenerations; // Parallel to m_pollFds
+  bool m_pollDirty;
+#endif
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,190 @@
+#include "ReceiverCore.h"
+#include "Log.h"
+#include <stdlib.h>
+
+bool parse_receiver_args(int argc, char **argv, ReceiverConfig *config) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--queue-depth" && hasValue) {
+      int depth = atoi(argv[++i]);
+      if (depth <= 0)
+        return false;
+      config->queue_depth = (size_t)depth;
+    } else if (arg == "--queue-policy" && hasValue) {
+      std::string policy = argv[++i];
+      if (policy == "drop")
+        config->queue_policy = QUEUE_DROP_TO_KEYFRAME;
+      else if (policy == "block")
+        config->queue_policy = QUEUE_BLOCK;
+      else
+        return false;
+    } else if (arg == "--port" && hasValue) {
+      int port = atoi(argv[++i]);
+      if (port <= 0 || port > 65535)
+        return false;
+      config->video_port = (uint16_t)port;
+    } else if (arg == "--data-dir" && hasValue) {
+      config->data_dir = argv[++i];
+    } else if (arg == "--no-discovery") {
+      config->discovery = false;
+    } else if (arg == "--no-feedback") {
+      config->rtp_feedback = false;
+    } else if (arg == "--rate-control") {
+      config->rate_control = true;
+    } else if (arg == "--latency-budget" && hasValue) {
+      config->latency_budget_ms = atoi(argv[++i]);
+      if (config->latency_budget_ms < 0)
+        return false;
+    } else if (arg == "--backlog-budget" && hasValue) {
+      config->backlog_budget_kb = atoi(argv[++i]);
+      if (config->backlog_budget_kb < 0)
+        return false;
+    } else if (arg == "--decode-profile" && hasValue) {
+      if (!parse_decode_profile(argv[++i], &config->decode_profile))
+        return false;
+    } else if (arg == "--convert-threads" && hasValue) {
+      config->convert_threads = atoi(argv[++i]);
+      if (config->convert_threads < 0)
+        return false;
+    } else if (arg == "--convert-band-rows" && hasValue) {
+      config->convert_band_rows = atoi(argv[++i]);
+      if (config->convert_band_rows < 0)
+        return false;
+    } else if (arg == "--band-convert") {
+      config->band_convert = true;
+    } else if (arg == "--no-log-receiver") {
+      config->log_receiver = false;
+    } else if (arg == "--capture") {
+      config->capture = true;
+    } else if (arg == "--replay" && hasValue) {
+      config->replay_path = argv[++i];
+    } else if (arg == "--replay-fast") {
+      config->replay_fast = true;
+    } else if (arg == "--max-sessions" && hasValue) {
+      config->max_sessions = atoi(argv[++i]);
+      if (config->max_sessions <= 0 ||
+          config->max_sessions > FRAME_BUS_MAX_SESSIONS)
+        return false;
+    } else if (arg == "--workers" && hasValue) {
+      config->workers = atoi(argv[++i]);
+      if (config->workers < 0)
+        return false;
+    } else if (arg == "--transport" && hasValue) {
+      std::string transport = argv[++i];
+      if (transport == "tcp")
+        config->transport = TRANSPORT_TCP;
+      else if (transport == "rtp")
+        config->transport = TRANSPORT_RTP;
+      else
+        return false;
+    } else {
+      // Unknown, or an option missing its value
+      log_err("Unrecognised argument: " + arg + "\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+ReceiverCore::ReceiverCore()
+    : m_stream(&m_clock), m_discovery(&m_clock), m_started(false) {}
+
+ReceiverCore::~ReceiverCore() { stop(); }
+
+bool ReceiverCore::start(const ReceiverConfig &config) {
+  if (!net_init()) {
+    log_err("Socket layer initialisation failed\n");
+    return false;
+  }
+
+  make_directory(config.data_dir);
+  log_init(path_join(config.data_dir, "debug"));
+
+  SessionConfig sessions;
+  sessions.queue_depth = config.queue_depth;
+  sessions.queue_policy = config.queue_policy;
+  sessions.max_sessions = config.max_sessions;
+  sessions.workers = config.workers;
+  sessions.transport = config.transport;
+  sessions.latency.max_age_us = (int64_t)config.latency_budget_ms * 1000;
+  sessions.latency.max_backlog_bytes = (size_t)config.backlog_budget_kb * 1024;
+  sessions.decode_profile = config.decode_profile;
+  sessions.band_convert = config.band_convert;
+  sessions.convert_threads = config.convert_threads;
+  sessions.convert_band_rows = config.convert_band_rows;
+
+  // One clock offset is shared by all sessions (discovery syncs with the
+  // phone that answered last)
+  bool replay = !config.replay_path.empty();
+  m_stream.set_connection_callback([this, replay](int session,
+                                                  bool connected) {
+    if (!connected && !replay && !m_stream.connected())
+      m_clock.reset(); // Re-sync on the next connection
+    if (m_onConnection)
+      m_onConnection(session, connected);
+  });
+
+  if (replay) {
+    if (!m_stream.start_replay(config.replay_path,
+                               config.replay_fast ? REPLAY_FAST
+                                                  : REPLAY_REALTIME,
+                               sessions)) {
+      net_cleanup();
+      return false;
+    }
+    // Map the recorded capture times onto now, so E2E latency reads as it
+    // did in the original session (only meaningful in real time)
+    m_clock.set_offset_ms(-m_stream.replay_shift_us() / 1000.0);
+    m_started = true;
+    return true;
+  }
+
+  if (!m_reactor.open()) {
+    net_cleanup();
+    return false;
+  }
+  if (config.capture)
+    m_stream.set_capture_dir(path_join(config.data_dir, "captures"));
+  if (config.rtp_feedback || config.rate_control)
+    m_stream.set_feedback_port(config.discovery_port);
+  m_stream.set_loss_feedback(config.rtp_feedback);
+  m_stream.set_rate_control(config.rate_control);
+  if (!m_stream.start(&m_reactor, config.video_port, sessions)) {
+    m_reactor.close();
+    net_cleanup();
+    return false;
+  }
+
+  // Both are optional: the stream works without them
+  if (config.discovery) {
+    m_discovery.start(&m_reactor, config.discovery_port,
+                      [this]() { return m_stream.connected(); });
+  }
+  if (config.log_receiver) {
+    m_logReceiver.start(&m_reactor, config.log_port,
+                        path_join(config.data_dir, "logs"));
+  }
+
+  m_reactorThread = std::thread(&Reactor::run, &m_reactor);
+  m_started = true;
+  return true;
+}
+
+void ReceiverCore::stop() {
+  if (!m_started)
+    return;
+  m_started = false;
+
+  // Nothing touches the sockets once the loop has returned
+  if (m_reactorThread.joinable()) {
+    m_reactor.stop();
+    m_reactorThread.join();
+  }
+  m_logReceiver.stop();
+  m_discovery.stop();
+  m_stream.stop(); // Closes the frame buses
+  m_reactor.close();
+  log_close();
+  net_cleanup();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef RECEIVER_CORE_H
+#define RECEIVER_CORE_H
+
+#include "ClockSync.h"
+#include "Discovery.h"
+#include "LogReceiver.h"
+#include "Reactor.h"
+#include "StreamReceiver.h"
+#include <functional>
+#include <string>
+#include <thread>
+
+struct ReceiverConfig {
+  uint16_t video_port = 5000;     // Wire frames (TCP) or RTP (UDP)
+  uint16_t discovery_port = 5001; // AGCM PING/PONG/SYNC (UDP)
+  uint16_t log_port = 5002;       // iOS log upload (TCP)
+
+  size_t queue_depth = 16; // Per session
+  QueueDropPolicy queue_policy = QUEUE_DROP_TO_KEYFRAME;
+  int max_sessions = 4; // Phones streaming at once, one frame bus each
+  int workers = 0;      // Decode workers; 0 = one per core
+  IngestTransport transport = TRANSPORT_TCP;
+
+  bool discovery = true;
+  bool log_receiver = true;
+  bool rtp_feedback = true; // NACK/PLI to the phone's discovery port
+  bool rate_control = false; // Bitrate targets to the same port (opt-in)
+
+  // Latency governor: skip to the newest keyframe once a picture has waited
+  // this long to be decoded, or this much is backed up (0 = no limit)
+  int latency_budget_ms = 250;
+  int backlog_budget_kb = 0;
+
+  // Decoder threading; can be changed while running
+  DecodeProfile decode_profile = DECODE_ULTRA_LOW_LATENCY;
+  // Copy rows into the frame bus as they are decoded (ultra-low-latency)
+  bool band_convert = false;
+  // Threads converting each frame (caller included; 0 = one per core, 1 =
+  // none) and the rows each takes at a time (0 = default)
+  int convert_threads = 0;
+  int convert_band_rows = 0;
+
+  // debug/ (our log) and logs/ (iPhone logs) are created under this
+  std::string data_dir = ".";
+
+  // Tee every connection into <data_dir>/captures/capture_<ts>.agcw
+  bool capture = false;
+
+  // Replay this capture instead of listening (no discovery/log receiver)
+  std::string replay_path;
+  bool replay_fast = false;
+};
+
+// Parses the options shared by every front end:
+//   --queue-depth N, --queue-policy drop|block, --port N, --data-dir PATH,
+//   --no-discovery, --no-log-receiver, --capture, --replay PATH,
+//   --replay-fast, --max-sessions N, --workers N, --transport tcp|rtp,
+//   --no-feedback, --rate-control, --latency-budget MS,
+//   --backlog-budget KB, --decode-profile NAME, --band-convert,
+//   --convert-threads N, --convert-band-rows N
+// Returns false on a bad value or an unrecognised argument.
+bool parse_receiver_args(int argc, char **argv, ReceiverConfig *config);
+
+// Everything between the network and the shared-memory frame buses, with
+// no UI: ingest -> decode -> convert -> publish for every connected phone,
+// plus discovery, clock sync and the log upload listener. All sockets share
+// one Reactor thread; decoding runs on the session workers. The Windows app
+// wraps it in a preview window; receiver_core runs it headless.
+class ReceiverCore {
+public:
+  ReceiverCore();
+  ~ReceiverCore();
+
+  // Opens the log, frame bus and decoder, then starts all threads.
+  bool start(const ReceiverConfig &config);
+  // Returns once every thread has been joined; the network side stops
+  // within one reactor wake-up.
+  void stop();
+
+  // Set before start(). Run on a decode worker / the reactor thread
+  // respectively, with the session index.
+  void set_frame_callback(std::function<void(int)> callback) {
+    m_stream.set_frame_callback(callback);
+  }
+  void set_connection_callback(std::function<void(int, bool)> callback) {
+    m_onConnection = callback;
+  }
+
+  // Frame bus of `session`; nullptr until that session was first used
+  SharedMemoryLayout *frame_layout(int session = 0) const {
+    return m_stream.frame_layout(session);
+  }
+
+  // Any phone connected
+  bool connected() const { return m_stream.connected(); }
+
+  // Any thread, once started; each session switches at its next keyframe
+  void set_decode_profile(DecodeProfile profile) {
+    m_stream.set_decode_profile(profile);
+  }
+  DecodeProfile decode_profile() const { return m_stream.decode_profile(); }
+
+  // Replay mode: the whole capture has been decoded
+  bool finished() const { return m_stream.replay_finished(); }
+
+private:
+  ClockSync m_clock;
+  Reactor m_reactor;
+  std::thread m_reactorThread;
+  StreamReceiver m_stream;
+  Discovery m_discovery;
+  LogReceiver m_logReceiver;
+  std::function<void(int, bool)> m_onConnection;
+  bool m_started;
+};
+
+#endif // RECEIVER_CORE_H
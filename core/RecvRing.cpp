@@ -0,0 +1,70 @@
+#include "RecvRing.h"
+#include <string.h>
+
+// Keep at least this much room for each recv() so a chunk can carry several
+// NALs; below it the partial frame at the read position is moved to the front.
+static const size_t MIN_RECV_CHUNK = 64 * 1024;
+
+static inline uint32_t read_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t read_be64(const uint8_t *p) {
+  return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+RecvRing::RecvRing(size_t capacity) : m_read(0), m_write(0) {
+  // A maximal frame must always fit once the buffer is compacted
+  if (capacity < WIRE_MAX_FRAME_SIZE + 4 + MIN_RECV_CHUNK)
+    capacity = WIRE_MAX_FRAME_SIZE + 4 + MIN_RECV_CHUNK;
+  m_buf.resize(capacity);
+}
+
+uint8_t *RecvRing::prepare(size_t *space) {
+  if (m_read == m_write) {
+    // Everything consumed: rewind for free
+    m_read = m_write = 0;
+  } else {
+    size_t pending = m_write - m_read;
+    size_t frameEnd = m_buf.size(); // Unknown length: only need a chunk
+    if (pending >= 4)
+      frameEnd = m_read + 4 + read_be32(&m_buf[m_read]);
+
+    if (m_buf.size() - m_write < MIN_RECV_CHUNK || frameEnd > m_buf.size()) {
+      memmove(m_buf.data(), m_buf.data() + m_read, pending);
+      m_read = 0;
+      m_write = pending;
+    }
+  }
+
+  *space = m_buf.size() - m_write;
+  return m_buf.data() + m_write;
+}
+
+void RecvRing::commit(size_t n) { m_write += n; }
+
+RecvRing::ParseResult RecvRing::next(WireFrame *frame) {
+  size_t pending = m_write - m_read;
+  if (pending < 4)
+    return NEED_MORE;
+
+  const uint8_t *p = m_buf.data() + m_read;
+  uint32_t len = read_be32(p);
+
+  // Validate as soon as the length is known so a corrupt stream is dropped
+  // before we wait for a megabyte that never comes.
+  if (len > WIRE_MAX_FRAME_SIZE)
+    return FRAME_OVERSIZED;
+  if (len < 8)
+    return FRAME_TOO_SMALL;
+
+  if (pending < 4 + (size_t)len)
+    return NEED_MORE;
+
+  frame->timestamp_us = read_be64(p + 4);
+  frame->payload = m_buf.data() + m_read + WIRE_HEADER_SIZE;
+  frame->size = len - 8;
+  m_read += 4 + len;
+  return FRAME_READY;
+}
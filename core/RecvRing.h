@@ -0,0 +1,61 @@
+#pragma once
+#ifndef RECV_RING_H
+#define RECV_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Wire format on port 5000 (see TCPClient.send on iOS):
+//   [Length (4 bytes, BE)][Timestamp us (8 bytes, BE)][NAL (Length - 8)]
+// A message without a NAL (Length == 8) marks the end of a picture
+// (TCPClient.endFrame); receivers that predate it skip it as empty.
+#define WIRE_HEADER_SIZE 12
+#define WIRE_MAX_FRAME_SIZE 1000000
+
+// One parsed message. `payload` points into the ring and stays valid until
+// the next RecvRing::prepare() call.
+struct WireFrame {
+  uint8_t *payload;
+  uint32_t size;
+  uint64_t timestamp_us; // Apple epoch (2001-01-01), sender clock
+};
+
+// Receive buffer for the port 5000 stream.
+//
+// The socket reader pulls large chunks straight into the free tail of the
+// buffer and frames are parsed in place, so the hot path makes one recv()
+// per chunk instead of three per NAL and never allocates. Consumed bytes are
+// reclaimed lazily: only the trailing partial frame is ever moved.
+class RecvRing {
+public:
+  enum ParseResult {
+    FRAME_READY,     // *frame filled in
+    NEED_MORE,       // incomplete frame buffered, call prepare()/commit()
+    FRAME_TOO_SMALL, // length field smaller than the timestamp
+    FRAME_OVERSIZED  // length field above WIRE_MAX_FRAME_SIZE
+  };
+
+  explicit RecvRing(size_t capacity = 2 * 1024 * 1024);
+
+  // Returns the writable tail and its size. Invalidates earlier WireFrames.
+  uint8_t *prepare(size_t *space);
+
+  // Marks `n` bytes written into the region returned by prepare().
+  void commit(size_t n);
+
+  // Parses the next complete frame out of the buffered bytes.
+  ParseResult next(WireFrame *frame);
+
+  // Bytes received but not yet handed out as frames.
+  size_t buffered() const { return m_write - m_read; }
+
+  void reset() { m_read = m_write = 0; }
+
+private:
+  std::vector<uint8_t> m_buf;
+  size_t m_read;
+  size_t m_write;
+};
+
+#endif // RECV_RING_H
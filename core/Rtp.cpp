@@ -0,0 +1,253 @@
+#include "Rtp.h"
+#include <string.h>
+
+static uint16_t get_be16(const uint8_t *p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+bool rtp_parse_header(const uint8_t *packet, size_t size, RtpHeader *out) {
+  if (size < RTP_HEADER_SIZE || (packet[0] >> 6) != 2)
+    return false;
+
+  bool padding = (packet[0] & 0x20) != 0;
+  bool extension = (packet[0] & 0x10) != 0;
+  size_t csrcCount = packet[0] & 0x0F;
+
+  out->marker = (packet[1] & 0x80) != 0;
+  out->payload_type = packet[1] & 0x7F;
+  out->seq = get_be16(packet + 2);
+  out->timestamp = get_be32(packet + 4);
+  out->ssrc = get_be32(packet + 8);
+  out->has_capture_time = false;
+  out->capture_us = 0;
+
+  size_t pos = RTP_HEADER_SIZE + csrcCount * 4;
+  if (extension) {
+    if (pos + 4 > size)
+      return false;
+    uint16_t profile = get_be16(packet + pos);
+    size_t extSize = (size_t)get_be16(packet + pos + 2) * 4;
+    size_t extEnd = pos + 4 + extSize;
+    if (extEnd > size)
+      return false;
+
+    // RFC 8285 one-byte elements: [ID:4|L:4][L + 1 bytes]
+    if (profile == 0xBEDE) {
+      size_t p = pos + 4;
+      while (p < extEnd) {
+        uint8_t id = packet[p] >> 4;
+        size_t len = (size_t)(packet[p] & 0x0F) + 1;
+        if (id == 0) { // Padding
+          p++;
+          continue;
+        }
+        if (id == 15 || p + 1 + len > extEnd)
+          break;
+        if (id == RTP_EXT_CAPTURE_TIME && len == 8) {
+          out->capture_us =
+              ((uint64_t)get_be32(packet + p + 1) << 32) |
+              get_be32(packet + p + 5);
+          out->has_capture_time = true;
+        }
+        p += 1 + len;
+      }
+    }
+    pos = extEnd;
+  }
+
+  size_t end = size;
+  if (padding) {
+    uint8_t padBytes = packet[size - 1];
+    if (padBytes == 0 || pos + padBytes > size)
+      return false;
+    end -= padBytes;
+  }
+  if (pos > end)
+    return false;
+
+  out->payload_offset = (uint32_t)pos;
+  out->payload_size = (uint32_t)(end - pos);
+  return true;
+}
+
+// --- Packetizer ---
+
+RtpPacketizer::RtpPacketizer(uint32_t ssrc, size_t mtu)
+    : m_ssrc(ssrc), m_mtu(mtu), m_seq((uint16_t)(ssrc * 2654435761u)),
+      m_timestamp(0), m_captureUs(0), m_used(0), m_aggBytes(0) {}
+
+void RtpPacketizer::begin_picture(uint32_t rtpTimestamp, uint64_t captureUs) {
+  m_timestamp = rtpTimestamp;
+  m_captureUs = captureUs;
+  m_used = 0;
+  m_aggNals.clear();
+  m_aggSizes.clear();
+  m_aggBytes = 0;
+}
+
+// Header + capture time extension, payload appended by the caller
+std::vector<uint8_t> &RtpPacketizer::new_packet() {
+  if (m_used == m_packets.size())
+    m_packets.emplace_back();
+  std::vector<uint8_t> &pkt = m_packets[m_used++];
+  pkt.resize(RTP_HEADER_SIZE + RTP_EXT_SIZE);
+
+  uint8_t *p = pkt.data();
+  p[0] = 0x90; // V=2, X=1
+  p[1] = RTP_PAYLOAD_TYPE;
+  put_be16(p + 2, m_seq++);
+  put_be32(p + 4, m_timestamp);
+  put_be32(p + 8, m_ssrc);
+
+  uint8_t *ext = p + RTP_HEADER_SIZE;
+  put_be16(ext, 0xBEDE);
+  put_be16(ext + 2, (RTP_EXT_SIZE - 4) / 4);
+  ext[4] = (RTP_EXT_CAPTURE_TIME << 4) | (8 - 1);
+  put_be32(ext + 5, (uint32_t)(m_captureUs >> 32));
+  put_be32(ext + 9, (uint32_t)m_captureUs);
+  ext[13] = ext[14] = ext[15] = 0;
+  return pkt;
+}
+
+void RtpPacketizer::flush_aggregate() {
+  if (m_aggNals.empty())
+    return;
+
+  std::vector<uint8_t> &pkt = new_packet();
+  if (m_aggNals.size() == 1) {
+    pkt.insert(pkt.end(), m_aggNals[0], m_aggNals[0] + m_aggSizes[0]);
+  } else {
+    // STAP-A: F and the highest NRI of the aggregated units
+    uint8_t nri = 0, forbidden = 0;
+    for (const uint8_t *nal : m_aggNals) {
+      if ((nal[0] & 0x60) > nri)
+        nri = nal[0] & 0x60;
+      forbidden |= nal[0] & 0x80;
+    }
+    pkt.push_back((uint8_t)(forbidden | nri | RTP_NAL_STAP_A));
+    for (size_t i = 0; i < m_aggNals.size(); i++) {
+      pkt.push_back((uint8_t)(m_aggSizes[i] >> 8));
+      pkt.push_back((uint8_t)m_aggSizes[i]);
+      pkt.insert(pkt.end(), m_aggNals[i], m_aggNals[i] + m_aggSizes[i]);
+    }
+  }
+  m_aggNals.clear();
+  m_aggSizes.clear();
+  m_aggBytes = 0;
+}
+
+void RtpPacketizer::add_nal(const uint8_t *nal, uint32_t size) {
+  if (size == 0)
+    return;
+
+  // Fits into a STAP-A (1 byte header, 2 byte size per unit)?
+  if (size + 2 + 1 <= m_mtu) {
+    if (m_aggBytes + size + 2 + 1 > m_mtu)
+      flush_aggregate();
+    m_aggNals.push_back(nal);
+    m_aggSizes.push_back(size);
+    m_aggBytes += size + 2;
+    return;
+  }
+  flush_aggregate();
+
+  // FU-A: the NAL header is rebuilt from the indicator and the FU header
+  uint8_t indicator = (uint8_t)((nal[0] & 0xE0) | RTP_NAL_FU_A);
+  uint8_t type = nal[0] & 0x1F;
+  const uint8_t *p = nal + 1;
+  uint32_t left = size - 1;
+  size_t chunkMax = m_mtu - 2;
+  bool first = true;
+  while (left > 0) {
+    uint32_t chunk = (uint32_t)(left < chunkMax ? left : chunkMax);
+    std::vector<uint8_t> &pkt = new_packet();
+    pkt.push_back(indicator);
+    pkt.push_back((uint8_t)((first ? 0x80 : 0) | (chunk == left ? 0x40 : 0) |
+                            type));
+    pkt.insert(pkt.end(), p, p + chunk);
+    p += chunk;
+    left -= chunk;
+    first = false;
+  }
+}
+
+void RtpPacketizer::finish_picture() {
+  flush_aggregate();
+  if (m_used > 0)
+    m_packets[m_used - 1][1] |= 0x80; // Marker
+}
+
+// --- Depacketizer ---
+
+void RtpDepacketizer::reset() {
+  m_fragment.clear();
+  m_inFragment = false;
+}
+
+bool RtpDepacketizer::push(const uint8_t *payload, uint32_t size) {
+  m_nals.clear();
+  if (size < 1)
+    return false;
+
+  uint8_t type = payload[0] & 0x1F;
+  if (type >= 1 && type <= 23) {
+    m_nals.push_back({payload, size});
+    return true;
+  }
+
+  if (type == RTP_NAL_STAP_A) {
+    uint32_t pos = 1;
+    while (pos + 2 <= size) {
+      uint32_t nalSize = get_be16(payload + pos);
+      pos += 2;
+      if (nalSize == 0 || pos + nalSize > size) {
+        m_nals.clear();
+        return false;
+      }
+      m_nals.push_back({payload + pos, nalSize});
+      pos += nalSize;
+    }
+    return !m_nals.empty();
+  }
+
+  if (type == RTP_NAL_FU_A) {
+    if (size < 3)
+      return false;
+    bool start = (payload[1] & 0x80) != 0;
+    bool end = (payload[1] & 0x40) != 0;
+    if (start) {
+      m_fragment.clear();
+      m_fragment.push_back(
+          (uint8_t)((payload[0] & 0xE0) | (payload[1] & 0x1F)));
+      m_inFragment = true;
+    } else if (!m_inFragment) {
+      return false; // Start of this NAL was lost
+    }
+    m_fragment.insert(m_fragment.end(), payload + 2, payload + size);
+    if (end) {
+      m_nals.push_back({m_fragment.data(), (uint32_t)m_fragment.size()});
+      m_inFragment = false;
+    }
+    return true;
+  }
+
+  // STAP-B, MTAP and FU-B only exist in interleaved mode
+  return false;
+}
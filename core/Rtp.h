@@ -0,0 +1,107 @@
+#pragma once
+#ifndef RTP_H
+#define RTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// H.264 over RTP (RFC 3550 / RFC 6184, non-interleaved mode) as an
+// alternative to the TCP wire protocol. Payloads are single NAL units,
+// STAP-A (several small NALs in one packet) and FU-A (one large NAL split
+// across packets); the marker bit is set on the last packet of a picture.
+//
+// The capture time the TCP header carries travels in an RFC 8285 one-byte
+// header extension (ID RTP_EXT_CAPTURE_TIME): 8 bytes, big endian,
+// microseconds since 2001-01-01 on the sender clock.
+#define RTP_HEADER_SIZE 12
+#define RTP_PAYLOAD_TYPE 96 // Dynamic, H.264
+// A packet resent on request: same SSRC, sequence number and payload, only
+// the payload type differs (a simplified RFC 4588)
+#define RTP_PAYLOAD_TYPE_RTX 97
+// FEC repair packets use 98, see RtpFec.h
+#define RTP_CLOCK_RATE 90000
+#define RTP_EXT_CAPTURE_TIME 1
+#define RTP_EXT_SIZE 16 // 0xBEDE header + element (1 + 8) + padding
+
+// Payload sizes that keep a packet inside a 1500 byte Ethernet frame with
+// IPv4/UDP headers and some headroom for tunnels
+#define RTP_DEFAULT_MTU 1200
+
+#define RTP_NAL_STAP_A 24
+#define RTP_NAL_FU_A 28
+
+struct RtpHeader {
+  uint16_t seq = 0;
+  uint32_t timestamp = 0; // RTP_CLOCK_RATE units
+  uint32_t ssrc = 0;
+  uint8_t payload_type = 0;
+  bool marker = false;
+  bool has_capture_time = false;
+  uint64_t capture_us = 0;     // Valid if has_capture_time
+  uint32_t payload_offset = 0; // From the start of the packet
+  uint32_t payload_size = 0;
+};
+
+// Parses the fixed header, CSRCs and extensions. Returns false for anything
+// that is not a well-formed RTP version 2 packet.
+bool rtp_parse_header(const uint8_t *packet, size_t size, RtpHeader *out);
+
+// Sender side: splits one picture's NALs into RTP packets. Small NALs are
+// aggregated into STAP-A, large ones fragmented into FU-A.
+class RtpPacketizer {
+public:
+  RtpPacketizer(uint32_t ssrc, size_t mtu = RTP_DEFAULT_MTU);
+
+  // Starts a picture. Packets are appended by add_nal() and the marker bit
+  // goes on the last one in finish_picture().
+  void begin_picture(uint32_t rtpTimestamp, uint64_t captureUs);
+  void add_nal(const uint8_t *nal, uint32_t size);
+  void finish_picture();
+
+  size_t packet_count() const { return m_used; }
+  const std::vector<uint8_t> &packet(size_t i) const { return m_packets[i]; }
+
+private:
+  std::vector<uint8_t> &new_packet();
+  void flush_aggregate();
+
+  uint32_t m_ssrc;
+  size_t m_mtu;
+  uint16_t m_seq;
+  uint32_t m_timestamp;
+  uint64_t m_captureUs;
+  std::vector<std::vector<uint8_t>> m_packets; // Reused across pictures
+  size_t m_used;
+
+  // NALs waiting to share a STAP-A
+  std::vector<const uint8_t *> m_aggNals;
+  std::vector<uint32_t> m_aggSizes;
+  size_t m_aggBytes;
+};
+
+// Receiver side: turns in-order RTP payloads back into NAL units. NAL views
+// stay valid until the next push() or reset().
+class RtpDepacketizer {
+public:
+  struct Nal {
+    const uint8_t *data;
+    uint32_t size;
+  };
+
+  // Returns false if the payload is malformed or of an unsupported type;
+  // the caller should treat that like a lost packet.
+  bool push(const uint8_t *payload, uint32_t size);
+
+  const std::vector<Nal> &nals() const { return m_nals; }
+
+  // Forgets a half-received FU-A (after a lost packet)
+  void reset();
+
+private:
+  std::vector<Nal> m_nals;
+  std::vector<uint8_t> m_fragment; // FU-A being reassembled
+  bool m_inFragment = false;
+};
+
+#endif // RTP_H
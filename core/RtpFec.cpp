@@ -0,0 +1,263 @@
+#include "RtpFec.h"
+#include "Fec.h"
+#include <algorithm>
+#include <string.h>
+
+// Media packets kept for rebuilding, and repair groups tracked at once:
+// around half a second of a 10 Mbit/s stream either way
+static const size_t FEC_HISTORY = 1024;
+static const size_t FEC_GROUPS = 64;
+
+static uint16_t get_be16(const uint8_t *p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put_be16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+// --- Encoder ---
+
+RtpFecEncoder::RtpFecEncoder(uint32_t ssrc, int k, int m)
+    : m_ssrc(ssrc), m_k(std::max(1, std::min(k, FEC_MAX_SOURCE))),
+      m_m(std::max(1, std::min(m, FEC_MAX_REPAIR))),
+      m_seq((uint16_t)(ssrc * 40503u)), m_timestamp(0), m_used(0) {}
+
+void RtpFecEncoder::begin_picture(uint32_t rtpTimestamp) {
+  m_timestamp = rtpTimestamp;
+  m_sources.clear();
+  m_sourceSizes.clear();
+  m_used = 0;
+}
+
+void RtpFecEncoder::add(const uint8_t *packet, size_t size) {
+  m_sources.push_back(packet);
+  m_sourceSizes.push_back(size);
+}
+
+// Groups of near-equal size rather than k, k, ..., remainder: the last one
+// is not left with a tiny group and an outsized share of repair packets
+void RtpFecEncoder::finish_picture() {
+  size_t n = m_sources.size();
+  size_t groups = (n + (size_t)m_k - 1) / (size_t)m_k;
+  size_t first = 0;
+  for (size_t g = 0; g < groups; g++) {
+    size_t count = n / groups + (g < n % groups ? 1 : 0);
+    protect_group(first, count);
+    first += count;
+  }
+}
+
+void RtpFecEncoder::protect_group(size_t first, size_t count) {
+  size_t symbolSize = 0;
+  for (size_t i = 0; i < count; i++)
+    symbolSize = std::max(symbolSize, m_sourceSizes[first + i] + 2);
+
+  const uint8_t *symbols[FEC_MAX_SOURCE];
+  m_symbols.assign(count * symbolSize, 0);
+  for (size_t i = 0; i < count; i++) {
+    uint8_t *s = &m_symbols[i * symbolSize];
+    put_be16(s, (uint16_t)m_sourceSizes[first + i]);
+    memcpy(s + 2, m_sources[first + i], m_sourceSizes[first + i]);
+    symbols[i] = s;
+  }
+
+  int repairs = std::max(1, (int)(((size_t)m_m * count + (size_t)m_k - 1) /
+                                  (size_t)m_k));
+  for (int row = 0; row < repairs; row++) {
+    if (m_used == m_packets.size())
+      m_packets.emplace_back();
+    std::vector<uint8_t> &pkt = m_packets[m_used++];
+    pkt.resize(RTP_HEADER_SIZE + RTP_FEC_HEADER_SIZE + symbolSize);
+
+    uint8_t *p = pkt.data();
+    p[0] = 0x80; // V=2
+    p[1] = RTP_PAYLOAD_TYPE_FEC;
+    put_be16(p + 2, m_seq++);
+    put_be32(p + 4, m_timestamp);
+    put_be32(p + 8, m_ssrc);
+
+    uint8_t *fec = p + RTP_HEADER_SIZE;
+    memcpy(fec, m_sources[first] + 2, 2); // Base: the first packet's seq
+    fec[2] = (uint8_t)count;
+    fec[3] = (uint8_t)repairs;
+    fec[4] = (uint8_t)row;
+    fec[5] = 0;
+    fec_encode(symbols, (int)count, row, fec + RTP_FEC_HEADER_SIZE,
+               symbolSize);
+  }
+}
+
+// --- Decoder ---
+
+RtpFecDecoder::RtpFecDecoder()
+    : m_history(FEC_HISTORY), m_groups(FEC_GROUPS) {
+  reset();
+}
+
+void RtpFecDecoder::reset() {
+  m_active = false;
+  for (Stored &s : m_history)
+    s.valid = false;
+  for (Group &g : m_groups)
+    g.used = false;
+  m_nextGroup = 0;
+  m_rebuiltCount = 0;
+  m_unrecovered = 0;
+}
+
+const RtpFecDecoder::Stored *RtpFecDecoder::find(uint16_t seq) const {
+  const Stored &s = m_history[seq % FEC_HISTORY];
+  return s.valid && s.seq == seq ? &s : nullptr;
+}
+
+RtpFecDecoder::Stored &RtpFecDecoder::store(const uint8_t *packet,
+                                            size_t size, uint16_t seq) {
+  Stored &s = m_history[seq % FEC_HISTORY];
+  s.data.assign(packet, packet + size);
+  s.seq = seq;
+  s.valid = true;
+  return s;
+}
+
+int RtpFecDecoder::missing(const Group &group) const {
+  int n = 0;
+  for (int j = 0; j < group.count; j++)
+    n += find((uint16_t)(group.base + j)) ? 0 : 1;
+  return n;
+}
+
+void RtpFecDecoder::retire(Group &group) {
+  if (group.used && !group.done)
+    m_unrecovered += (uint64_t)missing(group);
+  group.used = false;
+}
+
+void RtpFecDecoder::add_media(const uint8_t *packet, size_t size,
+                              uint16_t seq) {
+  m_rebuiltCount = 0;
+  if (find(seq))
+    return;
+  // A retransmission is kept as the original it repeats, which is what the
+  // repair symbols were computed over
+  Stored &s = store(packet, size, seq);
+  if (size > 1)
+    s.data[1] = (uint8_t)((s.data[1] & 0x80) | RTP_PAYLOAD_TYPE);
+
+  // Normally the repair packets come last; this is for the reordered case
+  for (Group &g : m_groups) {
+    if (g.used && !g.done && !g.rows.empty() &&
+        (uint16_t)(seq - g.base) < (uint16_t)g.count)
+      try_rebuild(g);
+  }
+}
+
+void RtpFecDecoder::add_repair(const uint8_t *packet, size_t size,
+                               const RtpHeader &header) {
+  m_rebuiltCount = 0;
+  if (header.payload_size <= RTP_FEC_HEADER_SIZE + 2 ||
+      header.payload_offset + header.payload_size > size)
+    return;
+  const uint8_t *fec = packet + header.payload_offset;
+  uint16_t base = get_be16(fec);
+  int count = fec[2];
+  int repairs = fec[3];
+  int row = fec[4];
+  size_t symbolSize = header.payload_size - RTP_FEC_HEADER_SIZE;
+  if (count == 0 || count > FEC_MAX_SOURCE || repairs == 0 ||
+      repairs > FEC_MAX_REPAIR || row >= repairs)
+    return;
+  m_active = true;
+
+  Group *group = nullptr;
+  for (Group &g : m_groups) {
+    if (g.used && g.base == base && g.count == count)
+      group = &g;
+  }
+  if (!group) {
+    group = &m_groups[m_nextGroup];
+    m_nextGroup = (m_nextGroup + 1) % m_groups.size();
+    retire(*group);
+    group->used = true;
+    group->done = false;
+    group->base = base;
+    group->count = count;
+    group->symbol_size = symbolSize;
+    group->repairs.resize((size_t)repairs);
+    group->rows.clear();
+  }
+  if (group->done || symbolSize != group->symbol_size ||
+      (size_t)row >= group->repairs.size() ||
+      std::find(group->rows.begin(), group->rows.end(), row) !=
+          group->rows.end())
+    return;
+
+  const uint8_t *symbol = fec + RTP_FEC_HEADER_SIZE;
+  group->repairs[(size_t)row].assign(symbol, symbol + symbolSize);
+  group->rows.push_back(row);
+  try_rebuild(*group);
+}
+
+void RtpFecDecoder::try_rebuild(Group &group) {
+  int lost = missing(group);
+  if (lost == 0) {
+    group.done = true;
+    return;
+  }
+  if (lost > (int)group.rows.size())
+    return; // Wait for more repair packets
+
+  size_t symbolSize = group.symbol_size;
+  uint8_t *sources[FEC_MAX_SOURCE];
+  bool present[FEC_MAX_SOURCE];
+  m_work.assign((size_t)group.count * symbolSize, 0);
+  for (int j = 0; j < group.count; j++) {
+    uint8_t *s = &m_work[(size_t)j * symbolSize];
+    sources[j] = s;
+    const Stored *stored = find((uint16_t)(group.base + j));
+    present[j] = stored != nullptr;
+    if (!stored)
+      continue;
+    if (stored->data.size() + 2 > symbolSize) {
+      group.done = true; // Does not match the repair packets; give up
+      return;
+    }
+    put_be16(s, (uint16_t)stored->data.size());
+    memcpy(s + 2, stored->data.data(), stored->data.size());
+  }
+
+  const uint8_t *repairs[FEC_MAX_REPAIR];
+  int rows[FEC_MAX_REPAIR];
+  for (size_t i = 0; i < group.rows.size(); i++) {
+    rows[i] = group.rows[i];
+    repairs[i] = group.repairs[(size_t)rows[i]].data();
+  }
+  if (!fec_decode(sources, present, group.count, repairs, rows,
+                  (int)group.rows.size(), symbolSize))
+    return;
+  group.done = true;
+
+  for (int j = 0; j < group.count; j++) {
+    if (present[j])
+      continue;
+    const uint8_t *s = sources[j];
+    size_t len = get_be16(s);
+    uint16_t seq = (uint16_t)(group.base + j);
+    // A corrupt group decodes to garbage; at least the header must fit
+    if (len < RTP_HEADER_SIZE || len + 2 > symbolSize ||
+        get_be16(s + 2 + 2) != seq)
+      continue;
+    store(s + 2, len, seq);
+    if (m_rebuiltCount == m_rebuilt.size())
+      m_rebuilt.emplace_back();
+    m_rebuilt[m_rebuiltCount++].assign(s + 2, s + 2 + len);
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#ifndef RTP_FEC_H
+#define RTP_FEC_H
+
+#include "Rtp.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Forward error correction for the RTP transport, on top of the Fec.h
+// erasure code.
+//
+// The sender cuts each picture's packets into groups of at most k and sends
+// every group's repair packets right behind it: ceil(m * n / k) of them for
+// a group of n, at least one. Groups never span pictures, so a picture can
+// be rebuilt as soon as its own packets are in, well inside the jitter
+// buffer's gap wait and without a round trip.
+//
+// A repair packet is an RTP packet on the media SSRC with payload type
+// RTP_PAYLOAD_TYPE_FEC and a sequence of its own, carrying:
+//   base seq  u16 BE  first media sequence number of the group
+//   count     u8      source packets in the group (consecutive)
+//   repairs   u8      repair packets sent for the group
+//   row       u8      this packet's repair row
+//   reserved  u8      0
+//   repair symbol
+// Source symbol j is media packet base + j, whole (RTP header included),
+// behind its length (u16 BE) and zero-padded to the size of the group's
+// largest; the repair symbols have that same size.
+#define RTP_PAYLOAD_TYPE_FEC 98
+#define RTP_FEC_HEADER_SIZE 6
+
+// How much larger a repair packet is than the largest packet it protects
+#define RTP_FEC_OVERHEAD (RTP_HEADER_SIZE + RTP_FEC_HEADER_SIZE + 2)
+
+// Sender side: repair packets for one picture at a time
+class RtpFecEncoder {
+public:
+  // `m` repair packets per `k` source packets (Fec.h limits)
+  RtpFecEncoder(uint32_t ssrc, int k, int m);
+
+  // Packets given to add() must stay valid until finish_picture(), which
+  // builds the repair packets
+  void begin_picture(uint32_t rtpTimestamp);
+  void add(const uint8_t *packet, size_t size);
+  void finish_picture();
+
+  size_t packet_count() const { return m_used; }
+  const std::vector<uint8_t> &packet(size_t i) const { return m_packets[i]; }
+
+private:
+  void protect_group(size_t first, size_t count);
+
+  uint32_t m_ssrc;
+  int m_k;
+  int m_m;
+  uint16_t m_seq;
+  uint32_t m_timestamp;
+  std::vector<const uint8_t *> m_sources;
+  std::vector<size_t> m_sourceSizes;
+  std::vector<uint8_t> m_symbols; // Source symbols of the current group
+  std::vector<std::vector<uint8_t>> m_packets; // Reused across pictures
+  size_t m_used;
+};
+
+// Receiver side: keeps the recent media packets of one stream and rebuilds
+// missing ones as repair packets make that possible. Not thread safe.
+class RtpFecDecoder {
+public:
+  RtpFecDecoder();
+
+  void reset();
+
+  // A repair packet has been seen: the sender is using FEC
+  bool active() const { return m_active; }
+
+  // Both may rebuild media packets, which are then listed in rebuilt()
+  // until the next call
+  void add_media(const uint8_t *packet, size_t size, uint16_t seq);
+  void add_repair(const uint8_t *packet, size_t size,
+                  const RtpHeader &header);
+
+  size_t rebuilt_count() const { return m_rebuiltCount; }
+  const std::vector<uint8_t> &rebuilt(size_t i) const { return m_rebuilt[i]; }
+
+  // Media packets still missing from groups that were given up
+  uint64_t unrecovered() const { return m_unrecovered; }
+
+private:
+  struct Stored {
+    std::vector<uint8_t> data;
+    uint16_t seq = 0;
+    bool valid = false;
+  };
+
+  struct Group {
+    bool used = false;
+    bool done = false; // Complete, rebuilt, or found inconsistent
+    uint16_t base = 0;
+    int count = 0;
+    size_t symbol_size = 0;
+    std::vector<std::vector<uint8_t>> repairs; // By row
+    std::vector<int> rows;                     // Rows received
+  };
+
+  const Stored *find(uint16_t seq) const;
+  Stored &store(const uint8_t *packet, size_t size, uint16_t seq);
+  int missing(const Group &group) const;
+  void retire(Group &group);
+  void try_rebuild(Group &group);
+
+  bool m_active;
+  std::vector<Stored> m_history; // By sequence number
+  std::vector<Group> m_groups;   // Recent groups, oldest replaced first
+  size_t m_nextGroup;
+  std::vector<uint8_t> m_work; // Symbols of the group being rebuilt
+  std::vector<std::vector<uint8_t>> m_rebuilt;
+  size_t m_rebuiltCount;
+  uint64_t m_unrecovered;
+};
+
+#endif // RTP_FEC_H
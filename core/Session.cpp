@@ -0,0 +1,409 @@
+#include "Session.h"
+#include "Log.h"
+#include "WorkerPool.h"
+#include <iomanip>
+#include <sstream>
+
+// Units decoded per run_slice(); bounds how long one busy session can hold
+// a worker while others wait
+static const int SLICE_UNITS = 4;
+
+static int64_t steady_now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Can start decoding: the decoder needs nothing from before it
+static bool is_sync_point(const AccessUnit &au) {
+  return au.has(NAL_SPS) || au.is_keyframe();
+}
+
+Session::Session(int index, const ClockSync *clock, WorkerPool *workers)
+    : m_index(index), m_tag("[S" + std::to_string(index) + "] "),
+      m_workers(workers), m_decoder(&m_pool, &m_bus, clock),
+      m_policy(QUEUE_DROP_TO_KEYFRAME), m_queue(nullptr), m_open(false),
+      m_scheduled(false), m_stalled(false), m_assembler(&m_pool),
+      m_resyncPending(false), m_generation(0), m_decoderThreads(0),
+      m_decodedGeneration(0), m_profile(DECODE_ULTRA_LOW_LATENCY),
+      m_awaitKeyframe(false),
+      m_skipAgeUs(0), m_skipDropped(0), m_skipRequested(false),
+      m_nonRefDropped(0), m_skips(0), m_connected(false),
+      m_socket(INVALID_SOCKET_VALUE), m_ringBufferedBytes(0),
+      m_queuedBytes(0), m_droppedUnits(0), m_lastPoolAllocs(0),
+      m_lastPoolCopied(0) {}
+
+Session::~Session() {
+  drain();
+  delete m_queue;
+}
+
+bool Session::open(size_t queueDepth, QueueDropPolicy policy) {
+  if (!m_bus.create(m_index) || !m_decoder.open())
+    return false;
+
+  m_policy = policy;
+  m_queue = new SpscQueue<PacketDesc>(queueDepth);
+  m_lastMetricTime = std::chrono::steady_clock::now();
+  m_open = true;
+  return true;
+}
+
+void Session::drain() {
+  if (!m_queue)
+    return;
+  while (PacketDesc *pkt = m_queue->front()) {
+    release_access_unit(&pkt->au);
+    m_queue->pop();
+  }
+  m_queuedBytes = 0;
+}
+
+// Hands the session to a worker unless one already has it
+void Session::notify() {
+  if (!m_scheduled.exchange(true))
+    m_workers->schedule(this);
+}
+
+void Session::run_slice() {
+  for (int i = 0; i < SLICE_UNITS; i++) {
+    PacketDesc *pkt = m_queue->front();
+    if (!pkt)
+      break;
+
+    // First unit of a new connection: reset decoder state
+    DecodeProfile profile = (DecodeProfile)m_profile.load();
+    if (pkt->generation != m_decodedGeneration) {
+      m_decoder.set_thread_count(pkt->decoder_threads);
+      m_decoder.set_profile(profile);
+      m_decoder.reset_stream();
+      m_decodedGeneration = pkt->generation;
+      m_awaitKeyframe = false;
+    }
+    if (m_budget.enabled() && !govern_latency(pkt))
+      continue; // Dropped instead
+    if (profile != m_decoder.profile() && pkt->au.is_keyframe()) {
+      m_decoder.set_profile(profile);
+      m_decoder.restart();
+      log_msg(m_tag + "Decode profile: " + decode_profile_name(profile) +
+              "\n");
+    }
+    m_decoder.decode(pkt->au);
+
+    // Log Every 30 Frames (~0.5 sec)
+    if (m_decoder.stats().frames >= 30)
+      log_metrics();
+    pop_front();
+  }
+
+  // A unit published after our last front() saw m_scheduled still set and
+  // did not reschedule, so check again once the flag is down
+  m_scheduled.store(false);
+  if (m_queue->size() > 0)
+    notify();
+}
+
+void Session::log_metrics() {
+  const DecodeStats &stats = m_decoder.stats();
+  auto nowSteady = std::chrono::steady_clock::now();
+  long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            nowSteady - m_lastMetricTime)
+                            .count();
+  if (elapsedMs > 0) {
+    double fps = (stats.frames * 1000.0) / elapsedMs;
+    double avgDecode = (stats.decode_us / 1000.0) / stats.frames;
+    double avgRender = (stats.render_us / 1000.0) / stats.frames;
+    double avgE2E = stats.e2e_ms / stats.frames;
+    double avgInOut = stats.in_out_frames
+                          ? stats.in_out_us / 1000.0 / stats.in_out_frames
+                          : 0;
+    double overlapPct =
+        stats.band_frames ? 100.0 * stats.overlap_sum / stats.band_frames
+                          : 0;
+    double nalsPerUnit =
+        stats.units ? (double)stats.nals / stats.units : 0;
+
+    // Bitstream allocations/copies per access unit since last line
+    uint64_t poolAllocs = m_pool.allocations();
+    uint64_t poolCopied = m_pool.bytes_copied();
+    double allocsPerUnit =
+        stats.units ? (double)(poolAllocs - m_lastPoolAllocs) / stats.units
+                    : 0;
+    double copiedKBPerUnit =
+        stats.units ? (poolCopied - m_lastPoolCopied) / 1024.0 / stats.units
+                    : 0;
+    m_lastPoolAllocs = poolAllocs;
+    m_lastPoolCopied = poolCopied;
+
+    // Check Pending Network Bytes (Latency Indicator)
+    double pendingKB = socket_pending_bytes(m_socket.load()) / 1024.0;
+    double ringKB = m_ringBufferedBytes.load() / 1024.0;
+
+    std::stringstream ss;
+    ss << "[Metrics] S" << m_index << " | FPS: " << std::fixed
+       << std::setprecision(1) << fps << " | E2E Latency: "
+       << std::setprecision(1) << avgE2E << "ms"
+       << " | Decode: " << std::setprecision(2) << avgDecode << "ms"
+       << " (in-out " << avgInOut << "ms, "
+       << decode_profile_name(m_decoder.profile()) << ")"
+       << " | Render: " << std::setprecision(2) << avgRender << "ms";
+    if (stats.band_frames) {
+      // Conversion done inside the decoder, per banded picture
+      ss << " (overlap " << std::setprecision(0) << overlapPct << "%, "
+         << stats.band_frames << "/" << stats.frames << " banded)";
+    }
+    ss << " | Queue: " << std::setprecision(1) << pendingKB << " KB"
+       << " | Ring: " << ringKB << " KB"
+       << " | DecQ: " << m_queue->size() << "/" << m_queue->capacity()
+       << " | Dropped: " << m_droppedUnits.exchange(0);
+    if (m_budget.enabled()) {
+      ss << " | Late skipped: " << m_nonRefDropped << " (" << m_skips
+         << " to IDR)";
+    }
+    ss << " | NAL/AU: " << std::setprecision(1) << nalsPerUnit
+       << " | Alloc/AU: " << std::setprecision(2) << allocsPerUnit
+       << " | Copy/AU: " << std::setprecision(1) << copiedKBPerUnit
+       << " KB\n";
+    log_msg(ss.str());
+  }
+
+  // Reset
+  m_decoder.reset_stats();
+  m_lastMetricTime = nowSteady;
+  m_nonRefDropped = m_skips = 0;
+}
+
+// Consumer: done with the head unit, decoded or not
+void Session::pop_front() {
+  PacketDesc *pkt = m_queue->front();
+  m_queuedBytes -= pkt->queued_bytes;
+  release_access_unit(&pkt->au); // No-op unless decoding bailed early
+  m_queue->pop();
+
+  // Pairs with the fence in wait_for_slot(): either the producer sees the
+  // freed slot or we see its stall flag
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_stalled.load() && m_stalled.exchange(false) && m_onResume)
+    m_onResume();
+}
+
+// Time spent in the decode queue. Measured on our clock only, so a bad
+// clock sync cannot make pictures look stale; a backlog further upstream
+// shows in the byte count instead.
+int64_t Session::unit_age_us(const PacketDesc &pkt) const {
+  return steady_now_us() - pkt.queued_us;
+}
+
+bool Session::over_budget(int64_t ageUs) const {
+  if (m_budget.max_age_us > 0 && ageUs > m_budget.max_age_us)
+    return true;
+  if (m_budget.max_backlog_bytes == 0)
+    return false;
+  size_t backlog = (size_t)socket_pending_bytes(m_socket.load()) +
+                   m_ringBufferedBytes.load() + m_queuedBytes.load();
+  return backlog > m_budget.max_backlog_bytes;
+}
+
+// Consumer: returns false if the head unit `pkt` was dropped (and popped)
+// instead of being left for decoding
+bool Session::govern_latency(PacketDesc *pkt) {
+  int64_t ageUs = unit_age_us(*pkt);
+  if (m_awaitKeyframe) {
+    if (!is_sync_point(pkt->au)) {
+      m_skipDropped++;
+      pop_front();
+      return false;
+    }
+    m_awaitKeyframe = false;
+    log_skip(ageUs);
+    return true;
+  }
+  if (!over_budget(ageUs) || is_sync_point(pkt->au))
+    return true; // In budget, or already as far ahead as the queue goes
+
+  // Newest keyframe of this connection already queued: jump to it
+  size_t target = 0;
+  for (size_t i = 1; PacketDesc *p = m_queue->peek(i); i++) {
+    if (p->generation != pkt->generation)
+      break;
+    if (is_sync_point(p->au))
+      target = i;
+  }
+  if (target > 0) {
+    m_skipAgeUs = ageUs;
+    m_skipRequested = false;
+    for (size_t i = 0; i < target; i++)
+      pop_front();
+    m_skipDropped = (uint32_t)target;
+    m_skips++;
+    log_skip(unit_age_us(*m_queue->front()));
+    return false;
+  }
+
+  // Nothing references it: dropping it costs one picture and no artefacts
+  if (!pkt->au.reference) {
+    m_nonRefDropped++;
+    pop_front();
+    return false;
+  }
+
+  // No keyframe to jump to yet: drop everything up to the next one
+  m_awaitKeyframe = true;
+  m_skipAgeUs = ageUs;
+  m_skipDropped = 1;
+  m_skipRequested = m_onKeyframeRequest != nullptr;
+  m_skips++;
+  pop_front();
+  if (m_onKeyframeRequest)
+    m_onKeyframeRequest();
+  return false;
+}
+
+// `ageUs`: age of the keyframe decoding resumes with
+void Session::log_skip(int64_t ageUs) {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1) << m_tag
+     << "Latency budget exceeded (" << m_skipAgeUs / 1000.0
+     << "ms behind): skipped " << m_skipDropped
+     << (m_skipDropped == 1 ? " picture" : " pictures")
+     << " to the newest keyframe"
+     << (m_skipRequested ? " (requested)" : "") << ", recovered "
+     << (m_skipAgeUs - ageUs) / 1000.0 << "ms\n";
+  log_msg(ss.str());
+}
+
+// Producer, QUEUE_BLOCK only: true if the next submit will find a slot.
+// Otherwise flags the stall so the worker that frees one calls the resume
+// callback.
+bool Session::wait_for_slot() {
+  if (m_policy != QUEUE_BLOCK || m_queue->prepare())
+    return true;
+  m_stalled.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!m_queue->prepare())
+    return false;
+  // Freed meanwhile. If the worker already took the flag, the resume it
+  // sends is redundant but harmless.
+  m_stalled.store(false);
+  return true;
+}
+
+// Producer: moves the pending access unit into the next free slot. Never
+// waits: under QUEUE_BLOCK the caller made sure of a slot; under
+// QUEUE_DROP_TO_KEYFRAME a dropped picture breaks the reference chain, so
+// everything up to the next SPS/IDR goes with it.
+void Session::submit_access_unit() {
+  if (m_assembler.empty())
+    return;
+
+  const AccessUnit &au = m_assembler.pending();
+  if (m_resyncPending) {
+    if (!au.has(NAL_SPS) && !au.is_keyframe()) {
+      m_droppedUnits++;
+      m_assembler.discard();
+      return;
+    }
+    m_resyncPending = false;
+  }
+
+  PacketDesc *slot = m_queue->prepare();
+  if (!slot) {
+    m_droppedUnits++;
+    m_resyncPending = true;
+    m_assembler.discard();
+    return;
+  }
+
+  slot->generation = m_generation;
+  slot->decoder_threads = m_decoderThreads;
+  slot->queued_us = steady_now_us();
+  m_assembler.take(&slot->au);
+  slot->queued_bytes = slot->au.size;
+  m_queuedBytes += slot->queued_bytes;
+  m_queue->publish();
+  notify();
+}
+
+void Session::begin_stream(const std::string &peer, socket_t socket,
+                           int decoderThreads) {
+  // New Connection: Reset Stream State (the worker resets the decoder when
+  // the first unit of this generation reaches it)
+  m_generation++;
+  m_decoderThreads = decoderThreads;
+  m_socket = socket;
+
+  log_msg(m_tag + "Connected: " + peer + "\n");
+  m_ring.reset();
+  m_assembler.discard();
+  m_resyncPending = false;
+  m_stalled = false;
+  m_connected = true;
+}
+
+// Queues every complete frame buffered in the ring. Payload views are only
+// valid until the next prepare().
+IngestStatus Session::process() {
+  WireFrame frame;
+  RecvRing::ParseResult res = RecvRing::NEED_MORE;
+  for (;;) {
+    // The next frame may close the pending picture; leave it in the ring
+    // until that picture has somewhere to go
+    if (!m_assembler.empty() && !wait_for_slot())
+      return INGEST_STALLED;
+    if ((res = m_ring.next(&frame)) != RecvRing::FRAME_READY)
+      break;
+    if (m_onNal)
+      m_onNal(frame.timestamp_us, frame.size + WIRE_HEADER_SIZE);
+    if (frame.size == 0) {
+      // End-of-picture marker: close the picture now rather than on the
+      // next picture's first NAL. An empty ring is no such signal; the
+      // phone sends every NAL on its own and a recv() can end mid-picture.
+      end_access_unit();
+      continue;
+    }
+    push_nal(frame.payload, frame.size, frame.timestamp_us);
+  }
+  m_ringBufferedBytes = (uint32_t)m_ring.buffered();
+
+  if (res == RecvRing::FRAME_OVERSIZED) {
+    log_err(m_tag + "Oversized packet. Dropping connection.\n");
+    return INGEST_CORRUPT;
+  } else if (res == RecvRing::FRAME_TOO_SMALL) {
+    log_err(m_tag + "Packet too small (no timestamp).\n");
+    return INGEST_CORRUPT;
+  }
+  return INGEST_OK;
+}
+
+void Session::push_nal(const uint8_t *nal, uint32_t size,
+                       uint64_t timestampUs) {
+  if (m_assembler.starts_new_unit(nal, size, timestampUs)) {
+    submit_access_unit();
+  }
+  if (!m_assembler.append(nal, size, timestampUs)) {
+    // Out of memory: lose this picture and resync at the next IDR
+    m_droppedUnits++;
+    m_resyncPending = true;
+  }
+}
+
+void Session::end_access_unit() {
+  if (m_assembler.pending().has_slices())
+    submit_access_unit();
+}
+
+// The rest of the picture (and every picture predicting from it) would
+// decode to garbage; skip to the next SPS/IDR instead
+void Session::drop_access_unit() {
+  if (!m_assembler.empty())
+    m_assembler.discard();
+  m_droppedUnits++;
+  m_resyncPending = true;
+}
+
+void Session::end_stream() {
+  log_msg(m_tag + "Disconnected.\n");
+  m_socket = INVALID_SOCKET_VALUE;
+  m_ringBufferedBytes = 0;
+  m_connected = false;
+}
@@ -0,0 +1,227 @@
+#pragma once
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "AccessUnit.h"
+#include "Decoder.h"
+#include "FrameBus.h"
+#include "PacketPool.h"
+#include "Platform.h"
+#include "RecvRing.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+class ClockSync;
+class WorkerPool;
+
+// Network -> Decode pipeline
+// The ingest side only parses frames and queues them; decoding, colour
+// conversion and the shared-memory write run on a pool worker.
+struct PacketDesc {
+  AccessUnit au;         // One picture (plus any headers), Annex B
+  uint32_t generation;   // Connection it came from; a change resets decoder
+  int decoder_threads;   // FFmpeg threads for that connection
+  int64_t queued_us;     // steady_clock time it was queued
+  uint32_t queued_bytes; // au.size when queued; decode() may prepend headers
+};
+
+// Latency governor: how stale a session may get before the worker stops
+// decoding in order and skips ahead to the newest keyframe
+struct LatencyBudget {
+  int64_t max_age_us = 0;       // Oldest picture's decode queue wait; 0 = none
+  size_t max_backlog_bytes = 0; // Socket + ring + decode queue; 0 = none
+  bool enabled() const { return max_age_us > 0 || max_backlog_bytes > 0; }
+};
+
+enum IngestStatus {
+  INGEST_OK,      // Everything buffered was parsed; read more
+  INGEST_STALLED, // QUEUE_BLOCK and the queue is full: stop reading until
+                  // the resume callback fires, then call process()
+  INGEST_CORRUPT  // Drop the connection
+};
+
+enum QueueDropPolicy {
+  QUEUE_DROP_TO_KEYFRAME, // Queue full: drop, then skip to the next SPS/IDR
+  QUEUE_BLOCK             // Queue full: stall the socket (lossless
+                          // unless a LatencyBudget is set)
+};
+
+// Everything one phone needs from socket to frame bus: its parser, a decode
+// queue, decoder + converter and a frame bus of its own. Sessions are
+// reused: a reconnecting phone gets the first free one, and with it the
+// same bus name.
+//
+// Producer side (begin_stream .. end_stream) is driven by one ingest thread
+// at a time (the reactor, or the replay thread); the consumer side
+// (run_slice) by whichever pool worker picked the session up. Neither side
+// ever waits for the other.
+//
+// With a LatencyBudget the worker checks the picture at the head of the
+// queue before decoding it. Once the budget is exceeded (the picture
+// waited too long, or too many bytes are backed up behind it) it jumps to the
+// newest keyframe already queued. Without one it drops non-reference
+// pictures, and if that is not enough, everything up to the next keyframe,
+// which the keyframe request callback can ask the phone for.
+class Session {
+public:
+  Session(int index, const ClockSync *clock, WorkerPool *workers);
+  ~Session();
+
+  // Creates the frame bus and opens the decoder; once, before first use.
+  bool open(size_t queueDepth, QueueDropPolicy policy);
+  bool is_open() const { return m_open.load(); }
+
+  // Releases whatever is still queued. Workers must be stopped.
+  void drain();
+
+  int index() const { return m_index; }
+
+  // --- Producer (ingest thread) ---
+
+  // `socket` is only used for the pending-bytes metric (may be invalid)
+  void begin_stream(const std::string &peer, socket_t socket,
+                    int decoderThreads);
+
+  // Writable tail of the receive ring; see RecvRing::prepare()
+  uint8_t *prepare(size_t *space) { return m_ring.prepare(space); }
+
+  // Marks `n` received bytes and queues every complete picture
+  IngestStatus commit(size_t n) {
+    m_ring.commit(n);
+    return process();
+  }
+
+  // Parses what is buffered; after INGEST_STALLED, call again on resume
+  // before reading more
+  IngestStatus process();
+
+  // Datagram transports (RTP), which deliver NAL units already split out.
+  // These never stall; use QUEUE_DROP_TO_KEYFRAME with them.
+  void push_nal(const uint8_t *nal, uint32_t size, uint64_t timestampUs);
+  void end_access_unit();  // Marker bit: the pending picture is complete
+  void drop_access_unit(); // Packets were lost: resync at the next keyframe
+
+  // Pictures are being dropped until the next SPS/IDR arrives
+  bool resync_pending() const { return m_resyncPending; }
+
+  void end_stream();
+
+  // --- Consumer (pool worker) ---
+
+  // Decodes up to a few queued units, then yields the worker
+  void run_slice();
+
+  // --- Any thread ---
+
+  bool connected() const { return m_connected.load(); }
+
+  // Access units waiting for (or being) decoded
+  size_t queued() const { return m_queue ? m_queue->size() : 0; }
+
+  SharedMemoryLayout *frame_layout() const {
+    return m_open ? m_bus.layout() : nullptr;
+  }
+
+  // Set before open(). Run on the worker thread after each frame.
+  void set_frame_callback(std::function<void()> callback) {
+    m_decoder.set_frame_callback(callback);
+  }
+
+  // Set before open(); off by default
+  void set_latency_budget(const LatencyBudget &budget) { m_budget = budget; }
+
+  // Set before open(); see Decoder::set_convert_pool
+  void set_convert_pool(ConvertPool *pool) { m_decoder.set_convert_pool(pool); }
+
+  // Set before open(); see Decoder::set_band_convert
+  void set_band_convert(bool enabled) { m_decoder.set_band_convert(enabled); }
+
+  // Any thread, any time: the worker switches the decoder over at the next
+  // keyframe (or new connection), so no picture loses its references
+  void set_decode_profile(DecodeProfile profile) { m_profile = profile; }
+
+  // Set before open(). Run on the worker thread when the latency governor
+  // needs a keyframe that is not queued yet; must not block.
+  void set_keyframe_request_callback(std::function<void()> callback) {
+    m_onKeyframeRequest = callback;
+  }
+
+  // Set before open(). Run on the worker thread once a stalled producer
+  // can continue; must not block.
+  void set_resume_callback(std::function<void()> callback) {
+    m_onResume = callback;
+  }
+
+  // Set before open(). Run on the producer for every wire frame parsed by
+  // process(), with its sender timestamp and size on the wire.
+  void set_nal_callback(std::function<void(uint64_t, uint32_t)> callback) {
+    m_onNal = callback;
+  }
+
+private:
+  void notify();
+  bool wait_for_slot();
+  void submit_access_unit();
+  void log_metrics();
+
+  // Consumer: latency governor
+  void pop_front();
+  bool govern_latency(PacketDesc *pkt);
+  bool over_budget(int64_t ageUs) const;
+  int64_t unit_age_us(const PacketDesc &pkt) const;
+  void log_skip(int64_t ageUs);
+
+  int m_index;
+  std::string m_tag; // "[S<n>] " log prefix
+  WorkerPool *m_workers;
+
+  PacketPool m_pool;
+  FrameBus m_bus;
+  Decoder m_decoder;
+
+  QueueDropPolicy m_policy;
+  SpscQueue<PacketDesc> *m_queue;
+  std::atomic<bool> m_open;
+  std::atomic<bool> m_scheduled; // On the ready list or running
+  std::atomic<bool> m_stalled;   // Producer waits for a free queue slot
+  std::function<void()> m_onResume;
+  std::function<void(uint64_t, uint32_t)> m_onNal;
+  std::function<void()> m_onKeyframeRequest;
+
+  // Producer state, reused across connections so ingest never allocates
+  RecvRing m_ring;
+  AccessUnitAssembler m_assembler;
+  bool m_resyncPending;
+  uint32_t m_generation; // Bumped by begin_stream()
+  int m_decoderThreads;
+
+  // Consumer state
+  uint32_t m_decodedGeneration;
+  std::atomic<int> m_profile; // DecodeProfile wanted
+
+  // Latency governor (consumer)
+  LatencyBudget m_budget;
+  bool m_awaitKeyframe;    // Queue flushed: drop until an SPS/IDR
+  int64_t m_skipAgeUs;     // Head picture's age when the skip began
+  uint32_t m_skipDropped;  // Pictures dropped by this skip so far
+  bool m_skipRequested;    // ... and whether a keyframe was asked for
+  uint32_t m_nonRefDropped; // Non-reference pictures dropped, per metric line
+  uint32_t m_skips;         // Skips to a keyframe, per metric line
+
+  // Pipeline metrics shared between the two stages
+  std::atomic<bool> m_connected;
+  std::atomic<socket_t> m_socket;
+  std::atomic<uint32_t> m_ringBufferedBytes;
+  std::atomic<uint32_t> m_queuedBytes; // Decode queue
+  std::atomic<uint32_t> m_droppedUnits;
+
+  // Consumer metric window
+  std::chrono::steady_clock::time_point m_lastMetricTime;
+  uint64_t m_lastPoolAllocs;
+  uint64_t m_lastPoolCopied;
+};
+
+#endif // SESSION_H
@@ -0,0 +1,72 @@
+#pragma once
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue.
+//
+// Slots are allocated once and filled in place (prepare/publish on the
+// producer, front/pop on the consumer), so elements that own buffers keep
+// their capacity across laps and the steady state never allocates. Push and
+// pop are lock-free; waking the consumer is up to the caller.
+template <typename T> class SpscQueue {
+public:
+  explicit SpscQueue(size_t depth)
+      : m_slots(depth ? depth : 1), m_head(0), m_tail(0) {}
+
+  size_t capacity() const { return m_slots.size(); }
+
+  size_t size() const {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+
+  // Producer: slot to fill, or nullptr if the queue is full.
+  T *prepare() {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) >= m_slots.size())
+      return nullptr;
+    return &m_slots[tail % m_slots.size()];
+  }
+
+  // Producer: makes the slot returned by prepare() visible to the consumer.
+  void publish() {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // Consumer: oldest element, or nullptr if the queue is empty.
+  T *front() {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+      return nullptr;
+    return &m_slots[head % m_slots.size()];
+  }
+
+  // Consumer: the i-th oldest element (0 is front()), or nullptr past the
+  // newest one.
+  T *peek(size_t i) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (m_tail.load(std::memory_order_acquire) - head <= i)
+      return nullptr;
+    return &m_slots[(head + i) % m_slots.size()];
+  }
+
+  // Consumer: releases the slot returned by front() back to the producer.
+  void pop() {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+private:
+  std::vector<T> m_slots;
+
+  // Producer and consumer indices on separate cache lines
+  alignas(64) std::atomic<size_t> m_head;
+  alignas(64) std::atomic<size_t> m_tail;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,841 @@
+#include "StreamReceiver.h"
+#include "ClockSync.h"
+#include "Feedback.h"
+#include "Log.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+
+// A connection silent for this long is dead (5 seconds)
+static const int SOCKET_TIMEOUT_MS = 5000;
+static const int WATCHDOG_PERIOD_MS = 1000;
+
+// recv() calls per readiness event; a phone with more pending yields to the
+// other sockets and is picked up again on the next pass
+static const int MAX_CHUNKS_PER_WAKEUP = 8;
+static const int MAX_DATAGRAMS_PER_WAKEUP = 64;
+
+// Unlike TCP, a small UDP buffer does not lower latency, it drops packets
+static const int RTP_RECV_BUFFER = 4 * 1024 * 1024;
+
+// Repeat a keyframe request this often until one arrives; the phone needs
+// a round trip plus an encode to answer
+static const int64_t PLI_RETRY_US = 250000;
+
+// With FEC in use, a gap is only NACKed once the rest of its group and the
+// repair packets behind it have had time to arrive
+static const int64_t FEC_NACK_HOLD_US = 4000;
+
+static int64_t steady_now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The picture's capture time. Without the extension the RTP clock still
+// separates the pictures; only the latency figures lose their meaning.
+static uint64_t rtp_send_time_us(const RtpHeader &header) {
+  return header.has_capture_time
+             ? header.capture_us
+             : (uint64_t)header.timestamp * 1000000 / RTP_CLOCK_RATE;
+}
+
+StreamReceiver::StreamReceiver(const ClockSync *clock)
+    : m_clock(clock), m_activeSessions(0),
+      m_decodeProfile(DECODE_ULTRA_LOW_LATENCY), m_running(false),
+      m_reactor(nullptr), m_listenSocket(INVALID_SOCKET_VALUE),
+      m_rejectedSsrc(0), m_feedbackPort(0), m_lossFeedback(true),
+      m_rateControl(false), m_feedbackSocket(INVALID_SOCKET_VALUE),
+      m_watchdog(0),
+      m_replayPacing(REPLAY_REALTIME), m_replayShiftUs(0),
+      m_replayFinished(false) {}
+
+StreamReceiver::~StreamReceiver() { stop(); }
+
+bool StreamReceiver::start(Reactor *reactor, uint16_t port,
+                           const SessionConfig &config) {
+  bool rtp = config.transport == TRANSPORT_RTP;
+  m_listenSocket = rtp ? udp_bind(port) : tcp_listen(port, config.max_sessions);
+  if (m_listenSocket == INVALID_SOCKET_VALUE) {
+    log_err("Bind failed on port " + std::to_string(port) + ".\n");
+    return false;
+  }
+  socket_set_nonblocking(m_listenSocket);
+  m_reactor = reactor;
+
+  // RTP feedback leaves from the video port; TCP needs a datagram socket
+  if (rtp) {
+    m_feedbackSocket = m_listenSocket;
+  } else if (m_feedbackPort) {
+    m_feedbackSocket = udp_bind(0);
+    if (m_feedbackSocket == INVALID_SOCKET_VALUE)
+      log_err("No feedback socket; rate control and keyframe requests "
+              "disabled\n");
+  }
+
+  SessionConfig sessionConfig = config;
+  if (rtp) {
+    int bufSize = RTP_RECV_BUFFER;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_RCVBUF, (const char *)&bufSize,
+               sizeof(bufSize));
+    m_datagram.resize(65536);
+    sessionConfig.queue_policy = QUEUE_DROP_TO_KEYFRAME;
+    if (!m_captureDir.empty()) {
+      log_err("Capture records the TCP stream only; ignored for RTP\n");
+      m_captureDir.clear();
+    }
+  }
+
+  // Session 0 is created up front so its frame bus exists before any phone
+  // connects, as the virtual camera expects
+  if (!start_sessions(sessionConfig) || !open_session(0)) {
+    stop();
+    return false;
+  }
+
+  if (!m_captureDir.empty()) {
+    make_directory(m_captureDir);
+    log_msg("Capturing wire data to " + m_captureDir + "\n");
+  }
+
+  if (rtp) {
+    m_reactor->add(m_listenSocket, REACTOR_READ,
+                   [this](uint32_t) { on_datagrams(); });
+  } else {
+    m_reactor->add(m_listenSocket, REACTOR_READ,
+                   [this](uint32_t) { on_accept(); });
+  }
+  log_msg(std::string(rtp ? "Waiting for RTP/UDP" : "Waiting for connection") +
+          " on port " + std::to_string(port) + " (" +
+          std::to_string(m_config.max_sessions) + " sessions, " +
+          std::to_string(m_workers.size()) + " decode workers)...\n");
+  return true;
+}
+
+bool StreamReceiver::start_replay(const std::string &path,
+                                  ReplayPacing pacing,
+                                  const SessionConfig &config) {
+  std::string error;
+  if (!m_replay.open(path, &error)) {
+    log_err("Replay: " + error + "\n");
+    return false;
+  }
+
+  SessionConfig replayConfig = config;
+  if (pacing == REPLAY_FAST) {
+    replayConfig.queue_policy = QUEUE_BLOCK;
+    replayConfig.latency = LatencyBudget(); // Every picture, however late
+  }
+  if (!start_sessions(replayConfig) || !open_session(0)) {
+    stop();
+    return false;
+  }
+
+  m_replayPacing = pacing;
+  m_replayShiftUs = clock_now_us() - m_replay.first_arrival_us();
+  m_replayFinished = false;
+  m_replayThread = std::thread(&StreamReceiver::replay_thread_func, this);
+  log_msg("Replaying " + path +
+          (pacing == REPLAY_FAST ? " (fast)\n" : " (real time)\n"));
+  return true;
+}
+
+bool StreamReceiver::start_sessions(const SessionConfig &config) {
+  m_config = config;
+  m_config.max_sessions =
+      std::max(1, std::min(config.max_sessions, FRAME_BUS_MAX_SESSIONS));
+
+  m_decodeProfile = m_config.decode_profile;
+  m_sessions.clear();
+  for (int i = 0; i < m_config.max_sessions; i++) {
+    m_sessions.emplace_back(new Session(i, m_clock, &m_workers));
+    m_sessions.back()->set_latency_budget(m_config.latency);
+    m_sessions.back()->set_decode_profile(m_config.decode_profile);
+    m_sessions.back()->set_band_convert(m_config.band_convert);
+    m_sessions.back()->set_convert_pool(&m_convert);
+    m_sessions.back()->set_frame_callback([this, i]() {
+      if (m_onFrame)
+        m_onFrame(i);
+    });
+    // A QUEUE_BLOCK session that stalled its socket continues on the
+    // reactor thread
+    if (m_reactor) {
+      m_sessions.back()->set_resume_callback([this, i]() {
+        m_reactor->post([this, i]() { on_resume(i); });
+      });
+      m_sessions.back()->set_keyframe_request_callback([this, i]() {
+        m_reactor->post([this, i]() { request_keyframe(i); });
+      });
+      m_sessions.back()->set_nal_callback(
+          [this, i](uint64_t timestampUs, uint32_t size) {
+            on_wire_frame(i, timestampUs, size);
+          });
+    }
+  }
+  m_connections.reset(new Connection[m_config.max_sessions]);
+
+  // More workers than sessions would only sit idle
+  int workers = m_config.workers > 0
+                    ? m_config.workers
+                    : (int)std::thread::hardware_concurrency();
+  m_workers.start(std::max(1, std::min(workers, m_config.max_sessions)));
+  m_convert.start(m_config.convert_threads, m_config.convert_band_rows);
+  log_msg("Frame conversion pool: " + std::to_string(m_convert.threads()) +
+          " threads, " + std::to_string(m_convert.band_rows()) +
+          "-row bands\n");
+
+  m_running = true;
+  return true;
+}
+
+Session *StreamReceiver::open_session(int index) {
+  Session *session = m_sessions[index].get();
+  if (!session->is_open() &&
+      !session->open(m_config.queue_depth, m_config.queue_policy)) {
+    log_err("[S" + std::to_string(index) + "] Could not open session\n");
+    return nullptr;
+  }
+  return session;
+}
+
+// Cores split evenly between the phones streaming right now; FFmpeg's own
+// threads would otherwise oversubscribe the machine N times over
+int StreamReceiver::decoder_threads_per_session() const {
+  int active = std::max(1, m_activeSessions.load());
+  if (active == 1)
+    return 0; // Auto, as with a single phone before
+  int cores = (int)std::thread::hardware_concurrency();
+  return std::max(1, cores / active);
+}
+
+void StreamReceiver::stop() {
+  if (!m_running.exchange(false))
+    return;
+
+  if (m_replayThread.joinable())
+    m_replayThread.join();
+  if (m_reactor) {
+    for (int i = 0; i < m_config.max_sessions; i++) {
+      if (m_connections[i].active)
+        close_connection(i);
+    }
+    if (m_listenSocket != INVALID_SOCKET_VALUE)
+      m_reactor->remove(m_listenSocket);
+    m_reactor = nullptr;
+  }
+  if (m_feedbackSocket != INVALID_SOCKET_VALUE &&
+      m_feedbackSocket != m_listenSocket)
+    socket_close(m_feedbackSocket);
+  m_feedbackSocket = INVALID_SOCKET_VALUE;
+  if (m_listenSocket != INVALID_SOCKET_VALUE) {
+    socket_close(m_listenSocket);
+    m_listenSocket = INVALID_SOCKET_VALUE;
+  }
+  m_replay.close();
+
+  // Workers own the codecs; stop them before the sessions go
+  m_workers.stop();
+  m_convert.stop();
+  m_sessions.clear(); // Releases whatever was still queued
+  m_connections.reset();
+}
+
+bool StreamReceiver::connected() const { return m_activeSessions.load() > 0; }
+
+void StreamReceiver::set_decode_profile(DecodeProfile profile) {
+  m_decodeProfile = profile;
+  for (auto &session : m_sessions)
+    session->set_decode_profile(profile);
+  log_msg(std::string("Decode profile: ") + decode_profile_name(profile) +
+          " (from the next keyframe)\n");
+}
+
+SharedMemoryLayout *StreamReceiver::frame_layout(int index) const {
+  if (index < 0 || index >= (int)m_sessions.size())
+    return nullptr;
+  return m_sessions[index]->frame_layout();
+}
+
+void StreamReceiver::on_accept() {
+  for (;;) {
+    sockaddr_in clientAddr;
+    socklen_t clientAddrLen = sizeof(clientAddr);
+    socket_t ClientSocket =
+        accept(m_listenSocket, (sockaddr *)&clientAddr, &clientAddrLen);
+    if (ClientSocket == INVALID_SOCKET_VALUE)
+      return; // Backlog drained (or a transient error; retried when ready)
+
+    char *clientIP = inet_ntoa(clientAddr.sin_addr);
+    std::string peer = std::string(clientIP) + ":" +
+                       std::to_string(ntohs(clientAddr.sin_port));
+
+    int index = free_slot();
+    Session *session = index >= 0 ? open_session(index) : nullptr;
+    if (!session) {
+      log_err("Rejected " + peer + ": all " +
+              std::to_string(m_config.max_sessions) + " sessions in use\n");
+      socket_close(ClientSocket);
+      continue;
+    }
+
+    socket_set_nonblocking(ClientSocket);
+
+    // Disable Nagle's Algorithm for Low Latency
+    int nodelay = 1;
+    if (setsockopt(ClientSocket, IPPROTO_TCP, TCP_NODELAY,
+                   (const char *)&nodelay, sizeof(nodelay)) < 0) {
+      log_msg("Warning: Could not set TCP_NODELAY\n");
+    } else {
+      log_msg("Low Latency Mode Enabled (TCP_NODELAY)\n");
+    }
+
+    // Minimize OS Receive Buffer (Reduce Latency)
+    int bufSize = 65536; // 64KB
+    if (setsockopt(ClientSocket, SOL_SOCKET, SO_RCVBUF, (const char *)&bufSize,
+                   sizeof(int)) < 0) {
+      log_msg("Warning: Could not set SO_RCVBUF\n");
+    } else {
+      log_msg("Receive Buffer limited to 64KB\n");
+    }
+
+    Connection &conn = m_connections[index];
+    conn.feedback_addr = clientAddr;
+    conn.feedback_addr.sin_port = htons(m_feedbackPort);
+    open_connection(index, peer, ClientSocket);
+    watch_socket(index);
+  }
+}
+
+// Lowest free slot, so a phone that reconnects gets its bus back
+int StreamReceiver::free_slot() const {
+  for (int i = 0; i < m_config.max_sessions; i++) {
+    if (!m_connections[i].active)
+      return i;
+  }
+  return -1;
+}
+
+// `socket` is the phone's own TCP socket, or invalid for RTP
+void StreamReceiver::open_connection(int index, const std::string &peer,
+                                     socket_t socket) {
+  Connection &conn = m_connections[index];
+  conn.active = true;
+  conn.peer = peer;
+  conn.socket = socket;
+  conn.last_rx = std::chrono::steady_clock::now();
+  conn.stalled = false;
+  conn.hung_up = false;
+  conn.bwe.reset();
+  conn.last_pli_us = 0;
+  conn.plis = 0;
+  if (!m_captureDir.empty()) {
+    std::string path = log_timestamped_path(
+        m_captureDir, "capture_s" + std::to_string(index) + "_", ".agcw");
+    if (conn.capture.open(path)) {
+      log_msg("Capture: " + path + "\n");
+      conn.capture.write(CAPTURE_CONNECT, clock_now_us(), nullptr, 0);
+    } else {
+      log_err("Could not create capture " + path + "\n");
+    }
+  }
+
+  m_activeSessions++;
+  m_sessions[index]->begin_stream(peer, socket, decoder_threads_per_session());
+  if (m_onConnection)
+    m_onConnection(index, true);
+
+  if (!m_watchdog) {
+    m_watchdog = m_reactor->add_timer(WATCHDOG_PERIOD_MS, WATCHDOG_PERIOD_MS,
+                                      [this]() {
+                                        check_timeouts();
+                                        log_rtp_stats();
+                                        log_rate_stats();
+                                      });
+  }
+}
+
+void StreamReceiver::watch_socket(int index) {
+  m_reactor->add(m_connections[index].socket, REACTOR_READ,
+                 [this, index](uint32_t events) {
+                   on_readable(index, events);
+                 });
+}
+
+// Pull whole chunks into the ring and parse them in place
+void StreamReceiver::on_readable(int index, uint32_t events) {
+  Connection &conn = m_connections[index];
+  Session *session = m_sessions[index].get();
+  if (conn.stalled) {
+    // Interest 0 does not mask hangups. The ring is full (recv would
+    // return 0), and closing now would drop the frames it holds, so leave
+    // the reactor until on_resume has drained it.
+    if (events & REACTOR_HANGUP) {
+      conn.hung_up = true;
+      m_reactor->remove(conn.socket);
+    }
+    return;
+  }
+  for (int chunk = 0; chunk < MAX_CHUNKS_PER_WAKEUP; chunk++) {
+    size_t space = 0;
+    uint8_t *dst = session->prepare(&space);
+    int r = (int)recv(conn.socket, (char *)dst, (int)space, 0);
+    if (r < 0 && socket_would_block())
+      return;
+    if (r <= 0) {
+      close_connection(index);
+      return;
+    }
+    conn.last_rx = std::chrono::steady_clock::now();
+    if (conn.capture.is_open())
+      conn.capture.write(CAPTURE_DATA, clock_now_us(), dst, (uint32_t)r);
+    if (!handle_ingest(index, session->commit(r)))
+      return;
+  }
+}
+
+// Every wire frame parsed off a TCP connection
+void StreamReceiver::on_wire_frame(int index, uint64_t timestampUs,
+                                   uint32_t size) {
+  if (!m_rateControl || m_feedbackSocket == INVALID_SOCKET_VALUE)
+    return;
+  int64_t nowUs = steady_now_us();
+  m_connections[index].bwe.on_packet((int64_t)timestampUs, nowUs, size);
+  send_rate_target(index, nowUs);
+}
+
+// The latency governor skipped to a keyframe that is not here yet. PLI
+// over RTP; over TCP the same message with SSRC 0.
+void StreamReceiver::request_keyframe(int index) {
+  Connection &conn = m_connections[index];
+  if (!conn.active || !m_feedbackPort || !m_lossFeedback ||
+      m_feedbackSocket == INVALID_SOCKET_VALUE)
+    return;
+  int64_t nowUs = steady_now_us();
+  if (nowUs - conn.last_pli_us < PLI_RETRY_US)
+    return;
+  send_agcm(conn, agcm_build_pli(conn.ssrc));
+  conn.last_pli_us = nowUs;
+  conn.plis++;
+}
+
+// A worker freed a queue slot for a stalled session
+void StreamReceiver::on_resume(int index) {
+  Connection &conn = m_connections[index];
+  if (!conn.active || !conn.stalled)
+    return; // Closed meanwhile, or a redundant resume
+  conn.stalled = false;
+  if (!handle_ingest(index, m_sessions[index]->process()))
+    return;
+  if (conn.hung_up) {
+    // Read what the kernel still holds; the closing recv() follows
+    conn.hung_up = false;
+    watch_socket(index);
+  } else {
+    m_reactor->modify(conn.socket, REACTOR_READ);
+  }
+}
+
+// Returns true if the connection should keep reading
+bool StreamReceiver::handle_ingest(int index, IngestStatus status) {
+  Connection &conn = m_connections[index];
+  if (status == INGEST_STALLED) {
+    // Lossless mode: leave the data in the kernel buffer so TCP pushes
+    // back on the phone, instead of waiting on this thread
+    conn.stalled = true;
+    m_reactor->modify(conn.socket, 0);
+    return false;
+  }
+  if (status == INGEST_CORRUPT) {
+    close_connection(index);
+    return false;
+  }
+  return true;
+}
+
+void StreamReceiver::close_connection(int index) {
+  Connection &conn = m_connections[index];
+  if (conn.capture.is_open()) {
+    conn.capture.write(CAPTURE_DISCONNECT, clock_now_us(), nullptr, 0);
+    log_msg("Capture closed (" +
+            std::to_string(conn.capture.bytes_written() / 1024) + " KB)\n");
+    conn.capture.close();
+  }
+  if (conn.gap_timer) {
+    m_reactor->cancel_timer(conn.gap_timer);
+    conn.gap_timer = 0;
+  }
+
+  if (conn.socket != INVALID_SOCKET_VALUE)
+    m_reactor->remove(conn.socket);
+  m_sessions[index]->end_stream();
+  m_activeSessions--;
+  if (m_onConnection)
+    m_onConnection(index, false);
+  socket_close(conn.socket);
+  conn.socket = INVALID_SOCKET_VALUE;
+  conn.stalled = false;
+  conn.hung_up = false;
+  conn.active = false;
+
+  if (m_activeSessions.load() == 0 && m_watchdog) {
+    m_reactor->cancel_timer(m_watchdog);
+    m_watchdog = 0;
+  }
+}
+
+// Replaces the blocking receive timeout: drops phones that went silent
+// without closing the connection (for RTP, the only way a stream ends). A
+// stalled session is silent by choice.
+void StreamReceiver::check_timeouts() {
+  auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i < m_config.max_sessions; i++) {
+    Connection &conn = m_connections[i];
+    if (!conn.active || conn.stalled)
+      continue;
+    if (now - conn.last_rx >= std::chrono::milliseconds(SOCKET_TIMEOUT_MS)) {
+      log_err("[S" + std::to_string(i) + "] " + conn.peer +
+              " timed out.\n");
+      close_connection(i);
+    }
+  }
+}
+
+void StreamReceiver::on_datagrams() {
+  for (int i = 0; i < MAX_DATAGRAMS_PER_WAKEUP; i++) {
+    sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    int r = (int)recvfrom(m_listenSocket, (char *)m_datagram.data(),
+                          (int)m_datagram.size(), 0, (sockaddr *)&from,
+                          &fromLen);
+    if (r < 0) {
+      if (socket_would_block())
+        return;
+      continue; // ICMP port unreachable and the like
+    }
+
+    RtpHeader header;
+    if (!rtp_parse_header(m_datagram.data(), (size_t)r, &header) ||
+        (header.payload_type != RTP_PAYLOAD_TYPE &&
+         header.payload_type != RTP_PAYLOAD_TYPE_RTX &&
+         header.payload_type != RTP_PAYLOAD_TYPE_FEC))
+      continue;
+    bool repair = header.payload_type == RTP_PAYLOAD_TYPE_FEC;
+
+    int index = -1;
+    for (int s = 0; s < m_config.max_sessions && index < 0; s++) {
+      if (m_connections[s].active && m_connections[s].ssrc == header.ssrc)
+        index = s;
+    }
+
+    if (index < 0 && repair)
+      continue; // A stream starts with its media
+    if (index < 0) {
+      char ip[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+      std::stringstream peer;
+      peer << ip << ":" << ntohs(from.sin_port) << " (SSRC " << std::hex
+           << std::setw(8) << std::setfill('0') << header.ssrc << ")";
+
+      index = free_slot();
+      if (index < 0 || !open_session(index)) {
+        if (m_rejectedSsrc != header.ssrc) {
+          log_err("Rejected " + peer.str() + ": all " +
+                  std::to_string(m_config.max_sessions) +
+                  " sessions in use\n");
+          m_rejectedSsrc = header.ssrc;
+        }
+        continue;
+      }
+
+      Connection &conn = m_connections[index];
+      conn.ssrc = header.ssrc;
+      if (!conn.jitter)
+        conn.jitter.reset(new JitterBuffer());
+      conn.jitter->reset();
+      conn.jitter->set_nack_enabled(m_feedbackPort != 0 && m_lossFeedback);
+      conn.jitter->set_nack_hold_us(0);
+      if (!conn.fec)
+        conn.fec.reset(new RtpFecDecoder());
+      conn.fec->reset();
+      conn.depacketizer.reset();
+      conn.feedback_addr = from;
+      conn.feedback_addr.sin_port = htons(m_feedbackPort);
+      conn.recovering = false;
+      conn.recoveries = 0;
+      conn.recover_frames_total = 0;
+      conn.recover_frames_max = 0;
+      open_connection(index, peer.str(), INVALID_SOCKET_VALUE);
+    }
+
+    Connection &conn = m_connections[index];
+    conn.last_rx = std::chrono::steady_clock::now();
+    int64_t nowUs = steady_now_us();
+    if (repair) {
+      if (!conn.fec->active())
+        conn.jitter->set_nack_hold_us(FEC_NACK_HOLD_US);
+      conn.fec->add_repair(m_datagram.data(), (size_t)r, header);
+    } else {
+      conn.jitter->insert(m_datagram.data(), (size_t)r, header, nowUs);
+      conn.fec->add_media(m_datagram.data(), (size_t)r, header.seq);
+      conn.bwe.on_packet((int64_t)rtp_send_time_us(header), nowUs, (size_t)r);
+    }
+    // Rebuilt packets go in before the jitter buffer gives their gap up
+    for (size_t i = 0; i < conn.fec->rebuilt_count(); i++) {
+      const std::vector<uint8_t> &pkt = conn.fec->rebuilt(i);
+      RtpHeader rebuilt;
+      if (rtp_parse_header(pkt.data(), pkt.size(), &rebuilt) &&
+          rebuilt.ssrc == conn.ssrc)
+        conn.jitter->insert(pkt.data(), pkt.size(), rebuilt, nowUs, true);
+    }
+    drain_rtp(index);
+  }
+}
+
+// Hands every releasable packet to the session, then waits (on a timer)
+// for whatever gap is left
+void StreamReceiver::drain_rtp(int index) {
+  Connection &conn = m_connections[index];
+  Session *session = m_sessions[index].get();
+  int64_t nowUs = steady_now_us();
+
+  const uint8_t *packet;
+  RtpHeader header;
+  uint32_t lost;
+  JitterBuffer::PopResult res;
+  while ((res = conn.jitter->pop(nowUs, &packet, &header, &lost)) !=
+         JitterBuffer::POP_EMPTY) {
+    if (res == JitterBuffer::POP_LOST)
+      conn.bwe.on_lost(lost);
+    if (res == JitterBuffer::POP_LOST ||
+        !conn.depacketizer.push(packet + header.payload_offset,
+                                header.payload_size)) {
+      conn.depacketizer.reset();
+      session->drop_access_unit();
+      continue;
+    }
+
+    uint64_t timestampUs = rtp_send_time_us(header);
+    for (const RtpDepacketizer::Nal &nal : conn.depacketizer.nals())
+      session->push_nal(nal.data, nal.size, timestampUs);
+    if (!header.marker)
+      continue;
+
+    session->end_access_unit();
+    if (conn.recovering && session->resync_pending()) {
+      conn.recover_frames++;
+    } else if (conn.recovering) {
+      conn.recovering = false;
+      conn.recoveries++;
+      conn.recover_frames_total += conn.recover_frames;
+      conn.recover_frames_max =
+          std::max(conn.recover_frames_max, conn.recover_frames);
+    }
+  }
+
+  // Lost packets (or a full decode queue) broke the reference chain
+  if (session->resync_pending() && !conn.recovering) {
+    conn.recovering = true;
+    conn.recover_frames = 0;
+  }
+
+  if (m_feedbackPort && m_lossFeedback)
+    send_feedback(index, nowUs);
+  if (m_feedbackPort && m_rateControl)
+    send_rate_target(index, nowUs);
+  arm_gap_timer(index, nowUs);
+}
+
+// Wakes drain_rtp() for the earlier of the head gap expiring and the next
+// NACK retry
+void StreamReceiver::arm_gap_timer(int index, int64_t nowUs) {
+  Connection &conn = m_connections[index];
+  int64_t waitUs = conn.jitter->wait_us(nowUs);
+  int64_t nackUs = conn.jitter->nack_wait_us(nowUs);
+  if (nackUs >= 0 && (waitUs < 0 || nackUs < waitUs))
+    waitUs = nackUs;
+  if (waitUs < 0)
+    return;
+
+  if (conn.gap_timer) {
+    if (conn.gap_due_us <= nowUs + waitUs)
+      return; // Already due early enough
+    m_reactor->cancel_timer(conn.gap_timer);
+  }
+  conn.gap_due_us = nowUs + waitUs;
+  conn.gap_timer = m_reactor->add_timer(
+      (uint32_t)((waitUs + 999) / 1000), 0, [this, index]() {
+        m_connections[index].gap_timer = 0;
+        drain_rtp(index);
+      });
+}
+
+// NACK for every missing packet a retransmission could still rescue; PLI
+// while pictures are being dropped anyway
+void StreamReceiver::send_feedback(int index, int64_t nowUs) {
+  Connection &conn = m_connections[index];
+
+  m_nackSeqs.clear();
+  conn.jitter->collect_nacks(nowUs, &m_nackSeqs);
+  if (!m_nackSeqs.empty()) {
+    for (const std::vector<uint8_t> &msg :
+         agcm_build_nacks(conn.ssrc, m_nackSeqs.data(), m_nackSeqs.size()))
+      send_agcm(conn, msg);
+  }
+
+  if (conn.recovering && nowUs - conn.last_pli_us >= PLI_RETRY_US) {
+    send_agcm(conn, agcm_build_pli(conn.ssrc));
+    conn.last_pli_us = nowUs;
+    conn.plis++;
+  }
+}
+
+void StreamReceiver::log_rtp_stats() {
+  for (int i = 0; i < m_config.max_sessions; i++) {
+    const Connection &conn = m_connections[i];
+    if (!conn.active || !conn.jitter)
+      continue; // TCP
+    const JitterBuffer &jb = *conn.jitter;
+    std::stringstream ss;
+    ss << "[RTP] S" << i << " | Jitter: " << std::fixed << std::setprecision(1)
+       << jb.jitter_ms() << "ms | Gap wait: " << jb.delay_ms()
+       << "ms | Lost: " << jb.lost() << " | Reordered: " << jb.reordered()
+       << " | Late: " << jb.late();
+    if (m_feedbackPort && m_lossFeedback) {
+      ss << " | NACK: " << jb.nacked() << " (" << jb.recovered()
+         << " recovered, RTT " << jb.rtt_ms() << "ms) | PLI: " << conn.plis;
+    }
+    if (conn.fec && conn.fec->active()) {
+      ss << " | FEC: " << jb.rebuilt() << " rebuilt, "
+         << conn.fec->unrecovered() << " beyond repair";
+    }
+    // Frames to recover: pictures dropped per break, until one decodes
+    if (conn.recoveries > 0) {
+      ss << " | Recovery: " << conn.recoveries << "x, avg "
+         << (double)conn.recover_frames_total / conn.recoveries << " max "
+         << conn.recover_frames_max << " frames";
+    }
+    ss << "\n";
+    log_msg(ss.str());
+  }
+}
+
+// The phone's encoder follows the estimate; SSRC 0 over TCP
+void StreamReceiver::send_rate_target(int index, int64_t nowUs) {
+  Connection &conn = m_connections[index];
+  uint32_t bps;
+  int fps;
+  if (conn.bwe.poll(nowUs, &bps, &fps))
+    send_agcm(conn, agcm_build_bitrate_target(conn.ssrc, bps, fps));
+}
+
+void StreamReceiver::send_agcm(const Connection &conn,
+                               const std::vector<uint8_t> &msg) {
+  sendto(m_feedbackSocket, (const char *)msg.data(), (int)msg.size(), 0,
+         (const sockaddr *)&conn.feedback_addr, sizeof(conn.feedback_addr));
+}
+
+void StreamReceiver::log_rate_stats() {
+  if (!m_feedbackPort || !m_rateControl ||
+      m_feedbackSocket == INVALID_SOCKET_VALUE)
+    return;
+  static const char *SIGNALS[] = {"normal", "overuse", "underuse"};
+  for (int i = 0; i < m_config.max_sessions; i++) {
+    const Connection &conn = m_connections[i];
+    if (!conn.active)
+      continue;
+    const BandwidthEstimator &bwe = conn.bwe;
+    std::stringstream ss;
+    ss << "[BWE] S" << i << " | Target: " << std::fixed
+       << std::setprecision(2) << bwe.target_bps() / 1e6 << " Mbit/s "
+       << bwe.target_fps() << " fps | Incoming: " << bwe.incoming_bps() / 1e6
+       << " Mbit/s | Trend: " << std::setprecision(1) << bwe.trend_ms()
+       << "/" << bwe.threshold_ms() << "ms " << SIGNALS[bwe.signal()]
+       << " | Overuse: " << bwe.overuses() << "\n";
+    log_msg(ss.str());
+  }
+}
+
+// Replay stage: feeds the recorded recv() chunks into session 0 with the
+// same chunking, so parsing and access-unit cuts match the original
+// session exactly.
+void StreamReceiver::replay_thread_func() {
+  Session *session = m_sessions[0].get();
+  CaptureRecord record;
+  auto replayStart = std::chrono::steady_clock::now();
+  int64_t firstArrivalUs = m_replay.first_arrival_us();
+  uint64_t replayedBytes = 0;
+  bool inStream = false;
+  bool streamOk = true;
+
+  auto end_replayed_stream = [&]() {
+    session->end_stream();
+    m_activeSessions--;
+    if (m_onConnection)
+      m_onConnection(0, false);
+    inStream = false;
+  };
+
+  while (m_running && m_replay.next(&record)) {
+    if (m_replayPacing == REPLAY_REALTIME) {
+      // Sleep in slices so stop() is not held up by long idle gaps
+      auto due = replayStart +
+                 std::chrono::microseconds(record.arrival_us - firstArrivalUs);
+      while (m_running && std::chrono::steady_clock::now() < due) {
+        std::this_thread::sleep_until(
+            std::min(due, std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(100)));
+      }
+    }
+
+    if (record.type == CAPTURE_CONNECT) {
+      if (inStream)
+        end_replayed_stream();
+      m_activeSessions++;
+      session->begin_stream("replay", INVALID_SOCKET_VALUE,
+                            decoder_threads_per_session());
+      if (m_onConnection)
+        m_onConnection(0, true);
+      inStream = true;
+      streamOk = true;
+    } else if (record.type == CAPTURE_DISCONNECT) {
+      if (inStream)
+        end_replayed_stream();
+    } else if (record.type == CAPTURE_DATA && inStream && streamOk) {
+      size_t offset = 0;
+      while (offset < record.data.size() && m_running) {
+        size_t space = 0;
+        uint8_t *dst = session->prepare(&space);
+        size_t n = std::min(space, record.data.size() - offset);
+        memcpy(dst, record.data.data() + offset, n);
+        offset += n;
+        // No socket to push back on: wait here for the decoder instead
+        IngestStatus status = session->commit(n);
+        while (status == INGEST_STALLED && m_running) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          status = session->process();
+        }
+        streamOk = status == INGEST_OK;
+      }
+      replayedBytes += record.data.size();
+    }
+  }
+  if (inStream)
+    end_replayed_stream();
+
+  // Let the decoder finish what was queued before reporting
+  while (m_running && session->queued() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - replayStart)
+                       .count();
+  std::stringstream ss;
+  ss << "[Replay] " << (m_running ? "Finished" : "Stopped") << ": "
+     << std::fixed << std::setprecision(1) << replayedBytes / 1024.0
+     << " KB in " << std::setprecision(3) << seconds << " s ("
+     << std::setprecision(1) << replayedBytes * 8.0 / 1e6 / seconds
+     << " Mbit/s)\n";
+  log_msg(ss.str());
+  m_replayFinished = true;
+}
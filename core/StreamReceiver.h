@@ -0,0 +1,222 @@
+#pragma once
+#ifndef STREAM_RECEIVER_H
+#define STREAM_RECEIVER_H
+
+#include "BandwidthEstimator.h"
+#include "ConvertPool.h"
+#include "JitterBuffer.h"
+#include "Platform.h"
+#include "Reactor.h"
+#include "Rtp.h"
+#include "RtpFec.h"
+#include "Session.h"
+#include "WireCapture.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class ClockSync;
+
+enum ReplayPacing {
+  REPLAY_REALTIME, // Original inter-arrival times, jitter included
+  REPLAY_FAST      // As fast as the decoder drains the queue
+};
+
+enum IngestTransport {
+  TRANSPORT_TCP, // Length-prefixed wire frames over TCP (RecvRing.h)
+  TRANSPORT_RTP  // H.264 over RTP/UDP (Rtp.h); one phone per SSRC
+};
+
+struct SessionConfig {
+  size_t queue_depth = 16; // Per session
+  QueueDropPolicy queue_policy = QUEUE_DROP_TO_KEYFRAME;
+  int max_sessions = 4;    // Concurrent phones (<= FRAME_BUS_MAX_SESSIONS)
+  int workers = 0;         // Decode workers; 0 = one per core
+  IngestTransport transport = TRANSPORT_TCP;
+  LatencyBudget latency; // Off by default
+  DecodeProfile decode_profile = DECODE_ULTRA_LOW_LATENCY;
+  bool band_convert = false; // See Decoder::set_band_convert
+  int convert_threads = 0;   // ConvertPool, shared; 0 = one per core
+  int convert_band_rows = 0; // 0 = ConvertPool's default
+};
+
+// Ingest on the video port: TCP connections, or RTP streams told apart by
+// SSRC. Every phone is bound to a Session (its own parser, decoder and
+// frame bus); all sockets are read on the Reactor thread and decoding runs
+// on a WorkerPool shared by all sessions. The TCP ingest path can instead
+// be fed from a wire capture (start_replay), which runs on a thread of its
+// own.
+class StreamReceiver {
+public:
+  explicit StreamReceiver(const ClockSync *clock);
+  ~StreamReceiver();
+
+  // Binds the video port (TCP or UDP, per config.transport), opens session
+  // 0 and starts the workers, then serves phones from `reactor` once it
+  // runs. Returns false if the port cannot be bound. RTP always uses
+  // QUEUE_DROP_TO_KEYFRAME: a datagram socket cannot push back.
+  bool start(Reactor *reactor, uint16_t port, const SessionConfig &config);
+
+  // Replays a capture written with set_capture_dir() into session 0
+  // instead of listening. REPLAY_FAST always uses QUEUE_BLOCK so no picture
+  // is dropped.
+  bool start_replay(const std::string &path, ReplayPacing pacing,
+                    const SessionConfig &config);
+
+  // Closes every connection and stops the workers. The reactor passed to
+  // start() must no longer be running.
+  void stop();
+
+  // Set before start(): every TCP connection is teed into
+  // <dir>/capture_s<n>_<timestamp>.agcw. Empty disables capturing.
+  void set_capture_dir(const std::string &dir) { m_captureDir = dir; }
+
+  // Set before start(). Feedback goes to this port on the phone's address
+  // (its AGCM discovery port). 0 disables all feedback.
+  void set_feedback_port(uint16_t port) { m_feedbackPort = port; }
+
+  // Set before start(). NACK and PLI for RTP, and the keyframe requests of
+  // the latency governor on either transport (on by default).
+  void set_loss_feedback(bool enabled) { m_lossFeedback = enabled; }
+
+  // Set before start(). Either transport: estimates each phone's bandwidth
+  // and sends it a bitrate and frame rate target (off by default).
+  void set_rate_control(bool enabled) { m_rateControl = enabled; }
+
+  // Set before start(). Run on the reactor (or replay) thread on connect
+  // (true) / disconnect (false) of a session.
+  void set_connection_callback(std::function<void(int, bool)> callback) {
+    m_onConnection = callback;
+  }
+
+  // Set before start(). Run on a worker after each frame of a session.
+  void set_frame_callback(std::function<void(int)> callback) {
+    m_onFrame = callback;
+  }
+
+  // Any thread, once started: every session switches at its next keyframe
+  void set_decode_profile(DecodeProfile profile);
+  DecodeProfile decode_profile() const {
+    return (DecodeProfile)m_decodeProfile.load();
+  }
+
+  // Any session connected
+  bool connected() const;
+
+  // Session `index`'s frame bus; nullptr until that session was first used
+  SharedMemoryLayout *frame_layout(int index) const;
+
+  // Replay reached the end of the capture and the decoder caught up
+  bool replay_finished() const { return m_replayFinished.load(); }
+
+  // Replay: local time minus original arrival time of the first record, for
+  // re-basing the sender timestamps in the capture
+  int64_t replay_shift_us() const { return m_replayShiftUs; }
+
+private:
+  // One streaming phone; the slot index is the session index
+  struct Connection {
+    bool active = false;
+    std::string peer;
+    std::chrono::steady_clock::time_point last_rx;
+
+    // TCP
+    socket_t socket = INVALID_SOCKET_VALUE;
+    CaptureWriter capture;
+    bool stalled = false; // Read interest dropped until the session resumes
+    bool hung_up = false; // Peer closed while stalled; off the reactor
+
+    // RTP
+    uint32_t ssrc = 0;
+    std::unique_ptr<JitterBuffer> jitter; // Allocated on first use
+    std::unique_ptr<RtpFecDecoder> fec;   // Ditto
+    RtpDepacketizer depacketizer;
+    TimerId gap_timer = 0; // Armed while a sequence gap is pending
+    int64_t gap_due_us = 0;
+
+    // Feedback, both transports
+    sockaddr_in feedback_addr;
+    BandwidthEstimator bwe;
+
+    // Keyframe recovery: from the first dropped picture to the next one
+    // that decodes
+    bool recovering = false;
+    uint32_t recover_frames = 0; // Pictures dropped so far
+    int64_t last_pli_us = 0;
+    uint64_t plis = 0;
+    uint32_t recoveries = 0;
+    uint64_t recover_frames_total = 0;
+    uint32_t recover_frames_max = 0;
+  };
+
+  bool start_sessions(const SessionConfig &config);
+  Session *open_session(int index);
+  int decoder_threads_per_session() const;
+
+  // Reactor thread
+  int free_slot() const;
+  void open_connection(int index, const std::string &peer, socket_t socket);
+  void close_connection(int index);
+  void check_timeouts();
+
+  // TCP
+  void on_accept();
+  void watch_socket(int index);
+  void on_readable(int index, uint32_t events);
+  void on_resume(int index);
+  bool handle_ingest(int index, IngestStatus status);
+  void request_keyframe(int index);
+  void on_wire_frame(int index, uint64_t timestampUs, uint32_t size);
+
+  // RTP
+  void on_datagrams();
+  void drain_rtp(int index);
+  void arm_gap_timer(int index, int64_t nowUs);
+  void send_feedback(int index, int64_t nowUs);
+  void log_rtp_stats();
+
+  // Both transports
+  void send_rate_target(int index, int64_t nowUs);
+  void send_agcm(const Connection &conn, const std::vector<uint8_t> &msg);
+  void log_rate_stats();
+
+  void replay_thread_func();
+
+  const ClockSync *m_clock;
+  std::function<void(int, bool)> m_onConnection;
+  std::function<void(int)> m_onFrame;
+
+  SessionConfig m_config;
+  WorkerPool m_workers;
+  ConvertPool m_convert;
+  std::vector<std::unique_ptr<Session>> m_sessions; // Opened on first use
+  std::unique_ptr<Connection[]> m_connections;      // One per session slot
+  std::atomic<int> m_activeSessions;
+  std::atomic<int> m_decodeProfile; // DecodeProfile
+
+  std::atomic<bool> m_running;
+  Reactor *m_reactor;
+  socket_t m_listenSocket; // TCP listener, or the RTP socket
+  std::vector<uint8_t> m_datagram;
+  uint32_t m_rejectedSsrc; // Last RTP stream turned away (logged once)
+  uint16_t m_feedbackPort;
+  bool m_lossFeedback;
+  bool m_rateControl;
+  socket_t m_feedbackSocket; // The RTP socket, or one of its own for TCP
+  std::vector<uint16_t> m_nackSeqs; // Reused by send_feedback()
+  TimerId m_watchdog; // Armed while any phone is connected; 0 = none
+  std::thread m_replayThread;
+
+  // Capture / replay
+  std::string m_captureDir;
+  CaptureReader m_replay;
+  ReplayPacing m_replayPacing;
+  int64_t m_replayShiftUs;
+  std::atomic<bool> m_replayFinished;
+};
+
+#endif // STREAM_RECEIVER_H
@@ -0,0 +1,106 @@
+#include "WireCapture.h"
+#include "ClockSync.h"
+#include <string.h>
+
+// Little Endian assuming x64, like the AGCM packets
+
+CaptureWriter::CaptureWriter() : m_file(nullptr), m_bytes(0) {}
+
+CaptureWriter::~CaptureWriter() { close(); }
+
+bool CaptureWriter::open(const std::string &path) {
+  close();
+  m_file = fopen(path.c_str(), "wb");
+  if (!m_file)
+    return false;
+  m_buffer.resize(1024 * 1024);
+  setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+
+  uint8_t header[WIRE_CAPTURE_HEADER_SIZE];
+  uint32_t version = WIRE_CAPTURE_VERSION;
+  int64_t created = clock_now_us();
+  memcpy(header, WIRE_CAPTURE_MAGIC, 4);
+  memcpy(header + 4, &version, 4);
+  memcpy(header + 8, &created, 8);
+  fwrite(header, 1, sizeof(header), m_file);
+  m_bytes = sizeof(header);
+  return true;
+}
+
+void CaptureWriter::close() {
+  if (!m_file)
+    return;
+  fclose(m_file); // Flushes the buffer
+  m_file = nullptr;
+}
+
+void CaptureWriter::write(CaptureRecordType type, int64_t arrivalUs,
+                          const uint8_t *data, uint32_t size) {
+  if (!m_file)
+    return;
+  uint8_t header[WIRE_CAPTURE_RECORD_HEADER_SIZE];
+  header[0] = (uint8_t)type;
+  memcpy(header + 1, &arrivalUs, 8);
+  memcpy(header + 9, &size, 4);
+  fwrite(header, 1, sizeof(header), m_file);
+  if (size)
+    fwrite(data, 1, size, m_file);
+  m_bytes += sizeof(header) + size;
+}
+
+CaptureReader::CaptureReader() : m_file(nullptr), m_firstArrivalUs(0) {}
+
+CaptureReader::~CaptureReader() { close(); }
+
+bool CaptureReader::open(const std::string &path, std::string *error) {
+  close();
+  m_file = fopen(path.c_str(), "rb");
+  if (!m_file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+
+  uint8_t header[WIRE_CAPTURE_HEADER_SIZE];
+  uint32_t version = 0;
+  if (fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+      memcmp(header, WIRE_CAPTURE_MAGIC, 4) != 0) {
+    *error = path + " is not a wire capture";
+    close();
+    return false;
+  }
+  memcpy(&version, header + 4, 4);
+  if (version != WIRE_CAPTURE_VERSION) {
+    *error = "unsupported capture version " + std::to_string(version);
+    close();
+    return false;
+  }
+
+  // Peek at the first record for the replay time base
+  uint8_t rec[WIRE_CAPTURE_RECORD_HEADER_SIZE];
+  if (fread(rec, 1, sizeof(rec), m_file) == sizeof(rec))
+    memcpy(&m_firstArrivalUs, rec + 1, 8);
+  fseek(m_file, WIRE_CAPTURE_HEADER_SIZE, SEEK_SET);
+  return true;
+}
+
+void CaptureReader::close() {
+  if (!m_file)
+    return;
+  fclose(m_file);
+  m_file = nullptr;
+}
+
+bool CaptureReader::next(CaptureRecord *record) {
+  if (!m_file)
+    return false;
+  uint8_t header[WIRE_CAPTURE_RECORD_HEADER_SIZE];
+  if (fread(header, 1, sizeof(header), m_file) != sizeof(header))
+    return false;
+
+  uint32_t size = 0;
+  record->type = (CaptureRecordType)header[0];
+  memcpy(&record->arrival_us, header + 1, 8);
+  memcpy(&size, header + 9, 4);
+  record->data.resize(size);
+  return size == 0 || fread(record->data.data(), 1, size, m_file) == size;
+}
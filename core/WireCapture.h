@@ -0,0 +1,77 @@
+#pragma once
+#ifndef WIRE_CAPTURE_H
+#define WIRE_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Capture of the raw port 5000 byte stream, exactly as recv() returned it,
+// so a session can be replayed through the ingest path bit for bit.
+//
+// File layout (little endian):
+//   Header: "AGCW"(4) + Version(4) + Created, Unix us (8)
+//   Record: Type(1) + Arrival, Unix us (8) + Length(4) + Bytes(Length)
+// DATA records keep the original recv() chunking, so the ring parser sees
+// the same partial frames it saw live.
+#define WIRE_CAPTURE_MAGIC "AGCW"
+#define WIRE_CAPTURE_VERSION 1
+#define WIRE_CAPTURE_HEADER_SIZE 16
+#define WIRE_CAPTURE_RECORD_HEADER_SIZE 13
+
+enum CaptureRecordType {
+  CAPTURE_CONNECT = 1,    // Client accepted (no payload)
+  CAPTURE_DATA = 2,       // One recv() chunk
+  CAPTURE_DISCONNECT = 3  // Connection closed (no payload)
+};
+
+struct CaptureRecord {
+  CaptureRecordType type;
+  int64_t arrival_us;
+  std::vector<uint8_t> data; // Reused between next() calls
+};
+
+// Written from the socket thread. Writes go through a 1 MB stdio buffer so
+// the recv loop only pays a memcpy per chunk, not a syscall.
+class CaptureWriter {
+public:
+  CaptureWriter();
+  ~CaptureWriter();
+
+  bool open(const std::string &path);
+  void close();
+  bool is_open() const { return m_file != nullptr; }
+
+  void write(CaptureRecordType type, int64_t arrivalUs, const uint8_t *data,
+             uint32_t size);
+
+  uint64_t bytes_written() const { return m_bytes; }
+
+private:
+  FILE *m_file;
+  std::vector<char> m_buffer;
+  uint64_t m_bytes;
+};
+
+class CaptureReader {
+public:
+  CaptureReader();
+  ~CaptureReader();
+
+  // Fails on a missing file or a bad header
+  bool open(const std::string &path, std::string *error);
+  void close();
+
+  // False at the end of the file (or on a truncated record)
+  bool next(CaptureRecord *record);
+
+  // Arrival time of the first record, or 0 if there is none
+  int64_t first_arrival_us() const { return m_firstArrivalUs; }
+
+private:
+  FILE *m_file;
+  int64_t m_firstArrivalUs;
+};
+
+#endif // WIRE_CAPTURE_H
@@ -0,0 +1,54 @@
+#include "WorkerPool.h"
+#include "Session.h"
+
+WorkerPool::WorkerPool() : m_running(false) {}
+
+WorkerPool::~WorkerPool() { stop(); }
+
+void WorkerPool::start(int threads) {
+  if (threads <= 0)
+    threads = (int)std::thread::hardware_concurrency();
+  if (threads <= 0)
+    threads = 1;
+
+  m_running = true;
+  for (int i = 0; i < threads; i++)
+    m_threads.emplace_back(&WorkerPool::thread_func, this);
+}
+
+void WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running)
+      return;
+    m_running = false;
+  }
+  m_cond.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+  m_threads.clear();
+  m_ready.clear();
+}
+
+void WorkerPool::schedule(Session *session) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready.push_back(session);
+  }
+  m_cond.notify_one();
+}
+
+void WorkerPool::thread_func() {
+  while (true) {
+    Session *session;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this]() { return !m_running || !m_ready.empty(); });
+      if (!m_running)
+        return;
+      session = m_ready.front();
+      m_ready.pop_front();
+    }
+    session->run_slice();
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Session;
+
+// Decode workers shared by all sessions. A session with queued access units
+// is put on the ready list once (Session::notify) and a worker runs one
+// slice of it (Session::run_slice); a session never runs on two workers at
+// once, so its decoder stays single-threaded while sessions spread across
+// cores.
+class WorkerPool {
+public:
+  WorkerPool();
+  ~WorkerPool();
+
+  // 0 = one per core
+  void start(int threads);
+
+  // Joins the workers; sessions still on the ready list are left queued
+  void stop();
+
+  int size() const { return (int)m_threads.size(); }
+
+  void schedule(Session *session);
+
+private:
+  void thread_func();
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<Session *> m_ready;
+  bool m_running;
+  std::vector<std::thread> m_threads;
+};
+
+#endif // WORKER_POOL_H
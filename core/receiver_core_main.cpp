@@ -0,0 +1,61 @@
+// Headless receiver: the full ingest -> decode -> frame bus pipeline without
+// a window, for Linux perf/valgrind runs and throughput tests. Frames are
+// published to the shared-memory ring exactly as the Windows app does.
+// With --replay it runs a recorded wire capture through the same path and
+// exits when the capture is done. SIGUSR1 moves every session on to the
+// next decode profile.
+#include "Log.h"
+#include "ReceiverCore.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <signal.h>
+#include <thread>
+
+static std::atomic<bool> stopRequested(false);
+
+static std::atomic<bool> nextProfileRequested(false);
+
+static void on_signal(int) { stopRequested = true; }
+#ifndef _WIN32
+static void on_next_profile(int) { nextProfileRequested = true; }
+#endif
+
+int main(int argc, char **argv) {
+  ReceiverConfig config;
+  if (!parse_receiver_args(argc, argv, &config)) {
+    std::cerr << "Usage: receiver_core [--port N] [--queue-depth N] "
+                 "[--queue-policy drop|block] [--data-dir PATH] "
+                 "[--max-sessions N] [--workers N] [--transport tcp|rtp] "
+                 "[--no-discovery] [--no-feedback] [--rate-control] "
+                 "[--latency-budget MS] [--backlog-budget KB] "
+                 "[--decode-profile ultra-low-latency|balanced|throughput] "
+                 "[--band-convert] [--convert-threads N] "
+                 "[--convert-band-rows N] "
+                 "[--no-log-receiver] [--capture] "
+                 "[--replay FILE [--replay-fast]]\n";
+    return 2;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+#ifndef _WIN32
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGUSR1, on_next_profile);
+#endif
+
+  ReceiverCore core;
+  if (!core.start(config))
+    return 1;
+
+  while (!stopRequested && !core.finished()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (nextProfileRequested.exchange(false))
+      core.set_decode_profile(
+          (DecodeProfile)((core.decode_profile() + 1) % DECODE_PROFILE_COUNT));
+  }
+
+  log_msg("Shutting down...\n");
+  core.stop();
+  return 0;
+}
@@ -34,7 +34,8 @@ class CameraViewController: UIViewController {
     
     private let captureSession = AVCaptureSession()
     private let videoOutput = AVCaptureVideoDataOutput()
-    private var tcpClient: TCPClient?
+    private var transport: VideoTransport?
+    private var useRTP = false // TCP wire protocol by default
     private var videoEncoder: VideoEncoder?
     private var needsKeyFrame = false
     private var isDroppingFrames = false // Recovery State
@@ -62,6 +63,11 @@ class CameraViewController: UIViewController {
     private let serverPort: UInt32 = 5000
     private let beaconPort: UInt16 = 5001
     private var currentFPS: Double = 30.0
+    private var selectedFPS: Double = 30.0 // The FPS button; rate control stays below it
+
+    // Receiver's rate control target (BITRATE_TARGET), until the next connection
+    private var targetBitrate = VideoEncoder.defaultBitrate
+    private var targetFPS: Double = 60.0
     
     // UDP Beacon for device discovery
     private var beaconListener: BeaconListener?
@@ -142,6 +148,16 @@ class CameraViewController: UIViewController {
         return btn
     }()
     
+    private let transportButton: UIButton = {
+        let btn = UIButton(type: .system)
+        btn.setTitle("TCP", for: .normal)
+        btn.backgroundColor = .systemGray
+        btn.setTitleColor(.white, for: .normal)
+        btn.layer.cornerRadius = 8
+        btn.translatesAutoresizingMaskIntoConstraints = false
+        return btn
+    }()
+    
     private let toggleLogsButton: UIButton = {
         let btn = UIButton(type: .system)
         btn.setTitle("Show Logs", for: .normal)
@@ -211,6 +227,7 @@ class CameraViewController: UIViewController {
         controlsContainer.addSubview(statusLabel)
         controlsContainer.addSubview(ipTextField)
         controlsContainer.addSubview(connectButton)
+        controlsContainer.addSubview(transportButton)
         controlsContainer.addSubview(fpsButton)
         controlsContainer.addSubview(sendLogsButton)
         controlsContainer.addSubview(toggleLogsButton)
@@ -220,6 +237,7 @@ class CameraViewController: UIViewController {
         connectButton.addTarget(self, action: #selector(connectTapped), for: .touchUpInside)
         sendLogsButton.addTarget(self, action: #selector(sendLogsTapped), for: .touchUpInside)
         fpsButton.addTarget(self, action: #selector(fpsTapped), for: .touchUpInside)
+        transportButton.addTarget(self, action: #selector(transportTapped), for: .touchUpInside)
         toggleLogsButton.addTarget(self, action: #selector(toggleLogs), for: .touchUpInside)
         
         // --- Layout Constraints ---
@@ -241,8 +259,13 @@ class CameraViewController: UIViewController {
             connectButton.widthAnchor.constraint(equalToConstant: 100),
             connectButton.heightAnchor.constraint(equalToConstant: 44),
             
+            transportButton.centerYAnchor.constraint(equalTo: connectButton.centerYAnchor),
+            transportButton.trailingAnchor.constraint(equalTo: connectButton.leadingAnchor, constant: -10),
+            transportButton.widthAnchor.constraint(equalToConstant: 60),
+            transportButton.heightAnchor.constraint(equalToConstant: 44),
+            
             ipTextField.centerYAnchor.constraint(equalTo: connectButton.centerYAnchor),
-            ipTextField.trailingAnchor.constraint(equalTo: connectButton.leadingAnchor, constant: -10),
+            ipTextField.trailingAnchor.constraint(equalTo: transportButton.leadingAnchor, constant: -10),
             ipTextField.leadingAnchor.constraint(equalTo: controlsContainer.leadingAnchor, constant: 20),
             ipTextField.heightAnchor.constraint(equalToConstant: 44),
             
@@ -285,11 +308,13 @@ class CameraViewController: UIViewController {
             connectButton.backgroundColor = .white
             connectButton.setTitleColor(.black, for: .normal)
             ipTextField.isEnabled = true
+            transportButton.isEnabled = true
         case .connecting, .reconnecting:
             connectButton.setTitle("Cancel", for: .normal)
             connectButton.backgroundColor = .systemOrange
             connectButton.setTitleColor(.white, for: .normal)
             ipTextField.isEnabled = false
+            transportButton.isEnabled = false
         case .connected:
             connectButton.setTitle("Disconnect", for: .normal)
             connectButton.backgroundColor = .systemRed
@@ -439,11 +464,33 @@ class CameraViewController: UIViewController {
     }
 
     @objc private func fpsTapped() {
-        if currentFPS == 30.0 {
-            updateFrameRate(fps: 60.0)
-        } else {
-            updateFrameRate(fps: 30.0)
+        selectedFPS = selectedFPS == 30.0 ? 60.0 : 30.0
+        updateFrameRate(fps: min(selectedFPS, targetFPS))
+    }
+
+    // The receiver's bandwidth estimate; SSRC 0 over TCP
+    private func applyRateTarget(ssrc: UInt32, bitrate: Int, fps: Int) {
+        if let rtp = transport as? RTPClient, rtp.ssrc != ssrc { return }
+        if bitrate != targetBitrate {
+            targetBitrate = bitrate
+            videoEncoder?.bitrate = bitrate
         }
+        guard fps > 0 else { return }
+        targetFPS = Double(fps)
+        let limitedFPS = min(selectedFPS, targetFPS)
+        if limitedFPS != currentFPS {
+            log("Rate control: \(bitrate / 1000) kbit/s at \(Int(limitedFPS)) FPS")
+            updateFrameRate(fps: limitedFPS)
+        }
+    }
+
+    // RTP must match the receiver's --transport; switch while disconnected
+    @objc private func transportTapped() {
+        guard connectionState == .disconnected else { return }
+        useRTP.toggle()
+        transportButton.setTitle(useRTP ? "RTP" : "TCP", for: .normal)
+        transportButton.backgroundColor = useRTP ? .systemGreen : .systemGray
+        log("Transport set to \(useRTP ? "RTP/UDP" : "TCP")")
     }
 
     private func updateFrameRate(fps: Double) {
@@ -525,7 +572,7 @@ class CameraViewController: UIViewController {
     
     private func setupEncoder() {
         // Initial setup with default 720p (Landscape)
-        videoEncoder = VideoEncoder(width: Int32(1280), height: Int32(720), logger: self.log)
+        videoEncoder = VideoEncoder(width: Int32(1280), height: Int32(720), bitrate: targetBitrate, logger: self.log)
         videoEncoder?.delegate = self
         videoEncoder?.errorHandler = { [weak self] error in
             self?.log("⚠️ Encoder Error: \(error)")
@@ -539,7 +586,7 @@ class CameraViewController: UIViewController {
         // Recreate encoder on critical error
         log("Recreating encoder after error...")
         // Default to landscape if we can't determine, or use last known (TODO: Better state tracking)
-        videoEncoder = VideoEncoder(width: Int32(1280), height: Int32(720), logger: self.log)
+        videoEncoder = VideoEncoder(width: Int32(1280), height: Int32(720), bitrate: targetBitrate, logger: self.log)
         videoEncoder?.delegate = self
         videoEncoder?.errorHandler = { [weak self] error in
             self?.log("⚠️ Encoder Error: \(error)")
@@ -560,15 +607,19 @@ class CameraViewController: UIViewController {
         connectionState = .connecting
         log("Connecting to \(serverIP)...")
         
-        tcpClient = TCPClient(address: serverIP, port: serverPort)
-        tcpClient?.logger = self.log
-        tcpClient?.onConnected = { [weak self] in
+        if useRTP {
+            transport = RTPClient(address: serverIP, port: serverPort)
+        } else {
+            transport = TCPClient(address: serverIP, port: serverPort)
+        }
+        transport?.logger = self.log
+        transport?.onConnected = { [weak self] in
             self?.handleConnected()
         }
-        tcpClient?.onDisconnected = { [weak self] error in
+        transport?.onDisconnected = { [weak self] error in
             self?.handleDisconnected(error: error)
         }
-        tcpClient?.connect()
+        transport?.connect()
     }
     
     private func handleConnected() {
@@ -626,11 +677,18 @@ class CameraViewController: UIViewController {
     }
     
     private func disconnectFromServer() {
-        tcpClient?.disconnect()
-        tcpClient = nil
+        transport?.disconnect()
+        transport = nil
         connectionState = .disconnected
         beaconListener?.setStreaming(false) // Reset beacon state
         isDroppingFrames = true
+        // A new connection starts a new estimate from the default rate
+        targetBitrate = VideoEncoder.defaultBitrate
+        videoEncoder?.bitrate = targetBitrate
+        targetFPS = 60.0
+        if currentFPS != selectedFPS {
+            updateFrameRate(fps: selectedFPS)
+        }
     }
     // MARK: - Helpers
     private func startBeacon() {
@@ -639,6 +697,19 @@ class CameraViewController: UIViewController {
         beaconListener?.onLog = { [weak self] msg in
             self?.log("[Beacon] \(msg)")
         }
+        beaconListener?.onNack = { [weak self] ssrc, sequences in
+            (self?.transport as? RTPClient)?.retransmit(ssrc: ssrc, sequences: sequences)
+        }
+        beaconListener?.onKeyframeRequest = { [weak self] ssrc in
+            // SSRC 0 comes over TCP, from the receiver's latency governor
+            if let rtp = self?.transport as? RTPClient, rtp.ssrc != ssrc { return }
+            self?.needsKeyFrame = true
+        }
+        beaconListener?.onBitrateTarget = { [weak self] ssrc, bitrate, fps in
+            DispatchQueue.main.async {
+                self?.applyRateTarget(ssrc: ssrc, bitrate: Int(bitrate), fps: fps)
+            }
+        }
         beaconListener?.start()
     }
     
@@ -700,7 +771,7 @@ extension CameraViewController: AVCaptureVideoDataOutputSampleBufferDelegate {
         
         if let encoder = videoEncoder, (encoder.width != width || encoder.height != height) {
              log("Resolution Changed to \(width)x\(height). Recreating Encoder.")
-             videoEncoder = VideoEncoder(width: width, height: height, logger: self.log)
+             videoEncoder = VideoEncoder(width: width, height: height, bitrate: targetBitrate, logger: self.log)
              videoEncoder?.delegate = self
              videoEncoder?.errorHandler = { [weak self] error in
                  self?.log("⚠️ Encoder Error: \(error)")
@@ -731,7 +802,7 @@ extension CameraViewController: VideoEncoderDelegate {
         }
     
         // 2. Try to Send
-        let sent = tcpClient?.send(data: nalData, captureTime: captureTime) ?? false
+        let sent = transport?.send(data: nalData, captureTime: captureTime) ?? false
         
         // 3. Handle Send Failure
         if !sent {
@@ -745,11 +816,17 @@ extension CameraViewController: VideoEncoderDelegate {
             }
         }
     }
+    
+    func didFinishFrame(captureTime: TimeInterval) {
+        transport?.endFrame()
+    }
 }
 
 // MARK: - Video Encoder
 protocol VideoEncoderDelegate: AnyObject {
     func didEncode(nalData: Data, isKeyFrame: Bool, captureTime: TimeInterval)
+    // Every NAL of the picture has been passed to didEncode
+    func didFinishFrame(captureTime: TimeInterval)
 }
 
 class VideoEncoder {
@@ -759,10 +836,18 @@ class VideoEncoder {
     
     var width: Int32
     var height: Int32
+
+    static let defaultBitrate = 1_500_000
+
+    // Bits per second; the receiver's rate control moves it while streaming
+    var bitrate: Int {
+        didSet { applyBitrate() }
+    }
     
-    init(width: Int32, height: Int32, logger: ((String) -> Void)? = nil) {
+    init(width: Int32, height: Int32, bitrate: Int = VideoEncoder.defaultBitrate, logger: ((String) -> Void)? = nil) {
         self.width = width
         self.height = height
+        self.bitrate = bitrate
         self.errorHandler = logger
         createSession()
     }
@@ -790,10 +875,19 @@ class VideoEncoder {
         VTSessionSetProperty(session, key: kVTCompressionPropertyKey_RealTime, value: kCFBooleanTrue)
         VTSessionSetProperty(session, key: kVTCompressionPropertyKey_ProfileLevel, value: kVTProfileLevel_H264_Baseline_AutoLevel)
         VTSessionSetProperty(session, key: kVTCompressionPropertyKey_MaxKeyFrameInterval, value: 30 as CFNumber) // 1 second
-        VTSessionSetProperty(session, key: kVTCompressionPropertyKey_AverageBitRate, value: 1_500_000 as CFNumber) 
+        applyBitrate()
         
         VTCompressionSessionPrepareToEncodeFrames(session)
     }
+
+    // Average rate, plus a hard cap of 1.5x over any second so a keyframe
+    // burst cannot build a queue the estimate did not allow for
+    private func applyBitrate() {
+        guard let session = session else { return }
+        VTSessionSetProperty(session, key: kVTCompressionPropertyKey_AverageBitRate, value: bitrate as CFNumber)
+        let limits = [bitrate * 3 / 2 / 8, 1] as CFArray // Bytes, seconds
+        VTSessionSetProperty(session, key: kVTCompressionPropertyKey_DataRateLimits, value: limits)
+    }
     
     func encode(_ sampleBuffer: CMSampleBuffer, forceKeyframe: Bool = false) {
         guard let session = session,
@@ -902,11 +996,27 @@ private func compressionCallback(outputCallbackRefCon: UnsafeMutableRawPointer?,
     }
     
     encoder.sendNALUs(from: sampleBuffer, isKeyFrame: isKeyFrame, captureTime: captureTime)
+    encoder.delegate?.didFinishFrame(captureTime: captureTime)
+}
+
+// MARK: - Video Transport
+// What the view controller streams through: TCPClient (wire protocol) or
+// RTPClient (RTP over UDP). Both report connection changes the same way.
+protocol VideoTransport: AnyObject {
+    var logger: ((String) -> Void)? { get set }
+    var onConnected: (() -> Void)? { get set }
+    var onDisconnected: ((String?) -> Void)? { get set }
+    func connect()
+    func disconnect()
+    // false = not connected or backed up; the caller drops to the next keyframe
+    func send(data: Data, captureTime: TimeInterval) -> Bool
+    // Called once all NALs of a picture have been sent
+    func endFrame()
 }
 
 // MARK: - TCP Client with StreamDelegate
 // MARK: - TCP Client with NWConnection (Low Latency)
-class TCPClient {
+class TCPClient: VideoTransport {
     let address: String
     let port: UInt32
     private var connection: NWConnection?
@@ -915,6 +1025,7 @@ class TCPClient {
     // Backpressure
     private var pendingPackets = 0
     private let maxPendingPackets = 5 // Low buffer for real-time
+    private var lastCaptureTime: TimeInterval = 0 // For the end-of-picture marker
     
     var logger: ((String) -> Void)?
     var onConnected: (() -> Void)?
@@ -990,6 +1101,7 @@ class TCPClient {
         // OR better: Send microsecond timestamp (UInt64) to be safe.
         
         // Using UInt64 microseconds
+        lastCaptureTime = captureTime
         let timestampMicros = UInt64(captureTime * 1_000_000)
         var tsBigEndian = timestampMicros.bigEndian
         packetData.append(Data(bytes: &tsBigEndian, count: 8))
@@ -1009,6 +1121,237 @@ class TCPClient {
         
         return true
     }
+    
+    // Every NAL already went out with its own header, so the receiver cannot
+    // tell where the picture ends. An empty message (timestamp only) marks it.
+    func endFrame() {
+        _ = send(data: Data(), captureTime: lastCaptureTime)
+    }
+}
+
+// MARK: - RTP Client (H.264 over UDP, RFC 6184)
+// Same job as TCPClient, but a lost packet costs one picture instead of
+// stalling every picture behind it. The NALs of a picture are collected until
+// endFrame(), then packetized: small ones share STAP-A packets, large ones are
+// split into FU-A, and the marker bit goes on the last packet. The capture
+// time travels in a one-byte header extension (ID 1), as receiver_core
+// expects with --transport rtp.
+class RTPClient: VideoTransport {
+    let address: String
+    let port: UInt32
+    private var connection: NWConnection?
+    private let queue = DispatchQueue(label: "com.antigravity.rtp")
+    
+    private let maxPayload = 1200 // Fits a 1500 byte MTU with headroom
+    private let payloadType: UInt8 = 96
+    private let retransmissionPayloadType: UInt8 = 97
+    let ssrc = UInt32.random(in: 1...UInt32.max)
+    private var sequence = UInt16.random(in: 0...UInt16.max)
+    
+    // Current picture
+    private var frameNALs: [[UInt8]] = []
+    private var frameCaptureTime: TimeInterval = 0
+    
+    // Backpressure: datagrams handed to the stack but not yet sent
+    private var pendingPackets = 0
+    private let maxPendingPackets = 256
+    
+    // Sent packets by sequence number, resent when the receiver NACKs them.
+    // Written by the encoder callback, read on the beacon queue.
+    private let historySize = 1024
+    private var history: [Data?]
+    private let historyLock = NSLock()
+    
+    var logger: ((String) -> Void)?
+    var onConnected: (() -> Void)?
+    var onDisconnected: ((String?) -> Void)?
+    
+    init(address: String, port: UInt32) {
+        self.address = address
+        self.port = port
+        self.history = [Data?](repeating: nil, count: historySize)
+    }
+    
+    func connect() {
+        let host = NWEndpoint.Host(address)
+        let port = NWEndpoint.Port(rawValue: UInt16(self.port))!
+        
+        let params = NWParameters.udp
+        params.serviceClass = .interactiveVideo
+        
+        connection = NWConnection(host: host, port: port, using: params)
+        
+        // UDP is "ready" once the route is up; the receiver only notices us
+        // when the first packet arrives
+        connection?.stateUpdateHandler = { [weak self] state in
+            switch state {
+            case .ready:
+                self?.logger?("RTP ready for \(self?.address ?? ""):\(self?.port ?? 0)")
+                self?.onConnected?()
+            case .failed(let error):
+                self?.logger?("RTP failed: \(error)")
+                self?.onDisconnected?(error.localizedDescription)
+            case .cancelled:
+                self?.logger?("RTP cancelled")
+                self?.onDisconnected?(nil)
+            case .waiting(let error):
+                self?.logger?("RTP waiting: \(error)")
+            default:
+                break
+            }
+        }
+        
+        connection?.start(queue: queue)
+        logger?("Starting RTP to \(address):\(port)...")
+    }
+    
+    func disconnect() {
+        connection?.cancel()
+        connection = nil
+        pendingPackets = 0
+        frameNALs.removeAll()
+    }
+    
+    func send(data: Data, captureTime: TimeInterval) -> Bool {
+        guard let connection = connection, connection.state == .ready else { return false }
+        if pendingPackets > maxPendingPackets {
+            frameNALs.removeAll() // Half a picture is of no use to the receiver
+            return false
+        }
+        frameNALs.append([UInt8](data))
+        frameCaptureTime = captureTime
+        return true
+    }
+    
+    func endFrame() {
+        guard let connection = connection, !frameNALs.isEmpty else { return }
+        let payloads = packetize(frameNALs)
+        frameNALs.removeAll()
+        
+        let captureMicros = UInt64(frameCaptureTime * 1_000_000)
+        let rtpTimestamp = UInt32(truncatingIfNeeded: captureMicros * 90_000 / 1_000_000)
+        
+        for (i, payload) in payloads.enumerated() {
+            let seq = sequence
+            var packet = header(marker: i == payloads.count - 1, timestamp: rtpTimestamp, captureMicros: captureMicros)
+            packet.append(contentsOf: payload)
+            
+            historyLock.lock()
+            history[Int(seq) % historySize] = packet
+            historyLock.unlock()
+            
+            transmit(packet, on: connection)
+        }
+    }
+    
+    // NACK from the receiver (beacon queue): resend what is still in the
+    // history, marked with the retransmission payload type
+    func retransmit(ssrc: UInt32, sequences: [UInt16]) {
+        guard ssrc == self.ssrc, let connection = connection, connection.state == .ready else { return }
+        for seq in sequences {
+            historyLock.lock()
+            let stored = history[Int(seq) % historySize]
+            historyLock.unlock()
+            
+            guard var packet = stored, packet.count >= 12,
+                  UInt16(packet[2]) << 8 | UInt16(packet[3]) == seq else { continue }
+            packet[1] = (packet[1] & 0x80) | retransmissionPayloadType
+            transmit(packet, on: connection)
+        }
+    }
+    
+    private func transmit(_ packet: Data, on connection: NWConnection) {
+        pendingPackets += 1
+        connection.send(content: packet, completion: .contentProcessed({ [weak self] error in
+            self?.queue.async {
+                self?.pendingPackets -= 1
+            }
+            if let error = error {
+                self?.logger?("RTP send error: \(error)")
+            }
+        }))
+    }
+    
+    // 12 byte fixed header + 16 byte extension carrying the capture time
+    private func header(marker: Bool, timestamp: UInt32, captureMicros: UInt64) -> Data {
+        var h = [UInt8]()
+        h.reserveCapacity(28)
+        h.append(0x90) // V=2, X=1
+        h.append((marker ? 0x80 : 0) | payloadType)
+        appendBigEndian(&h, UInt64(sequence), bytes: 2)
+        appendBigEndian(&h, UInt64(timestamp), bytes: 4)
+        appendBigEndian(&h, UInt64(ssrc), bytes: 4)
+        sequence &+= 1
+        
+        h += [0xBE, 0xDE, 0x00, 0x03] // One-byte extensions, 3 words
+        h.append((1 << 4) | (8 - 1)) // ID 1, 8 bytes
+        appendBigEndian(&h, captureMicros, bytes: 8)
+        h += [0, 0, 0] // Padding
+        return Data(h)
+    }
+    
+    private func appendBigEndian(_ out: inout [UInt8], _ value: UInt64, bytes: Int) {
+        for i in (0..<bytes).reversed() {
+            out.append(UInt8(truncatingIfNeeded: value >> (8 * UInt64(i))))
+        }
+    }
+    
+    private func packetize(_ nals: [[UInt8]]) -> [[UInt8]] {
+        var payloads: [[UInt8]] = []
+        var aggregate: [[UInt8]] = []
+        var aggregateBytes = 1 // STAP-A NAL header
+        
+        func flushAggregate() {
+            if aggregate.count == 1 {
+                payloads.append(aggregate[0]) // Single NAL unit packet
+            } else if aggregate.count > 1 {
+                var forbidden: UInt8 = 0
+                var nri: UInt8 = 0
+                for nal in aggregate {
+                    forbidden |= nal[0] & 0x80
+                    nri = max(nri, nal[0] & 0x60)
+                }
+                var stap: [UInt8] = [forbidden | nri | 24]
+                for nal in aggregate {
+                    stap.append(UInt8(nal.count >> 8))
+                    stap.append(UInt8(nal.count & 0xFF))
+                    stap += nal
+                }
+                payloads.append(stap)
+            }
+            aggregate.removeAll()
+            aggregateBytes = 1
+        }
+        
+        for nal in nals where !nal.isEmpty {
+            if 1 + 2 + nal.count <= maxPayload {
+                if aggregateBytes + 2 + nal.count > maxPayload {
+                    flushAggregate()
+                }
+                aggregate.append(nal)
+                aggregateBytes += 2 + nal.count
+                continue
+            }
+            
+            // FU-A: the NAL header is rebuilt from the indicator and FU header
+            flushAggregate()
+            let indicator = (nal[0] & 0xE0) | 28
+            let type = nal[0] & 0x1F
+            var offset = 1
+            while offset < nal.count {
+                let chunk = min(maxPayload - 2, nal.count - offset)
+                var fu: UInt8 = type
+                if offset == 1 { fu |= 0x80 } // Start
+                if offset + chunk == nal.count { fu |= 0x40 } // End
+                var payload: [UInt8] = [indicator, fu]
+                payload += nal[offset..<(offset + chunk)]
+                payloads.append(payload)
+                offset += chunk
+            }
+        }
+        flushAggregate()
+        return payloads
+    }
 }
 
 // MARK: - Active Discovery Listener
@@ -1025,6 +1368,11 @@ class BeaconListener {
     private let queue = DispatchQueue(label: "com.antigravity.beacon")
     
     var onLog: ((String) -> Void)?
+    // RTP feedback from the receiver, with the stream's SSRC
+    var onNack: ((UInt32, [UInt16]) -> Void)?
+    var onKeyframeRequest: ((UInt32) -> Void)?
+    // Rate control, either transport: SSRC (0 over TCP), bit/s, frames/s
+    var onBitrateTarget: ((UInt32, UInt32, Int) -> Void)?
     
     init(port: UInt16, deviceName: String) {
         self.port = port
@@ -1118,10 +1466,45 @@ class BeaconListener {
             } else if data[4] == 0x03 { // SYNC_REQUEST
                 handleSyncRequest(data, connection: connection)
                 return
+            } else if data[4] == 0x05 { // NACK
+                handleNack([UInt8](data))
+            } else if data[4] == 0x06 && data.count >= 9 { // PLI
+                let bytes = [UInt8](data)
+                onKeyframeRequest?(readLE32(bytes, at: 5))
+            } else if data[4] == 0x07 && data.count >= 14 { // BITRATE_TARGET
+                // Magic(4) + Type(1)=0x07 + SSRC(4) + Bitrate(4) + FPS(1)
+                let bytes = [UInt8](data)
+                onBitrateTarget?(readLE32(bytes, at: 5), readLE32(bytes, at: 9), Int(bytes[13]))
             }
         }
         
-        connection.cancel() // Close if not PING/SYNC
+        connection.cancel() // Nothing to answer
+    }
+    
+    // NACK: Magic(4) + Type(1)=0x05 + SSRC(4) + Count(1) + Count * {PID(2), BLP(2)}
+    // Bit i of BLP marks PID + i + 1 as lost too
+    private func handleNack(_ bytes: [UInt8]) {
+        guard bytes.count >= 10 else { return }
+        let ssrc = readLE32(bytes, at: 5)
+        let count = Int(bytes[9])
+        guard bytes.count >= 10 + count * 4 else { return }
+        
+        var sequences: [UInt16] = []
+        for entry in 0..<count {
+            let offset = 10 + entry * 4
+            let pid = UInt16(bytes[offset]) | UInt16(bytes[offset + 1]) << 8
+            let blp = UInt16(bytes[offset + 2]) | UInt16(bytes[offset + 3]) << 8
+            sequences.append(pid)
+            for bit in 0..<16 where blp & (1 << bit) != 0 {
+                sequences.append(pid &+ UInt16(bit + 1))
+            }
+        }
+        onNack?(ssrc, sequences)
+    }
+    
+    private func readLE32(_ bytes: [UInt8], at offset: Int) -> UInt32 {
+        return UInt32(bytes[offset]) | UInt32(bytes[offset + 1]) << 8 |
+            UInt32(bytes[offset + 2]) << 16 | UInt32(bytes[offset + 3]) << 24
     }
     
     private func handleSyncRequest(_ data: Data, connection: NWConnection) {
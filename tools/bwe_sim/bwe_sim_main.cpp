@@ -0,0 +1,246 @@
+// Bandwidth estimator simulator: one phone streaming through a bottleneck
+// whose rate changes in phases, with the receiver's BandwidthEstimator
+// steering the encoder over a delayed feedback path. Deterministic: time is
+// simulated in 1 ms ticks and the frame sizes come from a seeded generator.
+//
+// The encoder hits its target on average, with per-picture noise and an IDR
+// three times the size of a P picture every second; each picture leaves the
+// phone in one burst, as VideoToolbox output does. The link is a drop-tail
+// FIFO. Every phase must end with the link mostly used and no standing
+// queue (the wait of each picture's first packet, behind the pictures
+// before it), or the run fails.
+//
+//   bwe_sim [--phases MBPS:S,...] [--delay MS] [--fps N] [--seed N]
+#include "BandwidthEstimator.h"
+#include "Log.h"
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+struct Phase {
+  double mbps;
+  double seconds;
+};
+
+// Capacity rises, collapses, then rises past the start again
+static const Phase DEFAULT_PHASES[] = {{4.0, 30}, {1.5, 30}, {6.0, 40}};
+
+static const size_t PACKET_BYTES = 1200;
+static const int GOP_SECONDS = 1;
+static const double IDR_WEIGHT = 3.0;
+static const double FRAME_NOISE = 0.2; // +-20% per picture
+
+// Drop-tail limit of the bottleneck, in time to drain
+static const int64_t MAX_QUEUE_US = 500000;
+
+// Pass criteria, over the second half of each phase
+static const double MIN_UTILISATION = 0.6;
+static const double MAX_STANDING_QUEUE_MS = 60;
+
+struct InFlight {
+  int64_t send_us;
+  int64_t arrival_us;
+  size_t bytes;
+};
+
+struct Feedback {
+  int64_t due_us;
+  uint32_t bps;
+  int fps;
+};
+
+struct PhaseResult {
+  uint64_t bits = 0;  // Delivered in the second half
+  std::vector<double> waits_ms; // First-packet queue waits, ditto
+  uint64_t dropped = 0;
+};
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static bool parse_phases(const std::string &spec, std::vector<Phase> *out) {
+  std::stringstream ss(spec);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    Phase p;
+    if (sscanf(item.c_str(), "%lf:%lf", &p.mbps, &p.seconds) != 2 ||
+        p.mbps <= 0 || p.seconds <= 0)
+      return false;
+    out->push_back(p);
+  }
+  return !out->empty();
+}
+
+static void usage() {
+  std::cerr << "Usage: bwe_sim [--phases MBPS:S,...] [--delay MS] [--fps N] "
+               "[--seed N]\n";
+}
+
+int main(int argc, char **argv) {
+  std::vector<Phase> phases;
+  double delayMs = 20; // One way, both directions
+  int maxFps = 60;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--phases" && hasValue) {
+      if (!parse_phases(argv[++i], &phases)) {
+        usage();
+        return 2;
+      }
+    } else if (arg == "--delay" && hasValue) {
+      delayMs = atof(argv[++i]);
+    } else if (arg == "--fps" && hasValue) {
+      maxFps = atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (phases.empty())
+    phases.assign(std::begin(DEFAULT_PHASES), std::end(DEFAULT_PHASES));
+  if (delayMs < 0 || maxFps <= 0) {
+    usage();
+    return 2;
+  }
+
+  BweConfig config;
+  config.max_fps = maxFps;
+  BandwidthEstimator bwe(config);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> noise(1 - FRAME_NOISE,
+                                               1 + FRAME_NOISE);
+  const int64_t delayUs = (int64_t)(delayMs * 1000);
+
+  // Sender
+  uint32_t encoderBps = config.start_bps;
+  int encoderFps = maxFps;
+  int64_t nextFrameUs = 0;
+  int64_t lastIdrUs = -GOP_SECONDS * 1000000LL;
+
+  // Link and feedback path
+  int64_t linkFreeUs = 0;
+  std::deque<InFlight> inFlight;
+  std::deque<Feedback> feedback;
+  uint32_t lostPending = 0;
+
+  bool ok = true;
+  int64_t phaseStartUs = 0;
+  uint64_t sentBits = 0, deliveredBits = 0;
+  double maxWaitMs = 0;
+  for (size_t ph = 0; ph < phases.size(); ph++) {
+    const Phase &phase = phases[ph];
+    const double linkBps = phase.mbps * 1e6;
+    const int64_t phaseEndUs = phaseStartUs + (int64_t)(phase.seconds * 1e6);
+    const int64_t settledUs = (phaseStartUs + phaseEndUs) / 2;
+    PhaseResult result;
+
+    for (int64_t nowUs = phaseStartUs; nowUs < phaseEndUs; nowUs += 1000) {
+      while (!feedback.empty() && feedback.front().due_us <= nowUs) {
+        encoderBps = feedback.front().bps;
+        encoderFps = std::min(maxFps, std::max(1, feedback.front().fps));
+        feedback.pop_front();
+      }
+
+      if (nowUs >= nextFrameUs) {
+        double perFrame = encoderBps / 8.0 / encoderFps;
+        int gop = encoderFps * GOP_SECONDS;
+        double pUnit = perFrame * gop / (gop - 1 + IDR_WEIGHT);
+        bool idr = nowUs - lastIdrUs >= GOP_SECONDS * 1000000LL;
+        if (idr)
+          lastIdrUs = nowUs;
+        size_t bytes =
+            std::max<size_t>(1, (size_t)(pUnit * (idr ? IDR_WEIGHT : 1.0) *
+                                         noise(rng)));
+        bool first = true;
+        for (size_t off = 0; off < bytes; off += PACKET_BYTES) {
+          size_t size = std::min(PACKET_BYTES, bytes - off);
+          sentBits += size * 8;
+          int64_t startUs = std::max(nowUs, linkFreeUs);
+          if (startUs - nowUs > MAX_QUEUE_US) {
+            lostPending++;
+            result.dropped++;
+            continue;
+          }
+          if (first && nowUs >= settledUs)
+            result.waits_ms.push_back((startUs - nowUs) / 1000.0);
+          first = false;
+          linkFreeUs = startUs + (int64_t)(size * 8 * 1e6 / linkBps);
+          inFlight.push_back({nowUs, linkFreeUs + delayUs, size});
+        }
+        nextFrameUs += 1000000 / encoderFps;
+      }
+
+      while (!inFlight.empty() && inFlight.front().arrival_us <= nowUs) {
+        const InFlight &p = inFlight.front();
+        if (lostPending) {
+          // The receiver sees the gap in the sequence once this one lands
+          bwe.on_lost(lostPending);
+          lostPending = 0;
+        }
+        bwe.on_packet(p.send_us, p.arrival_us, p.bytes);
+        deliveredBits += p.bytes * 8;
+        if (p.send_us >= settledUs)
+          result.bits += p.bytes * 8;
+        uint32_t bps;
+        int fps;
+        if (bwe.poll(p.arrival_us, &bps, &fps))
+          feedback.push_back({p.arrival_us + delayUs, bps, fps});
+        inFlight.pop_front();
+      }
+
+      double queueMs = std::max<int64_t>(0, linkFreeUs - nowUs) / 1000.0;
+      maxWaitMs = std::max(maxWaitMs, queueMs);
+      if ((nowUs + 1000) % 1000000 == 0) {
+        static const char *SIGNALS[] = {"normal", "overuse", "underuse"};
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2) << "[t=" << std::setw(3)
+           << (nowUs + 1000) / 1000000 << "s] link " << phase.mbps
+           << " | target " << bwe.target_bps() / 1e6 << " Mbit/s "
+           << bwe.target_fps() << " fps | sent " << sentBits / 1e6
+           << " | delivered " << deliveredBits / 1e6 << " | queue "
+           << std::setprecision(1) << maxWaitMs << "ms | trend "
+           << bwe.trend_ms() << "/" << bwe.threshold_ms() << " "
+           << SIGNALS[bwe.signal()] << "\n";
+        log_msg(ss.str());
+        sentBits = deliveredBits = 0;
+        maxWaitMs = 0;
+      }
+    }
+
+    double settledS = (phaseEndUs - settledUs) / 1e6;
+    double utilisation = result.bits / (linkBps * settledS);
+    double p95 = percentile(result.waits_ms, 0.95);
+    bool pass = utilisation >= MIN_UTILISATION && p95 <= MAX_STANDING_QUEUE_MS;
+    ok = ok && pass;
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "[Phase " << ph + 1 << "] "
+       << phase.mbps << " Mbit/s for " << phase.seconds << "s | settled: "
+       << 100.0 * utilisation << "% used, standing queue p95 " << p95
+       << "ms | dropped " << result.dropped << " | "
+       << (pass ? "ok" : "FAILED") << "\n";
+    log_msg(ss.str());
+    phaseStartUs = phaseEndUs;
+  }
+
+  std::stringstream ss;
+  ss << "Overuse events: " << bwe.overuses() << "\n";
+  log_msg(ss.str());
+  if (!ok)
+    log_err("Estimator did not converge on every phase\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+// Colour conversion benchmark: YUV -> BGRA time per frame through the
+// ConvertPool, against the number of threads and the band size, at 1080p
+// and 4K. Each pool's output is compared byte for byte with a plain
+// single-threaded yuv_to_bgra() of the same frame; a mismatch fails the
+// run, so this doubles as a check of the band split and the barrier.
+//
+// libswscale, which the in-tree kernels replaced, is timed on the same
+// frames (one thread, the flags the decoder used) and its output compared
+// with ours: the largest per-channel difference and the share of bytes
+// that differ. Those are reported, not checked; the two round differently.
+//
+//   convert_bench [--threads N,...] [--band-rows N,...] [--seconds S]
+//                 [--nv12]
+#include "ColorConvert.h"
+#include "ConvertPool.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libswscale/swscale.h>
+}
+
+struct Resolution {
+  const char *name;
+  int width;
+  int height;
+};
+
+static const Resolution RESOLUTIONS[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4K", 3840, 2160},
+};
+
+// Camera-like content: smooth gradients plus noise, so every kernel path
+// (clamping included) gets exercised
+struct Frame {
+  std::vector<uint8_t> planes[3];
+  YuvImage image;
+};
+
+static void make_frame(const Resolution &r, bool nv12, std::mt19937 &rng,
+                       Frame *f) {
+  int cw = r.width / 2, ch = r.height / 2;
+  f->planes[0].resize((size_t)r.width * r.height);
+  f->planes[1].resize((size_t)cw * ch * (nv12 ? 2 : 1));
+  f->planes[2].resize(nv12 ? 0 : (size_t)cw * ch);
+  std::uniform_int_distribution<int> noise(-24, 24);
+  for (int y = 0; y < r.height; y++) {
+    for (int x = 0; x < r.width; x++) {
+      int v = (x * 255 / r.width + y * 255 / r.height) / 2 + noise(rng);
+      f->planes[0][(size_t)y * r.width + x] =
+          (uint8_t)std::min(255, std::max(0, v));
+    }
+  }
+  for (size_t i = 0; i < f->planes[1].size(); i++)
+    f->planes[1][i] = (uint8_t)(128 + noise(rng) * 4);
+  for (size_t i = 0; i < f->planes[2].size(); i++)
+    f->planes[2][i] = (uint8_t)(128 + noise(rng) * 4);
+
+  YuvImage &img = f->image;
+  img.layout = nv12 ? YUV_LAYOUT_NV12 : YUV_LAYOUT_I420;
+  img.width = r.width;
+  img.height = r.height;
+  img.plane[0] = f->planes[0].data();
+  img.plane[1] = f->planes[1].data();
+  img.plane[2] = nv12 ? nullptr : f->planes[2].data();
+  img.stride[0] = r.width;
+  img.stride[1] = nv12 ? r.width : cw;
+  img.stride[2] = nv12 ? 0 : cw;
+}
+
+static std::vector<int> parse_list(const char *s) {
+  std::vector<int> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    out.push_back(atoi(item.c_str()));
+  return out;
+}
+
+static void usage() {
+  std::cerr << "Usage: convert_bench [--threads N,...] [--band-rows N,...] "
+               "[--seconds S] [--nv12]\n";
+}
+
+// Milliseconds per frame, converting for about `seconds`
+static double time_frames(ConvertPool *pool, const YuvImage &img,
+                          uint8_t *dst, double seconds) {
+  int stride = img.width * 4;
+  pool->convert(img, YUV_MATRIX_BT709, YUV_RANGE_LIMITED, dst, stride, 0,
+                img.height); // Warm-up: page in the destination
+  int frames = 0;
+  auto begin = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    pool->convert(img, YUV_MATRIX_BT709, YUV_RANGE_LIMITED, dst, stride, 0,
+                  img.height);
+    frames++;
+    elapsed = std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - begin)
+                  .count();
+  } while (elapsed < seconds);
+  return elapsed * 1000.0 / frames;
+}
+
+struct SwsResult {
+  double ms = 0;        // Per frame
+  int max_error = 0;    // Largest |sws - ours| over B, G, R
+  double differing = 0; // Share of B, G, R bytes that differ
+};
+
+// Returns false if libswscale cannot do the conversion as yuv_to_bgra()
+// does (BT.709 limited range in, full range BGRA out)
+static bool time_sws(const Frame &f, const std::vector<uint8_t> &reference,
+                     double seconds, SwsResult *result) {
+  const YuvImage &img = f.image;
+  AVPixelFormat format = img.layout == YUV_LAYOUT_NV12 ? AV_PIX_FMT_NV12
+                                                       : AV_PIX_FMT_YUV420P;
+  SwsContext *ctx =
+      sws_getContext(img.width, img.height, format, img.width, img.height,
+                     AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+  if (!ctx)
+    return false;
+  const int *bt709 = sws_getCoefficients(SWS_CS_ITU709);
+  if (sws_setColorspaceDetails(ctx, bt709, 0, bt709, 1, 0, 1 << 16,
+                               1 << 16) < 0) {
+    sws_freeContext(ctx);
+    return false;
+  }
+
+  std::vector<uint8_t> out(reference.size());
+  const uint8_t *src[4] = {img.plane[0], img.plane[1], img.plane[2], NULL};
+  int srcStride[4] = {img.stride[0], img.stride[1], img.stride[2], 0};
+  uint8_t *dst[4] = {out.data(), NULL, NULL, NULL};
+  int dstStride[4] = {img.width * 4, 0, 0, 0};
+
+  sws_scale(ctx, src, srcStride, 0, img.height, dst, dstStride); // Warm-up
+  int frames = 0;
+  auto begin = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    sws_scale(ctx, src, srcStride, 0, img.height, dst, dstStride);
+    frames++;
+    elapsed = std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - begin)
+                  .count();
+  } while (elapsed < seconds);
+  sws_freeContext(ctx);
+  result->ms = elapsed * 1000.0 / frames;
+
+  size_t differing = 0, compared = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    if (i % 4 == 3)
+      continue; // Alpha
+    int error = std::abs((int)out[i] - (int)reference[i]);
+    result->max_error = std::max(result->max_error, error);
+    differing += error != 0;
+    compared++;
+  }
+  result->differing = compared ? (double)differing / compared : 0;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::vector<int> threadCounts;
+  std::vector<int> bandRows;
+  double seconds = 0.5; // Per figure
+  bool nv12 = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--threads" && hasValue) {
+      threadCounts = parse_list(argv[++i]);
+    } else if (arg == "--band-rows" && hasValue) {
+      bandRows = parse_list(argv[++i]);
+    } else if (arg == "--seconds" && hasValue) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--nv12") {
+      nv12 = true;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  int cores = std::max(1, (int)std::thread::hardware_concurrency());
+  if (threadCounts.empty()) {
+    for (int n = 1; n < cores; n *= 2)
+      threadCounts.push_back(n);
+    threadCounts.push_back(cores);
+  }
+  if (bandRows.empty())
+    bandRows = {16, 32, 64};
+  for (int n : threadCounts) {
+    if (n < 1) {
+      usage();
+      return 2;
+    }
+  }
+
+  log_msg(std::string("Kernel: ") + yuv_to_bgra_backend() + ", " +
+          std::to_string(cores) + " cores, " + (nv12 ? "NV12" : "I420") +
+          "\n");
+  std::mt19937 rng(1);
+  bool ok = true;
+
+  for (const Resolution &r : RESOLUTIONS) {
+    Frame frame;
+    make_frame(r, nv12, rng, &frame);
+    size_t bytes = (size_t)r.width * r.height * 4;
+    std::vector<uint8_t> reference(bytes), out(bytes);
+    yuv_to_bgra(frame.image, YUV_MATRIX_BT709, YUV_RANGE_LIMITED,
+                reference.data(), r.width * 4, 0, r.height);
+
+    // Speed-ups are against one thread, no pool
+    ConvertPool baseline;
+    baseline.start(1, 0);
+    double single = time_frames(&baseline, frame.image, out.data(), seconds);
+
+    SwsResult sws;
+    std::stringstream ref;
+    ref << std::fixed << std::setprecision(2) << std::left << std::setw(6)
+        << r.name << std::right << " | libswscale | ";
+    if (time_sws(frame, reference, seconds, &sws)) {
+      ref << std::setw(6) << sws.ms << " ms/frame | in-tree x"
+          << sws.ms / single << " faster (one thread) | max error "
+          << sws.max_error << " | " << std::setprecision(1)
+          << 100.0 * sws.differing << "% of bytes differ\n";
+    } else {
+      ref << "unavailable for this conversion\n";
+    }
+    log_msg(ref.str());
+
+    for (int rows : bandRows) {
+      for (int n : threadCounts) {
+        ConvertPool pool;
+        pool.start(n, rows);
+        memset(out.data(), 0, bytes);
+        double ms = time_frames(&pool, frame.image, out.data(), seconds);
+        bool match = memcmp(out.data(), reference.data(), bytes) == 0;
+        ok = ok && match;
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2) << std::left
+           << std::setw(6) << r.name << std::right << " | " << std::setw(3)
+           << pool.band_rows() << "-row bands | " << std::setw(2)
+           << pool.threads() << " threads | " << std::setw(6) << ms
+           << " ms/frame | x" << single / ms << " | "
+           << std::setprecision(0) << 100.0 * single / ms / n
+           << "% efficiency" << (match ? "" : " | OUTPUT MISMATCH") << "\n";
+        log_msg(ss.str());
+      }
+    }
+  }
+
+  log_msg(ok ? "All outputs match the single-threaded conversion\n"
+             : "FAILED: pool output differs from yuv_to_bgra()\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+// Decode profile benchmark: replays a wire capture (receiver_core --capture)
+// through the receiver's own ring parser, access-unit assembler and Decoder
+// once per decode profile, and reports how long each picture spent between
+// avcodec_send_packet and coming back out as a frame.
+//
+// Pictures are fed at their recorded arrival times, so frame threads see the
+// same gaps they would live; --fast feeds them back to back instead, which
+// is the throughput figure. Frames still inside the decoder when the capture
+// ends are reported as held: with frame threads that is the pipeline depth.
+// Nothing is published (no frame bus is created), so conversion is left out.
+//
+//   decode_bench CAPTURE.agcw [--profile NAME ...] [--threads N] [--fast]
+#include "AccessUnit.h"
+#include "ClockSync.h"
+#include "Decoder.h"
+#include "FrameBus.h"
+#include "Log.h"
+#include "PacketPool.h"
+#include "RecvRing.h"
+#include "WireCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Result {
+  uint64_t units = 0;  // Access units sent
+  uint64_t frames = 0; // Pictures out, matched back to their packet
+  std::vector<double> in_out_ms;
+  double seconds = 0;
+};
+
+static void usage() {
+  std::cerr << "Usage: decode_bench CAPTURE.agcw [--profile "
+               "ultra-low-latency|balanced|throughput ...] [--threads N] "
+               "[--fast]\n";
+}
+
+// The Session ingest path without the queue: NALs into units, units
+// straight into the decoder on this thread
+class Replay {
+public:
+  Replay(Decoder *decoder, PacketPool *pool, Result *result)
+      : m_decoder(decoder), m_assembler(pool), m_result(result) {}
+
+  void connect() {
+    m_ring.reset();
+    m_assembler.discard();
+    m_decoder->reset_stream();
+  }
+
+  bool data(const std::vector<uint8_t> &chunk) {
+    size_t space = 0;
+    uint8_t *tail = m_ring.prepare(&space);
+    if (chunk.size() > space) {
+      log_err("Capture chunk larger than the receive ring\n");
+      return false;
+    }
+    memcpy(tail, chunk.data(), chunk.size());
+    m_ring.commit(chunk.size());
+
+    WireFrame frame;
+    RecvRing::ParseResult res;
+    while ((res = m_ring.next(&frame)) == RecvRing::FRAME_READY) {
+      if (frame.size == 0) {
+        end_picture(); // End-of-picture marker, as Session handles it
+        continue;
+      }
+      if (m_assembler.starts_new_unit(frame.payload, frame.size,
+                                      frame.timestamp_us))
+        submit();
+      if (!m_assembler.append(frame.payload, frame.size, frame.timestamp_us))
+        m_assembler.discard();
+    }
+    if (res != RecvRing::NEED_MORE) {
+      log_err("Corrupt wire stream in capture\n");
+      return false;
+    }
+    return true;
+  }
+
+  // Closes the pending picture, if it has any slices
+  void end_picture() {
+    if (m_assembler.pending().has_slices())
+      submit();
+  }
+
+private:
+  void submit() {
+    if (m_assembler.empty())
+      return;
+    AccessUnit au;
+    m_assembler.take(&au);
+    m_decoder->reset_stats();
+    m_decoder->decode(au);
+    release_access_unit(&au);
+
+    const DecodeStats &stats = m_decoder->stats();
+    m_result->units += stats.units;
+    // Normally one picture per call; more only while a frame-threaded
+    // decoder drains after a gap
+    if (stats.in_out_frames) {
+      double ms = stats.in_out_us / 1000.0 / stats.in_out_frames;
+      for (uint32_t i = 0; i < stats.in_out_frames; i++)
+        m_result->in_out_ms.push_back(ms);
+      m_result->frames += stats.in_out_frames;
+    }
+  }
+
+  Decoder *m_decoder;
+  AccessUnitAssembler m_assembler;
+  RecvRing m_ring;
+  Result *m_result;
+};
+
+static bool run(const std::string &path, DecodeProfile profile, int threads,
+                bool fast, Result *result) {
+  CaptureReader reader;
+  std::string error;
+  if (!reader.open(path, &error)) {
+    log_err("Error: " + error + "\n");
+    return false;
+  }
+
+  PacketPool pool;
+  FrameBus bus; // Never created: decode only
+  ClockSync clock;
+  Decoder decoder(&pool, &bus, &clock);
+  decoder.set_thread_count(threads);
+  decoder.set_profile(profile);
+  if (!decoder.open())
+    return false;
+
+  Replay replay(&decoder, &pool, result);
+  CaptureRecord record;
+  auto begin = std::chrono::steady_clock::now();
+  while (reader.next(&record)) {
+    if (!fast) {
+      std::this_thread::sleep_until(
+          begin + std::chrono::microseconds(record.arrival_us -
+                                            reader.first_arrival_us()));
+    }
+    if (record.type == CAPTURE_CONNECT) {
+      replay.connect();
+    } else if (record.type == CAPTURE_DATA) {
+      if (!replay.data(record.data))
+        return false;
+    } else if (record.type == CAPTURE_DISCONNECT) {
+      replay.end_picture();
+    }
+  }
+  replay.end_picture(); // Capture cut short without a disconnect
+  result->seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+  return true;
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty())
+    return 0;
+  size_t i = std::min(v.size() - 1, (size_t)(p * (double)v.size()));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+int main(int argc, char **argv) {
+  std::string path;
+  std::vector<DecodeProfile> profiles;
+  int threads = 0; // As the receiver: one per core
+  bool fast = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    DecodeProfile profile;
+    if (arg == "--profile" && hasValue) {
+      if (!parse_decode_profile(argv[++i], &profile)) {
+        usage();
+        return 2;
+      }
+      profiles.push_back(profile);
+    } else if (arg == "--threads" && hasValue) {
+      threads = atoi(argv[++i]);
+    } else if (arg == "--fast") {
+      fast = true;
+    } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+      path = arg;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (path.empty() || threads < 0) {
+    usage();
+    return 2;
+  }
+  if (profiles.empty()) {
+    for (int i = 0; i < DECODE_PROFILE_COUNT; i++)
+      profiles.push_back((DecodeProfile)i);
+  }
+
+  std::vector<Result> results(profiles.size());
+  for (size_t i = 0; i < profiles.size(); i++) {
+    if (!run(path, profiles[i], threads, fast, &results[i]))
+      return 1;
+  }
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2) << "\n"
+     << (fast ? "Back to back" : "Paced at capture arrival times") << ", "
+     << (threads ? std::to_string(threads) : std::string("auto"))
+     << " threads\n";
+  for (size_t i = 0; i < profiles.size(); i++) {
+    const Result &r = results[i];
+    ss << std::left << std::setw(18) << decode_profile_name(profiles[i])
+       << std::right << " in-out p50 " << percentile(r.in_out_ms, 0.50)
+       << " ms | p95 " << percentile(r.in_out_ms, 0.95) << " ms | max "
+       << percentile(r.in_out_ms, 1.0) << " ms | units " << r.units
+       << " | out " << r.frames << " | held " << r.units - r.frames
+       << " | " << std::setprecision(1)
+       << (r.seconds > 0 ? r.frames / r.seconds : 0) << " fps\n"
+       << std::setprecision(2);
+  }
+  log_msg(ss.str());
+  return 0;
+}
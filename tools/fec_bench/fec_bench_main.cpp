@@ -0,0 +1,355 @@
+// FEC benchmark: encode/decode throughput of the RTP FEC layer at the
+// bitrates the phone sends, and how much of a lossy link it repairs.
+//
+// Pictures are synthetic (one random IDR-sized or P-sized NAL each), but go
+// through the real RtpPacketizer, RtpFecEncoder and RtpFecDecoder, and every
+// rebuilt packet is checked byte for byte against the original: a mismatch
+// fails the run, so this doubles as a codec self-check.
+//
+//   fec_bench [--fec K:M ...] [--seconds S] [--seed N]
+#include "Fec.h"
+#include "Log.h"
+#include "Rtp.h"
+#include "RtpFec.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+struct Profile {
+  const char *name;
+  double mbps; // Encoder target bitrate
+  double fps;
+};
+
+// Roughly what VideoEncoder asks VideoToolbox for
+static const Profile PROFILES[] = {
+    {"720p60", 4.0, 60.0},
+    {"1080p60", 10.0, 60.0},
+};
+
+// One IDR per second, sized like ten P pictures
+static const int GOP = 60;
+static const double IDR_WEIGHT = 10.0;
+
+struct FecConfig {
+  int k;
+  int m;
+};
+
+struct Clip {
+  std::vector<std::vector<std::vector<uint8_t>>> pictures; // Packets
+  uint64_t bytes = 0;
+  uint64_t packets = 0;
+};
+
+// Packetizes a second of synthetic pictures at the profile's bitrate
+static Clip make_clip(const Profile &p, size_t mtu, std::mt19937 &rng) {
+  Clip clip;
+  double perPicture = p.mbps * 1e6 / 8 / p.fps;
+  double pUnit = perPicture * GOP / (GOP - 1 + IDR_WEIGHT);
+  RtpPacketizer packetizer(0x46454342, mtu);
+  std::vector<uint8_t> nal;
+  for (int i = 0; i < (int)p.fps; i++) {
+    bool idr = i % GOP == 0;
+    nal.resize((size_t)(idr ? pUnit * IDR_WEIGHT : pUnit));
+    for (uint8_t &b : nal)
+      b = (uint8_t)rng();
+    nal[0] = idr ? 0x65 : 0x41;
+
+    uint32_t ts = (uint32_t)(i * RTP_CLOCK_RATE / p.fps);
+    packetizer.begin_picture(ts, (uint64_t)i * 16667);
+    packetizer.add_nal(nal.data(), (uint32_t)nal.size());
+    packetizer.finish_picture();
+    std::vector<std::vector<uint8_t>> packets;
+    for (size_t j = 0; j < packetizer.packet_count(); j++) {
+      packets.push_back(packetizer.packet(j));
+      clip.bytes += packets.back().size();
+    }
+    clip.packets += packets.size();
+    clip.pictures.push_back(std::move(packets));
+  }
+  return clip;
+}
+
+static uint16_t seq_of(const uint8_t *packet) {
+  return (uint16_t)((packet[2] << 8) | packet[3]);
+}
+
+// Gilbert model: runs of losses with the given mean length; a mean of 1
+// is independent loss
+class LossModel {
+public:
+  LossModel(double lossPct, double meanBurst, uint32_t seed)
+      : m_rng(seed), m_bad(false) {
+    double loss = lossPct / 100.0;
+    m_leaveBad = 1.0 / std::max(1.0, meanBurst);
+    m_enterBad = loss >= 1.0 ? 1.0 : loss * m_leaveBad / (1.0 - loss);
+  }
+
+  bool lose() {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(m_rng);
+    m_bad = m_bad ? u >= m_leaveBad : u < m_enterBad;
+    return m_bad;
+  }
+
+private:
+  std::mt19937 m_rng;
+  bool m_bad;
+  double m_enterBad;
+  double m_leaveBad;
+};
+
+struct RecoveryResult {
+  uint64_t lost = 0;        // Media packets the link dropped
+  uint64_t unrecovered = 0; // ... and FEC could not rebuild
+  uint64_t pictures_lost = 0;
+  uint64_t repair_bytes = 0;
+  bool mismatch = false;
+};
+
+// Runs `loops` passes of the clip through the link. The decoder sees the
+// surviving media, then the surviving repair packets, as on the wire.
+static RecoveryResult simulate(const Clip &clip, const FecConfig *fec,
+                               LossModel &link, int loops) {
+  RecoveryResult r;
+  std::unique_ptr<RtpFecEncoder> encoder;
+  if (fec)
+    encoder.reset(new RtpFecEncoder(0x46454342, fec->k, fec->m));
+  RtpFecDecoder decoder;
+  std::vector<bool> have;
+
+  auto check_rebuilt = [&](const std::vector<std::vector<uint8_t>> &media,
+                           uint16_t first) {
+    for (size_t i = 0; i < decoder.rebuilt_count(); i++) {
+      const std::vector<uint8_t> &pkt = decoder.rebuilt(i);
+      size_t j = (uint16_t)(seq_of(pkt.data()) - first);
+      if (j >= media.size() || pkt != media[j]) {
+        r.mismatch = true;
+        continue;
+      }
+      have[j] = true;
+    }
+  };
+
+  for (int loop = 0; loop < loops; loop++) {
+    decoder.reset(); // The clip's sequence numbers come round again
+    for (const auto &media : clip.pictures) {
+      uint16_t first = seq_of(media[0].data());
+      have.assign(media.size(), false);
+      for (size_t j = 0; j < media.size(); j++) {
+        if (link.lose()) {
+          r.lost++;
+          continue;
+        }
+        have[j] = true;
+        decoder.add_media(media[j].data(), media[j].size(),
+                          seq_of(media[j].data()));
+        check_rebuilt(media, first);
+      }
+      if (encoder) {
+        encoder->begin_picture(0);
+        for (const auto &pkt : media)
+          encoder->add(pkt.data(), pkt.size());
+        encoder->finish_picture();
+        for (size_t i = 0; i < encoder->packet_count(); i++) {
+          const std::vector<uint8_t> &pkt = encoder->packet(i);
+          r.repair_bytes += pkt.size();
+          if (link.lose())
+            continue;
+          RtpHeader h;
+          rtp_parse_header(pkt.data(), pkt.size(), &h);
+          decoder.add_repair(pkt.data(), pkt.size(), h);
+          check_rebuilt(media, first);
+        }
+      }
+      uint64_t missing = 0;
+      for (bool b : have)
+        missing += b ? 0 : 1;
+      r.unrecovered += missing;
+      r.pictures_lost += missing ? 1 : 0;
+    }
+  }
+  return r;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t)
+      .count();
+}
+
+// Encode: the sender's work per picture. Decode: the worst case the group
+// can still repair, its first `repairs` media packets gone.
+static bool throughput(const Profile &p, const Clip &clip,
+                       const FecConfig &fec, double seconds) {
+  RtpFecEncoder encoder(0x46454342, fec.k, fec.m);
+  uint64_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  double encodeS;
+  do {
+    for (const auto &media : clip.pictures) {
+      encoder.begin_picture(0);
+      for (const auto &pkt : media)
+        encoder.add(pkt.data(), pkt.size());
+      encoder.finish_picture();
+    }
+    bytes += clip.bytes;
+  } while ((encodeS = seconds_since(start)) < seconds);
+  double encodeMBps = bytes / encodeS / 1e6;
+
+  // Pre-encode once so only the decoder is timed
+  std::vector<std::vector<std::vector<uint8_t>>> repairs;
+  std::vector<std::vector<RtpHeader>> repairHeaders;
+  for (const auto &media : clip.pictures) {
+    encoder.begin_picture(0);
+    for (const auto &pkt : media)
+      encoder.add(pkt.data(), pkt.size());
+    encoder.finish_picture();
+    repairs.emplace_back();
+    repairHeaders.emplace_back();
+    for (size_t i = 0; i < encoder.packet_count(); i++) {
+      repairs.back().push_back(encoder.packet(i));
+      RtpHeader h;
+      rtp_parse_header(encoder.packet(i).data(), encoder.packet(i).size(),
+                       &h);
+      repairHeaders.back().push_back(h);
+    }
+  }
+
+  RtpFecDecoder decoder;
+  uint64_t rebuilt = 0, dropped = 0;
+  bytes = 0;
+  start = std::chrono::steady_clock::now();
+  double decodeS;
+  do {
+    decoder.reset();
+    for (size_t f = 0; f < clip.pictures.size(); f++) {
+      const auto &media = clip.pictures[f];
+      // Groups as the encoder cut them: the first packets of each go
+      size_t n = media.size();
+      size_t groups = (n + fec.k - 1) / fec.k;
+      size_t first = 0;
+      for (size_t g = 0; g < groups; g++) {
+        size_t count = n / groups + (g < n % groups ? 1 : 0);
+        size_t drop =
+            std::max<size_t>(1, (fec.m * count + fec.k - 1) / fec.k);
+        for (size_t j = first; j < first + count; j++) {
+          if (j - first < drop) {
+            dropped++;
+            continue;
+          }
+          decoder.add_media(media[j].data(), media[j].size(),
+                            seq_of(media[j].data()));
+        }
+        first += count;
+      }
+      for (size_t i = 0; i < repairs[f].size(); i++) {
+        decoder.add_repair(repairs[f][i].data(), repairs[f][i].size(),
+                           repairHeaders[f][i]);
+        rebuilt += decoder.rebuilt_count();
+      }
+    }
+    bytes += clip.bytes;
+  } while ((decodeS = seconds_since(start)) < seconds);
+  double decodeMBps = bytes / decodeS / 1e6;
+
+  double linkMBps = p.mbps / 8;
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1) << "[Throughput] " << p.name
+     << " " << p.mbps << " Mbit/s | FEC " << fec.k << ":" << fec.m
+     << " | encode " << encodeMBps << " MB/s (" << std::setprecision(3)
+     << 100.0 * linkMBps / encodeMBps << "% of a core) | decode "
+     << std::setprecision(1) << decodeMBps << " MB/s ("
+     << std::setprecision(3) << 100.0 * linkMBps / decodeMBps
+     << "% of a core, " << rebuilt << "/" << dropped << " rebuilt)\n";
+  log_msg(ss.str());
+  return rebuilt == dropped;
+}
+
+static void usage() {
+  std::cerr << "Usage: fec_bench [--fec K:M ...] [--seconds S] [--seed N]\n";
+}
+
+int main(int argc, char **argv) {
+  std::vector<FecConfig> configs;
+  double seconds = 1.0; // Per throughput figure
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    FecConfig c;
+    if (arg == "--fec" && hasValue) {
+      if (sscanf(argv[++i], "%d:%d", &c.k, &c.m) != 2 || c.k < 1 ||
+          c.k > FEC_MAX_SOURCE || c.m < 1 || c.m > FEC_MAX_REPAIR) {
+        usage();
+        return 2;
+      }
+      configs.push_back(c);
+    } else if (arg == "--seconds" && hasValue) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (configs.empty())
+    configs = {{10, 1}, {10, 2}, {5, 2}, {20, 4}};
+
+  log_msg(std::string("GF(2^8) kernel: ") + fec_backend() + "\n");
+  std::mt19937 rng(seed);
+  size_t mtu = RTP_DEFAULT_MTU - RTP_FEC_OVERHEAD; // As stream_sender does
+  bool ok = true;
+
+  for (const Profile &p : PROFILES) {
+    Clip clip = make_clip(p, mtu, rng);
+    for (const FecConfig &c : configs)
+      ok = throughput(p, clip, c, seconds) && ok;
+  }
+
+  // Independent loss, then bursts: a Wi-Fi retry storm is the case that
+  // matters, and where single parity falls over
+  static const double LOSS_PCT[] = {1, 2, 5, 10};
+  static const double BURST[] = {1, 4};
+  const Profile &p = PROFILES[1];
+  Clip clip = make_clip(p, mtu, rng);
+  const int loops = 20;
+  for (double burst : BURST) {
+    for (double loss : LOSS_PCT) {
+      for (int c = -1; c < (int)configs.size(); c++) {
+        const FecConfig *fec = c < 0 ? nullptr : &configs[(size_t)c];
+        LossModel link(loss, burst, seed);
+        RecoveryResult r = simulate(clip, fec, link, loops);
+        ok = ok && !r.mismatch;
+
+        uint64_t packets = clip.packets * loops;
+        uint64_t pictures = clip.pictures.size() * loops;
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2) << "[Recovery] " << p.name
+           << " | loss " << loss << "% burst " << burst << " | FEC ";
+        if (fec)
+          ss << fec->k << ":" << fec->m;
+        else
+          ss << "off";
+        ss << " (+" << 100.0 * r.repair_bytes / (clip.bytes * loops)
+           << "%) | residual loss "
+           << 100.0 * r.unrecovered / packets << "% | rebuilt "
+           << (r.lost ? 100.0 * (r.lost - r.unrecovered) / r.lost : 100.0)
+           << "% | pictures lost " << 100.0 * r.pictures_lost / pictures
+           << "%" << (r.mismatch ? " | MISMATCH" : "") << "\n";
+        log_msg(ss.str());
+      }
+    }
+  }
+  if (!ok)
+    log_err("FEC self-check failed\n");
+  return ok ? 0 : 1;
+}
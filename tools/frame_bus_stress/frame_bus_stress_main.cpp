@@ -0,0 +1,222 @@
+// Frame bus stress test: one writer publishing through FrameBus as fast as
+// it can, several readers each with their own mapping of the section,
+// reading the newest slot the way the virtual camera does (seqlock begin,
+// copy, validate, retry).
+//
+// Every frame's size and content follow from its frame_id: geometry cycles
+// through landscape, portrait and 1080p, and each 64-bit word of the data
+// is frame_id * WORD_STEP + index, so the words of a frame add up to a
+// checksum known from the id alone. A copy the seqlock accepted whose
+// geometry or checksum does not match its frame_id is a torn frame; any
+// torn frame fails the run. --no-validate skips the seqlock check, which
+// shows the test does catch tearing (expect torn frames and a failure).
+//
+// POSIX only (shm_open), and the readers are threads rather than processes;
+// the section is mapped once per reader all the same.
+//
+//   frame_bus_stress [--readers N] [--seconds S] [--session N]
+//                    [--no-validate]
+#include "FrameBus.h"
+#include "Log.h"
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint64_t WORD_STEP = 0x9E3779B97F4A7C15ull;
+
+struct Geometry {
+  uint32_t width;
+  uint32_t height;
+};
+
+static const Geometry GEOMETRIES[] = {
+    {1280, 720}, {720, 1280}, {1920, 1080}, {640, 360}};
+static const int GEOMETRY_COUNT = sizeof(GEOMETRIES) / sizeof(GEOMETRIES[0]);
+
+static const Geometry &frame_geometry(uint64_t frameId) {
+  return GEOMETRIES[frameId % GEOMETRY_COUNT];
+}
+
+// Sum of frameId * WORD_STEP + i over i in [0, words), mod 2^64
+static uint64_t expected_checksum(uint64_t frameId, size_t words) {
+  uint64_t n = words;
+  uint64_t triangle = (n % 2 == 0) ? (n / 2) * (n - 1) : n * ((n - 1) / 2);
+  return n * frameId * WORD_STEP + triangle;
+}
+
+struct ReaderStats {
+  uint64_t frames = 0;  // Copies the seqlock accepted and were checked
+  uint64_t retries = 0; // Copies the seqlock rejected
+  uint64_t torn = 0;    // Accepted copies that did not match their id
+  uint64_t out_of_order = 0;
+};
+
+static std::atomic<bool> running(true);
+
+static void writer_func(FrameBus *bus, double seconds, uint64_t *published) {
+  SharedMemoryLayout *shm = bus->layout();
+  auto end = std::chrono::steady_clock::now() +
+             std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    uint64_t id = shm->write_sequence + 1; // What end_write will assign
+    const Geometry &g = frame_geometry(id);
+    FrameSlot *slot = bus->begin_write();
+    slot->width = g.width;
+    slot->height = g.height;
+    slot->stride = frame_nv12_stride(g.width);
+    slot->format = FRAME_FORMAT_NV12;
+    slot->color = 0;
+    slot->timestamp_us = id;
+    uint64_t *words = (uint64_t *)slot->data;
+    size_t count = frame_nv12_bytes(g.width, g.height) / 8;
+    uint64_t base = id * WORD_STEP;
+    for (size_t i = 0; i < count; i++)
+      words[i] = base + i;
+    bus->end_write(slot);
+    (*published)++;
+  }
+  running = false;
+}
+
+static void reader_func(const char *name, bool validate, ReaderStats *stats) {
+  int fd = shm_open(name, O_RDWR, 0); // Write: waiter_count only
+  if (fd < 0) {
+    log_err(std::string("Reader could not open ") + name + "\n");
+    stats->torn++;
+    return;
+  }
+  SharedMemoryLayout *shm =
+      (SharedMemoryLayout *)mmap(NULL, sizeof(SharedMemoryLayout),
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    log_err("Reader could not map the frame bus\n");
+    stats->torn++;
+    return;
+  }
+
+  FrameNotifyHandle notify = frame_notify_open();
+  std::vector<uint8_t> copy(FRAME_BUFFER_SIZE);
+  uint32_t seen = 0;
+  uint64_t lastId = 0;
+  while (running) {
+    if (!frame_notify_wait(shm, notify, seen, 10000))
+      continue;
+    seen = shm_load_acquire(&shm->write_sequence);
+
+    uint32_t index = shm_load_acquire(&shm->latest_slot) % FRAME_SLOT_COUNT;
+    const FrameSlot *slot = &shm->slots[index];
+    uint32_t sequence = frame_slot_read_begin(slot);
+    if (validate && (sequence & 1)) {
+      stats->retries++;
+      continue;
+    }
+    uint32_t width = slot->width, height = slot->height;
+    uint64_t id = slot->frame_id;
+    size_t bytes = frame_nv12_bytes(width, height);
+    if (bytes > FRAME_BUFFER_SIZE)
+      bytes = FRAME_BUFFER_SIZE; // Torn header; caught below
+    memcpy(copy.data(), (const void *)slot->data, bytes);
+    if (validate && !frame_slot_read_validate(slot, sequence)) {
+      stats->retries++;
+      continue;
+    }
+
+    stats->frames++;
+    const Geometry &g = frame_geometry(id);
+    uint64_t sum = 0;
+    const uint64_t *words = (const uint64_t *)copy.data();
+    for (size_t i = 0; i < bytes / 8; i++)
+      sum += words[i];
+    if (width != g.width || height != g.height ||
+        sum != expected_checksum(id, bytes / 8))
+      stats->torn++;
+    if (id < lastId)
+      stats->out_of_order++;
+    lastId = id;
+  }
+  frame_notify_close(notify);
+  munmap(shm, sizeof(SharedMemoryLayout));
+}
+
+static void usage() {
+  std::cerr << "Usage: frame_bus_stress [--readers N] [--seconds S] "
+               "[--session N] [--no-validate]\n";
+}
+
+int main(int argc, char **argv) {
+  int readers = 3;
+  double seconds = 5;
+  // Out of the way of a receiver running on the same machine
+  int session = FRAME_BUS_MAX_SESSIONS - 1;
+  bool validate = true;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--readers" && hasValue) {
+      readers = atoi(argv[++i]);
+    } else if (arg == "--seconds" && hasValue) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--session" && hasValue) {
+      session = atoi(argv[++i]);
+    } else if (arg == "--no-validate") {
+      validate = false;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (readers < 1 || seconds <= 0 || session < 0 ||
+      session >= FRAME_BUS_MAX_SESSIONS) {
+    usage();
+    return 2;
+  }
+
+  FrameBus bus;
+  if (!bus.create(session))
+    return 1;
+  char name[FRAME_BUS_NAME_SIZE];
+  frame_bus_name(name, sizeof(name), SHARED_MEMORY_POSIX_NAME, session);
+
+  std::vector<ReaderStats> stats(readers);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < readers; i++)
+    threads.emplace_back(reader_func, name, validate, &stats[i]);
+  uint64_t published = 0;
+  writer_func(&bus, seconds, &published);
+  for (auto &t : threads)
+    t.join();
+  bus.close();
+
+  std::stringstream ss;
+  ss << "Writer: " << published << " frames in " << seconds << " s, "
+     << FRAME_SLOT_COUNT << " slots"
+     << (validate ? "" : " (readers not validating)") << "\n";
+  uint64_t torn = 0, reads = 0;
+  for (int i = 0; i < readers; i++) {
+    const ReaderStats &s = stats[i];
+    ss << "Reader " << i << ": " << s.frames << " frames checked, "
+       << s.retries << " retries, " << s.torn << " torn, " << s.out_of_order
+       << " out of order\n";
+    torn += s.torn + s.out_of_order;
+    reads += s.frames;
+  }
+  if (reads == 0) {
+    ss << "FAILED: no reader got a frame\n";
+    log_msg(ss.str());
+    return 1;
+  }
+  ss << (torn ? "FAILED: torn frames got past the readers\n"
+              : "No torn frames\n");
+  log_msg(ss.str());
+  return torn ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+// Access unit hand-off benchmark: pooled buffers against the per-picture
+// allocation they replaced, measured on the same NALs.
+//
+//   before  each unit is built in a std::vector, then copied into a fresh
+//           AVPacket (av_packet_alloc + av_new_packet + memcpy)
+//   after   AccessUnitAssembler writes the unit into a PacketPool buffer
+//           and the buffer goes into one reused AVPacket by reference, as
+//           Decoder does
+//
+// Both paths hold each picture for --in-flight units before letting go of
+// it, like a frame-threaded decoder. Reported per access unit: bitstream
+// buffer allocations, AVPacket allocations, bytes copied and time. The two
+// paths' bitstreams are compared unit by unit first; a mismatch fails the
+// run.
+//
+// NALs come from a wire capture, or from a synthetic 720p60 stream at
+// 4 Mbit/s with an IDR every second.
+//
+//   packet_pool_bench [CAPTURE.agcw] [--seconds S] [--in-flight N]
+#include "AccessUnit.h"
+#include "Log.h"
+#include "PacketPool.h"
+#include "RecvRing.h"
+#include "WireCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+static const uint8_t START_CODE[] = {0x00, 0x00, 0x00, 0x01};
+
+struct Nal {
+  uint64_t timestamp_us;
+  std::vector<uint8_t> data;
+};
+
+struct UnitRange {
+  size_t first; // Index into the NAL list
+  size_t count;
+};
+
+struct Counts {
+  uint64_t units = 0;
+  uint64_t bytes = 0;         // Annex B bytes handed to the decoder
+  uint64_t buffer_allocs = 0; // Bitstream buffers
+  uint64_t packet_allocs = 0; // AVPacket structs
+  uint64_t bytes_copied = 0;
+  double seconds = 0;
+};
+
+// Synthetic stream: one slice per picture, SPS/PPS ahead of every IDR
+static void make_synthetic(std::vector<Nal> *nals) {
+  const double fps = 60, mbps = 4.0;
+  const int gop = 60;
+  const double idrWeight = 10.0; // An IDR is sized like ten P pictures
+  double perPicture = mbps * 1e6 / 8 / fps;
+  double pSize = perPicture * gop / (gop - 1 + idrWeight);
+  std::mt19937 rng(1);
+  for (int i = 0; i < 10 * gop; i++) {
+    uint64_t ts = 1000000 + (uint64_t)(i * 1e6 / fps);
+    bool idr = i % gop == 0;
+    if (idr) {
+      nals->push_back({ts, {0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9, 0x40, 0x50}});
+      nals->push_back({ts, {0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0}});
+    }
+    // first_mb_in_slice = 0 (ue(v) "1") right after the header
+    size_t size = (size_t)(idr ? pSize * idrWeight : pSize);
+    Nal slice{ts, std::vector<uint8_t>(size)};
+    for (size_t j = 2; j < size; j++)
+      slice.data[j] = (uint8_t)rng();
+    slice.data[0] = idr ? 0x65 : 0x41;
+    slice.data[1] = 0x88;
+    nals->push_back(std::move(slice));
+  }
+}
+
+static bool load_capture(const std::string &path, std::vector<Nal> *nals) {
+  CaptureReader reader;
+  std::string error;
+  if (!reader.open(path, &error)) {
+    log_err(error + "\n");
+    return false;
+  }
+  RecvRing ring;
+  CaptureRecord record;
+  while (reader.next(&record)) {
+    if (record.type == CAPTURE_CONNECT)
+      ring.reset();
+    if (record.type != CAPTURE_DATA)
+      continue;
+    size_t offset = 0;
+    while (offset < record.data.size()) {
+      size_t space = 0;
+      uint8_t *dst = ring.prepare(&space);
+      size_t n = std::min(space, record.data.size() - offset);
+      memcpy(dst, record.data.data() + offset, n);
+      offset += n;
+      ring.commit(n);
+      WireFrame frame;
+      RecvRing::ParseResult result;
+      while ((result = ring.next(&frame)) == RecvRing::FRAME_READY) {
+        if (frame.size)
+          nals->push_back({frame.timestamp_us,
+                           std::vector<uint8_t>(frame.payload,
+                                                frame.payload + frame.size)});
+      }
+      if (result != RecvRing::NEED_MORE) {
+        log_err("Parse error in " + path + "\n");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Access unit boundaries, cut with the assembler's own rules
+static std::vector<UnitRange> group_units(const std::vector<Nal> &nals) {
+  PacketPool pool;
+  AccessUnitAssembler assembler(&pool);
+  std::vector<UnitRange> units;
+  AccessUnit au;
+  size_t first = 0;
+  for (size_t i = 0; i < nals.size(); i++) {
+    const Nal &nal = nals[i];
+    if (assembler.starts_new_unit(nal.data.data(), (uint32_t)nal.data.size(),
+                                  nal.timestamp_us)) {
+      assembler.take(&au);
+      units.push_back({first, i - first});
+      first = i;
+    }
+    assembler.append(nal.data.data(), (uint32_t)nal.data.size(),
+                     nal.timestamp_us);
+  }
+  if (first < nals.size())
+    units.push_back({first, nals.size() - first});
+  release_access_unit(&au);
+  return units;
+}
+
+// The old path: the unit assembled in a reused vector, then copied out
+class VectorPath {
+public:
+  explicit VectorPath(int inFlight) : m_held(inFlight, nullptr), m_next(0) {}
+  ~VectorPath() {
+    for (AVPacket *&pkt : m_held)
+      av_packet_free(&pkt);
+  }
+
+  AVPacket *run(const std::vector<Nal> &nals, const UnitRange &unit,
+                Counts *counts) {
+    m_building.clear();
+    for (size_t i = unit.first; i < unit.first + unit.count; i++) {
+      const std::vector<uint8_t> &nal = nals[i].data;
+      size_t capacity = m_building.capacity();
+      m_building.insert(m_building.end(), START_CODE, START_CODE + 4);
+      m_building.insert(m_building.end(), nal.begin(), nal.end());
+      if (m_building.capacity() != capacity)
+        counts->buffer_allocs++;
+      counts->bytes_copied += nal.size();
+    }
+
+    // decode_access_unit: a fresh packet per picture
+    AVPacket *pkt = av_packet_alloc();
+    counts->packet_allocs++;
+    if (!pkt || av_new_packet(pkt, (int)m_building.size()) < 0) {
+      av_packet_free(&pkt);
+      return nullptr;
+    }
+    counts->buffer_allocs++;
+    memcpy(pkt->data, m_building.data(), m_building.size());
+    memset(pkt->data + m_building.size(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    counts->bytes_copied += m_building.size();
+    counts->bytes += m_building.size();
+    counts->units++;
+
+    AVPacket *&slot = m_held[m_next++ % m_held.size()];
+    av_packet_free(&slot);
+    slot = pkt;
+    return pkt;
+  }
+
+private:
+  std::vector<uint8_t> m_building;
+  std::vector<AVPacket *> m_held;
+  size_t m_next;
+};
+
+// The pooled path, as Session and Decoder run it
+class PooledPath {
+public:
+  explicit PooledPath(int inFlight)
+      : m_assembler(&m_pool), m_packet(av_packet_alloc()),
+        m_held(inFlight, nullptr), m_next(0) {}
+  ~PooledPath() {
+    for (AVBufferRef *&buf : m_held)
+      av_buffer_unref(&buf);
+    av_packet_free(&m_packet);
+  }
+
+  // Returns the picture's buffer reference; held until --in-flight more
+  // units have gone by
+  const AVPacket *run(const std::vector<Nal> &nals, const UnitRange &unit,
+                      Counts *counts) {
+    for (size_t i = unit.first; i < unit.first + unit.count; i++) {
+      const Nal &nal = nals[i];
+      if (!m_assembler.append(nal.data.data(), (uint32_t)nal.data.size(),
+                              nal.timestamp_us))
+        return nullptr;
+    }
+    m_assembler.take(&m_unit);
+
+    AVPacket *pkt = m_packet;
+    pkt->buf = m_unit.buf;
+    pkt->data = m_unit.buf->data;
+    pkt->size = (int)m_unit.size;
+    m_unit.buf = nullptr;
+    counts->bytes += m_unit.size;
+    counts->units++;
+
+    // The decoder's reference, dropped once the picture is out
+    AVBufferRef *&slot = m_held[m_next++ % m_held.size()];
+    av_buffer_unref(&slot);
+    slot = pkt->buf;
+    m_view = *pkt;
+    pkt->buf = nullptr;
+    av_packet_unref(pkt);
+    return &m_view;
+  }
+
+  void collect(Counts *counts, uint64_t allocsBefore, uint64_t copiedBefore) {
+    counts->buffer_allocs = m_pool.allocations() - allocsBefore;
+    counts->bytes_copied = m_pool.bytes_copied() - copiedBefore;
+  }
+
+  const PacketPool &pool() const { return m_pool; }
+
+private:
+  PacketPool m_pool;
+  AccessUnitAssembler m_assembler;
+  AccessUnit m_unit;
+  AVPacket *m_packet;
+  AVPacket m_view; // What the decoder was given, for the comparison
+  std::vector<AVBufferRef *> m_held;
+  size_t m_next;
+};
+
+static bool same_bitstreams(const std::vector<Nal> &nals,
+                            const std::vector<UnitRange> &units) {
+  VectorPath before(1);
+  PooledPath after(1);
+  Counts ignored;
+  for (size_t i = 0; i < units.size(); i++) {
+    const AVPacket *a = before.run(nals, units[i], &ignored);
+    const AVPacket *b = after.run(nals, units[i], &ignored);
+    if (!a || !b || a->size != b->size ||
+        memcmp(a->data, b->data, a->size + AV_INPUT_BUFFER_PADDING_SIZE)) {
+      log_err("Unit " + std::to_string(i) + " differs between the paths\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Path>
+static bool time_path(Path &path, const std::vector<Nal> &nals,
+                      const std::vector<UnitRange> &units, double seconds,
+                      Counts *counts) {
+  auto start = std::chrono::steady_clock::now();
+  do {
+    for (const UnitRange &unit : units) {
+      if (!path.run(nals, unit, counts))
+        return false;
+    }
+    counts->seconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  } while (counts->seconds < seconds);
+  return true;
+}
+
+static std::string report(const char *name, const Counts &c) {
+  double units = (double)std::max<uint64_t>(c.units, 1);
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(3) << std::left << std::setw(7)
+     << name << std::right << " | buffer allocs/AU " << c.buffer_allocs / units
+     << " | packet allocs/AU " << c.packet_allocs / units
+     << std::setprecision(0) << " | copied/AU " << c.bytes_copied / units
+     << " bytes (" << std::setprecision(2) << (double)c.bytes_copied / c.bytes
+     << "x the bitstream) | " << std::setprecision(0)
+     << c.seconds * 1e9 / units << " ns/AU\n";
+  return ss.str();
+}
+
+static void usage() {
+  std::cerr << "Usage: packet_pool_bench [CAPTURE.agcw] [--seconds S] "
+               "[--in-flight N]\n";
+}
+
+int main(int argc, char **argv) {
+  std::string path;
+  double seconds = 2;
+  int inFlight = 4;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--seconds" && hasValue) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--in-flight" && hasValue) {
+      inFlight = atoi(argv[++i]);
+    } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+      path = arg;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (seconds <= 0 || inFlight < 1) {
+    usage();
+    return 2;
+  }
+
+  std::vector<Nal> nals;
+  if (path.empty())
+    make_synthetic(&nals);
+  else if (!load_capture(path, &nals))
+    return 1;
+  std::vector<UnitRange> units = group_units(nals);
+  if (units.empty()) {
+    log_err("No access units in " + path + "\n");
+    return 1;
+  }
+  if (!same_bitstreams(nals, units))
+    return 1;
+
+  Counts before, after;
+  VectorPath vectorPath(inFlight);
+  if (!time_path(vectorPath, nals, units, seconds, &before))
+    return 1;
+  PooledPath pooledPath(inFlight);
+  uint64_t allocs = pooledPath.pool().allocations();
+  uint64_t copied = pooledPath.pool().bytes_copied();
+  if (!time_path(pooledPath, nals, units, seconds, &after))
+    return 1;
+  pooledPath.collect(&after, allocs, copied);
+
+  std::stringstream ss;
+  ss << (path.empty() ? std::string("Synthetic 720p60, 4 Mbit/s") : path)
+     << ": " << nals.size() << " NALs in " << units.size()
+     << " access units, " << inFlight << " in flight\n";
+  log_msg(ss.str());
+  log_msg(report("before", before));
+  log_msg(report("after", after));
+  ss.str("");
+  ss << "Pool warm-up: " << after.buffer_allocs << " buffers for "
+     << after.units << " access units\n";
+  log_msg(ss.str());
+  return 0;
+}
@@ -0,0 +1,374 @@
+// RecvRing check and parse timing.
+//
+// The checks push synthetic port 5000 streams through a RecvRing the way
+// the socket reader does (prepare, copy a chunk, commit, parse until
+// NEED_MORE) with frames split at every byte, at random points and around
+// maximal frames, and check every parsed frame's timestamp and payload.
+// They also cover a frame held back byte by byte, an oversize length that
+// must be refused from the length field alone, and lengths that do not
+// cover the timestamp. Any failed check fails the run.
+//
+// Given a wire capture, it then times parsing of the recorded recv() chunks
+// (no decode, no socket), the cost the ring adds per frame on the hot path.
+//
+//   recv_ring_bench [CAPTURE.agcw] [--seconds S] [--seed N]
+#include "Log.h"
+#include "RecvRing.h"
+#include "WireCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct Expected {
+  uint64_t timestamp_us;
+  uint32_t size;
+};
+
+static inline uint8_t payload_byte(uint64_t timestamp, uint32_t i) {
+  return (uint8_t)(timestamp * 31 + i);
+}
+
+static void put_be32(std::vector<uint8_t> *out, uint32_t v) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out->push_back((uint8_t)(v >> shift));
+}
+
+// Appends one frame with an arbitrary length field and no payload
+static void append_header(std::vector<uint8_t> *stream, uint32_t length,
+                          uint64_t timestamp) {
+  put_be32(stream, length);
+  put_be32(stream, (uint32_t)(timestamp >> 32));
+  put_be32(stream, (uint32_t)timestamp);
+}
+
+static void append_frame(std::vector<uint8_t> *stream,
+                         std::vector<Expected> *expected, uint64_t timestamp,
+                         uint32_t size) {
+  append_header(stream, size + 8, timestamp);
+  for (uint32_t i = 0; i < size; i++)
+    stream->push_back(payload_byte(timestamp, i));
+  expected->push_back({timestamp, size});
+}
+
+// Feeds `stream` through `ring` in chunks of `chunk()` bytes (clipped to the
+// space prepare() offers), parsing after every commit. Frames must come out
+// as `expected`, in order, with nothing left over.
+static bool feed(RecvRing &ring, const std::vector<uint8_t> &stream,
+                 const std::vector<Expected> &expected,
+                 const std::function<size_t()> &chunk, std::string *error) {
+  size_t offset = 0, parsed = 0;
+  while (offset < stream.size()) {
+    size_t space = 0;
+    uint8_t *dst = ring.prepare(&space);
+    if (space == 0) {
+      *error = "prepare() offered no space at byte " + std::to_string(offset);
+      return false;
+    }
+    size_t n = std::min({chunk(), space, stream.size() - offset});
+    memcpy(dst, stream.data() + offset, n);
+    offset += n;
+    ring.commit(n);
+
+    WireFrame frame;
+    RecvRing::ParseResult result;
+    while ((result = ring.next(&frame)) == RecvRing::FRAME_READY) {
+      if (parsed >= expected.size()) {
+        *error = "more frames than were sent";
+        return false;
+      }
+      const Expected &e = expected[parsed];
+      if (frame.timestamp_us != e.timestamp_us || frame.size != e.size) {
+        *error = "frame " + std::to_string(parsed) + " header mismatch";
+        return false;
+      }
+      for (uint32_t i = 0; i < frame.size; i++) {
+        if (frame.payload[i] != payload_byte(e.timestamp_us, i)) {
+          *error = "frame " + std::to_string(parsed) + " payload mismatch";
+          return false;
+        }
+      }
+      parsed++;
+    }
+    if (result != RecvRing::NEED_MORE) {
+      *error = "parse error " + std::to_string(result) + " at frame " +
+               std::to_string(parsed);
+      return false;
+    }
+  }
+  if (parsed != expected.size() || ring.buffered() != 0) {
+    *error = std::to_string(parsed) + " of " +
+             std::to_string(expected.size()) + " frames, " +
+             std::to_string(ring.buffered()) + " bytes left over";
+    return false;
+  }
+  return true;
+}
+
+static bool check_split_every_byte(std::mt19937 &, std::string *error) {
+  std::vector<uint8_t> stream;
+  std::vector<Expected> expected;
+  const uint32_t sizes[] = {0, 1, 3, 4, 11, 12, 13, 200, 4096};
+  uint64_t ts = 1;
+  for (uint32_t size : sizes)
+    append_frame(&stream, &expected, ts++ << 40, size);
+  RecvRing ring;
+  return feed(ring, stream, expected, [] { return (size_t)1; }, error);
+}
+
+static bool check_split_random(std::mt19937 &rng, std::string *error) {
+  std::vector<uint8_t> stream;
+  std::vector<Expected> expected;
+  std::uniform_int_distribution<uint32_t> small(0, 64 * 1024);
+  for (uint64_t ts = 1; ts <= 400; ts++) {
+    // Every 50th frame as big as the wire allows, to hit compaction
+    uint32_t size = ts % 50 == 0 ? WIRE_MAX_FRAME_SIZE - 8 : small(rng);
+    append_frame(&stream, &expected, ts * 16667, size);
+  }
+  std::uniform_int_distribution<size_t> chunk(1, 256 * 1024);
+  RecvRing ring;
+  return feed(ring, stream, expected, [&] { return chunk(rng); }, error);
+}
+
+static bool check_partial(std::mt19937 &, std::string *error) {
+  std::vector<uint8_t> stream;
+  std::vector<Expected> expected;
+  append_frame(&stream, &expected, 42, 1000);
+  RecvRing ring;
+  WireFrame frame;
+  for (size_t i = 0; i < stream.size(); i++) {
+    size_t space = 0;
+    uint8_t *dst = ring.prepare(&space);
+    *dst = stream[i];
+    ring.commit(1);
+    RecvRing::ParseResult want = i + 1 < stream.size()
+                                     ? RecvRing::NEED_MORE
+                                     : RecvRing::FRAME_READY;
+    if (ring.next(&frame) != want) {
+      *error = "wrong result after " + std::to_string(i + 1) + " bytes";
+      return false;
+    }
+    if (want == RecvRing::NEED_MORE && ring.buffered() != i + 1) {
+      *error = "partial frame not kept after " + std::to_string(i + 1) +
+               " bytes";
+      return false;
+    }
+  }
+  if (frame.size != 1000 || frame.timestamp_us != 42 ||
+      ring.buffered() != 0) {
+    *error = "completed frame does not match";
+    return false;
+  }
+  return true;
+}
+
+// Feeds just `bytes` and expects `want` from the first next()
+static bool expect_result(const std::vector<uint8_t> &bytes,
+                          RecvRing::ParseResult want, std::string *error) {
+  RecvRing ring;
+  size_t space = 0;
+  uint8_t *dst = ring.prepare(&space);
+  memcpy(dst, bytes.data(), bytes.size());
+  ring.commit(bytes.size());
+  WireFrame frame;
+  RecvRing::ParseResult result = ring.next(&frame);
+  if (result != want) {
+    *error = "got " + std::to_string(result) + ", expected " +
+             std::to_string(want);
+    return false;
+  }
+  return true;
+}
+
+static bool check_oversize(std::mt19937 &, std::string *error) {
+  // Refused from the length field alone, before waiting for the payload
+  std::vector<uint8_t> bytes;
+  put_be32(&bytes, WIRE_MAX_FRAME_SIZE + 1);
+  if (!expect_result(bytes, RecvRing::FRAME_OVERSIZED, error))
+    return false;
+  bytes.clear();
+  put_be32(&bytes, 0xFFFFFFFF);
+  if (!expect_result(bytes, RecvRing::FRAME_OVERSIZED, error))
+    return false;
+
+  // The largest legal length still parses
+  std::vector<uint8_t> stream;
+  std::vector<Expected> expected;
+  append_frame(&stream, &expected, 7, WIRE_MAX_FRAME_SIZE - 8);
+  RecvRing ring;
+  return feed(ring, stream, expected, [] { return (size_t)65536; }, error);
+}
+
+static bool check_too_small(std::mt19937 &, std::string *error) {
+  std::vector<uint8_t> bytes;
+  append_header(&bytes, 7, 0);
+  if (!expect_result(bytes, RecvRing::FRAME_TOO_SMALL, error))
+    return false;
+  bytes.clear();
+  append_header(&bytes, 0, 0);
+  if (!expect_result(bytes, RecvRing::FRAME_TOO_SMALL, error))
+    return false;
+  // A bare timestamp is an empty frame, not an error
+  bytes.clear();
+  append_header(&bytes, 8, 0);
+  return expect_result(bytes, RecvRing::FRAME_READY, error);
+}
+
+struct Check {
+  const char *name;
+  bool (*run)(std::mt19937 &, std::string *);
+};
+
+static const Check CHECKS[] = {
+    {"split at every byte", check_split_every_byte},
+    {"random splits, maximal frames", check_split_random},
+    {"partial frame", check_partial},
+    {"oversize length", check_oversize},
+    {"length below timestamp", check_too_small},
+};
+
+struct Chunk {
+  bool connect; // Start of a new connection; ring is reset
+  std::vector<uint8_t> data;
+};
+
+static bool load_capture(const std::string &path, std::vector<Chunk> *chunks,
+                         uint64_t *bytes) {
+  CaptureReader reader;
+  std::string error;
+  if (!reader.open(path, &error)) {
+    log_err(error + "\n");
+    return false;
+  }
+  CaptureRecord record;
+  *bytes = 0;
+  while (reader.next(&record)) {
+    if (record.type == CAPTURE_CONNECT) {
+      chunks->push_back({true, {}});
+    } else if (record.type == CAPTURE_DATA) {
+      chunks->push_back({false, record.data});
+      *bytes += record.data.size();
+    }
+  }
+  return true;
+}
+
+// One pass over the capture; same loop as the replay ingest. Returns
+// frames parsed, or -1 on a parse error.
+static int64_t parse_capture(RecvRing &ring, const std::vector<Chunk> &chunks,
+                             uint64_t *payloadBytes) {
+  int64_t frames = 0;
+  WireFrame frame;
+  for (const Chunk &c : chunks) {
+    if (c.connect) {
+      ring.reset();
+      continue;
+    }
+    size_t offset = 0;
+    while (offset < c.data.size()) {
+      size_t space = 0;
+      uint8_t *dst = ring.prepare(&space);
+      size_t n = std::min(space, c.data.size() - offset);
+      memcpy(dst, c.data.data() + offset, n);
+      offset += n;
+      ring.commit(n);
+      RecvRing::ParseResult result;
+      while ((result = ring.next(&frame)) == RecvRing::FRAME_READY) {
+        *payloadBytes += frame.size;
+        frames++;
+      }
+      if (result != RecvRing::NEED_MORE)
+        return -1;
+    }
+  }
+  return frames;
+}
+
+static void usage() {
+  std::cerr << "Usage: recv_ring_bench [CAPTURE.agcw] [--seconds S] "
+               "[--seed N]\n";
+}
+
+int main(int argc, char **argv) {
+  std::string path;
+  double seconds = 3;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--seconds" && hasValue) {
+      seconds = atof(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      seed = (unsigned)atoi(argv[++i]);
+    } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+      path = arg;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (seconds <= 0) {
+    usage();
+    return 2;
+  }
+
+  std::mt19937 rng(seed);
+  bool ok = true;
+  for (const Check &check : CHECKS) {
+    std::string error;
+    bool pass = check.run(rng, &error);
+    ok = ok && pass;
+    std::stringstream ss;
+    ss << std::left << std::setw(30) << check.name << " | "
+       << (pass ? "ok" : "FAILED: " + error) << "\n";
+    log_msg(ss.str());
+  }
+  if (!ok) {
+    log_err("RecvRing checks failed\n");
+    return 1;
+  }
+  if (path.empty())
+    return 0;
+
+  std::vector<Chunk> chunks;
+  uint64_t bytes = 0;
+  if (!load_capture(path, &chunks, &bytes))
+    return 1;
+
+  RecvRing ring;
+  uint64_t payloadBytes = 0;
+  int64_t frames = 0, passes = 0;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    int64_t n = parse_capture(ring, chunks, &payloadBytes);
+    if (n < 0) {
+      log_err("Parse error in " + path + "\n");
+      return 1;
+    }
+    frames += n;
+    passes++;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  } while (elapsed < seconds);
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1) << "\n"
+     << path << ": " << chunks.size() << " records, " << bytes
+     << " bytes, " << frames / passes << " frames per pass\n"
+     << passes << " passes in " << elapsed << " s | "
+     << bytes * passes / elapsed / 1e6 << " MB/s | "
+     << std::setprecision(0) << elapsed * 1e9 / std::max<int64_t>(frames, 1)
+     << " ns/frame | avg payload "
+     << payloadBytes / std::max<int64_t>(frames, 1) << " bytes\n";
+  log_msg(ss.str());
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "DiscoveryResponder.h"
+#include "ClockSync.h"
+#include "Feedback.h"
+#include "Log.h"
+#include <algorithm>
+#include <string.h>
+
+DiscoveryResponder::DiscoveryResponder()
+    : m_socket(INVALID_SOCKET_VALUE), m_running(false) {
+  memset(m_name, 0, sizeof(m_name));
+}
+
+DiscoveryResponder::~DiscoveryResponder() { stop(); }
+
+bool DiscoveryResponder::start(uint16_t port, const std::string &name) {
+  m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (m_socket == INVALID_SOCKET_VALUE)
+    return false;
+
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = INADDR_ANY;
+  local.sin_port = htons(port);
+  if (bind(m_socket, (sockaddr *)&local, sizeof(local)) < 0) {
+    log_msg("[Discovery] Port " + std::to_string(port) +
+            " in use, not answering PING/SYNC\n");
+    socket_close(m_socket);
+    m_socket = INVALID_SOCKET_VALUE;
+    return false;
+  }
+  socket_set_recv_timeout(m_socket, 200);
+
+  memcpy(m_name, name.data(), std::min(name.size(), sizeof(m_name)));
+  m_running = true;
+  m_thread = std::thread(&DiscoveryResponder::thread_func, this);
+  return true;
+}
+
+void DiscoveryResponder::stop() {
+  if (!m_running.exchange(false))
+    return;
+  // The 200 ms receive timeout bounds the wait
+  if (m_thread.joinable())
+    m_thread.join();
+  socket_close(m_socket);
+  m_socket = INVALID_SOCKET_VALUE;
+}
+
+void DiscoveryResponder::thread_func() {
+  std::vector<uint16_t> seqs;
+  while (m_running) {
+    char buf[1024];
+    sockaddr_in sender;
+    socklen_t senderLen = sizeof(sender);
+    int len = (int)recvfrom(m_socket, buf, sizeof(buf), 0, (sockaddr *)&sender,
+                            &senderLen);
+    if (len < 5 || strncmp(buf, "AGCM", 4) != 0)
+      continue;
+
+    if (buf[4] == 0x01) {
+      // PONG: Magic(4) + Type(1)=2 + Ver(1) + State(1) + Name(32)
+      char pong[39];
+      memcpy(pong, "AGCM", 4);
+      pong[4] = 0x02;
+      pong[5] = 1;
+      pong[6] = 1; // Streaming
+      memcpy(pong + 7, m_name, 32);
+      sendto(m_socket, pong, sizeof(pong), 0, (sockaddr *)&sender, senderLen);
+    } else if (buf[4] == 0x03 && len >= 13) {
+      // SYNC_REPLY: Magic(4)+Type(1)+T1(8)+T2(8)+T3(8), little endian
+      int64_t t2 = clock_now_us();
+      char reply[29];
+      memcpy(reply, "AGCM", 4);
+      reply[4] = 0x04;
+      memcpy(reply + 5, buf + 5, 8);
+      memcpy(reply + 13, &t2, 8);
+      int64_t t3 = clock_now_us();
+      memcpy(reply + 21, &t3, 8);
+      sendto(m_socket, reply, sizeof(reply), 0, (sockaddr *)&sender,
+             senderLen);
+    } else if (buf[4] == AGCM_NACK) {
+      uint32_t ssrc;
+      if (agcm_parse_nack((const uint8_t *)buf, (size_t)len, &ssrc, &seqs) &&
+          m_onNack)
+        m_onNack(ssrc, seqs);
+    } else if (buf[4] == AGCM_PLI) {
+      uint32_t ssrc;
+      if (agcm_parse_pli((const uint8_t *)buf, (size_t)len, &ssrc) && m_onPli)
+        m_onPli(ssrc);
+    } else if (buf[4] == AGCM_BITRATE_TARGET) {
+      uint32_t ssrc, bitrate;
+      int fps;
+      if (agcm_parse_bitrate_target((const uint8_t *)buf, (size_t)len, &ssrc,
+                                    &bitrate, &fps) &&
+          m_onBitrate)
+        m_onBitrate(ssrc, bitrate, fps);
+    }
+  }
+}
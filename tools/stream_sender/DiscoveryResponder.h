@@ -0,0 +1,54 @@
+#pragma once
+#ifndef DISCOVERY_RESPONDER_H
+#define DISCOVERY_RESPONDER_H
+
+#include "Platform.h"
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Phone side of the AGCM protocol: answers the receiver's PING with a PONG
+// and its SYNC_REQUEST with a SYNC_REPLY, so the receiver syncs its clock
+// and reports end-to-end latency for synthetic streams too. Feedback
+// (NACK, PLI, bitrate targets) arriving on the same port is handed to the
+// callbacks.
+class DiscoveryResponder {
+public:
+  DiscoveryResponder();
+  ~DiscoveryResponder();
+
+  // Returns false if the port is taken (e.g. the receiver runs on this
+  // host and owns it); the streams work without discovery.
+  bool start(uint16_t port, const std::string &name);
+  void stop();
+
+  // Set before start(); run on the responder thread with the stream's SSRC
+  void set_nack_callback(
+      std::function<void(uint32_t, const std::vector<uint16_t> &)> callback) {
+    m_onNack = callback;
+  }
+  void set_pli_callback(std::function<void(uint32_t)> callback) {
+    m_onPli = callback;
+  }
+  // SSRC (0 over TCP), bit/s, frames/s
+  void set_bitrate_callback(
+      std::function<void(uint32_t, uint32_t, int)> callback) {
+    m_onBitrate = callback;
+  }
+
+private:
+  void thread_func();
+
+  socket_t m_socket;
+  char m_name[32]; // Zero padded, as in the PONG
+  std::function<void(uint32_t, const std::vector<uint16_t> &)> m_onNack;
+  std::function<void(uint32_t)> m_onPli;
+  std::function<void(uint32_t, uint32_t, int)> m_onBitrate;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif // DISCOVERY_RESPONDER_H
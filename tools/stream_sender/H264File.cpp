@@ -0,0 +1,242 @@
+#include "H264File.h"
+#include "AccessUnit.h" // NAL_* types, read_first_mb_in_slice
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+void SourceFrame::add_nal(const uint8_t *nal, uint32_t size) {
+  nal_offsets.push_back((uint32_t)data.size());
+  nal_sizes.push_back(size);
+  data.insert(data.end(), nal, nal + size);
+  if ((nal[0] & 0x1F) == NAL_IDR)
+    keyframe = true;
+}
+
+// Groups NALs into pictures with the receiver's access-unit rules and makes
+// sure every keyframe starts with the current SPS/PPS.
+class FrameBuilder {
+public:
+  explicit FrameBuilder(SourceClip *clip) : m_clip(clip), m_hasSlices(false) {}
+
+  void add(const uint8_t *nal, uint32_t size) {
+    if (size == 0)
+      return;
+    int type = nal[0] & 0x1F;
+    if (starts_new_frame(nal, size, type))
+      flush();
+
+    if (type == NAL_SPS)
+      m_sps.assign(nal, nal + size);
+    else if (type == NAL_PPS)
+      m_pps.assign(nal, nal + size);
+
+    if (type == NAL_IDR && !has_type(NAL_SPS) && !m_sps.empty() &&
+        !m_pps.empty()) {
+      m_pending.add_nal(m_sps.data(), (uint32_t)m_sps.size());
+      m_pending.add_nal(m_pps.data(), (uint32_t)m_pps.size());
+    }
+    m_pending.add_nal(nal, size);
+    if (type == NAL_SLICE || type == NAL_IDR)
+      m_hasSlices = true;
+  }
+
+  void flush() {
+    if (m_hasSlices) {
+      m_clip->total_bytes += m_pending.data.size();
+      m_clip->frames.push_back(std::move(m_pending));
+    }
+    m_pending = SourceFrame();
+    m_hasSlices = false;
+  }
+
+  // Container packets are whole pictures already
+  void end_frame() { flush(); }
+
+private:
+  bool starts_new_frame(const uint8_t *nal, uint32_t size, int type) const {
+    if (m_pending.nal_sizes.empty())
+      return false;
+    if (type == NAL_AUD)
+      return true;
+    if (!m_hasSlices)
+      return false;
+    if (type == NAL_SPS || type == NAL_PPS || type == NAL_SEI)
+      return true;
+    if (type == NAL_SLICE || type == NAL_IDR) {
+      uint32_t firstMb = 0;
+      return read_first_mb_in_slice(nal, size, &firstMb) && firstMb == 0;
+    }
+    return false;
+  }
+
+  bool has_type(int type) const {
+    for (size_t i = 0; i < m_pending.nal_sizes.size(); i++) {
+      if ((m_pending.data[m_pending.nal_offsets[i]] & 0x1F) == type)
+        return true;
+    }
+    return false;
+  }
+
+  SourceClip *m_clip;
+  SourceFrame m_pending;
+  bool m_hasSlices;
+  std::vector<uint8_t> m_sps;
+  std::vector<uint8_t> m_pps;
+};
+
+static bool is_annexb(const std::vector<uint8_t> &buf) {
+  return (buf.size() >= 4 && buf[0] == 0 && buf[1] == 0 &&
+          (buf[2] == 1 || (buf[2] == 0 && buf[3] == 1)));
+}
+
+// Calls builder->add() for every NAL between start codes in [p, end)
+static void split_annexb(const uint8_t *p, const uint8_t *end,
+                         FrameBuilder *builder) {
+  const uint8_t *nal = nullptr;
+  const uint8_t *i = p;
+  while (i + 3 <= end) {
+    if (i[0] == 0 && i[1] == 0 && i[2] == 1) {
+      if (nal) {
+        // Zeros before the start code belong to it (4-byte form)
+        const uint8_t *nalEnd = i;
+        while (nalEnd > nal && nalEnd[-1] == 0)
+          nalEnd--;
+        builder->add(nal, (uint32_t)(nalEnd - nal));
+      }
+      i += 3;
+      nal = i;
+    } else {
+      i++;
+    }
+  }
+  if (nal && nal < end)
+    builder->add(nal, (uint32_t)(end - nal));
+}
+
+static bool load_annexb(const std::vector<uint8_t> &buf, SourceClip *clip) {
+  FrameBuilder builder(clip);
+  split_annexb(buf.data(), buf.data() + buf.size(), &builder);
+  builder.flush();
+  return true;
+}
+
+// avcC (ISO/IEC 14496-15) parameter sets; returns the NAL length size
+static int parse_avcc(const uint8_t *p, int size, FrameBuilder *builder) {
+  if (size < 7 || p[0] != 1)
+    return 0;
+  int lengthSize = (p[4] & 3) + 1;
+  int pos = 5;
+  for (int list = 0; list < 2; list++) {
+    if (pos >= size)
+      return 0;
+    int count = list == 0 ? (p[pos] & 0x1F) : p[pos];
+    pos++;
+    for (int i = 0; i < count; i++) {
+      if (pos + 2 > size)
+        return 0;
+      int len = (p[pos] << 8) | p[pos + 1];
+      pos += 2;
+      if (pos + len > size)
+        return 0;
+      builder->add(p + pos, (uint32_t)len); // Cached as SPS/PPS
+      pos += len;
+    }
+  }
+  return lengthSize;
+}
+
+static bool load_container(const std::string &path, SourceClip *clip,
+                           std::string *error) {
+  AVFormatContext *fmt = nullptr;
+  if (avformat_open_input(&fmt, path.c_str(), NULL, NULL) < 0) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  if (avformat_find_stream_info(fmt, NULL) < 0) {
+    avformat_close_input(&fmt);
+    *error = "cannot read stream info";
+    return false;
+  }
+
+  int streamIndex =
+      av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+  if (streamIndex < 0 ||
+      fmt->streams[streamIndex]->codecpar->codec_id != AV_CODEC_ID_H264) {
+    avformat_close_input(&fmt);
+    *error = "no H.264 video stream";
+    return false;
+  }
+
+  AVStream *stream = fmt->streams[streamIndex];
+  if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0)
+    clip->fps = av_q2d(stream->avg_frame_rate);
+
+  FrameBuilder builder(clip);
+  const uint8_t *extra = stream->codecpar->extradata;
+  int extraSize = stream->codecpar->extradata_size;
+  int lengthSize = 0; // 0: packets are Annex B
+  if (extra && extraSize > 0 && extra[0] == 1)
+    lengthSize = parse_avcc(extra, extraSize, &builder);
+  else if (extra && extraSize > 0)
+    split_annexb(extra, extra + extraSize, &builder);
+  builder.flush(); // Headers alone never form a frame
+
+  AVPacket *pkt = av_packet_alloc();
+  while (av_read_frame(fmt, pkt) >= 0) {
+    if (pkt->stream_index == streamIndex) {
+      const uint8_t *p = pkt->data;
+      const uint8_t *end = pkt->data + pkt->size;
+      if (lengthSize) {
+        while (p + lengthSize <= end) {
+          uint32_t len = 0;
+          for (int i = 0; i < lengthSize; i++)
+            len = (len << 8) | p[i];
+          p += lengthSize;
+          if (len > (uint32_t)(end - p))
+            break; // Truncated packet
+          builder.add(p, len);
+          p += len;
+        }
+      } else {
+        split_annexb(p, end, &builder);
+      }
+      builder.end_frame();
+    }
+    av_packet_unref(pkt);
+  }
+  av_packet_free(&pkt);
+  avformat_close_input(&fmt);
+  return true;
+}
+
+bool load_h264_file(const std::string &path, SourceClip *clip,
+                    std::string *error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::vector<uint8_t> head(4);
+  in.read((char *)head.data(), head.size());
+
+  bool ok;
+  if (is_annexb(head)) {
+    in.seekg(0);
+    std::vector<uint8_t> buf((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+    ok = load_annexb(buf, clip);
+  } else {
+    in.close();
+    ok = load_container(path, clip, error);
+  }
+
+  if (ok && clip->frames.empty()) {
+    *error = "no pictures found in " + path;
+    return false;
+  }
+  return ok;
+}
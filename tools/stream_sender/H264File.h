@@ -0,0 +1,32 @@
+#pragma once
+#ifndef H264_FILE_H
+#define H264_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One coded picture of the source file, split into NAL units the way
+// VideoEncoder.sendNALUs emits them (no start codes, no length prefixes).
+struct SourceFrame {
+  std::vector<uint8_t> data; // NAL payloads back to back
+  std::vector<uint32_t> nal_offsets;
+  std::vector<uint32_t> nal_sizes;
+  bool keyframe = false;
+
+  void add_nal(const uint8_t *nal, uint32_t size);
+};
+
+struct SourceClip {
+  std::vector<SourceFrame> frames;
+  double fps = 0; // From the container; 0 if unknown (raw Annex B)
+  uint64_t total_bytes = 0;
+};
+
+// Loads an H.264 elementary stream (Annex B, .h264/.264) or an MP4/MOV/MKV
+// file into memory. Keyframes always carry SPS/PPS in front, as the phone
+// sends them. Returns false and fills `error` on failure.
+bool load_h264_file(const std::string &path, SourceClip *clip,
+                    std::string *error);
+
+#endif // H264_FILE_H
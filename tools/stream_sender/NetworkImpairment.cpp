@@ -0,0 +1,56 @@
+#include "NetworkImpairment.h"
+#include <algorithm>
+
+NetworkImpairment::NetworkImpairment(const ImpairmentOptions &options,
+                                     uint32_t seed)
+    : m_options(options), m_rng(seed), m_unit(0.0, 1.0), m_burstLeft(0),
+      m_dropped(0), m_reordered(0) {}
+
+void NetworkImpairment::submit(const uint8_t *packet, size_t size,
+                               Clock::time_point now) {
+  if (m_options.burst > 0) {
+    auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(m_options.burst_period_s));
+    if (m_nextBurst == Clock::time_point()) {
+      m_nextBurst = now + period;
+    } else if (now >= m_nextBurst) {
+      m_burstLeft = m_options.burst;
+      m_nextBurst = now + period;
+    }
+    if (m_burstLeft > 0) {
+      m_burstLeft--;
+      m_dropped++;
+      return;
+    }
+  }
+  if (m_unit(m_rng) * 100.0 < m_options.loss_pct) {
+    m_dropped++;
+    return;
+  }
+
+  auto jitter = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(m_unit(m_rng) *
+                                                m_options.jitter_ms));
+  Clock::time_point due = std::max(now + jitter, m_lastDue);
+
+  if (m_unit(m_rng) * 100.0 < m_options.reorder_pct) {
+    // Held back 1-5 ms (or up to twice the jitter) past its slot, so the
+    // packets after it overtake it
+    double holdMs = 1.0 + m_unit(m_rng) *
+                              std::max(4.0, 2.0 * m_options.jitter_ms);
+    due += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(holdMs));
+    m_reordered++;
+  } else {
+    m_lastDue = due;
+  }
+  m_queue.emplace(due, std::vector<uint8_t>(packet, packet + size));
+}
+
+NetworkImpairment::Clock::time_point NetworkImpairment::next_due() const {
+  return m_queue.empty() ? Clock::time_point::max() : m_queue.begin()->first;
+}
+
+NetworkImpairment::Clock::time_point NetworkImpairment::last_due() const {
+  return m_queue.empty() ? Clock::time_point() : m_queue.rbegin()->first;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef NETWORK_IMPAIRMENT_H
+#define NETWORK_IMPAIRMENT_H
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+struct ImpairmentOptions {
+  double loss_pct = 0;    // Packets dropped outright
+  double reorder_pct = 0; // Packets held back behind later ones
+  double jitter_ms = 0;   // Extra delay, uniform in [0, jitter_ms]
+  int burst = 0;          // Consecutive packets lost every burst_period_s
+  double burst_period_s = 2.0;
+
+  bool any() const {
+    return loss_pct > 0 || reorder_pct > 0 || jitter_ms > 0 || burst > 0;
+  }
+};
+
+// Wi-Fi in a box for the RTP sender: a delay line between the packetizer
+// and the socket that loses, delays and reorders datagrams. Jitter alone
+// keeps the packet order, as a congested queue would; reordering is a
+// separate knob. Bursts model a microwave or a roaming hop: every period,
+// a run of consecutive packets disappears.
+class NetworkImpairment {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  NetworkImpairment(const ImpairmentOptions &options, uint32_t seed);
+
+  // Takes a copy of the packet, or drops it
+  void submit(const uint8_t *packet, size_t size, Clock::time_point now);
+
+  // Release time of the next queued packet (time_point::max() if none)
+  Clock::time_point next_due() const;
+
+  // Release time of the last queued packet (time_point() if none)
+  Clock::time_point last_due() const;
+
+  // Calls `send(data, size)` for every packet due by `now`, in order
+  template <typename SendFn> void release(Clock::time_point now, SendFn send) {
+    while (!m_queue.empty() && m_queue.begin()->first <= now) {
+      const std::vector<uint8_t> &pkt = m_queue.begin()->second;
+      send(pkt.data(), pkt.size());
+      m_queue.erase(m_queue.begin());
+    }
+  }
+
+  uint64_t dropped() const { return m_dropped; }
+  uint64_t reordered() const { return m_reordered; }
+
+private:
+  ImpairmentOptions m_options;
+  std::mt19937 m_rng;
+  std::uniform_real_distribution<double> m_unit;
+  std::multimap<Clock::time_point, std::vector<uint8_t>> m_queue;
+  Clock::time_point m_lastDue; // In-order packets never overtake this
+  Clock::time_point m_nextBurst;
+  int m_burstLeft;
+  uint64_t m_dropped;
+  uint64_t m_reordered;
+};
+
+#endif // NETWORK_IMPAIRMENT_H
@@ -0,0 +1,333 @@
+#include "SenderStream.h"
+#include "ClockSync.h"
+#include "Log.h"
+#include <algorithm>
+#include <string.h>
+
+#ifndef _WIN32
+#include <netdb.h> // getaddrinfo (ws2tcpip.h on Windows)
+#endif
+
+// Capture timestamps are microseconds since 2001-01-01, like CMTime on iOS
+static const int64_t APPLE_TO_UNIX_OFFSET_US = 978307200000000LL;
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static void put_be64(uint8_t *p, uint64_t v) {
+  put_be32(p, (uint32_t)(v >> 32));
+  put_be32(p + 4, (uint32_t)v);
+}
+
+// SSRCs read "AGC" plus the stream index in a packet dump
+static const uint32_t SSRC_BASE = 0x41474300;
+
+// Packets kept for retransmission: ~1 s of a 10 Mbit/s stream, far more
+// than the receiver waits for one
+static const size_t RTX_HISTORY = 1024;
+
+// SOCK_STREAM or SOCK_DGRAM; a connected UDP socket only fixes the peer
+static socket_t net_connect(const std::string &host, uint16_t port,
+                            int type) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = type;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &result) != 0)
+    return INVALID_SOCKET_VALUE;
+
+  socket_t s = INVALID_SOCKET_VALUE;
+  for (addrinfo *ai = result; ai; ai = ai->ai_next) {
+    s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (s == INVALID_SOCKET_VALUE)
+      continue;
+    if (connect(s, ai->ai_addr, (socklen_t)ai->ai_addrlen) == 0)
+      break;
+    socket_close(s);
+    s = INVALID_SOCKET_VALUE;
+  }
+  freeaddrinfo(result);
+
+  if (s != INVALID_SOCKET_VALUE && type == SOCK_STREAM) {
+    // One send() per picture already; don't let Nagle hold the tail back
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay,
+               sizeof(noDelay));
+  }
+  return s;
+}
+
+SenderStream::SenderStream(int index, const SourceClip *clip,
+                           const SenderOptions &options)
+    : m_index(index), m_clip(clip), m_options(options),
+      m_socket(INVALID_SOCKET_VALUE), m_keyframeRequested(false),
+      m_running(false) {}
+
+SenderStream::~SenderStream() { stop(); }
+
+bool SenderStream::start(std::chrono::steady_clock::time_point startAt) {
+  m_socket = net_connect(m_options.host, m_options.port,
+                         m_options.rtp ? SOCK_DGRAM : SOCK_STREAM);
+  if (m_socket == INVALID_SOCKET_VALUE) {
+    log_err("[Stream " + std::to_string(m_index) + "] Connect to " +
+            m_options.host + ":" + std::to_string(m_options.port) +
+            " failed\n");
+    return false;
+  }
+  if (m_options.rtp) {
+    // Repair packets are a little larger than what they protect
+    size_t mtu = m_options.mtu;
+    if (m_options.fec_k > 0) {
+      mtu -= RTP_FEC_OVERHEAD;
+      m_fec.reset(
+          new RtpFecEncoder(ssrc(), m_options.fec_k, m_options.fec_m));
+    }
+    m_packetizer.reset(new RtpPacketizer(ssrc(), mtu));
+    if (m_options.impairment.any())
+      m_impairment.reset(new NetworkImpairment(
+          m_options.impairment, m_options.seed + (uint32_t)m_index));
+    m_history.resize(RTX_HISTORY);
+  }
+  m_startAt = startAt;
+  m_running = true;
+  m_thread = std::thread(&SenderStream::thread_func, this);
+  return true;
+}
+
+void SenderStream::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_feedbackMutex);
+    m_running = false;
+  }
+  m_feedbackCv.notify_all();
+  if (m_socket != INVALID_SOCKET_VALUE)
+    socket_shutdown(m_socket); // Unblocks a send() stuck on a full window
+  if (m_thread.joinable())
+    m_thread.join();
+  if (m_socket != INVALID_SOCKET_VALUE) {
+    socket_close(m_socket);
+    m_socket = INVALID_SOCKET_VALUE;
+  }
+}
+
+// All NALs of the picture go out in one send(), each with its own header and
+// the same capture time, then the empty end-of-picture marker: what the
+// receiver sees from the phone
+bool SenderStream::send_frame(const SourceFrame &frame) {
+  uint64_t captureUs = (uint64_t)(clock_now_us() - APPLE_TO_UNIX_OFFSET_US);
+  if (m_packetizer)
+    return send_rtp_frame(frame, captureUs);
+
+  m_wire.clear();
+  for (size_t i = 0; i < frame.nal_sizes.size(); i++) {
+    uint32_t nalSize = frame.nal_sizes[i];
+    size_t pos = m_wire.size();
+    m_wire.resize(pos + 12 + nalSize);
+    put_be32(&m_wire[pos], nalSize + 8);
+    put_be64(&m_wire[pos + 4], captureUs);
+    memcpy(&m_wire[pos + 12], &frame.data[frame.nal_offsets[i]], nalSize);
+  }
+  size_t pos = m_wire.size();
+  m_wire.resize(pos + 12);
+  put_be32(&m_wire[pos], 8);
+  put_be64(&m_wire[pos + 4], captureUs);
+
+  auto sendStart = std::chrono::steady_clock::now();
+  size_t sent = 0;
+  while (sent < m_wire.size()) {
+    int n = (int)send(m_socket, (const char *)m_wire.data() + sent,
+                      (int)(m_wire.size() - sent), 0);
+    if (n <= 0)
+      return false;
+    sent += (size_t)n;
+  }
+  m_stats.send_blocked_us +=
+      (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - sendStart)
+          .count();
+  m_stats.frames++;
+  m_stats.bytes += m_wire.size();
+  return true;
+}
+
+// One datagram per packet. Send errors are not fatal: UDP has no
+// connection to lose, and a receiver that is restarted picks the stream
+// up again at the next keyframe.
+bool SenderStream::send_rtp_frame(const SourceFrame &frame,
+                                  uint64_t captureUs) {
+  uint32_t rtpTs = (uint32_t)(captureUs * RTP_CLOCK_RATE / 1000000);
+  m_packetizer->begin_picture(rtpTs, captureUs);
+  for (size_t i = 0; i < frame.nal_sizes.size(); i++)
+    m_packetizer->add_nal(&frame.data[frame.nal_offsets[i]],
+                          frame.nal_sizes[i]);
+  m_packetizer->finish_picture();
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < m_packetizer->packet_count(); i++) {
+    const std::vector<uint8_t> &pkt = m_packetizer->packet(i);
+    bytes += pkt.size();
+    uint16_t seq = (uint16_t)((pkt[2] << 8) | pkt[3]);
+    m_history[seq % RTX_HISTORY] = pkt;
+    transmit(pkt.data(), pkt.size());
+  }
+  if (m_fec) {
+    m_fec->begin_picture(rtpTs);
+    for (size_t i = 0; i < m_packetizer->packet_count(); i++)
+      m_fec->add(m_packetizer->packet(i).data(),
+                 m_packetizer->packet(i).size());
+    m_fec->finish_picture();
+    for (size_t i = 0; i < m_fec->packet_count(); i++) {
+      const std::vector<uint8_t> &pkt = m_fec->packet(i);
+      bytes += pkt.size();
+      transmit(pkt.data(), pkt.size());
+    }
+    m_stats.repairs += m_fec->packet_count();
+  }
+  if (m_impairment)
+    send_due_packets();
+  m_stats.frames++;
+  m_stats.bytes += bytes;
+  return true;
+}
+
+// Into the delay line if there is one, else straight out
+void SenderStream::transmit(const uint8_t *packet, size_t size) {
+  if (m_impairment) {
+    m_impairment->submit(packet, size, std::chrono::steady_clock::now());
+    m_stats.dropped = m_impairment->dropped();
+    m_stats.reordered = m_impairment->reordered();
+  } else {
+    send(m_socket, (const char *)packet, (int)size, 0);
+    m_stats.packets++;
+  }
+}
+
+void SenderStream::send_due_packets() {
+  m_impairment->release(std::chrono::steady_clock::now(),
+                        [this](const uint8_t *data, size_t size) {
+                          send(m_socket, (const char *)data, (int)size, 0);
+                          m_stats.packets++;
+                        });
+}
+
+uint32_t SenderStream::ssrc() const {
+  return SSRC_BASE + (uint32_t)m_index;
+}
+
+void SenderStream::request_retransmission(const std::vector<uint16_t> &seqs) {
+  {
+    std::lock_guard<std::mutex> lock(m_feedbackMutex);
+    m_nackQueue.insert(m_nackQueue.end(), seqs.begin(), seqs.end());
+  }
+  m_feedbackCv.notify_all();
+}
+
+// Resends from the history with the retransmission payload type; packets
+// that already left the history are not worth sending any more
+void SenderStream::retransmit(const std::vector<uint16_t> &seqs) {
+  for (uint16_t seq : seqs) {
+    m_stats.nacked++;
+    const std::vector<uint8_t> &pkt = m_history[seq % RTX_HISTORY];
+    if (pkt.size() < RTP_HEADER_SIZE || pkt[2] != (uint8_t)(seq >> 8) ||
+        pkt[3] != (uint8_t)seq)
+      continue;
+    m_resend = pkt;
+    m_resend[1] = (uint8_t)((m_resend[1] & 0x80) | RTP_PAYLOAD_TYPE_RTX);
+    transmit(m_resend.data(), m_resend.size());
+    m_stats.resent++;
+  }
+  if (m_impairment)
+    send_due_packets();
+}
+
+// First keyframe at or after `from`; `from` itself if the clip has none left
+size_t SenderStream::next_keyframe(size_t from) const {
+  for (size_t i = from; i < m_clip->frames.size(); i++) {
+    if (m_clip->frames[i].keyframe)
+      return i;
+  }
+  return from;
+}
+
+void SenderStream::wait_until(std::chrono::steady_clock::time_point deadline) {
+  std::vector<uint16_t> nacks;
+  std::unique_lock<std::mutex> lock(m_feedbackMutex);
+  while (m_running) {
+    if (!m_nackQueue.empty()) {
+      nacks.swap(m_nackQueue);
+      lock.unlock();
+      retransmit(nacks);
+      nacks.clear();
+      lock.lock();
+      continue;
+    }
+    if (m_impairment) {
+      lock.unlock();
+      send_due_packets();
+      lock.lock();
+    }
+    auto wake = deadline;
+    if (m_impairment)
+      wake = std::min(wake, m_impairment->next_due());
+    if (std::chrono::steady_clock::now() >= deadline)
+      return;
+    m_feedbackCv.wait_until(lock, wake);
+  }
+}
+
+void SenderStream::thread_func() {
+  auto interval =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / m_options.fps));
+  auto scheduleStart = m_startAt;
+  uint64_t scheduled = 0; // Frames since scheduleStart
+  int loop = 0;
+
+  if (!m_options.fast)
+    wait_until(m_startAt);
+
+  while (m_running) {
+    for (size_t i = 0; i < m_clip->frames.size() && m_running; i++) {
+      if (!m_options.fast) {
+        auto deadline = scheduleStart + interval * scheduled;
+        auto now = std::chrono::steady_clock::now();
+        if (now > deadline + interval) {
+          // More than a frame behind: the receiver (or we) can't keep up.
+          // Start a new schedule instead of bursting to catch up.
+          m_stats.late++;
+          scheduleStart = now;
+          scheduled = 0;
+        } else if (now < deadline) {
+          wait_until(deadline);
+        }
+        scheduled++;
+      } else if (m_packetizer) {
+        wait_until(std::chrono::steady_clock::now()); // NACKs only
+      }
+
+      // Stands in for the encoder's forced keyframe
+      if (m_keyframeRequested.exchange(false))
+        i = next_keyframe(i);
+
+      if (!send_frame(m_clip->frames[i])) {
+        if (m_running)
+          log_err("[Stream " + std::to_string(m_index) +
+                  "] Connection closed by receiver\n");
+        m_running = false;
+        return;
+      }
+    }
+    if (m_options.loops > 0 && ++loop >= m_options.loops)
+      break;
+  }
+  // Let the packets still in the delay line out
+  if (m_impairment && m_running)
+    wait_until(m_impairment->last_due());
+  m_running = false;
+}
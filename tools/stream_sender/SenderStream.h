@@ -0,0 +1,126 @@
+#pragma once
+#ifndef SENDER_STREAM_H
+#define SENDER_STREAM_H
+
+#include "H264File.h"
+#include "NetworkImpairment.h"
+#include "Platform.h"
+#include "Rtp.h"
+#include "RtpFec.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SenderOptions {
+  std::string host = "127.0.0.1";
+  uint16_t port = 5000;
+  double fps = 60.0;
+  bool fast = false; // Ignore pacing, send as fast as the socket allows
+  int loops = 0;     // Passes over the clip; 0 = until stopped
+
+  // RTP over UDP (RFC 6184) instead of the TCP wire protocol
+  bool rtp = false;
+  size_t mtu = RTP_DEFAULT_MTU;
+  int fec_k = 0; // FEC: fec_m repair packets per fec_k source packets;
+  int fec_m = 0; // 0 = off
+  ImpairmentOptions impairment; // RTP only
+  uint32_t seed = 1;            // Impairment RNG; stream i uses seed + i
+};
+
+// Counters read by the reporting thread while the stream runs
+struct SenderStats {
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> late{0}; // Schedule resets (> 1 frame behind)
+  std::atomic<uint64_t> send_blocked_us{0}; // Time spent inside send()
+
+  // RTP only
+  std::atomic<uint64_t> packets{0};   // Handed to the socket
+  std::atomic<uint64_t> dropped{0};   // Lost by the impairment
+  std::atomic<uint64_t> reordered{0}; // Held back behind later packets
+  std::atomic<uint64_t> nacked{0};    // Sequence numbers asked for again
+  std::atomic<uint64_t> resent{0};    // ... and still in the history
+  std::atomic<uint64_t> plis{0};      // Keyframe requests
+  std::atomic<uint64_t> repairs{0};   // FEC packets
+
+  // Last rate control target from the receiver; 0 = none yet
+  std::atomic<uint32_t> target_bps{0};
+  std::atomic<int> target_fps{0};
+  std::atomic<uint64_t> targets{0}; // Messages received
+};
+
+// One emulated phone: a TCP connection to the receiver that replays the clip
+// with the VideoEncoder wire framing and fresh capture timestamps. In RTP
+// mode the pictures are packetized instead and sent over UDP, through the
+// optional NetworkImpairment delay line, with FEC repair packets behind
+// each picture if asked for, and the stream answers the receiver's NACK /
+// PLI feedback like the phone does.
+class SenderStream {
+public:
+  SenderStream(int index, const SourceClip *clip, const SenderOptions &options);
+  ~SenderStream();
+
+  // `startAt` staggers streams so their frames do not all land together
+  bool start(std::chrono::steady_clock::time_point startAt);
+  void stop();
+
+  bool running() const { return m_running.load(); }
+  const SenderStats &stats() const { return m_stats; }
+
+  // RTP feedback, from any thread
+  uint32_t ssrc() const;
+  void request_retransmission(const std::vector<uint16_t> &seqs);
+  // The clip cannot encode a keyframe on demand; skip ahead to its next one
+  void request_keyframe() {
+    m_stats.plis++;
+    m_keyframeRequested = true;
+  }
+  // Nor re-encode at another rate: the target is only recorded and shown
+  void set_target(uint32_t bitrate, int fps) {
+    m_stats.target_bps = bitrate;
+    m_stats.target_fps = fps;
+    m_stats.targets++;
+  }
+
+private:
+  void thread_func();
+  bool send_frame(const SourceFrame &frame);
+  bool send_rtp_frame(const SourceFrame &frame, uint64_t captureUs);
+  void transmit(const uint8_t *packet, size_t size);
+  void send_due_packets();
+  void retransmit(const std::vector<uint16_t> &seqs);
+  size_t next_keyframe(size_t from) const;
+  // Sleeps until `deadline`, releasing impaired packets as they fall due
+  // and answering NACKs as they come in
+  void wait_until(std::chrono::steady_clock::time_point deadline);
+
+  int m_index;
+  const SourceClip *m_clip;
+  SenderOptions m_options;
+  socket_t m_socket;
+  std::chrono::steady_clock::time_point m_startAt;
+  std::vector<uint8_t> m_wire; // Reused per frame
+  std::unique_ptr<RtpPacketizer> m_packetizer;
+  std::unique_ptr<RtpFecEncoder> m_fec;
+  std::unique_ptr<NetworkImpairment> m_impairment;
+
+  // Recently sent packets by sequence number, for retransmission
+  std::vector<std::vector<uint8_t>> m_history;
+  std::vector<uint8_t> m_resend;
+
+  std::mutex m_feedbackMutex;
+  std::condition_variable m_feedbackCv; // Also wakes wait_until() on stop
+  std::vector<uint16_t> m_nackQueue;    // Guarded by m_feedbackMutex
+  std::atomic<bool> m_keyframeRequested;
+  SenderStats m_stats;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif // SENDER_STREAM_H
@@ -0,0 +1,306 @@
+// Synthetic load generator: N emulated phones replay an H.264 clip to a
+// receiver over the port-5000 wire protocol. Raise --streams (or use --fast)
+// until the receiver's metrics or the "late" counter here show saturation.
+// With --transport rtp the streams go out as RTP over UDP, optionally through
+// --loss/--reorder/--jitter/--burst, to exercise the receiver's jitter buffer
+// and its NACK/PLI feedback; --fec K:M adds M repair packets per K media
+// packets of each picture. Run the receiver with --no-discovery on the same
+// host so this side can own the AGCM port the feedback is sent to; the
+// receiver's bitrate targets are shown next to the rate actually sent.
+#include "DiscoveryResponder.h"
+#include "Fec.h"
+#include "H264File.h"
+#include "Log.h"
+#include "SenderStream.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> stopRequested(false);
+
+static void on_signal(int) { stopRequested = true; }
+
+struct Totals {
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  uint64_t late = 0;
+  uint64_t send_blocked_us = 0;
+  uint64_t packets = 0;
+  uint64_t dropped = 0;
+  uint64_t reordered = 0;
+  uint64_t nacked = 0;
+  uint64_t resent = 0;
+  uint64_t plis = 0;
+  uint64_t repairs = 0;
+  uint64_t targets = 0;
+  double target_mbps = 0; // Summed over the streams
+  int running = 0;
+};
+
+static Totals
+collect(const std::vector<std::unique_ptr<SenderStream>> &streams) {
+  Totals t;
+  for (const auto &s : streams) {
+    const SenderStats &st = s->stats();
+    t.frames += st.frames;
+    t.bytes += st.bytes;
+    t.late += st.late;
+    t.send_blocked_us += st.send_blocked_us;
+    t.packets += st.packets;
+    t.dropped += st.dropped;
+    t.reordered += st.reordered;
+    t.nacked += st.nacked;
+    t.resent += st.resent;
+    t.plis += st.plis;
+    t.repairs += st.repairs;
+    t.targets += st.targets;
+    t.target_mbps += st.target_bps / 1e6;
+    if (s->running())
+      t.running++;
+  }
+  return t;
+}
+
+static std::string format_line(const char *label, const Totals &now,
+                               const Totals &prev, double seconds,
+                               size_t streamCount) {
+  double fps = (now.frames - prev.frames) / seconds;
+  double mbps = (now.bytes - prev.bytes) * 8.0 / seconds / 1e6;
+  // Share of the streams' wall time spent inside send(): near 100% means
+  // TCP backpressure from the receiver is what limits the rate
+  double blockedPct = 100.0 * (now.send_blocked_us - prev.send_blocked_us) /
+                      (seconds * 1e6 * (double)streamCount);
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1) << label << " streams "
+     << now.running << "/" << streamCount << " | " << fps << " fps ("
+     << fps / (double)streamCount << "/stream) | " << mbps
+     << " Mbit/s | late " << now.late;
+  if (now.packets + now.dropped > 0) {
+    // RTP: send() on UDP never blocks, so show the impairment instead
+    ss << " | packets " << now.packets << " | dropped " << now.dropped
+       << " | reordered " << now.reordered << " | nack " << now.nacked
+       << " (resent " << now.resent << ") | pli " << now.plis;
+    if (now.repairs > 0)
+      ss << " | fec " << now.repairs;
+  } else {
+    ss << " | send blocked " << blockedPct << "%";
+    if (now.plis > 0)
+      ss << " | pli " << now.plis;
+  }
+  if (now.targets > 0)
+    ss << " | target " << now.target_mbps << " Mbit/s";
+  ss << "\n";
+  return ss.str();
+}
+
+static void usage() {
+  std::cerr << "Usage: stream_sender [HOST] --file PATH [--port N] "
+               "[--streams N] [--fps F] [--fast] [--duration S] [--loops N] "
+               "[--name NAME] [--discovery-port N] [--no-discovery] "
+               "[--transport tcp|rtp] [--mtu N] [--loss PCT] "
+               "[--reorder PCT] [--jitter MS] [--burst N] "
+               "[--burst-period S] [--fec K:M] [--seed N]\n";
+}
+
+int main(int argc, char **argv) {
+  SenderOptions options;
+  std::string file;
+  std::string name = "StreamSender";
+  int streamCount = 1;
+  double fpsOverride = 0;
+  double duration = 0; // Seconds; 0 = until the clip/loops end or Ctrl+C
+  int discoveryPort = 5001;
+  bool discovery = true;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--file" && hasValue) {
+      file = argv[++i];
+    } else if (arg == "--port" && hasValue) {
+      options.port = (uint16_t)atoi(argv[++i]);
+    } else if (arg == "--streams" && hasValue) {
+      streamCount = atoi(argv[++i]);
+    } else if (arg == "--fps" && hasValue) {
+      fpsOverride = atof(argv[++i]);
+    } else if (arg == "--fast") {
+      options.fast = true;
+    } else if (arg == "--duration" && hasValue) {
+      duration = atof(argv[++i]);
+    } else if (arg == "--loops" && hasValue) {
+      options.loops = atoi(argv[++i]);
+    } else if (arg == "--name" && hasValue) {
+      name = argv[++i];
+    } else if (arg == "--discovery-port" && hasValue) {
+      discoveryPort = atoi(argv[++i]);
+    } else if (arg == "--no-discovery") {
+      discovery = false;
+    } else if (arg == "--transport" && hasValue) {
+      std::string transport = argv[++i];
+      if (transport != "tcp" && transport != "rtp") {
+        usage();
+        return 2;
+      }
+      options.rtp = transport == "rtp";
+    } else if (arg == "--mtu" && hasValue) {
+      options.mtu = (size_t)atoi(argv[++i]);
+    } else if (arg == "--loss" && hasValue) {
+      options.impairment.loss_pct = atof(argv[++i]);
+    } else if (arg == "--reorder" && hasValue) {
+      options.impairment.reorder_pct = atof(argv[++i]);
+    } else if (arg == "--jitter" && hasValue) {
+      options.impairment.jitter_ms = atof(argv[++i]);
+    } else if (arg == "--burst" && hasValue) {
+      options.impairment.burst = atoi(argv[++i]);
+    } else if (arg == "--burst-period" && hasValue) {
+      options.impairment.burst_period_s = atof(argv[++i]);
+    } else if (arg == "--fec" && hasValue) {
+      if (sscanf(argv[++i], "%d:%d", &options.fec_k, &options.fec_m) != 2 ||
+          options.fec_k < 1 || options.fec_k > FEC_MAX_SOURCE ||
+          options.fec_m < 1 || options.fec_m > FEC_MAX_REPAIR) {
+        usage();
+        return 2;
+      }
+    } else if (arg == "--seed" && hasValue) {
+      options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (!arg.empty() && arg[0] != '-') {
+      options.host = arg;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  // Room for the RTP header, extension, an FU-A header and FEC
+  if (file.empty() || streamCount <= 0 || options.port == 0 ||
+      options.mtu < RTP_HEADER_SIZE + RTP_EXT_SIZE + RTP_FEC_OVERHEAD + 64) {
+    usage();
+    return 2;
+  }
+
+  if ((options.impairment.any() || options.fec_k > 0) && !options.rtp)
+    log_msg("Note: impairment and FEC only apply to --transport rtp\n");
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+#ifndef _WIN32
+  signal(SIGPIPE, SIG_IGN);
+#endif
+
+  if (!net_init()) {
+    log_err("Socket layer initialisation failed\n");
+    return 1;
+  }
+
+  SourceClip clip;
+  std::string error;
+  if (!load_h264_file(file, &clip, &error)) {
+    log_err("Error: " + error + "\n");
+    net_cleanup();
+    return 1;
+  }
+  if (fpsOverride > 0)
+    options.fps = fpsOverride;
+  else if (clip.fps > 0)
+    options.fps = clip.fps;
+
+  size_t keyframes = 0;
+  for (const SourceFrame &f : clip.frames)
+    keyframes += f.keyframe ? 1 : 0;
+  {
+    std::stringstream ss;
+    ss << "Loaded " << file << ": " << clip.frames.size() << " frames, "
+       << keyframes << " keyframes, "
+       << clip.total_bytes * 8.0 * options.fps / clip.frames.size() / 1e6
+       << " Mbit/s at " << options.fps << " fps\n";
+    log_msg(ss.str());
+  }
+
+  // Spread the streams across one frame interval
+  auto t0 = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+  auto stagger =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / options.fps / streamCount));
+
+  std::vector<std::unique_ptr<SenderStream>> streams;
+  for (int i = 0; i < streamCount; i++) {
+    std::unique_ptr<SenderStream> s(new SenderStream(i, &clip, options));
+    if (!s->start(t0 + stagger * i))
+      break;
+    streams.push_back(std::move(s));
+  }
+  if (streams.empty()) {
+    net_cleanup();
+    return 1;
+  }
+
+  // Started once `streams` is complete: the feedback callbacks read it
+  DiscoveryResponder responder;
+  responder.set_nack_callback(
+      [&streams](uint32_t ssrc, const std::vector<uint16_t> &seqs) {
+        for (auto &s : streams) {
+          if (s->ssrc() == ssrc)
+            s->request_retransmission(seqs);
+        }
+      });
+  responder.set_pli_callback([&streams](uint32_t ssrc) {
+    for (auto &s : streams) {
+      if (ssrc == 0 || s->ssrc() == ssrc) // 0: TCP, from the latency governor
+        s->request_keyframe();
+    }
+  });
+  responder.set_bitrate_callback(
+      [&streams](uint32_t ssrc, uint32_t bitrate, int fps) {
+        // Over TCP the receiver cannot tell our streams apart
+        for (auto &s : streams) {
+          if (ssrc == 0 || s->ssrc() == ssrc)
+            s->set_target(bitrate, fps);
+        }
+      });
+  if (discovery)
+    responder.start((uint16_t)discoveryPort, name);
+  log_msg("Sending " + std::to_string(streams.size()) + " stream(s) to " +
+          options.host + ":" + std::to_string(options.port) +
+          (options.rtp ? " (RTP)" : "") + "\n");
+
+  auto begin = std::chrono::steady_clock::now();
+  auto lastReport = begin;
+  Totals prev;
+  while (!stopRequested) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto now = std::chrono::steady_clock::now();
+    Totals cur = collect(streams);
+    if (cur.running == 0)
+      break;
+    if (duration > 0 &&
+        std::chrono::duration<double>(now - begin).count() >= duration)
+      break;
+
+    double sinceReport =
+        std::chrono::duration<double>(now - lastReport).count();
+    if (sinceReport >= 1.0) {
+      log_msg(format_line("[Sender]", cur, prev, sinceReport, streams.size()));
+      prev = cur;
+      lastReport = now;
+    }
+  }
+
+  for (auto &s : streams)
+    s->stop();
+  responder.stop();
+
+  double total =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  log_msg(format_line("[Summary]", collect(streams), Totals(), total,
+                      streams.size()));
+  net_cleanup();
+  return 0;
+}
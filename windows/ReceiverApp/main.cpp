@@ -1,934 +1,16 @@
-// CRITICAL: winsock2.h must be included BEFORE windows.h
-#define WIN32_LEAN_AND_MEAN
-#include "../common/SharedMemory.h"
-#include <atomic>
-#include <chrono>
+// Windows front end: a preview window around the platform-neutral receiver
+// core (core/), which does the ingest, decode and shared-memory publishing.
+// P cycles the decode profile.
+#include "ReceiverCore.h" // Pulls in winsock2.h before windows.h
+#include "ColorConvert.h"
 #include <iostream>
-#include <mutex>
-#include <thread>
 #include <vector>
-#include <windows.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
 
-// Link against Ws2_32.lib
-#pragma comment(lib, "Ws2_32.lib")
+ReceiverCore receiverCore;
 
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include <libavcodec/codec.h>
-#include <libavcodec/packet.h>
-#include <libavformat/avformat.h>
-#include <libavutil/avutil.h>
-#include <libavutil/frame.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
-}
-
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
-
-std::ofstream debugFile;
-
-void init_debug_log() {
-  CreateDirectoryA("C:\\Users\\Hamza\\Documents\\Antigravity\\IOS Camrea "
-                   "Potato Stream\\debug",
-                   NULL);
-
-  // Generate unique filename
-  auto t = std::time(nullptr);
-  auto tm = *std::localtime(&t);
-  std::ostringstream oss;
-  oss << "C:\\Users\\Hamza\\Documents\\Antigravity\\IOS Camrea Potato "
-         "Stream\\debug\\log_"
-      << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".txt";
-
-  debugFile.open(oss.str(), std::ios::out | std::ios::trunc);
-  if (debugFile.is_open()) {
-    debugFile << "Frame,Time,R,G,B\n";
-    std::cout << "Debug Log: " << oss.str() << "\n";
-  }
-}
-
-template <typename T> void log_msg(const T &msg) {
-  std::cout << msg;
-  if (debugFile.is_open()) {
-    debugFile << "# " << msg;
-    debugFile.flush();
-  }
-}
-
-template <typename T> void log_err(const T &msg) {
-  std::cerr << msg;
-  if (debugFile.is_open()) {
-    debugFile << "ERROR: " << msg;
-    debugFile.flush();
-  }
-}
-
-// Global AV variables
-AVCodecContext *codecCtx = nullptr;
-AVCodecParserContext *parser = nullptr;
-AVFrame *pFrame = nullptr;
-AVFrame *pFrameRGB = nullptr;
-SwsContext *sws_ctx = nullptr;
-uint8_t *pFrameRGBBuffer = nullptr; // Track RGB buffer for cleanup
-
-// Decoding State
-const AVCodec *codec = nullptr;
-
-// Socket timeout in milliseconds (5 seconds)
-const int SOCKET_TIMEOUT_MS = 5000;
-
-HANDLE hMapFile = NULL;
-SharedMemoryLayout *pSharedMem = nullptr;
-
-// UI & Threading globals
+// UI globals
 HWND hWindow = NULL;
-std::mutex frameMutex;
-std::atomic<bool> isRunning(true);
-std::atomic<bool> isConnected(false);
-
-// FFmpeg Log Callback
-void ffmpeg_log_callback(void *ptr, int level, const char *fmt, va_list vl) {
-  if (level > AV_LOG_WARNING)
-    return; // Only log warnings and above
-
-  // Format the message
-  char line[1024];
-  vsnprintf(line, sizeof(line), fmt, vl);
-
-  // Write to our log file
-  log_msg(std::string("[FFMPEG] ") + line);
-}
-
-void cleanup() {
-  if (debugFile.is_open())
-    debugFile.close();
-  if (sws_ctx)
-    sws_freeContext(sws_ctx);
-  if (pFrame)
-    av_frame_free(&pFrame);
-  if (pFrameRGB)
-    av_frame_free(&pFrameRGB);
-  if (pFrameRGBBuffer)
-    av_free(pFrameRGBBuffer);
-  if (codecCtx)
-    avcodec_free_context(&codecCtx);
-  if (parser)
-    av_parser_close(parser);
-  if (pSharedMem)
-    UnmapViewOfFile(pSharedMem);
-  if (hMapFile)
-    CloseHandle(hMapFile);
-  WSACleanup();
-}
-
-// NAL start code for Annex B format (required by FFmpeg H.264 decoder)
-static const uint8_t NAL_START_CODE[] = {0x00, 0x00, 0x00, 0x01};
-
-// Core initialization of decoder context (Software Only)
-bool setup_decoder(const std::vector<uint8_t> &sps = {},
-                   const std::vector<uint8_t> &pps = {}) {
-  if (codecCtx) {
-    avcodec_free_context(&codecCtx);
-  }
-
-  codecCtx = avcodec_alloc_context3(codec);
-  if (!codecCtx) {
-    std::cerr << "Could not allocate video codec context\n";
-    return false;
-  }
-
-  // Set Extradata if provided
-  if (!sps.empty() && !pps.empty()) {
-    size_t extraSize = sps.size() + pps.size() + 8; // +8 for start codes
-    codecCtx->extradata =
-        (uint8_t *)av_malloc(extraSize + AV_INPUT_BUFFER_PADDING_SIZE);
-    codecCtx->extradata_size = extraSize;
-
-    uint8_t *ptr = codecCtx->extradata;
-    memcpy(ptr, NAL_START_CODE, 4);
-    ptr += 4;
-    memcpy(ptr, sps.data(), sps.size());
-    ptr += sps.size();
-    memcpy(ptr, NAL_START_CODE, 4);
-    ptr += 4;
-    memcpy(ptr, pps.data(), pps.size());
-    ptr += pps.size();
-
-    memset(ptr, 0, AV_INPUT_BUFFER_PADDING_SIZE);
-    log_msg("Decoder configured with Extradata (SPS+PPS)\n");
-  }
-
-  // Software decoding configuration
-  log_msg("Decoder Configured for SOFTWARE decoding\n");
-  codecCtx->thread_count = 0; // Auto-detect optimal thread count
-
-  if (avcodec_open2(codecCtx, codec, NULL) < 0) {
-    std::cerr << "Could not open codec\n";
-    return false;
-  }
-  return true;
-}
-
-void init_ffmpeg() {
-  // Setup Logging
-  av_log_set_callback(ffmpeg_log_callback);
-  av_log_set_level(AV_LOG_WARNING);
-
-  codec = avcodec_find_decoder(AV_CODEC_ID_H264);
-  if (!codec) {
-    std::cerr << "Codec not found\n";
-    exit(1);
-  }
-
-  log_msg("Using H.264 software decoder\n");
-
-  setup_decoder();
-
-  pFrame = av_frame_alloc();
-  pFrameRGB = av_frame_alloc();
-
-  // Prepare RGB Frame buffer
-  int numBytes =
-      av_image_get_buffer_size(AV_PIX_FMT_BGRA, VIDEO_WIDTH, VIDEO_HEIGHT, 1);
-  pFrameRGBBuffer = (uint8_t *)av_malloc(numBytes * sizeof(uint8_t));
-  av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, pFrameRGBBuffer,
-                       AV_PIX_FMT_BGRA, VIDEO_WIDTH, VIDEO_HEIGHT, 1);
-
-  sws_ctx = NULL;
-}
-
-void init_shared_memory() {
-  hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
-                                sizeof(SharedMemoryLayout), SHARED_MEMORY_NAME);
-
-  if (hMapFile == NULL) {
-    std::cerr << "Could not create file mapping object (" << GetLastError()
-              << ").\n";
-    exit(1);
-  }
-
-  pSharedMem = (SharedMemoryLayout *)MapViewOfFile(
-      hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedMemoryLayout));
-
-  if (pSharedMem == NULL) {
-    std::cerr << "Could not map view of file (" << GetLastError() << ").\n";
-    CloseHandle(hMapFile);
-    exit(1);
-  }
-
-  // Init Header
-  pSharedMem->magic = 0x43424557; // 'WEBC'
-  pSharedMem->version = 2;        // Version 2: double-buffered
-  pSharedMem->width = VIDEO_WIDTH;
-  pSharedMem->height = VIDEO_HEIGHT;
-  pSharedMem->write_sequence = 0;
-  pSharedMem->active_buffer = 0;
-}
-
-// Connection / Stream State
-std::atomic<bool> hasSeenKeyframe(false);
-bool isDecoderConfiguredWithHeaders = false;
-
-// Clock Synchronization
-std::atomic<double> time_offset_ms{0.0};
-std::atomic<bool> is_clock_synced{false};
-
-// SPS/PPS Cache for bundling with IDR
-std::vector<uint8_t> sps_cache;
-std::vector<uint8_t> pps_cache;
-static int send_packet_err_count = 0;
-
-// Decode function taking raw NAL buf (adds start code for FFmpeg)
-void decode_frame(SOCKET clientSocket, uint8_t *data, int size,
-                  uint64_t captureTimestampUs) {
-  if (size <= 0)
-    return;
-
-  // Simple NAL Unit Type Check (first byte & 0x1F)
-  int nalType = data[0] & 0x1F;
-
-  // SPS (7), PPS (8), IDR (5) are critical for starting playback
-  if (nalType == 7 || nalType == 8 || nalType == 5) {
-    if (!hasSeenKeyframe) {
-      log_msg(" [Keyframe/Header Found! Syncing Stream...] \n");
-      hasSeenKeyframe = true;
-    }
-  }
-
-  // If we haven't seen a keyframe yet, drop this packet to avoid artifacts
-  if (!hasSeenKeyframe) {
-    return;
-  }
-
-  // Handle SPS/PPS Caching
-  if (nalType == 7) {
-    sps_cache.assign(data, data + size);
-    return; // Wait for IDR to bundle
-  }
-  if (nalType == 8) {
-    pps_cache.assign(data, data + size);
-    return; // Wait for IDR to bundle
-  }
-
-  // Prepare Payload
-  std::vector<uint8_t> payload;
-  payload.reserve(size + 1024);
-
-  // If IDR, prepend SPS/PPS if available
-  if (nalType == 5) {
-    // LAZY INIT: If we have SPS/PPS but haven't configured decoder with
-    // them yet, do it now.
-    if (!isDecoderConfiguredWithHeaders && !sps_cache.empty() &&
-        !pps_cache.empty()) {
-      log_msg("Re-initializing Decoder with SPS/PPS Extradata...\n");
-      setup_decoder(sps_cache, pps_cache);
-      isDecoderConfiguredWithHeaders = true;
-    }
-
-    if (!sps_cache.empty()) {
-      payload.insert(payload.end(), NAL_START_CODE, NAL_START_CODE + 4);
-      payload.insert(payload.end(), sps_cache.begin(), sps_cache.end());
-    }
-    if (!pps_cache.empty()) {
-      payload.insert(payload.end(), NAL_START_CODE, NAL_START_CODE + 4);
-      payload.insert(payload.end(), pps_cache.begin(), pps_cache.end());
-    }
-  }
-
-  // Add Start Code + Current NAL
-  payload.insert(payload.end(), NAL_START_CODE, NAL_START_CODE + 4);
-  payload.insert(payload.end(), data, data + size);
-
-  // Actual data size without padding
-  size_t actualSize = payload.size();
-
-  // Direct Send to Decoder
-  AVPacket *pkt = av_packet_alloc();
-  if (!pkt) {
-    std::cerr << "OOM: Could not allocate packet struct\n";
-    return;
-  }
-
-  if (av_new_packet(pkt, actualSize) < 0) {
-    std::cerr << "OOM: Could not allocate packet buffer\n";
-    av_packet_free(&pkt);
-    return;
-  }
-
-  memcpy(pkt->data, payload.data(), actualSize);
-  memset(pkt->data + actualSize, 0, AV_INPUT_BUFFER_PADDING_SIZE);
-
-  // Set Flags
-  if (nalType == 5) {
-    pkt->flags |= AV_PKT_FLAG_KEY;
-  }
-
-  // Performance Metrics
-  static long long totalDecodeTime = 0;
-  static long long totalRenderTime = 0;
-  static double totalE2ELatency = 0;
-  static int frameMetricCount = 0;
-  static auto lastMetricTime = std::chrono::steady_clock::now();
-
-  auto t0 = std::chrono::high_resolution_clock::now();
-
-  int sendRes = avcodec_send_packet(codecCtx, pkt);
-  if (sendRes < 0) {
-    send_packet_err_count++;
-    if (send_packet_err_count % 100 == 1) {
-      char errbuf[AV_ERROR_MAX_STRING_SIZE] = {0};
-      av_strerror(sendRes, errbuf, AV_ERROR_MAX_STRING_SIZE);
-      std::string errmsg =
-          "Error sending packet: " + std::string(errbuf) + "\n";
-      log_err(errmsg);
-    }
-  } else {
-    int recvRes = 0;
-    while (true) {
-      recvRes = avcodec_receive_frame(codecCtx, pFrame);
-      if (recvRes == AVERROR(EAGAIN) || recvRes == AVERROR_EOF) {
-        break;
-      }
-      if (recvRes < 0) {
-        char errbuf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(recvRes, errbuf, AV_ERROR_MAX_STRING_SIZE);
-        static int recv_err_count = 0;
-        recv_err_count++;
-        if (recv_err_count % 100 == 1) {
-          log_err("Error receiving frame: " + std::string(errbuf) + "\n");
-        }
-        break;
-      }
-
-      auto t1 = std::chrono::high_resolution_clock::now(); // Decode Done
-
-      // Convert to RGB
-      {
-        std::lock_guard<std::mutex> lock(frameMutex);
-
-        // Re-initialize scaler if format/size changes
-        static int cached_format = -1;
-        static int cached_w = -1;
-        static int cached_h = -1;
-
-        if (cached_format != pFrame->format || cached_w != pFrame->width ||
-            cached_h != pFrame->height) {
-          if (sws_ctx)
-            sws_freeContext(sws_ctx);
-          // Destination resolution should match source resolution (no scaling)
-          sws_ctx = sws_getContext(pFrame->width, pFrame->height,
-                                   (AVPixelFormat)pFrame->format, pFrame->width,
-                                   pFrame->height, AV_PIX_FMT_BGRA,
-                                   SWS_BILINEAR, NULL, NULL, NULL);
-
-          // CRITICAL FIX: Reconfigure pFrameRGB layout for new dimensions.
-          // Since 1280x720 and 720x1280 have same total byte count, we can
-          // reuse pFrameRGBBuffer. This updates linesize so we don't overflow.
-          av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize,
-                               pFrameRGBBuffer, AV_PIX_FMT_BGRA, pFrame->width,
-                               pFrame->height, 1);
-
-          cached_format = pFrame->format;
-          cached_w = pFrame->width;
-          cached_h = pFrame->height;
-        }
-
-        if (sws_ctx) {
-          // Update pFrameRGB dimensions so UI thread knows what to draw
-          pFrameRGB->width = pFrame->width;
-          pFrameRGB->height = pFrame->height;
-
-          sws_scale(sws_ctx, (uint8_t const *const *)pFrame->data,
-                    pFrame->linesize, 0, codecCtx->height, pFrameRGB->data,
-                    pFrameRGB->linesize);
-        }
-
-        // Write to Shared Memory (double-buffered)
-        if (pSharedMem) {
-          // Update Shared Memory Metadata with ACTUAL frame size
-          pSharedMem->width = pFrame->width;
-          pSharedMem->height = pFrame->height;
-          // Write to inactive buffer
-          uint32_t writeBuffer = pSharedMem->active_buffer ^ 1;
-          memcpy(pSharedMem->data[writeBuffer], pFrameRGB->data[0],
-                 FRAME_BUFFER_SIZE);
-
-          // Memory barrier to ensure write completes before updating index
-          _ReadWriteBarrier();
-
-          // Atomically switch to new buffer
-          pSharedMem->active_buffer = writeBuffer;
-          pSharedMem->write_sequence++;
-        }
-      }
-
-      auto t2 = std::chrono::high_resolution_clock::now(); // Render Done
-
-      // Calculate E2E Latency
-      // iOS sends microseconds since 2001-01-01.
-      // Need to adjust to Unix Epoch (1970) for system_clock comparison
-      // Offset: 978307200 seconds * 1,000,000
-      const int64_t APPLE_TO_UNIX_OFFSET_US = 978307200000000LL;
-      int64_t remoteUnixUs = captureTimestampUs + APPLE_TO_UNIX_OFFSET_US;
-
-      // Adjust for Clock Offset
-      // Offset = iPhone - Windows
-      // We want Windows Time, so Windows = iPhone - Offset
-      double offsetUs = time_offset_ms.load() * 1000.0;
-      int64_t remoteUnixUsCorrected = remoteUnixUs - (int64_t)offsetUs;
-
-      auto now = std::chrono::system_clock::now();
-      int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
-                          now.time_since_epoch())
-                          .count();
-
-      double latencyMs = (nowUs - remoteUnixUsCorrected) / 1000.0;
-      totalE2ELatency += latencyMs;
-
-      // Accumulate Metrics
-      long long decodeUs =
-          std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0)
-              .count();
-      long long renderUs =
-          std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
-              .count();
-
-      totalDecodeTime += decodeUs;
-      totalRenderTime += renderUs;
-      frameMetricCount++;
-
-      // Log Every 30 Frames (~0.5 sec)
-      if (frameMetricCount >= 30) {
-        auto nowSteady = std::chrono::steady_clock::now();
-        long long elapsedMs =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                nowSteady - lastMetricTime)
-                .count();
-        if (elapsedMs > 0) {
-          double fps = (frameMetricCount * 1000.0) / elapsedMs;
-          double avgDecode = (totalDecodeTime / 1000.0) / frameMetricCount;
-          double avgRender = (totalRenderTime / 1000.0) / frameMetricCount;
-          double avgE2E = totalE2ELatency / frameMetricCount;
-
-          // Check Pending Network Bytes (Latency Indicator)
-          u_long pendingBytes = 0;
-          ioctlsocket(clientSocket, FIONREAD, &pendingBytes);
-          double pendingKB = pendingBytes / 1024.0;
-
-          std::stringstream ss;
-          ss << "[Metrics] FPS: " << std::fixed << std::setprecision(1) << fps
-             << " | E2E Latency: " << std::setprecision(1) << avgE2E << "ms"
-             << " | Decode: " << std::setprecision(2) << avgDecode << "ms"
-             << " | Render: " << std::setprecision(2) << avgRender << "ms"
-             << " | Queue: " << std::setprecision(1) << pendingKB << " KB\n";
-          log_msg(ss.str());
-          std::cout << ss.str(); // Keep console output too
-        }
-
-        // Reset
-        frameMetricCount = 0;
-        totalDecodeTime = 0;
-        totalRenderTime = 0;
-        totalE2ELatency = 0;
-        lastMetricTime = nowSteady;
-
-        // Quick Drift Correction Check: If negative latency, our clocks are
-        // mismatched or we are too fast :). Just alert if it is weird. if
-        // (avgE2E < -1000 || avgE2E > 5000) { log_msg("WARNING: Large Clock
-        // Skew detected.\n"); }
-      }
-
-      // Request UI Repaint
-      if (hWindow) {
-        InvalidateRect(hWindow, NULL, FALSE);
-      }
-    }
-  }
-  av_packet_free(&pkt);
-}
-
-// Helper to receive exact amount of data
-bool recv_all(SOCKET s, void *buf, int len) {
-  char *ptr = (char *)buf;
-  int total = 0;
-  while (total < len) {
-    int r = recv(s, ptr + total, len - total, 0);
-    if (r <= 0) {
-      return false;
-    }
-    total += r;
-  }
-  return true;
-}
-
-void receiver_thread_func() {
-  SOCKET ListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  sockaddr_in service;
-  service.sin_family = AF_INET;
-  service.sin_addr.s_addr = INADDR_ANY;
-  service.sin_port = htons(5000);
-
-  if (bind(ListenSocket, (SOCKADDR *)&service, sizeof(service)) ==
-      SOCKET_ERROR) {
-    std::cerr << "Bind failed.\n";
-    return;
-  }
-
-  if (listen(ListenSocket, 1) == SOCKET_ERROR) {
-    std::cerr << "Listen failed.\n";
-    return;
-  }
-
-  std::cout << "Waiting for connection on port 5000...\n";
-
-  while (isRunning) {
-    sockaddr_in clientAddr;
-    int clientAddrLen = sizeof(clientAddr);
-    SOCKET ClientSocket =
-        accept(ListenSocket, (SOCKADDR *)&clientAddr, &clientAddrLen);
-
-    if (ClientSocket == INVALID_SOCKET) {
-      if (!isRunning)
-        break;
-      continue;
-    }
-
-    // Set socket receive timeout to detect dead connections
-    setsockopt(ClientSocket, SOL_SOCKET, SO_RCVTIMEO,
-               (const char *)&SOCKET_TIMEOUT_MS, sizeof(SOCKET_TIMEOUT_MS));
-
-    // Disable Nagle's Algorithm for Low Latency
-    BOOL nodelay = TRUE;
-    if (setsockopt(ClientSocket, IPPROTO_TCP, TCP_NODELAY,
-                   (const char *)&nodelay, sizeof(nodelay)) < 0) {
-      log_msg("Warning: Could not set TCP_NODELAY\n");
-    } else {
-      log_msg("Low Latency Mode Enabled (TCP_NODELAY)\n");
-    }
-
-    // Minimize OS Receive Buffer (Reduce Latency)
-    int bufSize = 65536; // 64KB
-    if (setsockopt(ClientSocket, SOL_SOCKET, SO_RCVBUF, (char *)&bufSize,
-                   sizeof(int)) == SOCKET_ERROR) {
-      log_msg("Warning: Could not set SO_RCVBUF\n");
-    } else {
-      log_msg("Receive Buffer limited to 64KB\n");
-    }
-
-    // New Connection: Reset Stream State
-    hasSeenKeyframe = false;
-    isDecoderConfiguredWithHeaders = false;
-    // Flush decoder to remove any old reference frames
-    if (codecCtx) {
-      avcodec_flush_buffers(codecCtx);
-    }
-    std::cout << "DEBUG: Waiting for Keyframe/SPS/PPS...\n";
-
-    char *clientIP = inet_ntoa(clientAddr.sin_addr);
-    int clientPort = ntohs(clientAddr.sin_port);
-    std::cout << "Connected: " << clientIP << ":" << clientPort << "\n";
-    isConnected = true;
-
-    // Update Window Title
-    if (hWindow)
-      SetWindowTextA(hWindow, "AntigravityCam Receiver - Connected");
-
-    while (isRunning) {
-      // 1. Read Length Header (4 bytes)
-      uint32_t netLen = 0;
-      if (!recv_all(ClientSocket, &netLen, 4)) {
-        break;
-      }
-
-      uint32_t len = ntohl(netLen);
-
-      // Sanity check
-      if (len > 1000000) {
-        std::cerr << "Oversized packet (" << len
-                  << " bytes). Dropping connection.\n";
-        break;
-      }
-
-      if (len < 8) {
-        std::cerr << "Packet too small (no timestamp).\n";
-        break;
-      }
-
-      // 2. Read Timestamp (8 bytes)
-      uint64_t netTimestamp = 0;
-      if (!recv_all(ClientSocket, &netTimestamp, 8)) {
-        break;
-      }
-      uint64_t captureTimestamp =
-          _byteswap_uint64(netTimestamp); // Big Endian -> Little Endian
-
-      // 3. Read Payload (len - 8)
-      uint32_t payloadSize = len - 8;
-      std::vector<uint8_t> buf(payloadSize);
-      if (!recv_all(ClientSocket, buf.data(), payloadSize)) {
-        break;
-      }
-
-      decode_frame(ClientSocket, buf.data(), payloadSize, captureTimestamp);
-    }
-
-    std::cout << "Disconnected.\n";
-    isConnected = false;
-    is_clock_synced = false;
-    if (hWindow)
-      SetWindowTextA(hWindow, "AntigravityCam Receiver - Waiting...");
-    closesocket(ClientSocket);
-  }
-
-  closesocket(ListenSocket);
-}
-
-// Active Discovery Thread: Broadcasts PING, Listens for PONG
-void beacon_listener_thread_func() {
-  SOCKET udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  if (udpSock == INVALID_SOCKET) {
-    log_msg("[Discovery] Error: Socket creation failed\n");
-    return;
-  }
-
-  // 1. Enable Broadcast
-  BOOL broadcast = TRUE;
-  if (setsockopt(udpSock, SOL_SOCKET, SO_BROADCAST, (char *)&broadcast,
-                 sizeof(broadcast)) < 0) {
-    log_msg("[Discovery] Error: Could not enable broadcast.\n");
-    closesocket(udpSock);
-    return;
-  }
-
-  // 2. Bind to 5001
-  sockaddr_in local;
-  local.sin_family = AF_INET;
-  local.sin_addr.s_addr = INADDR_ANY;
-  local.sin_port = htons(5001);
-  if (bind(udpSock, (SOCKADDR *)&local, sizeof(local)) < 0) {
-    log_msg("[Discovery] Error: Bind failed.\n");
-    closesocket(udpSock);
-    return;
-  }
-
-  // 3. Set Timeout
-  DWORD timeout = 200;
-  setsockopt(udpSock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
-             sizeof(timeout));
-
-  // 4. Setup Broadcast Destination
-  sockaddr_in broadcastAddr;
-  broadcastAddr.sin_family = AF_INET;
-  broadcastAddr.sin_port = htons(5001);
-  broadcastAddr.sin_addr.s_addr = INADDR_BROADCAST;
-
-  log_msg(
-      "[Discovery] Starting Active Discovery (Broadcasting PING on 5001)...\n");
-  std::cout << "Device Not Found\n";
-
-  // Track last discovery to avoid log spam
-  char lastDiscoveryName[33] = {0};
-  char lastDiscoveryIP[INET_ADDRSTRLEN] = {0};
-  sockaddr_in lastDeviceAddr = {0};
-
-  auto lastBeaconTime = std::chrono::steady_clock::now();
-  auto lastPingTime = std::chrono::steady_clock::now();
-  bool deviceAvailable = false;
-
-  enum DiscoveryState { STATE_WAITING, STATE_AVAILABLE, STATE_CONNECTED };
-  DiscoveryState lastConsoleState = STATE_WAITING;
-
-  const char PING_PACKET[] = {0x41, 0x47, 0x43, 0x4D, 0x01, 1};
-
-  while (isRunning) {
-    auto now = std::chrono::steady_clock::now();
-
-    long long elapsedPing =
-        std::chrono::duration_cast<std::chrono::milliseconds>(now -
-                                                              lastPingTime)
-            .count();
-    if (elapsedPing >= 1000) {
-      sendto(udpSock, PING_PACKET, sizeof(PING_PACKET), 0,
-             (sockaddr *)&broadcastAddr, sizeof(broadcastAddr));
-      lastPingTime = now;
-
-      // SYNC REQUEST every 2s if connected but not synced
-      if (isConnected && deviceAvailable && !is_clock_synced) {
-        char syncPkt[13]; // Magic(4) + Type(1) + T1(8)
-        memcpy(syncPkt, "AGCM", 4);
-        syncPkt[4] = 0x03; // SYNC_REQUEST
-
-        auto nowSys = std::chrono::system_clock::now();
-        int64_t t1 = std::chrono::duration_cast<std::chrono::microseconds>(
-                         nowSys.time_since_epoch())
-                         .count();
-        // Little Endian assuming x64
-        memcpy(syncPkt + 5, &t1, 8);
-
-        // Send to specific device IP, not broadcast
-        sendto(udpSock, syncPkt, sizeof(syncPkt), 0,
-               (sockaddr *)&lastDeviceAddr, sizeof(lastDeviceAddr));
-      }
-    }
-
-    char buf[1024];
-    sockaddr_in sender;
-    int senderLen = sizeof(sender);
-
-    int len =
-        recvfrom(udpSock, buf, sizeof(buf), 0, (sockaddr *)&sender, &senderLen);
-
-    if (len > 0) {
-      // Ensure null termination for string operations if buf is treated as
-      // char* This assumes buf is large enough to hold len + 1 bytes. The
-      // original code uses `char name[33] = {0}; memcpy(name, &buf[7], 32);`
-      // which implies buf is treated as raw bytes.
-      // The new code uses strncmp and strncpy, which expect null-terminated
-      // strings. Let's ensure buf is treated as char* and null-terminated if
-      // possible. If len is 1024, buf[1024] would be out of bounds. For safety,
-      // we'll copy to a temporary buffer if needed for string ops.
-
-      // PONG Format: Magic(4) + Type(1)=2 + Ver(1) + State(1) + Name(32)
-      if (len >= 39 && strncmp(buf, "AGCM", 4) == 0 && buf[4] == 0x02) {
-        char *namePtr = buf + 7;
-        char nameBuffer[33];
-        strncpy(nameBuffer, namePtr, 32);
-        nameBuffer[32] = 0; // Ensure null termination
-
-        // Extract Sender IP
-        char ipStr[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(sender.sin_addr), ipStr, INET_ADDRSTRLEN);
-
-        std::string deviceName(nameBuffer);
-
-        // Only print if new or changed
-        if (std::string(lastDiscoveryName) != deviceName ||
-            std::strcmp(lastDiscoveryIP, ipStr) != 0) {
-          log_msg("[Discovery] Device Found: ");
-          log_msg(deviceName.c_str());
-          log_msg(" (");
-          log_msg(ipStr);
-          log_msg(")\n");
-          std::cout << "Device Found: " << deviceName << " (" << ipStr << ")\n";
-
-          // Update last discovered info
-          strncpy(lastDiscoveryName, nameBuffer, 32);
-          lastDiscoveryName[32] = 0;
-          strncpy(lastDiscoveryIP, ipStr, INET_ADDRSTRLEN - 1);
-          lastDiscoveryIP[INET_ADDRSTRLEN - 1] = 0;
-        }
-
-        lastDeviceAddr = sender;
-
-        lastBeaconTime = now;
-        deviceAvailable = true;
-
-        // UI Update Logic (Console Only, No Window Title)
-        if (!isConnected) {
-          if (lastConsoleState != STATE_AVAILABLE) {
-            lastConsoleState = STATE_AVAILABLE;
-          }
-        } else {
-          if (lastConsoleState != STATE_CONNECTED) {
-            lastConsoleState = STATE_CONNECTED;
-          }
-        }
-      } else if (buf[4] == 0x04 &&
-                 len >= 29) { // SYNC_REPLY: Magic(4)+Type(1)+T1(8)+T2(8)+T3(8)
-        // Handle Sync Reply
-        int64_t t1, t2, t3;
-        memcpy(&t1, buf + 5, 8);
-        memcpy(&t2, buf + 13, 8);
-        memcpy(&t3, buf + 21, 8);
-
-        auto nowSys = std::chrono::system_clock::now();
-        int64_t t4 = std::chrono::duration_cast<std::chrono::microseconds>(
-                         nowSys.time_since_epoch())
-                         .count();
-
-        // Check if this reply matches our recent request (T1)
-        // For simplicity, we just use it if reasonable RTT
-        int64_t rtt = (t4 - t1) - (t3 - t2);
-        if (rtt < 0)
-          rtt = 0;
-
-        // Offset = ((T2 - T1) + (T3 - T4)) / 2
-        double offset = ((double)(t2 - t1) + (double)(t3 - t4)) / 2.0;
-
-        time_offset_ms = offset / 1000.0;
-        is_clock_synced = true;
-
-        std::stringstream ss;
-        ss << "[ClockSync] Synced! Offset: " << time_offset_ms.load()
-           << "ms | RTT: " << (rtt / 1000.0) << "ms\n";
-        log_msg(ss.str());
-      }
-    }
-
-    if (deviceAvailable) {
-      long long elapsed =
-          std::chrono::duration_cast<std::chrono::seconds>(now - lastBeaconTime)
-              .count();
-      if (elapsed > 3) {
-        deviceAvailable = false;
-
-        if (lastConsoleState != STATE_WAITING) {
-          if (!isConnected) {
-            std::cout << "Device Not Found\n";
-            log_msg("[Discovery] Device Lost (Timeout)\n");
-          }
-          lastConsoleState = STATE_WAITING;
-        }
-      }
-    } else {
-      if (!deviceAvailable && !isConnected &&
-          lastConsoleState != STATE_WAITING) {
-        std::cout << "Device Not Found\n";
-        lastConsoleState = STATE_WAITING;
-      }
-    }
-  }
-
-  closesocket(udpSock);
-}
-
-// Log Receiver Thread: Listens on 5002 for text logs
-void log_receiver_thread_func() {
-  SOCKET ListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  sockaddr_in service;
-  service.sin_family = AF_INET;
-  service.sin_addr.s_addr = INADDR_ANY;
-  service.sin_port = htons(5002);
-
-  if (bind(ListenSocket, (SOCKADDR *)&service, sizeof(service)) ==
-      SOCKET_ERROR) {
-    log_msg("[LogReceiver] Bind failed on 5002.\n");
-    return;
-  }
-
-  if (listen(ListenSocket, 1) == SOCKET_ERROR) {
-    log_msg("[LogReceiver] Listen failed.\n");
-    return;
-  }
-
-  log_msg("[LogReceiver] Listening for logs on port 5002...\n");
-
-  // Create logs directory if it doesn't exist
-  CreateDirectoryA("C:\\Users\\Hamza\\Documents\\Antigravity\\IOS Camrea "
-                   "Potato Stream\\logs",
-                   NULL);
-
-  while (isRunning) {
-    sockaddr_in clientAddr;
-    int clientAddrLen = sizeof(clientAddr);
-    SOCKET ClientSocket =
-        accept(ListenSocket, (SOCKADDR *)&clientAddr, &clientAddrLen);
-
-    if (ClientSocket == INVALID_SOCKET) {
-      if (!isRunning)
-        break;
-      continue;
-    }
-
-    log_msg("[LogReceiver] Receiving Log File...\n");
-
-    // Generate filename with timestamp
-    auto t = std::time(nullptr);
-    auto tm = *std::localtime(&t);
-    std::ostringstream oss;
-    oss << "C:\\Users\\Hamza\\Documents\\Antigravity\\IOS Camrea Potato "
-           "Stream\\logs\\iphone_log_"
-        << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".txt";
-
-    std::ofstream logOut(oss.str(), std::ios::binary);
-
-    // Read and Write
-    char buffer[4096];
-    int totalBytes = 0;
-    while (true) {
-      int bytesReceived = recv(ClientSocket, buffer, sizeof(buffer), 0);
-      if (bytesReceived <= 0)
-        break;
-      logOut.write(buffer, bytesReceived);
-      totalBytes += bytesReceived;
-    }
-
-    logOut.close();
-    closesocket(ClientSocket);
-
-    std::stringstream ss;
-    ss << "[LogReceiver] Saved " << totalBytes << " bytes to " << oss.str()
-       << "\n";
-    log_msg(ss.str());
-  }
-
-  closesocket(ListenSocket);
-}
+std::vector<uint8_t> previewPixels; // The slot's NV12 as BGRA, for GDI
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
                             LPARAM lParam) {
@@ -937,14 +19,29 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
     PostQuitMessage(0);
     return 0;
 
+  case WM_KEYDOWN:
+    if (wParam == 'P') {
+      receiverCore.set_decode_profile((DecodeProfile)(
+          (receiverCore.decode_profile() + 1) % DECODE_PROFILE_COUNT));
+      return 0;
+    }
+    break;
+
   case WM_PAINT: {
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(hwnd, &ps);
 
-    // Draw the latest frame using Double Buffering (Fixes Flicker)
+    // Draw the newest shared-memory frame using Double Buffering (Fixes
+    // Flicker). The decoder never waits for us; if it laps the slot while
+    // we draw, the seqlock check below schedules a clean repaint.
     {
-      std::lock_guard<std::mutex> lock(frameMutex);
-      if (pFrameRGB && pFrameRGB->data[0]) {
+      SharedMemoryLayout *pSharedMem = receiverCore.frame_layout();
+      if (pSharedMem && shm_load_acquire(&pSharedMem->write_sequence) > 0) {
+        const FrameSlot *slot =
+            &pSharedMem->slots[shm_load_acquire(&pSharedMem->latest_slot) %
+                               FRAME_SLOT_COUNT];
+        uint32_t slotSequence = frame_slot_read_begin(slot);
+
         RECT clientRect;
         GetClientRect(hwnd, &clientRect);
         int winW = clientRect.right - clientRect.left;
@@ -960,10 +57,32 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
         FillRect(memDC, &clientRect, hBrush);
         DeleteObject(hBrush);
 
-        int srcW = pFrameRGB->width;
-        int srcH = pFrameRGB->height;
+        int srcW = (int)slot->width;
+        int srcH = (int)slot->height;
+        // Checked before use: a torn read may leave any of these wrong
+        bool drawable = slot->format == FRAME_FORMAT_NV12 &&
+                        slot->stride == frame_nv12_stride(srcW) &&
+                        frame_nv12_bytes(srcW, srcH) <= FRAME_BUFFER_SIZE;
+
+        if (drawable && srcW > 0 && srcH > 0 && winW > 0 && winH > 0) {
+          // GDI only takes RGB: convert the frame the bus carries as NV12
+          YuvImage yuv = {};
+          yuv.layout = YUV_LAYOUT_NV12;
+          yuv.width = srcW;
+          yuv.height = srcH;
+          yuv.plane[0] = slot->data;
+          yuv.plane[1] = slot->data + (size_t)slot->stride * srcH;
+          yuv.stride[0] = yuv.stride[1] = (int)slot->stride;
+          previewPixels.resize((size_t)srcW * srcH * 4);
+          yuv_to_bgra(yuv,
+                      (slot->color & FRAME_COLOR_BT709) ? YUV_MATRIX_BT709
+                                                        : YUV_MATRIX_BT601,
+                      (slot->color & FRAME_COLOR_FULL_RANGE)
+                          ? YUV_RANGE_FULL
+                          : YUV_RANGE_LIMITED,
+                      previewPixels.data(), srcW * 4, 0, srcH);
+          const uint8_t *srcPixels = previewPixels.data();
 
-        if (srcW > 0 && srcH > 0 && winW > 0 && winH > 0) {
           // 2. Calculate Aspect Ratio Preserving Dimensions
           float srcAspect = (float)srcW / (float)srcH;
           float winAspect = (float)winW / (float)winH;
@@ -996,9 +115,15 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
           // Use StretchDIBits for scaling onto Memory DC
           SetStretchBltMode(memDC, HALFTONE);
           StretchDIBits(memDC, dstX, dstY, dstW, dstH, 0, 0, srcW, srcH,
-                        pFrameRGB->data[0], &bmi, DIB_RGB_COLORS, SRCCOPY);
+                        srcPixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
         }
 
+        // Torn read: the decoder reused the slot mid-draw. Present anyway
+        // (one frame) and draw the newer frame on the next paint.
+        if (!frame_slot_read_validate(slot, slotSequence) ||
+            (slotSequence & 1))
+          InvalidateRect(hwnd, NULL, FALSE);
+
         // 4. Blit Memory DC to Screen (Atomic Present)
         BitBlt(hdc, 0, 0, winW, winH, memDC, 0, 0, SRCCOPY);
 
@@ -1016,18 +141,14 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
   return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
-int main() {
-  WSADATA wsaData;
-  int wsaResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-  if (wsaResult != 0) {
-    std::cerr << "WSAStartup failed with error: " << wsaResult << "\n";
+int main(int argc, char **argv) {
+  // Pipeline options: --queue-depth N, --queue-policy drop|block, ...
+  ReceiverConfig config;
+  if (!parse_receiver_args(argc, argv, &config)) {
+    std::cerr << "Invalid arguments\n";
     return 1;
   }
 
-  init_debug_log();
-  init_shared_memory();
-  init_ffmpeg();
-
   // Create Window Class
   const wchar_t CLASS_NAME[] = L"AntigravityReceiverClass";
   WNDCLASSW wc = {};
@@ -1051,12 +172,24 @@ int main() {
     return 0;
   }
 
-  ShowWindow(hWindow, SW_SHOW);
+  // Request UI Repaint (the preview shows session 0)
+  receiverCore.set_frame_callback([](int session) {
+    if (session == 0)
+      InvalidateRect(hWindow, NULL, FALSE);
+  });
 
-  // Start Receiver Thread
-  std::thread receiverThread(receiver_thread_func);
-  std::thread beaconThread(beacon_listener_thread_func);
-  std::thread logReceiverThread(log_receiver_thread_func);
+  // Update Window Title
+  receiverCore.set_connection_callback([](int, bool) {
+    SetWindowTextA(hWindow, receiverCore.connected()
+                                ? "AntigravityCam Receiver - Connected"
+                                : "AntigravityCam Receiver - Waiting...");
+  });
+
+  if (!receiverCore.start(config)) {
+    return 1;
+  }
+
+  ShowWindow(hWindow, SW_SHOW);
 
   // Message Loop
   MSG msg = {};
@@ -1065,14 +198,7 @@ int main() {
     DispatchMessage(&msg);
   }
 
-  isRunning = false;
-
-  // Close socket to unblock accept() if possible, or just detach
-  // Ideally, we'd have a way to signal threads to exit cleanly
-  receiverThread.detach();
-  beaconThread.detach();
-  logReceiverThread.detach();
-
-  cleanup();
+  // Joins every pipeline thread before the frame bus is unmapped
+  receiverCore.stop();
   return 0;
 }
@@ -1,6 +1,8 @@
 #include "CaptureSource.h"
+#include "ColorConvert.h"
 #include <initguid.h>
 #include <olectl.h>
+#include <stdlib.h>
 
 // Self-definition of GUIDs to avoid link errors if not in libs
 DEFINE_GUID(CLSID_AntigravityCam, 0x8e14549a, 0xdb61, 0x4309, 0xaf, 0xa1, 0x35,
@@ -47,6 +49,58 @@ BOOL APIENTRY DllMain(HANDLE hModule, DWORD dwReason, LPVOID lpReserved) {
   return DllEntryPoint((HINSTANCE)(hModule), dwReason, lpReserved);
 }
 
+// Output media types, offered in this order. The frame bus carries NV12,
+// so NV12 is a row copy, YUY2 and I420 only move bytes, and RGB32 is the
+// one that needs colour maths; each sample is converted once, straight
+// from shared memory, to whichever the downstream pin picked.
+enum { OUTPUT_NV12, OUTPUT_YUY2, OUTPUT_I420, OUTPUT_RGB32, OUTPUT_COUNT };
+
+struct OutputFormat {
+  DWORD compression; // biCompression: FOURCC, or BI_RGB
+  WORD bitCount;
+};
+
+static const OutputFormat OUTPUT_FORMATS[OUTPUT_COUNT] = {
+    {MAKEFOURCC('N', 'V', '1', '2'), 12},
+    {MAKEFOURCC('Y', 'U', 'Y', '2'), 16},
+    {MAKEFOURCC('I', '4', '2', '0'), 12},
+    {BI_RGB, 32},
+};
+
+static GUID OutputSubtype(int output) {
+  if (output == OUTPUT_RGB32)
+    return MEDIASUBTYPE_RGB32;
+  return FOURCCMap(OUTPUT_FORMATS[output].compression);
+}
+
+static DWORD OutputImageSize(int output, LONG width, LONG height) {
+  return (DWORD)((size_t)width * labs(height) *
+                 OUTPUT_FORMATS[output].bitCount / 8);
+}
+
+// Which output `pmt` is, and its geometry. RGB32 may be top-down
+// (negative height); the YUV types never are.
+static bool ParseMediaType(const CMediaType *pmt, int *output, LONG *width,
+                           LONG *height) {
+  if (*pmt->Type() != MEDIATYPE_Video ||
+      *pmt->FormatType() != FORMAT_VideoInfo || !pmt->Format() ||
+      pmt->FormatLength() < sizeof(VIDEOINFOHEADER))
+    return false;
+  const VIDEOINFOHEADER *pvi = (const VIDEOINFOHEADER *)pmt->Format();
+  for (int i = 0; i < OUTPUT_COUNT; i++) {
+    if (*pmt->Subtype() != OutputSubtype(i))
+      continue;
+    if (pvi->bmiHeader.biWidth <= 0 || pvi->bmiHeader.biHeight == 0 ||
+        (pvi->bmiHeader.biHeight < 0 && i != OUTPUT_RGB32))
+      return false;
+    *output = i;
+    *width = pvi->bmiHeader.biWidth;
+    *height = pvi->bmiHeader.biHeight;
+    return true;
+  }
+  return false;
+}
+
 // CVCam Implementation
 CUnknown *WINAPI CVCam::CreateInstance(LPUNKNOWN lpunk, HRESULT *phr) {
   CUnknown *punk = new CVCam(lpunk, phr);
@@ -72,7 +126,14 @@ CVCamStream::CVCamStream(HRESULT *phr, CVCam *pParent, LPCWSTR pPinName)
     : CSourceStream(NAME("Output"), phr, pParent, pPinName) {
   m_hMapFile = NULL;
   m_pSharedMem = NULL;
+  m_hFrameNotify = NULL;
   m_lastReadSequence = 0;
+  m_rtFrameInterval = 10000000 / VIDEO_FPS;
+  m_lastFrameId = 0;
+  m_rtLastStart = -1;
+  m_output = OUTPUT_NV12;
+  m_outWidth = VIDEO_WIDTH;
+  m_outHeight = VIDEO_HEIGHT;
 }
 
 CVCamStream::~CVCamStream() {
@@ -81,6 +142,11 @@ CVCamStream::~CVCamStream() {
 
 HRESULT CVCamStream::OnThreadCreate() {
   InitSharedMemory();
+  m_hFrameNotify = frame_notify_open();
+  m_rtFrameInterval = FrameInterval();
+  m_lastDelivery = std::chrono::steady_clock::time_point();
+  m_lastFrameId = 0;
+  m_rtLastStart = -1;
   return S_OK;
 }
 
@@ -89,12 +155,15 @@ HRESULT CVCamStream::OnThreadDestroy() {
     UnmapViewOfFile(m_pSharedMem);
   if (m_hMapFile)
     CloseHandle(m_hMapFile);
+  frame_notify_close(m_hFrameNotify);
   m_pSharedMem = NULL;
   m_hMapFile = NULL;
+  m_hFrameNotify = NULL;
   return S_OK;
 }
 
 void CVCamStream::InitSharedMemory() {
+  // Read-only: waiting on the frame events writes nothing to the section
   m_hMapFile = OpenFileMappingA(FILE_MAP_READ, FALSE, SHARED_MEMORY_NAME);
   if (m_hMapFile) {
     m_pSharedMem = (SharedMemoryLayout *)MapViewOfFile(
@@ -102,40 +171,235 @@ void CVCamStream::InitSharedMemory() {
   }
 }
 
+// Reads the section header directly: media types are negotiated before the
+// streaming thread maps it. False if there is no receiver, no announced
+// geometry, or frames of it would not fit a slot.
+bool CVCamStream::AnnouncedGeometry(LONG *width, LONG *height) {
+  HANDLE hMap = OpenFileMappingA(FILE_MAP_READ, FALSE, SHARED_MEMORY_NAME);
+  if (!hMap)
+    return false;
+  bool found = false;
+  const SharedMemoryLayout *shm = (const SharedMemoryLayout *)MapViewOfFile(
+      hMap, FILE_MAP_READ, 0, 0, offsetof(SharedMemoryLayout, slots));
+  if (shm) {
+    uint32_t w = shm->width, h = shm->height;
+    if (shm->magic == SHARED_MEMORY_MAGIC &&
+        shm->version == SHARED_MEMORY_VERSION && w && h &&
+        frame_nv12_bytes(w, h) <= FRAME_BUFFER_SIZE) {
+      *width = (LONG)w;
+      *height = (LONG)h;
+      found = true;
+    }
+    UnmapViewOfFile(shm);
+  }
+  CloseHandle(hMap);
+  return found;
+}
+
+REFERENCE_TIME CVCamStream::FrameInterval() {
+  // The media type is fixed while the streaming thread runs
+  if (m_mt.formattype == FORMAT_VideoInfo && m_mt.Format()) {
+    VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER *)m_mt.Format();
+    if (pvi->AvgTimePerFrame > 0)
+      return pvi->AvgTimePerFrame;
+  }
+  return 10000000 / VIDEO_FPS;
+}
+
+// Rows the frame and the negotiated type have in common go to the top
+// left of the sample; the caller blacks the sample first if they differ
+void CVCamStream::ConvertSlot(const FrameSlot *slot, BYTE *pData) {
+  LONG outHeight = labs(m_outHeight);
+  YuvImage src = {};
+  src.layout = YUV_LAYOUT_NV12;
+  src.width = (int)slot->width < m_outWidth ? (int)slot->width : m_outWidth;
+  src.height =
+      (int)slot->height < outHeight ? (int)slot->height : (int)outHeight;
+  src.plane[0] = slot->data;
+  src.plane[1] = slot->data + (size_t)slot->stride * slot->height;
+  src.stride[0] = src.stride[1] = (int)slot->stride;
+
+  size_t luma = (size_t)m_outWidth * outHeight;
+  switch (m_output) {
+  case OUTPUT_NV12:
+    yuv_to_nv12(src, pData, pData + luma, m_outWidth, 0, src.height);
+    break;
+  case OUTPUT_YUY2:
+    yuv_to_yuy2(src, pData, m_outWidth * 2, 0, src.height);
+    break;
+  case OUTPUT_I420:
+    yuv_to_i420(src, pData, pData + luma, pData + luma + luma / 4, m_outWidth,
+                0, src.height);
+    break;
+  default: {
+    // RGB32 with a positive height is bottom-up
+    int stride = m_outWidth * 4;
+    BYTE *row0 = pData;
+    if (m_outHeight > 0) {
+      row0 += (size_t)stride * (outHeight - 1);
+      stride = -stride;
+    }
+    yuv_to_bgra(src,
+                (slot->color & FRAME_COLOR_BT709) ? YUV_MATRIX_BT709
+                                                  : YUV_MATRIX_BT601,
+                (slot->color & FRAME_COLOR_FULL_RANGE) ? YUV_RANGE_FULL
+                                                       : YUV_RANGE_LIMITED,
+                row0, stride, 0, src.height);
+    break;
+  }
+  }
+}
+
+// Black in the negotiated format (zero luma would be dark green in YUV)
+void CVCamStream::FillBlack(BYTE *pData, long size) {
+  size_t bytes = (size_t)size;
+  size_t luma = (size_t)m_outWidth * labs(m_outHeight);
+  if (luma > bytes)
+    luma = bytes;
+  switch (m_output) {
+  case OUTPUT_NV12:
+  case OUTPUT_I420:
+    memset(pData, 16, luma);
+    memset(pData + luma, 128, bytes - luma);
+    break;
+  case OUTPUT_YUY2:
+    for (size_t i = 0; i + 1 < bytes; i += 2) {
+      pData[i] = 16;
+      pData[i + 1] = 128;
+    }
+    break;
+  default:
+    memset(pData, 0, bytes);
+    break;
+  }
+}
+
+bool CVCamStream::ConvertLatestFrame(BYTE *pData, long size,
+                                     uint64_t *frameId,
+                                     uint64_t *timestampUs) {
+  if (!m_pSharedMem || m_pSharedMem->magic != SHARED_MEMORY_MAGIC ||
+      m_pSharedMem->version != SHARED_MEMORY_VERSION)
+    return false;
+  if (OutputImageSize(m_output, m_outWidth, m_outHeight) > (DWORD)size)
+    return false;
+
+  // Convert the newest frame of the ring. The writer never waits for us,
+  // so re-check the slot's seqlock afterwards and retry if it was reused
+  // mid-read (only possible if we are a whole ring behind).
+  for (int attempt = 0; attempt < FRAME_SLOT_COUNT; attempt++) {
+    // Sampled first: the frame we read is at least this new, so waiting on
+    // it afterwards can only wake early, never miss a frame.
+    uint32_t published = shm_load_acquire(&m_pSharedMem->write_sequence);
+    if (published == 0)
+      return false; // Receiver has not decoded anything yet
+
+    uint32_t index =
+        shm_load_acquire(&m_pSharedMem->latest_slot) % FRAME_SLOT_COUNT;
+    const FrameSlot *slot = &m_pSharedMem->slots[index];
+    uint32_t sequence = frame_slot_read_begin(slot);
+    if (sequence & 1)
+      continue; // Being written
+
+    // Checked before use: a torn read may leave any of these wrong
+    uint32_t width = slot->width, height = slot->height;
+    if (slot->format != FRAME_FORMAT_NV12 ||
+        slot->stride != frame_nv12_stride(width) ||
+        frame_nv12_bytes(width, height) > FRAME_BUFFER_SIZE) {
+      if (frame_slot_read_validate(slot, sequence))
+        return false; // Not a frame we can read
+      continue;
+    }
+    uint64_t id = slot->frame_id;
+    uint64_t timestamp = slot->timestamp_us;
+    // Stream size changed since the pin connected (e.g. portrait)
+    if ((LONG)width != m_outWidth || (LONG)height != labs(m_outHeight))
+      FillBlack(pData, size);
+    ConvertSlot(slot, pData);
+
+    if (frame_slot_read_validate(slot, sequence)) {
+      m_lastReadSequence = published;
+      *frameId = id;
+      *timestampUs = timestamp;
+      return true;
+    }
+  }
+  return false;
+}
+
 HRESULT CVCamStream::FillBuffer(IMediaSample *pms) {
   CheckPointer(pms, E_POINTER);
 
-  // Default to black if no data
   BYTE *pData;
   pms->GetPointer(&pData);
   long size = pms->GetSize();
 
-  // Check Shared Memory
+  // Check Shared Memory (the receiver may start after us)
   if (!m_pSharedMem) {
     InitSharedMemory();
   }
+  if (m_pSharedMem && !m_hFrameNotify) {
+    m_hFrameNotify = frame_notify_open();
+  }
 
-  // Safety clear to green so we know it's alive but not connected
-  memset(pData, 0, size); // Black
+  // Deliver as soon as the receiver publishes a frame. If none arrives
+  // within one negotiated frame interval of the previous delivery, repeat
+  // the last frame so the consumer still sees a steady stream.
+  REFERENCE_TIME interval = m_rtFrameInterval;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point deadline =
+      m_lastDelivery + std::chrono::microseconds(interval / 10);
+  if (deadline < now)
+    deadline = now; // First frame, or the consumer is pulling slowly
+
+  while ((now = std::chrono::steady_clock::now()) < deadline) {
+    uint32_t remainingUs = (uint32_t)
+        std::chrono::duration_cast<std::chrono::microseconds>(deadline - now)
+            .count();
+    if (!m_pSharedMem) {
+      Sleep((remainingUs + 999) / 1000); // Not connected: plain pacing
+      continue;
+    }
+    if (frame_notify_wait(m_pSharedMem, m_hFrameNotify, m_lastReadSequence,
+                          remainingUs))
+      break;
+  }
+  m_lastDelivery = std::chrono::steady_clock::now();
 
-  if (m_pSharedMem && m_pSharedMem->magic == 0x43424557) {
-    // Read from the currently active buffer (double-buffered for race-free
-    // access)
-    uint32_t readBuffer = m_pSharedMem->active_buffer;
-    memcpy(pData, (void *)m_pSharedMem->data[readBuffer], FRAME_BUFFER_SIZE);
-    m_lastReadSequence = m_pSharedMem->write_sequence;
+  uint64_t frameId = 0;
+  uint64_t timestampUs = 0;
+  bool haveFrame = ConvertLatestFrame(pData, size, &frameId, &timestampUs);
+  if (!haveFrame) {
+    FillBlack(pData, size); // Until the receiver has a frame
   }
+  bool repeated = !haveFrame || frameId == m_lastFrameId;
+  m_lastFrameId = frameId;
+
+  // Set timing. A fresh frame is stamped with its capture time: the
+  // receiver stores it on the system clock (Unix epoch), so shift "now" on
+  // the stream clock back by the frame's age. Repeats are stamped now.
+  CRefTime rtNow;
+  m_pFilter->StreamTime(rtNow);
+  REFERENCE_TIME rtStart = rtNow;
+  if (!repeated && timestampUs) {
+    int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    int64_t ageUs = nowUs - (int64_t)timestampUs;
+    // Ignore ages a bad clock offset would produce
+    if (ageUs > 0 && ageUs < 1000000)
+      rtStart -= ageUs * 10;
+  }
+  if (rtStart <= m_rtLastStart)
+    rtStart = m_rtLastStart + 1;
+  if (rtStart < 0)
+    rtStart = 0;
+  m_rtLastStart = rtStart;
 
-  // Set timing
-  CRefTime now;
-  m_pFilter->StreamTime(now);
-  REFERENCE_TIME rtStart = now;
-  REFERENCE_TIME rtEnd = rtStart + (10000000 / VIDEO_FPS);
+  REFERENCE_TIME rtEnd = rtStart + interval;
   pms->SetTime(&rtStart, &rtEnd);
   pms->SetSyncPoint(TRUE);
-
-  // Sleep to maintain framerate roughly (simple rate control)
-  Sleep(1000 / VIDEO_FPS);
+  // Tells consumers this sample carries no new picture
+  pms->SetDiscontinuity(repeated ? TRUE : FALSE);
 
   return S_OK;
 }
@@ -161,8 +425,17 @@ HRESULT CVCamStream::DecideBufferSize(IMemAllocator *pAlloc,
   return S_OK;
 }
 
+// Any of the offered types at the announced geometry
 HRESULT CVCamStream::CheckMediaType(const CMediaType *pMediaType) {
-  if (*pMediaType != m_mt)
+  CheckPointer(pMediaType, E_POINTER);
+  int output;
+  LONG width, height;
+  if (!ParseMediaType(pMediaType, &output, &width, &height))
+    return E_INVALIDARG;
+
+  LONG announcedWidth = VIDEO_WIDTH, announcedHeight = VIDEO_HEIGHT;
+  AnnouncedGeometry(&announcedWidth, &announcedHeight);
+  if (width != announcedWidth || labs(height) != announcedHeight)
     return E_INVALIDARG;
   return S_OK;
 }
@@ -170,20 +443,26 @@ HRESULT CVCamStream::CheckMediaType(const CMediaType *pMediaType) {
 HRESULT CVCamStream::GetMediaType(int iPosition, CMediaType *pmt) {
   if (iPosition < 0)
     return E_INVALIDARG;
-  if (iPosition > 0)
+  if (iPosition >= OUTPUT_COUNT)
     return VFW_S_NO_MORE_ITEMS;
 
+  // The receiver announces the stream's size as soon as it has parsed the
+  // SPS, so a graph built after that gets frames at their own geometry
+  LONG width = VIDEO_WIDTH, height = VIDEO_HEIGHT;
+  AnnouncedGeometry(&width, &height);
+
   VIDEOINFOHEADER *pvi =
       (VIDEOINFOHEADER *)pmt->AllocFormatBuffer(sizeof(VIDEOINFOHEADER));
   ZeroMemory(pvi, sizeof(VIDEOINFOHEADER));
 
-  pvi->bmiHeader.biCompression = BI_RGB;
-  pvi->bmiHeader.biBitCount = 32;
+  const OutputFormat &format = OUTPUT_FORMATS[iPosition];
+  pvi->bmiHeader.biCompression = format.compression;
+  pvi->bmiHeader.biBitCount = format.bitCount;
   pvi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-  pvi->bmiHeader.biWidth = VIDEO_WIDTH;
-  pvi->bmiHeader.biHeight = VIDEO_HEIGHT;
+  pvi->bmiHeader.biWidth = width;
+  pvi->bmiHeader.biHeight = height; // Bottom-up for RGB32
   pvi->bmiHeader.biPlanes = 1;
-  pvi->bmiHeader.biSizeImage = GetBitmapSize(&pvi->bmiHeader);
+  pvi->bmiHeader.biSizeImage = OutputImageSize(iPosition, width, height);
   pvi->bmiHeader.biClrImportant = 0;
 
   // Average Time Per Frame (100ns units)
@@ -193,8 +472,7 @@ HRESULT CVCamStream::GetMediaType(int iPosition, CMediaType *pmt) {
   pmt->SetFormatType(&FORMAT_VideoInfo);
   pmt->SetTemporalCompression(FALSE);
 
-  // SUBTYPE_RGB32
-  const GUID subtype = MEDIASUBTYPE_RGB32;
+  const GUID subtype = OutputSubtype(iPosition);
   pmt->SetSubtype(&subtype);
   pmt->SetSampleSize(pvi->bmiHeader.biSizeImage);
 
@@ -202,6 +480,16 @@ HRESULT CVCamStream::GetMediaType(int iPosition, CMediaType *pmt) {
 }
 
 HRESULT CVCamStream::SetMediaType(const CMediaType *pmt) {
-  // Should verify it works
-  return CSourceStream::SetMediaType(pmt);
+  HRESULT hr = CSourceStream::SetMediaType(pmt);
+  if (FAILED(hr))
+    return hr;
+  // FillBuffer converts every sample to this
+  int output;
+  LONG width, height;
+  if (!ParseMediaType(pmt, &output, &width, &height))
+    return E_INVALIDARG;
+  m_output = output;
+  m_outWidth = width;
+  m_outHeight = height;
+  return S_OK;
 }
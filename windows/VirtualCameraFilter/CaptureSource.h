@@ -1,6 +1,8 @@
 #pragma once
 #include <streams.h> // DirectShow BaseClasses
+#include "../common/FrameNotify.h"
 #include "../common/SharedMemory.h"
+#include <chrono>
 
 // UUIDs for our Filter using a generated GUID (Do not change this once registered)
 // {8E14549A-DB61-4309-AFA1-3578E927E933}
@@ -36,8 +38,20 @@ public:
 private:
     HANDLE m_hMapFile;
     SharedMemoryLayout* m_pSharedMem;
-    uint32_t m_lastReadSequence;
-    CCritSec m_cSharedState; // Lock
+    FrameNotifyHandle m_hFrameNotify; // Signalled by the receiver per frame
+    uint32_t m_lastReadSequence;      // write_sequence of the last copy
+    REFERENCE_TIME m_rtFrameInterval; // Repeat deadline (100ns units)
+    std::chrono::steady_clock::time_point m_lastDelivery;
+    uint64_t m_lastFrameId;        // FrameSlot::frame_id last delivered
+    REFERENCE_TIME m_rtLastStart;  // Keeps sample times increasing
+    int m_output;                  // OUTPUT_* the pin connected with
+    LONG m_outWidth, m_outHeight;  // Its biWidth/biHeight
     
     void InitSharedMemory();
+    REFERENCE_TIME FrameInterval(); // Negotiated AvgTimePerFrame
+    bool AnnouncedGeometry(LONG *width, LONG *height); // From the SPS
+    bool ConvertLatestFrame(BYTE *pData, long size, uint64_t *frameId,
+                            uint64_t *timestampUs);
+    void ConvertSlot(const FrameSlot *slot, BYTE *pData);
+    void FillBlack(BYTE *pData, long size);
 };
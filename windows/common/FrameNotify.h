@@ -0,0 +1,156 @@
+#pragma once
+#ifndef FRAME_NOTIFY_H
+#define FRAME_NOTIFY_H
+
+#include "SharedMemory.h"
+#include <limits.h>
+
+// "New frame published" signal from the receiver to the frame readers.
+//
+// Windows: two named manual-reset events, one per parity of
+// write_sequence. Publishing sequence s resets the event for s + 1, then
+// sets the one for s; a reader that has seen s - 1 waits on the latter.
+// A manual-reset event wakes every reader blocked on it and stays set until
+// the frame after next, so a slow reader cannot lose its wake-up to a fast
+// one re-waiting. The only late wake-up: if two frames are published
+// between a reader's sequence check and its wait, its event has been reset
+// again and it sleeps until the next frame (or its timeout), at most one
+// frame late.
+//
+// Linux: a futex on write_sequence itself; no extra object is needed.
+//
+// Readers always compare write_sequence before waiting, so a frame
+// published between the check and the wait is never missed.
+
+#define SHARED_MEMORY_FRAME_EVENT_NAME "Local\\AntiGravityWebcamFrame"
+
+#ifdef _WIN32
+#include <windows.h>
+
+struct FrameNotifyEvents {
+  HANDLE events[2]; // Set once write_sequence reaches an even / odd value
+};
+typedef FrameNotifyEvents *FrameNotifyHandle;
+
+static inline void frame_notify_close(FrameNotifyHandle handle) {
+  if (!handle)
+    return;
+  for (HANDLE event : handle->events) {
+    if (event)
+      CloseHandle(event);
+  }
+  delete handle;
+}
+
+// `create`: writer side, creates the events if needed; else opens them.
+static inline FrameNotifyHandle frame_notify_get(int session, bool create) {
+  static const char *const SUFFIX[2] = {"Even", "Odd"};
+  FrameNotifyHandle handle = new FrameNotifyEvents();
+  for (int i = 0; i < 2; i++) {
+    char base[FRAME_BUS_NAME_SIZE];
+    char name[FRAME_BUS_NAME_SIZE];
+    snprintf(base, sizeof(base), "%s%s", SHARED_MEMORY_FRAME_EVENT_NAME,
+             SUFFIX[i]);
+    frame_bus_name(name, sizeof(name), base, session);
+    handle->events[i] = create ? CreateEventA(NULL, TRUE, FALSE, name)
+                               : OpenEventA(SYNCHRONIZE, FALSE, name);
+    if (!handle->events[i]) {
+      frame_notify_close(handle);
+      return NULL;
+    }
+  }
+  return handle;
+}
+
+// Writer side: creates (or opens) the events of a session's frame bus.
+// NULL on failure.
+static inline FrameNotifyHandle frame_notify_create(int session = 0) {
+  return frame_notify_get(session, true);
+}
+
+// Reader side: NULL if the receiver has not created them yet.
+static inline FrameNotifyHandle frame_notify_open(int session = 0) {
+  return frame_notify_get(session, false);
+}
+#else
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+typedef int FrameNotifyHandle; // The futex lives in the mapping itself
+
+static inline FrameNotifyHandle frame_notify_create(int = 0) { return 1; }
+static inline FrameNotifyHandle frame_notify_open(int = 0) { return 1; }
+static inline void frame_notify_close(FrameNotifyHandle) {}
+#endif
+
+// Call after frame_slot_end_write(). Wakes every reader blocked in
+// frame_notify_wait().
+static inline void frame_notify_publish(SharedMemoryLayout *shm,
+                                        FrameNotifyHandle handle) {
+#ifdef _WIN32
+  // Unconditional: skipping a reset would leave a stale event set for the
+  // next reader. Reset first so that no instant has both events set.
+  if (handle) {
+    uint32_t sequence = shm_load_acquire(&shm->write_sequence);
+    ResetEvent(handle->events[(sequence + 1) & 1]);
+    SetEvent(handle->events[sequence & 1]);
+  }
+#elif defined(__linux__)
+  (void)handle;
+  // Pairs with the waiter's increment-then-recheck: either it sees the new
+  // write_sequence or we see it in waiter_count.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (shm->waiter_count == 0)
+    return;
+  syscall(SYS_futex, (uint32_t *)&shm->write_sequence, FUTEX_WAKE, INT_MAX,
+          NULL, NULL, 0);
+#else
+  (void)shm;
+  (void)handle;
+#endif
+}
+
+// Blocks until write_sequence differs from `seen` or `timeoutUs` elapses.
+// Returns true if a new frame was published. May return false early
+// (spurious wake-up); callers loop against their own deadline.
+static inline bool frame_notify_wait(SharedMemoryLayout *shm,
+                                     FrameNotifyHandle handle, uint32_t seen,
+                                     uint32_t timeoutUs) {
+  if (shm_load_acquire(&shm->write_sequence) != seen)
+    return true;
+  if (timeoutUs == 0)
+    return false;
+
+#ifdef _WIN32
+  if (!handle) {
+    Sleep((timeoutUs + 999) / 1000);
+    return shm_load_acquire(&shm->write_sequence) != seen;
+  }
+
+  // Set when write_sequence reaches seen + 1. Round up so the deadline is
+  // never missed by a partial millisecond.
+  WaitForSingleObject(handle->events[(seen + 1) & 1], (timeoutUs + 999) / 1000);
+  return shm_load_acquire(&shm->write_sequence) != seen;
+#elif defined(__linux__)
+  (void)handle;
+  __atomic_add_fetch(&shm->waiter_count, 1, __ATOMIC_SEQ_CST);
+  struct timespec timeout;
+  timeout.tv_sec = timeoutUs / 1000000;
+  timeout.tv_nsec = (long)(timeoutUs % 1000000) * 1000;
+  // Returns immediately (EAGAIN) if write_sequence already moved on
+  syscall(SYS_futex, (uint32_t *)&shm->write_sequence, FUTEX_WAIT, seen,
+          &timeout, NULL, 0);
+  __atomic_sub_fetch(&shm->waiter_count, 1, __ATOMIC_SEQ_CST);
+  return shm_load_acquire(&shm->write_sequence) != seen;
+#else
+  (void)handle;
+  usleep(timeoutUs < 1000 ? timeoutUs : 1000); // Polling fallback
+  return shm_load_acquire(&shm->write_sequence) != seen;
+#endif
+}
+
+#endif // FRAME_NOTIFY_H
@@ -2,46 +2,164 @@
 #ifndef SHARED_MEMORY_H
 #define SHARED_MEMORY_H
 
+#include <atomic>
 #include <stdint.h>
+#include <stdio.h>
 
 // Protocol Constants
 #define SHARED_MEMORY_NAME "Local\\AntiGravityWebcamSource"
+#define SHARED_MEMORY_POSIX_NAME "/AntiGravityWebcamSource" // shm_open()
+#define SHARED_MEMORY_MAGIC 0x43424557 // 'WEBC'
+#define SHARED_MEMORY_VERSION 4
 #define VIDEO_WIDTH 1280
 #define VIDEO_HEIGHT 720
 #define VIDEO_FPS 30
 
-// Pixel Format: BGRA (32-bit)
-// Size: 1280 * 720 * 4 = 3,686,400 bytes
+// One frame bus per receiver session. Session 0 uses the plain names above
+// (what the virtual camera opens); session n >= 1 appends "_<n>".
+#define FRAME_BUS_MAX_SESSIONS 16
+#define FRAME_BUS_NAME_SIZE 64
+
+static inline void frame_bus_name(char *out, size_t outSize, const char *base,
+                                  int session) {
+  if (session == 0)
+    snprintf(out, outSize, "%s", base);
+  else
+    snprintf(out, outSize, "%s_%d", base, session);
+}
+
+// Slot capacity: 1280 * 720 * 4 = 3,686,400 bytes. Frames are published as
+// NV12 (12 bits per pixel), so anything up to 1920x1080 fits.
 #define FRAME_BUFFER_SIZE (VIDEO_WIDTH * VIDEO_HEIGHT * 4)
 
+// Frame ring depth. Three slots let the writer fill one while readers copy
+// the newest and a slow reader still finishes the one before.
+#define FRAME_SLOT_COUNT 3
+
+// FrameSlot::format values (0 was BGRA, up to version 3)
+#define FRAME_FORMAT_NV12 1 // Y plane, then the interleaved UV plane
+
+// FrameSlot::color flags: what a reader converting to RGB needs to know
+#define FRAME_COLOR_BT709 1      // Else BT.601
+#define FRAME_COLOR_FULL_RANGE 2 // Else limited (16-235)
+
+// NV12 in a slot: both planes are `stride` bytes per row, and the
+// (height + 1) / 2 rows of UV start right after the height rows of Y
+static inline uint32_t frame_nv12_stride(uint32_t width) {
+  return (width + 1) & ~1u;
+}
+
+static inline size_t frame_nv12_bytes(uint32_t width, uint32_t height) {
+  return (size_t)frame_nv12_stride(width) * (height + (height + 1) / 2);
+}
+
 #pragma pack(1)
+// One frame of the ring, guarded by its own seqlock counter.
+// Writer: sequence -> odd, fill, sequence -> even.
+// Reader: read sequence (retry if odd), copy, re-read; equal means untorn.
+struct FrameSlot {
+  volatile uint32_t sequence;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride; // Bytes per row, of each plane
+  uint32_t format; // FRAME_FORMAT_*
+  uint32_t color;  // FRAME_COLOR_* flags
+  uint64_t timestamp_us; // Capture time, receiver clock (Unix epoch)
+  uint64_t frame_id;     // write_sequence value this frame was published as
+  uint8_t reserved1[24]; // Keeps data 64-byte aligned
+
+  uint8_t data[FRAME_BUFFER_SIZE];
+};
+
 struct SharedMemoryLayout {
   uint32_t magic;   // 'WEBC' (0x43424557)
-  uint32_t version; // Version 2 (added double-buffering)
+  uint32_t version; // Version 4 (seqlock frame ring, NV12)
 
-  // Writers increment this after writing data.
-  // Readers poll this to detect new frames.
+  // Number of frames published so far; bumped after each frame.
   volatile uint32_t write_sequence;
 
-  // Double-buffering: Active buffer index (0 or 1)
-  // Writer updates this AFTER completing a frame write
-  volatile uint32_t active_buffer;
+  // Slot holding the newest complete frame
+  volatile uint32_t latest_slot;
+
+  uint32_t slot_count; // FRAME_SLOT_COUNT
 
+  // Geometry of the newest frame, or of the next one once the receiver has
+  // parsed a new SPS (for readers picking a media type)
   uint32_t width;
   uint32_t height;
 
-  // Timestamp in microseconds (useful for A/V sync later)
-  uint64_t timestamp_us;
+  // Readers currently blocked in frame_notify_wait() on the futex (Linux).
+  // Lets the writer skip the wake-up syscall when nobody is waiting.
+  volatile uint32_t waiter_count;
+
+  uint8_t reserved[32]; // Header padded to 64 bytes
 
-  // Double-buffered frame data for race-free access
-  // Reader reads from active_buffer, writer writes to (active_buffer ^ 1)
-  uint8_t data[2][FRAME_BUFFER_SIZE];
+  FrameSlot slots[FRAME_SLOT_COUNT];
 };
 #pragma pack() // Restore default alignment
 
 // Verify structure size to ensure packing is working
-// Header: 32 bytes + 2 buffers * 3,686,400 = 7,372,832 bytes
-static_assert(sizeof(struct SharedMemoryLayout) == (32 + 2 * FRAME_BUFFER_SIZE),
+// Header: 64 bytes + 3 slots * (64 + 3,686,400) = 11,059,456 bytes
+static_assert(sizeof(FrameSlot) == 64 + FRAME_BUFFER_SIZE,
+              "FrameSlot size mismatch");
+static_assert(sizeof(struct SharedMemoryLayout) ==
+                  (64 + FRAME_SLOT_COUNT * sizeof(FrameSlot)),
               "SharedMemoryLayout size mismatch");
 
+// Cross-process ordering for the header/slot counters. The fences emit the
+// required hardware barriers; volatile keeps the compiler from caching or
+// splitting the aligned 32-bit accesses.
+static inline uint32_t shm_load_acquire(const volatile uint32_t *p) {
+  uint32_t v = *p;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return v;
+}
+
+static inline void shm_store_release(volatile uint32_t *p, uint32_t v) {
+  std::atomic_thread_fence(std::memory_order_release);
+  *p = v;
+}
+
+// Writer side (single writer). Never blocks: the slot after the newest one
+// is claimed, and readers still copying from it will notice and retry.
+static inline FrameSlot *frame_slot_begin_write(SharedMemoryLayout *shm) {
+  uint32_t index = (shm->latest_slot + 1) % FRAME_SLOT_COUNT;
+  FrameSlot *slot = &shm->slots[index];
+  slot->sequence = slot->sequence + 1; // Odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  return slot;
+}
+
+static inline void frame_slot_end_write(SharedMemoryLayout *shm,
+                                        FrameSlot *slot) {
+  uint32_t index = (uint32_t)(slot - shm->slots);
+  slot->frame_id = shm->write_sequence + 1;
+  shm_store_release(&slot->sequence, slot->sequence + 1); // Even: stable
+  shm->width = slot->width;
+  shm->height = slot->height;
+  shm_store_release(&shm->latest_slot, index);
+  shm_store_release(&shm->write_sequence, shm->write_sequence + 1);
+}
+
+// Writer side, ahead of a geometry change
+static inline void frame_bus_announce_geometry(SharedMemoryLayout *shm,
+                                               uint32_t width,
+                                               uint32_t height) {
+  shm->width = width;
+  shm->height = height;
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Reader side. Returns the slot's sequence; odd means mid-write, retry.
+static inline uint32_t frame_slot_read_begin(const FrameSlot *slot) {
+  return shm_load_acquire(&slot->sequence);
+}
+
+// True if nothing was written to the slot since frame_slot_read_begin().
+static inline bool frame_slot_read_validate(const FrameSlot *slot,
+                                            uint32_t sequence) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot->sequence == sequence;
+}
+
 #endif // SHARED_MEMORY_H